@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""Generated-code benchmarks: bytes per function, string pool bytes and cycles per kernel.
+
+Each bench/<kernel>.c is compiled with the host tools, run under zsim and
+checked against its expected exit code. The results are compared with the
+committed baseline; any metric that grows by more than --threshold percent
+is reported as a regression.
+"""
+import argparse
+import platform
+import re
+import subprocess
+import sys
+from pathlib import Path
+
+
+RED = "\033[0;31m"
+GREEN = "\033[0;32m"
+YELLOW = "\033[1;33m"
+BLUE = "\033[0;34m"
+NC = "\033[0m"
+
+ROOT = Path(__file__).resolve().parent.parent
+BENCH_DIR = ROOT / "bench"
+
+# Kernel -> exit code of a correct run (each kernel self-checks)
+EXPECTED_RESULTS = {
+    "memcpy": "74",
+    "crc16": "A9",
+    "sort": "B5",
+    "strscan": "8F",
+    "fixed": "1F",
+    "fsm": "5C",
+}
+
+PIPELINES = {
+    "stream": ("cc_semantic", "cc_codegen"),
+    "ir": ("cc_lower", "cc_isel"),
+}
+
+STRING_RE = re.compile(r"^_s\d+$")
+FUNC_RE = re.compile(r"^[A-Za-z_][\w\s\*]*?\b([A-Za-z_]\w*)\s*\([^;]*\)\s*\{?\s*$")
+
+
+def host_arch() -> str:
+    sys_name = platform.system()
+    if sys_name == "Darwin":
+        return "darwin"
+    if sys_name == "Linux":
+        return "linux"
+    return sys_name
+
+
+def tool(name: str) -> str:
+    return str(ROOT / "bin" / f"{name}_{host_arch()}")
+
+
+def run_cmd_capture(cmd):
+    try:
+        return subprocess.run(cmd, check=False, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    except FileNotFoundError:
+        return None
+
+
+def source_functions(src: Path):
+    names = []
+    for line in src.read_text().splitlines():
+        match = FUNC_RE.match(line)
+        if match and match.group(1) not in ("if", "while", "for", "return"):
+            names.append(match.group(1))
+    return names
+
+
+def compile_kernel(name: str, pipeline: str):
+    src = BENCH_DIR / f"{name}.c"
+    ast = BENCH_DIR / f"{name}.ast"
+    asm = BENCH_DIR / f"{name}.asm"
+    middle, back = PIPELINES[pipeline]
+    if pipeline == "stream":
+        steps = [
+            [tool("cc_parse"), str(src), str(ast)],
+            [tool(middle), str(ast)],
+            [tool(back), str(ast), str(asm)],
+        ]
+    else:
+        ir = BENCH_DIR / f"{name}.ir"
+        steps = [
+            [tool("cc_parse"), str(src), str(ast)],
+            [tool(middle), str(ast), str(ir)],
+            [tool(back), str(ir), str(asm)],
+        ]
+    for step in steps:
+        result = run_cmd_capture(step)
+        if result is None or result.returncode != 0:
+            return None, f"{Path(step[0]).name} failed"
+    return asm, None
+
+
+def measure(name: str, pipeline: str):
+    asm, error = compile_kernel(name, pipeline)
+    if asm is None:
+        return None, error
+
+    result = run_cmd_capture([tool("zsim"), "--quiet", "--sizes", "--csv", str(asm)])
+    if result is None:
+        return None, "zsim not found"
+    status = re.search(r"exit=0x([0-9A-F]+)\s+cycles=(\d+)", result.stderr)
+    if not status:
+        return None, result.stderr.strip().splitlines()[-1] if result.stderr.strip() else "no status"
+    if status.group(1) != EXPECTED_RESULTS[name]:
+        return None, f"exit 0x{status.group(1)}, expected 0x{EXPECTED_RESULTS[name]}"
+
+    sizes = {}
+    for line in result.stdout.splitlines()[1:]:
+        parts = line.split(",")
+        if len(parts) == 3:
+            sizes[parts[0]] = int(parts[2])
+
+    metrics = {"cycles": int(status.group(2))}
+    total = 0
+    for func in source_functions(BENCH_DIR / f"{name}.c"):
+        if func in sizes:
+            metrics[f"bytes.{func}"] = sizes[func]
+            total += sizes[func]
+    metrics["bytes"] = total
+    # String literal pool, which shrinks when literals share a suffix
+    pool = sum(size for label, size in sizes.items() if STRING_RE.match(label))
+    if pool:
+        metrics["strings"] = pool
+    return metrics, None
+
+
+def load_baseline(path: Path):
+    baseline = {}
+    if not path.exists():
+        return baseline
+    for line in path.read_text().splitlines():
+        if not line.strip() or line.startswith("#"):
+            continue
+        kernel, metric, value = line.split("\t")
+        baseline[(kernel, metric)] = int(value)
+    return baseline
+
+
+def write_baseline(path: Path, results, pipeline: str) -> None:
+    lines = [f"# kernel\tmetric\tvalue ({pipeline} pipeline; regenerate with bench/bench.py --update)"]
+    for kernel in EXPECTED_RESULTS:
+        metrics = results.get(kernel)
+        if not metrics:
+            continue
+        for metric in sorted(metrics, key=lambda m: (m != "cycles", m != "bytes", m)):
+            lines.append(f"{kernel}\t{metric}\t{metrics[metric]}")
+    path.write_text("\n".join(lines) + "\n")
+
+
+def format_delta(old: int, new: int) -> str:
+    if old == 0:
+        return "new" if new else "0.0%"
+    return f"{(new - old) * 100.0 / old:+.1f}%"
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Run the generated-code benchmarks")
+    parser.add_argument("kernels", nargs="*", help="kernels to run (default: all)")
+    parser.add_argument("--pipeline", choices=sorted(PIPELINES), default="stream",
+                        help="back end to measure (default: stream)")
+    parser.add_argument("--baseline", type=Path, help="baseline file (default: bench/baseline[-ir].txt)")
+    parser.add_argument("--threshold", type=float, default=2.0,
+                        help="percent growth reported as a regression (default: 2.0)")
+    parser.add_argument("--update", action="store_true", help="rewrite the baseline with these results")
+    parser.add_argument("--verbose", action="store_true", help="list per-function sizes")
+    args = parser.parse_args()
+
+    kernels = args.kernels or list(EXPECTED_RESULTS)
+    for kernel in kernels:
+        if kernel not in EXPECTED_RESULTS:
+            print(f"{RED}Unknown kernel: {kernel}{NC}")
+            return 2
+
+    baseline_path = args.baseline
+    if baseline_path is None:
+        suffix = "" if args.pipeline == "stream" else f"-{args.pipeline}"
+        baseline_path = BENCH_DIR / f"baseline{suffix}.txt"
+    baseline = load_baseline(baseline_path)
+
+    results = {}
+    failed = 0
+    regressions = 0
+    name_width = max(len(k) for k in kernels)
+
+    print(f"{BLUE}{'kernel':<{name_width}} {'cycles':>10} {'delta':>8} {'bytes':>7} {'delta':>8}{NC}")
+    for kernel in kernels:
+        metrics, error = measure(kernel, args.pipeline)
+        if metrics is None:
+            print(f"{RED}✗{NC} {kernel:<{name_width - 2}} {error}")
+            failed += 1
+            continue
+        results[kernel] = metrics
+
+        notes = []
+        row = f"{kernel:<{name_width}}"
+        for metric in ("cycles", "bytes"):
+            old = baseline.get((kernel, metric))
+            new = metrics[metric]
+            delta = "-" if old is None else format_delta(old, new)
+            row += f" {new:>{10 if metric == 'cycles' else 7}} {delta:>8}"
+        for metric, new in metrics.items():
+            old = baseline.get((kernel, metric))
+            if old is None or new <= old:
+                continue
+            if old == 0 or (new - old) * 100.0 / old > args.threshold:
+                notes.append(f"{metric} {old} -> {new} ({format_delta(old, new)})")
+        if notes:
+            regressions += 1
+            print(f"{RED}{row}{NC}")
+            for note in notes:
+                print(f"  > regression: {note}")
+        else:
+            print(row)
+        if args.verbose:
+            for metric, value in metrics.items():
+                if metric.startswith("bytes."):
+                    print(f"    {metric[6:]:<20} {value:>6}")
+
+    if args.update:
+        if failed:
+            print(f"{RED}Not updating {baseline_path}: {failed} kernel(s) failed{NC}")
+            return 1
+        merged = {}
+        for (kernel, metric), value in baseline.items():
+            merged.setdefault(kernel, {})[metric] = value
+        for kernel, metrics in results.items():
+            merged[kernel] = metrics
+        write_baseline(baseline_path, merged, args.pipeline)
+        print(f"{GREEN}Updated {baseline_path.relative_to(ROOT)}{NC}")
+        return 0
+
+    if failed or regressions:
+        print(f"\n{RED}{failed} failed, {regressions} regressed (threshold {args.threshold}%){NC}")
+        return 1
+    if not baseline:
+        print(f"\n{YELLOW}No baseline at {baseline_path}; run with --update to record one{NC}")
+        return 0
+    print(f"\n{GREEN}All kernels within {args.threshold}% of the baseline{NC}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,55 @@
+/* CRC-16/CCITT-FALSE, bitwise, over a string and a generated buffer */
+char* g_check = "123456789";
+unsigned char g_data[64];
+
+int crc16_update(int crc, unsigned char byte) {
+    unsigned char bit;
+
+    crc = crc ^ (byte << 8);
+    for (bit = 0; bit < 8; bit++) {
+        if (crc & 0x8000) {
+            crc = (crc << 1) ^ 0x1021;
+        } else {
+            crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+int crc16_string(char* s) {
+    int crc;
+    int i;
+
+    crc = 0xFFFF;
+    i = 0;
+    while (s[i]) {
+        crc = crc16_update(crc, s[i]);
+        i = i + 1;
+    }
+    return crc;
+}
+
+int crc16_buffer(unsigned char* buf, int n) {
+    int crc;
+    int i;
+
+    crc = 0xFFFF;
+    for (i = 0; i < n; i++) {
+        crc = crc16_update(crc, buf[i]);
+    }
+    return crc;
+}
+
+int main() {
+    int i;
+    int a;
+    int b;
+
+    for (i = 0; i < 64; i++) {
+        g_data[i] = i * 3;
+    }
+    a = crc16_string(g_check);
+    if (a != 0x29B1) return 0x01;
+    b = crc16_buffer(g_data, 64);
+    return (b ^ (b >> 8)) & 0xFF;
+}
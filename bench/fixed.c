@@ -0,0 +1,53 @@
+/* 8.8 fixed-point arithmetic: multiply, square root and a damped series */
+int fx_mul(int a, int b) {
+    int ah;
+    int al;
+    int bh;
+    int bl;
+
+    ah = a >> 8;
+    al = a & 0xFF;
+    bh = b >> 8;
+    bl = b & 0xFF;
+    return ((ah * bh) << 8) + ah * bl + al * bh + ((al * bl) >> 8);
+}
+
+int fx_sqrt(int x) {
+    int r;
+    int i;
+
+    r = x;
+    if (r > 0x1000) r = 0x1000;
+    for (i = 0; i < 8; i++) {
+        r = (r + ((x / (r >> 4)) << 4)) >> 1;
+    }
+    return r;
+}
+
+int fx_series(int x, int n) {
+    int term;
+    int sum;
+    int i;
+
+    term = 0x100;
+    sum = 0;
+    for (i = 0; i < n; i++) {
+        sum = sum + term;
+        term = fx_mul(term, x);
+    }
+    return sum;
+}
+
+int main() {
+    int p;
+    int s;
+    int g;
+
+    p = fx_mul(0x0280, 0x0340);
+    if (p != 0x0820) return 0x01;
+    s = fx_sqrt(0x1000);
+    if (s < 0x3F0 || s > 0x410) return 0x02;
+    g = fx_series(0x0080, 10);
+    if (g < 0x1F0 || g > 0x200) return 0x03;
+    return (p + s + g) & 0xFF;
+}
@@ -0,0 +1,88 @@
+/* Table- and branch-driven state machine tokenising a command stream */
+char* g_input = "set x 12; add y 300; mul x 7; print x; set  zz 65535 ; print zz;;";
+unsigned char g_class[128];
+unsigned char g_next[20];
+
+int g_tokens;
+int g_numbers;
+int g_value;
+int g_checksum;
+
+void init_classes(void) {
+    int i;
+
+    for (i = 0; i < 128; i++) {
+        g_class[i] = 0;
+    }
+    for (i = 'a'; i <= 'z'; i++) {
+        g_class[i] = 1;
+    }
+    for (i = '0'; i <= '9'; i++) {
+        g_class[i] = 2;
+    }
+    g_class[' '] = 3;
+    g_class[';'] = 4;
+    /* next state = g_next[state * 5 + class] */
+    g_next[0] = 0; g_next[1] = 1; g_next[2] = 2; g_next[3] = 0; g_next[4] = 3;
+    g_next[5] = 0; g_next[6] = 1; g_next[7] = 1; g_next[8] = 0; g_next[9] = 3;
+    g_next[10] = 0; g_next[11] = 1; g_next[12] = 2; g_next[13] = 0; g_next[14] = 3;
+    g_next[15] = 0; g_next[16] = 1; g_next[17] = 2; g_next[18] = 0; g_next[19] = 3;
+}
+
+void on_enter(unsigned char state, unsigned char c) {
+    if (state == 1) {
+        g_tokens = g_tokens + 1;
+        g_checksum = g_checksum + c;
+    } else if (state == 2) {
+        g_value = c - '0';
+    } else if (state == 3) {
+        g_checksum = g_checksum ^ 0x55;
+    }
+}
+
+void on_stay(unsigned char state, unsigned char c) {
+    if (state == 1) {
+        g_checksum = g_checksum + c;
+    } else if (state == 2) {
+        g_value = g_value * 10 + (c - '0');
+    }
+}
+
+void on_leave(unsigned char state) {
+    if (state == 2) {
+        g_numbers = g_numbers + 1;
+        g_checksum = g_checksum + g_value;
+    }
+}
+
+int run(char* s) {
+    unsigned char state;
+    unsigned char next;
+    unsigned char c;
+    int i;
+
+    state = 0;
+    for (i = 0; s[i]; i++) {
+        c = s[i];
+        next = g_next[state * 5 + g_class[c & 0x7F]];
+        if (next != state) {
+            on_leave(state);
+            on_enter(next, c);
+        } else {
+            on_stay(state, c);
+        }
+        state = next;
+    }
+    on_leave(state);
+    return g_tokens;
+}
+
+int main() {
+    int tokens;
+
+    init_classes();
+    tokens = run(g_input);
+    if (tokens != 12) return 0x01;
+    if (g_numbers != 4) return 0x02;
+    return g_checksum & 0xFF;
+}
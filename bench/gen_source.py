@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Generate a synthetic C source in the subset cc_parse accepts.
+
+The output is deterministic for a given seed, so sizes can be compared
+across compiler changes. Every knob scales one input dimension:
+
+  --functions   number of functions (plus main, which calls each one)
+  --locals      locals declared per function
+  --depth       nesting depth of the generated expressions
+  --globals     global variables (distinct identifiers in the string table)
+  --strings     global string literals (and as many local literal uses)
+"""
+import argparse
+import random
+import sys
+
+
+BINARY_OPS = ["+", "-", "&", "|", "^", "+", "-"]
+COMPARE_OPS = ["<", ">", "==", "!=", "<=", ">="]
+
+
+class Generator:
+    def __init__(self, args):
+        self.args = args
+        self.rng = random.Random(args.seed)
+        self.globals = [f"g_v{i}" for i in range(args.globals)]
+        self.strings = [f"g_s{i}" for i in range(args.strings)]
+
+    def leaf(self, names):
+        pick = self.rng.randrange(4)
+        if pick == 0 or not names:
+            return str(self.rng.randrange(1, 100))
+        if pick == 1 and self.globals:
+            return self.rng.choice(self.globals)
+        if pick == 2 and self.strings:
+            return f"{self.rng.choice(self.strings)}[{self.rng.randrange(4)}]"
+        return self.rng.choice(names)
+
+    def expr(self, names, depth):
+        if depth <= 0:
+            return self.leaf(names)
+        left = self.expr(names, depth - 1)
+        right = self.expr(names, self.rng.randrange(depth))
+        return f"({left} {self.rng.choice(BINARY_OPS)} {right})"
+
+    def function(self, index):
+        args = self.args
+        names = ["a", "b"] + [f"l{i}" for i in range(args.locals)]
+        lines = [f"int f{index}(int a, char b) {{"]
+        for i in range(args.locals):
+            kind = "int" if i % 3 else "char"
+            lines.append(f"    {kind} l{i};")
+        if args.strings:
+            lines.append("    char* p;")
+        lines.append("")
+        for i in range(args.locals):
+            lines.append(f"    l{i} = {self.expr(names[:2 + i], min(args.depth, 2))};")
+        if args.strings:
+            lines.append(f"    p = \"local string {index}\";")
+        target = self.rng.choice(names[2:] or ["a"])
+        cond = f"{self.expr(names, 1)} {self.rng.choice(COMPARE_OPS)} {self.leaf(names)}"
+        lines.append(f"    if ({cond}) {{")
+        lines.append(f"        {target} = {self.expr(names, args.depth)};")
+        lines.append("    } else {")
+        lines.append(f"        {target} = {self.expr(names, args.depth)};")
+        lines.append("    }")
+        lines.append(f"    while ({target} > 200) {{")
+        lines.append(f"        {target} = {target} - 7;")
+        lines.append("    }")
+        if self.globals:
+            lines.append(f"    {self.rng.choice(self.globals)} = {self.expr(names, args.depth)};")
+        result = self.expr(names, args.depth)
+        if args.strings:
+            result = f"{result} + p[{index % 8}]"
+        lines.append(f"    return {result};")
+        lines.append("}")
+        return lines
+
+    def source(self):
+        args = self.args
+        lines = [
+            f"/* Generated by bench/gen_source.py --functions {args.functions} "
+            f"--locals {args.locals} --depth {args.depth} --globals {args.globals} "
+            f"--strings {args.strings} --seed {args.seed} */",
+        ]
+        for i, name in enumerate(self.strings):
+            lines.append(f"char* {name} = \"synthetic string number {i}\";")
+        for name in self.globals:
+            lines.append(f"int {name};")
+        lines.append("")
+        for i in range(args.functions):
+            lines.extend(self.function(i))
+            lines.append("")
+        lines.append("int main() {")
+        lines.append("    int r;")
+        lines.append("")
+        lines.append("    r = 0;")
+        for i in range(args.functions):
+            lines.append(f"    r = r + f{i}({self.rng.randrange(100)}, {self.rng.randrange(100)});")
+        lines.append("    return r & 0xFF;")
+        lines.append("}")
+        return "\n".join(lines) + "\n"
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Generate a synthetic C source for throughput tests")
+    parser.add_argument("--functions", type=int, default=8)
+    parser.add_argument("--locals", type=int, default=4)
+    parser.add_argument("--depth", type=int, default=3)
+    parser.add_argument("--globals", type=int, default=4)
+    parser.add_argument("--strings", type=int, default=2)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    args = parser.parse_args()
+
+    text = Generator(args).source()
+    if args.output:
+        with open(args.output, "w") as out:
+            out.write(text)
+    else:
+        sys.stdout.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
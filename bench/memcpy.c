@@ -0,0 +1,59 @@
+/* Byte and word copy loops over global buffers */
+unsigned char g_src[128];
+unsigned char g_dst[128];
+int g_words[32];
+int g_words_out[32];
+
+void fill(unsigned char* buf, int n, unsigned char seed) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        buf[i] = seed;
+        seed = seed * 5 + 1;
+    }
+}
+
+void copy_bytes(unsigned char* dst, unsigned char* src, int n) {
+    int i;
+
+    for (i = 0; i < n; i++) {
+        dst[i] = src[i];
+    }
+}
+
+void copy_words(int* dst, int* src, int n) {
+    int i;
+
+    i = 0;
+    while (i < n) {
+        dst[i] = src[i];
+        i = i + 1;
+    }
+}
+
+unsigned char sum_bytes(unsigned char* buf, int n) {
+    unsigned char sum;
+    int i;
+
+    sum = 0;
+    for (i = 0; i < n; i++) {
+        sum = sum + buf[i];
+    }
+    return sum;
+}
+
+int main() {
+    int i;
+    int check;
+
+    fill(g_src, 128, 7);
+    for (i = 0; i < 32; i++) {
+        g_words[i] = i * 37;
+    }
+    copy_bytes(g_dst, g_src, 128);
+    copy_words(g_words_out, g_words, 32);
+
+    check = sum_bytes(g_dst, 128);
+    check = check + g_words_out[31] + g_words_out[5];
+    return check;
+}
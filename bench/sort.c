@@ -0,0 +1,65 @@
+/* Insertion sort and bubble sort over int and byte arrays */
+int g_values[40];
+unsigned char g_bytes[48];
+
+void insertion_sort(int* a, int n) {
+    int i;
+    int j;
+    int key;
+
+    for (i = 1; i < n; i++) {
+        key = a[i];
+        j = i;
+        while (j > 0 && a[j - 1] > key) {
+            a[j] = a[j - 1];
+            j = j - 1;
+        }
+        a[j] = key;
+    }
+}
+
+void bubble_sort(unsigned char* a, int n) {
+    int i;
+    int j;
+    unsigned char t;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j + 1 < n - i; j++) {
+            if (a[j] > a[j + 1]) {
+                t = a[j];
+                a[j] = a[j + 1];
+                a[j + 1] = t;
+            }
+        }
+    }
+}
+
+int is_sorted(int* a, int n) {
+    int i;
+
+    for (i = 1; i < n; i++) {
+        if (a[i - 1] > a[i]) return 0;
+    }
+    return 1;
+}
+
+int main() {
+    int i;
+    int seed;
+
+    seed = 13;
+    for (i = 0; i < 40; i++) {
+        seed = seed * 75 + 74;
+        g_values[i] = seed & 0x3FFF;
+    }
+    for (i = 0; i < 48; i++) {
+        g_bytes[i] = (i * 29 + 11) & 0xFF;
+    }
+    insertion_sort(g_values, 40);
+    bubble_sort(g_bytes, 48);
+    if (!is_sorted(g_values, 40)) return 0x01;
+    for (i = 1; i < 48; i++) {
+        if (g_bytes[i - 1] > g_bytes[i]) return 0x02;
+    }
+    return (g_values[0] + g_values[39] + g_bytes[0] + g_bytes[47]) & 0xFF;
+}
@@ -0,0 +1,77 @@
+/* String length, character counting and substring search */
+char* g_text = "the quick brown fox jumps over the lazy dog while the cat sleeps";
+char* g_cat = "cat";
+char* g_cow = "cow";
+char* g_sleeps = "sleeps"; /* ends g_text, so the literal pool shares its bytes */
+
+int str_length(char* s) {
+    int n;
+
+    n = 0;
+    while (s[n]) {
+        n = n + 1;
+    }
+    return n;
+}
+
+int count_char(char* s, char c) {
+    int i;
+    int count;
+
+    count = 0;
+    for (i = 0; s[i]; i++) {
+        if (s[i] == c) count = count + 1;
+    }
+    return count;
+}
+
+int find(char* s, char* pat) {
+    int i;
+    int j;
+
+    for (i = 0; s[i]; i++) {
+        j = 0;
+        while (pat[j] && s[i + j] == pat[j]) {
+            j = j + 1;
+        }
+        if (!pat[j]) return i;
+    }
+    return 0xFFFF;
+}
+
+int count_words(char* s) {
+    int i;
+    int words;
+    int in_word;
+
+    words = 0;
+    in_word = 0;
+    for (i = 0; s[i]; i++) {
+        if (s[i] == ' ') {
+            in_word = 0;
+        } else if (!in_word) {
+            in_word = 1;
+            words = words + 1;
+        }
+    }
+    return words;
+}
+
+int main() {
+    int len;
+    int spaces;
+    int pos;
+    int words;
+
+    len = str_length(g_text);
+    if (len != 64) return 0x01;
+    spaces = count_char(g_text, ' ');
+    if (spaces != 12) return 0x02;
+    pos = find(g_text, g_cat);
+    if (pos != 54) return 0x03;
+    if (find(g_text, g_cow) != 0xFFFF) return 0x04;
+    if (find(g_text, g_sleeps) != 58) return 0x06;
+    words = count_words(g_text);
+    if (words != 13) return 0x05;
+    return len + spaces + pos + words;
+}
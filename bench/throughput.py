@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Time cc_parse, cc_semantic and cc_codegen on growing synthetic sources.
+
+One input dimension is swept (the others stay at their defaults) and each
+stage is timed on host, best of --repeat runs, together with its pool
+high-water mark. The "x" columns give the growth of time per unit of the
+swept dimension against the first point: values that keep rising point at
+a superlinear path.
+"""
+import argparse
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+
+RED = "\033[0;31m"
+GREEN = "\033[0;32m"
+YELLOW = "\033[1;33m"
+BLUE = "\033[0;34m"
+NC = "\033[0m"
+
+ROOT = Path(__file__).resolve().parent.parent
+STAGES = ("cc_parse", "cc_semantic", "cc_codegen")
+DIMENSIONS = ("functions", "locals", "depth", "globals", "strings")
+DEFAULTS = {"functions": 8, "locals": 4, "depth": 3, "globals": 4, "strings": 2}
+POOL_RE = re.compile(r"pool peak = (\d+)")
+
+
+def host_arch() -> str:
+    sys_name = platform.system()
+    if sys_name == "Darwin":
+        return "darwin"
+    if sys_name == "Linux":
+        return "linux"
+    return sys_name
+
+
+def stage_cmd(stage: str, src: Path, ast: Path, asm: Path):
+    tool = str(ROOT / "bin" / f"{stage}_{host_arch()}")
+    if stage == "cc_parse":
+        return [tool, str(src), str(ast)]
+    if stage == "cc_semantic":
+        return [tool, str(ast)]
+    return [tool, str(ast), str(asm)]
+
+
+def time_stage(cmd, repeat: int):
+    best = None
+    peak = None
+    env = {"CC_POOL_REPORT": "1"}
+    for _ in range(repeat):
+        start = time.perf_counter()
+        try:
+            result = subprocess.run(cmd, check=False, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                    text=True, env=env)
+        except FileNotFoundError:
+            return None, None, f"{Path(cmd[0]).name} not found"
+        elapsed = time.perf_counter() - start
+        if result.returncode != 0:
+            lines = [l for l in result.stdout.splitlines() if not POOL_RE.search(l)]
+            return None, None, lines[-1] if lines else f"exit {result.returncode}"
+        match = POOL_RE.search(result.stdout)
+        peak = int(match.group(1)) if match else None
+        best = elapsed if best is None else min(best, elapsed)
+    return best, peak, None
+
+
+def generate(path: Path, knobs, seed: int) -> None:
+    cmd = [sys.executable, str(ROOT / "bench" / "gen_source.py"), "-o", str(path), "--seed", str(seed)]
+    for name, value in knobs.items():
+        cmd += [f"--{name}", str(value)]
+    subprocess.run(cmd, check=True)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Measure compiler throughput on synthetic sources")
+    parser.add_argument("--sweep", choices=DIMENSIONS, default="functions",
+                        help="dimension to vary (default: functions)")
+    parser.add_argument("--values", default="3,6,12,24",
+                        help="comma-separated values of the swept dimension")
+    parser.add_argument("--repeat", type=int, default=3, help="runs per stage, best time kept")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--csv", action="store_true", help="print CSV instead of a table")
+    parser.add_argument("--keep", type=Path, help="keep the generated sources in this directory")
+    for name in DIMENSIONS:
+        parser.add_argument(f"--{name}", type=int, default=DEFAULTS[name],
+                            help=f"fixed value when not swept (default: {DEFAULTS[name]})")
+    args = parser.parse_args()
+
+    values = [int(v) for v in args.values.split(",") if v]
+    workdir = args.keep or Path(tempfile.mkdtemp(prefix="cc_throughput_"))
+    workdir.mkdir(parents=True, exist_ok=True)
+
+    if args.csv:
+        print("sweep,value,source_bytes," + ",".join(f"{s}_ms,{s}_pool" for s in STAGES))
+    else:
+        header = f"{args.sweep:>9} {'bytes':>8}"
+        for stage in STAGES:
+            header += f" {stage[3:] + ' ms':>12} {'x':>5} {'pool':>6}"
+        print(f"{BLUE}{header}{NC}")
+
+    first = {}
+    failed = 0
+    for value in values:
+        knobs = {name: getattr(args, name) for name in DIMENSIONS}
+        knobs[args.sweep] = value
+        stem = f"{args.sweep}_{value}"
+        src = workdir / f"{stem}.c"
+        ast = workdir / f"{stem}.ast"
+        asm = workdir / f"{stem}.asm"
+        generate(src, knobs, args.seed)
+        size = src.stat().st_size
+
+        row = [args.sweep, str(value), str(size)]
+        text = f"{value:>9} {size:>8}"
+        error = None
+        for stage in STAGES:
+            elapsed, peak, error = time_stage(stage_cmd(stage, src, ast, asm), args.repeat)
+            if error:
+                break
+            ms = elapsed * 1000.0
+            per_unit = ms / max(value, 1)
+            growth = per_unit / first[stage] if stage in first else 1.0
+            first.setdefault(stage, per_unit)
+            row += [f"{ms:.2f}", "" if peak is None else str(peak)]
+            text += f" {ms:>12.2f} {growth:>5.2f} {peak if peak is not None else '-':>6}"
+        if error:
+            failed += 1
+            if args.csv:
+                print(",".join(row) + f",error: {error}")
+            else:
+                print(f"{text} {RED}{stage}: {error}{NC}")
+            continue
+        print(",".join(row) if args.csv else text)
+
+    if not args.csv:
+        if args.keep is None:
+            print(f"\nSources in {workdir}")
+        if failed:
+            print(f"{YELLOW}{failed} size(s) exceeded a compiler limit{NC}")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
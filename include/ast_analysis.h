@@ -0,0 +1,20 @@
+#ifndef AST_ANALYSIS_H
+#define AST_ANALYSIS_H
+
+#include <stdint.h>
+
+/* Storage rules shared by cc_semantic, which records them in the analysis
+ * section of an analyzed AST, and cc_codegen, which lays out frames and
+ * globals with them when the section is absent. */
+
+/* AST_VAR_* flags of a global or local of this type; elem_size gets the
+ * element size of an array or pointer, 0 otherwise. */
+uint8_t ast_var_flags(uint8_t base, uint8_t depth, uint16_t array_len, uint8_t* elem_size);
+
+/* Bytes a local of this kind takes in the frame */
+uint16_t ast_var_size(uint8_t flags, uint8_t elem_size, uint16_t array_len);
+
+/* Return value is passed in HL rather than A */
+uint8_t ast_type_is_16(uint8_t base, uint8_t depth);
+
+#endif /* AST_ANALYSIS_H */
@@ -23,9 +23,27 @@
 #define AST_TAG_STRING_LITERAL 19
 #define AST_TAG_ARRAY_ACCESS 20
 
+/* Compact format: a tag byte with the high bit set is a constant 0..127 */
+#define AST_TAG_SMALL_CONST 0x80
+#define AST_SMALL_CONST_MAX 0x7F
+
 /* AST binary header size in bytes */
 #define AST_HEADER_SIZE 16
 
+/* Header flags (byte 5) */
+#define AST_FLAG_ANALYZED 0x04 /* analysis section after the string table */
+#define AST_FLAG_DECL_INDEX 0x08 /* declaration index after the string table */
+
+/* Declaration index entry: tag u8, name u16, offset u32, length u32 */
+#define AST_DECL_ENTRY_SIZE 11
+
+/* Variable flags in the analysis section */
+#define AST_VAR_IS_16 0x01
+#define AST_VAR_IS_SIGNED 0x02
+#define AST_VAR_IS_POINTER 0x04
+#define AST_VAR_IS_ARRAY 0x08
+#define AST_VAR_ELEM_SIGNED 0x10
+
 /* Type encoding base values */
 #define AST_BASE_INT 1
 #define AST_BASE_CHAR 2
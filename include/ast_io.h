@@ -7,6 +7,14 @@
 
 #define AST_MAGIC "ZAST"
 #define AST_FORMAT_VERSION 1
+/* Varint indices and counts, constants folded into the tag byte and a
+ * type table after the header; see ast_format.h */
+#define AST_FORMAT_COMPACT 2
+
+/* Format written by cc_parse; readers accept both */
+#ifndef CC_AST_FORMAT
+#define CC_AST_FORMAT AST_FORMAT_COMPACT
+#endif
 
 typedef void (*error_handler)(char* msg);
 
@@ -22,11 +30,21 @@ void ast_write_u8(output_t out, uint8_t value);
 void ast_write_u16(output_t out, uint16_t value);
 void ast_write_u32(output_t out, uint32_t value);
 void ast_write_i16(output_t out, int16_t value);
+void ast_write_varint(output_t out, uint16_t value);
+uint8_t ast_varint_size(uint16_t value);
 
 uint8_t ast_read_u8(void);
 uint16_t ast_read_u16(void);
 uint32_t ast_read_u32(void);
 int16_t ast_read_i16(void);
+uint16_t ast_read_varint(void);
+
+/* Fields whose encoding depends on the format version, which
+ * ast_read_format() selects from the AST header. */
+void ast_read_format(uint8_t version);
+uint8_t ast_read_tag(void);    /* leaves an AST_TAG_CONSTANT node unread */
+uint16_t ast_read_index(void); /* string index or child count */
+int16_t ast_read_const(void);  /* reads a whole constant node, tag included */
 
 // uint8_t ast_read_u8_safe(reader_t* reader);
 // uint16_t ast_read_u16_safe(reader_t* reader);
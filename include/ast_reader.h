@@ -3,15 +3,53 @@
 
 #include <stdint.h>
 
+#include "common.h"
 #include "parser.h"
 #include "target.h"
 
+#if CC_LAZY_STRINGS
+#define AST_STRING_CACHE_SLOTS 4
+
+typedef struct {
+    uint16_t index[AST_STRING_CACHE_SLOTS];
+    uint16_t used[AST_STRING_CACHE_SLOTS]; /* tick of last use, 0 = empty */
+    uint16_t tick;
+    char text[AST_STRING_CACHE_SLOTS][MAX_STRING_LENGTH];
+} ast_string_cache_t;
+#endif
+
+/* Compact format: one entry per distinct declared type */
+typedef struct {
+    uint8_t base;
+    uint8_t depth;
+    uint16_t array_len;
+} ast_type_entry_t;
+
+/* One top-level declaration from the index (AST_FLAG_DECL_INDEX) */
+typedef struct {
+    uint32_t offset; /* of the declaration's tag byte */
+    uint32_t length; /* bytes, tag included */
+    uint16_t name_index;
+    uint8_t tag;
+} ast_decl_entry_t;
+
 typedef struct {
     uint16_t node_count;
     uint16_t string_count;
     uint32_t string_table_offset;
     uint8_t format_version;
-    char** strings;
+    uint8_t flags; /* AST_FLAG_* */
+    uint32_t program_offset;
+    uint32_t analysis_offset; /* end of the string table and index */
+    ast_type_entry_t* types;
+    uint16_t type_count;
+    char** strings; /* lazy: names pinned by ast_reader_name() */
+#if CC_LAZY_STRINGS
+    uint16_t* string_offsets; /* from string_table_offset */
+    ast_string_cache_t* string_cache;
+#endif
+    ast_decl_entry_t* decls; /* NULL without a declaration index */
+    uint16_t decl_entry_count;
     uint16_t decl_count;
     uint16_t decl_index;
     uint8_t program_started;
@@ -19,10 +57,20 @@ typedef struct {
 
 int8_t ast_reader_init(void);
 int8_t ast_reader_load_strings(void);
+/* Valid until AST_STRING_CACHE_SLOTS other strings have been read (lazy);
+ * use for text that is consumed right away, such as string literals. */
 const char* ast_reader_string(uint16_t index);
+/* Valid until ast_reader_destroy(); use for names kept in symbol tables. */
+const char* ast_reader_name(uint16_t index);
 int8_t ast_reader_read_type_info(uint8_t* base, uint8_t* depth,
                                  uint16_t* array_len);
 int8_t ast_reader_begin_program(uint16_t* decl_count);
+/* Moves to the next top-level declaration with the given tag (0 = any) and
+ * returns its tag, with the reader just past the tag byte; 0 when there are
+ * none left, -1 on error. With a declaration index the reader seeks there
+ * directly, and the previous declaration need not have been read to its end;
+ * without one, it must have been, and the declarations between are skipped. */
+int16_t ast_reader_next_decl(uint8_t tag);
 int8_t ast_reader_skip_node(void);
 int8_t ast_reader_skip_tag(uint8_t tag);
 void ast_reader_destroy(void);
@@ -0,0 +1,27 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Host-only content-hash cache for the cc driver. Keys are 64-bit FNV-1a
+ * hashes; entries are plain files named <key>.<ext> in the cache dir. */
+
+typedef uint64_t cache_key_t;
+
+/* Compiler version and output-affecting build flags */
+cache_key_t cache_seed(void);
+cache_key_t cache_hash(cache_key_t key, const void* data, size_t len);
+int8_t cache_hash_file(cache_key_t* key, const char* path);
+
+/* Returns a malloc'd "<dir>/<key as hex>.<ext>" or NULL */
+char* cache_path(const char* dir, cache_key_t key, const char* ext);
+
+/* Reads a whole file into a malloc'd buffer; -1 if missing */
+int8_t cache_load(const char* path, char** data, size_t* len);
+
+/* Writes via a temporary file and rename, so parallel workers never see
+ * a partial entry */
+int8_t cache_store(const char* path, const char* data, size_t len);
+
+#endif /* CACHE_H */
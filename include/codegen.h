@@ -2,23 +2,30 @@
 #define CODEGEN_H
 
 #include "common.h"
+#include "ast_format.h"
 #include "ast_reader.h"
 #include "symbol.h"
 #include "target.h"
+#if CC_COST
+#include "codegen_cost.h"
+#endif
 
 /* Keep codegen counters consistent across host/ZOS to expose limits early. */
-typedef uint8_t codegen_local_count_t;
-typedef uint8_t codegen_param_count_t;
-typedef uint8_t codegen_function_count_t;
-typedef uint8_t codegen_global_count_t;
-typedef uint8_t codegen_string_count_t;
+typedef uint16_t codegen_local_count_t;
+typedef uint16_t codegen_param_count_t;
+typedef uint16_t codegen_function_count_t;
+typedef uint16_t codegen_global_count_t;
+typedef uint16_t codegen_string_count_t;
 
+/* The low bits match AST_VAR_* so analysis entries load as they are */
 enum {
-    CG_FLAG_IS_16 = 0x01,
-    CG_FLAG_IS_SIGNED = 0x02,
-    CG_FLAG_IS_POINTER = 0x04,
-    CG_FLAG_IS_ARRAY = 0x08,
-    CG_FLAG_ELEM_SIGNED = 0x10
+    CG_FLAG_IS_16 = AST_VAR_IS_16,
+    CG_FLAG_IS_SIGNED = AST_VAR_IS_SIGNED,
+    CG_FLAG_IS_POINTER = AST_VAR_IS_POINTER,
+    CG_FLAG_IS_ARRAY = AST_VAR_IS_ARRAY,
+    CG_FLAG_ELEM_SIGNED = AST_VAR_ELEM_SIGNED,
+    CG_FLAG_IS_NARROW = 0x20, /* int local proven to fit a byte */
+    CG_FLAG_ADDR_TAKEN = 0x40 /* &x seen in the function body */
 };
 
 typedef struct {
@@ -41,7 +48,51 @@ typedef struct {
     uint8_t flags;
 } codegen_global_t;
 
-/* Code generator structure */
+/* A string literal, labelled _s<slot> in order of first use */
+typedef struct {
+    uint16_t index;  /* AST string table index */
+    uint16_t hash;   /* of the text, once the pool is being emitted */
+    uint16_t host;   /* slot whose bytes end with this text; its own if none */
+    uint16_t offset; /* of the text in the host's */
+    uint16_t next;   /* next slot sharing the host, by offset */
+} codegen_string_t;
+
+#if CC_COST
+enum {
+    CG_COST_NONE = 0, /* declared only, or not emitted yet */
+    CG_COST_BODY,     /* emitted, total not known yet */
+    CG_COST_VISITING, /* on the call chain being totalled */
+    CG_COST_DONE
+};
+
+#define CG_STACK_UNBOUNDED 0xFFFFu
+#define CG_CALL_EXTERNAL 0xFFFFu
+
+/* A function's cost, kept until the whole call graph is known; indexed
+ * like function_return_flags */
+typedef struct {
+    codegen_cost_t cost;
+    uint16_t total;      /* worst-case stack of a call to it, callees included */
+    uint16_t first_call; /* its call sites in calls */
+    uint16_t call_count;
+    uint8_t state;       /* CG_COST_* */
+    bool external;       /* total leaves out calls out of the unit */
+} codegen_function_cost_t;
+
+/* A call site: the callee's function slot, or CG_CALL_EXTERNAL when it
+ * has no body here, and the caller's stack depth at the call */
+typedef struct {
+    uint16_t callee;
+    uint16_t depth;
+} codegen_call_t;
+#endif
+
+/* Code generator structure. The tables come from the pool: globals and
+ * function return widths are sized once from the AST (analysis section or
+ * declaration count), locals and params grow to the largest function seen
+ * so far, and string literals double up to the string table size. Their
+ * hash buckets are keyed by index while code is generated, then by text
+ * while the pool is merged. */
 typedef struct {
     output_t output_handle;
     
@@ -49,21 +100,37 @@ typedef struct {
 
     const char* current_function_name;
     int16_t stack_offset;
-    codegen_local_t locals[64];
+    codegen_local_t* locals;
     codegen_local_count_t local_var_count;
-    codegen_param_t params[8];
+    codegen_local_count_t local_capacity;
+    codegen_param_t* params;
     codegen_param_count_t param_count;
+    codegen_param_count_t param_capacity;
     char* function_end_label;
     bool function_return_is_16;
-    uint16_t function_return_flags[64];
+    uint16_t* function_return_flags;
     codegen_function_count_t function_count;
+    codegen_function_count_t function_capacity;
 
-    codegen_global_t globals[64];
+    codegen_global_t* globals;
     codegen_global_count_t global_count;
+    codegen_global_count_t global_capacity;
 
-    const char* string_labels[64];
-    char* string_literals[64];
+    codegen_string_t* strings;
+    uint16_t* string_buckets; /* slot + 1, 0 = empty; linear probing */
+    uint16_t string_bucket_mask;
     codegen_string_count_t string_count;
+    codegen_string_count_t string_capacity;
+
+#if CC_COST
+    output_t cost_handle; /* --cost CSV, if given */
+    uint16_t stack_limit; /* --stack-limit, 0 for none */
+    codegen_function_cost_t* function_costs;
+    codegen_function_count_t function_cost_capacity;
+    codegen_call_t* calls;
+    uint16_t call_count;
+    uint16_t call_capacity;
+#endif
 
     char* loop_break_labels[8];
     char* loop_continue_labels[8];
@@ -74,9 +141,18 @@ typedef struct {
 codegen_t* codegen_create(const char* output_file);
 void codegen_destroy(codegen_t* gen);
 cc_error_t codegen_generate_stream(void);
+/* Where the runtime .asm files copied into the output live; by default
+ * "runtime" in the current directory */
+void codegen_set_runtime_dir(const char* dir);
+#if CC_COST
+/* Also writes each function's totals to path as CSV rows */
+int8_t codegen_open_cost(const char* path);
+/* Fails code generation when a call graph needs more than bytes of stack */
+void codegen_set_stack_limit(uint16_t bytes);
+#endif
 
 /* Helper functions */
 void codegen_emit(const char* fmt);
 char* codegen_new_label(void);
-char* codegen_new_string_label(void);
+char* codegen_string_label(uint16_t slot);
 #endif /* CODEGEN_H */
@@ -0,0 +1,28 @@
+#ifndef CODEGEN_COST_H
+#define CODEGEN_COST_H
+
+#include <stdint.h>
+
+/* Static size and timing of emitted Z80 code. Every instruction counts
+ * once: min_t takes untaken branches (and one pass of a block
+ * instruction), max_t taken ones, so a function's totals bound a single
+ * straight pass through its body, not a run of it.
+ *
+ * sp follows pushes and pops in text order, which holds for generated
+ * code because every path reaches a label with the same temporaries
+ * pushed; stack is its peak, counting the return address of each call
+ * (and the runtime's own nesting below it). Moves of sp itself, like the
+ * frame, are for the caller to add. */
+typedef struct {
+    uint16_t bytes;
+    uint32_t min_t;
+    uint32_t max_t;
+    int16_t sp;
+    uint16_t stack;
+} codegen_cost_t;
+
+/* Adds the cost of one line of assembly (without its newline) to cost;
+ * labels, directives, comments and unknown mnemonics count nothing. */
+void codegen_cost_line(const char* line, uint8_t len, codegen_cost_t* cost);
+
+#endif /* CODEGEN_COST_H */
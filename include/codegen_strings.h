@@ -27,6 +27,8 @@ extern const char CG_STR_CALL[];
 extern const char CG_STR_LD_L_A_H_ZERO_PUSH_HL[];
 extern const char CG_STR_PUSH_HL[];
 extern const char CG_STR_POP_BC[];
+extern const char CG_STR_LD_BC_HL[];
+extern const char CG_STR_LD_HL_BC[];
 extern const char CG_STR_PUSH_IX[];
 extern const char CG_STR_COLON[];
 extern const char CG_STR_DB[];
@@ -55,6 +57,12 @@ extern const char CG_MSG_UNSUPPORTED_ARRAY_ACCESS[];
 extern const char CG_MSG_ARRAY_INIT_NOT_SUPPORTED[];
 extern const char CG_MSG_USAGE_CODEGEN[];
 extern const char CG_MSG_FAILED_OPEN_OUTPUT[];
+#if CC_COST
+extern const char CG_MSG_FAILED_OPEN_COST[];
+extern const char CG_MSG_STACK_LIMIT[];
+extern const char CG_MSG_STACK_UNBOUNDED[];
+#endif
 extern const char CG_MSG_CODEGEN_FAILED[];
+extern const char CG_MSG_OUT_OF_MEMORY[];
 
 #endif /* CODEGEN_STRINGS_H */
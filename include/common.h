@@ -11,6 +11,32 @@
 #define CC_DEBUG_POOL 0
 #endif
 
+/* If set, tools accept --stats and print per-stage I/O, allocator and
+ * AST counters on exit. */
+#ifndef CC_STATS
+#define CC_STATS 0
+#endif
+
+/* If set, cc_codegen counts the bytes and T-states of each function it
+ * emits and writes them in a comment after it, and accepts --cost FILE
+ * for a CSV summary. */
+#ifndef CC_COST
+#define CC_COST 0
+#endif
+
+/* Size of the pool blocks a cc_arena_t bumps through; larger requests
+ * get a block of their own. */
+#ifndef CC_ARENA_BLOCK
+#define CC_ARENA_BLOCK 512
+#endif
+
+/* If set, the AST string table is not loaded up front: ast_reader_string()
+ * reads strings on demand through a small LRU, so the pool no longer grows
+ * with the total size of the string literals. */
+#ifndef CC_LAZY_STRINGS
+#define CC_LAZY_STRINGS 1
+#endif
+
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
@@ -69,9 +95,70 @@ typedef struct {
 void cc_error(const char* msg);
 void* cc_malloc(size_t size);
 void cc_free(void* ptr);
+void* cc_realloc(void* ptr, size_t size);
+void* cc_grow(void* data, uint16_t* capacity, uint16_t need, size_t size);
 char* cc_strdup(const char* str);
 void cc_reset_pool(void);
 uint16_t cc_init_pool(void* pool, size_t size);
 uint16_t cc_init_pool_default(void);
 
+/* Bump allocator over pool blocks, for data that dies together. A mark
+ * records the top; releasing to it frees everything allocated since
+ * without visiting it. */
+typedef struct cc_arena_block cc_arena_block_t;
+
+typedef struct {
+    cc_arena_block_t* block;
+    uint16_t used;
+} cc_arena_mark_t;
+
+typedef struct {
+    cc_arena_block_t* block; /* newest; links to the ones before */
+    uint16_t used;           /* bytes taken from block */
+    cc_arena_block_t* spare; /* last released block, kept for reuse */
+} cc_arena_t;
+
+void* cc_arena_alloc(cc_arena_t* arena, size_t size);
+cc_arena_mark_t cc_arena_mark(const cc_arena_t* arena);
+void cc_arena_release(cc_arena_t* arena, cc_arena_mark_t mark);
+void cc_arena_reset(cc_arena_t* arena); /* keeps the spare block */
+void cc_arena_free(cc_arena_t* arena);
+
+/* AST nodes, types and their names come from the selected arena, or from
+ * the pool while none is. With an arena selected cc_tree_free does
+ * nothing and ast_node_destroy/type_destroy return at once: the owner
+ * releases the arena instead. cc_tree_arena returns the previous one. */
+extern cc_arena_t* g_cc_tree_arena;
+cc_arena_t* cc_tree_arena(cc_arena_t* arena);
+void* cc_tree_alloc(size_t size);
+char* cc_tree_strdup(const char* str);
+void cc_tree_free(void* ptr);
+
+#if CC_STATS
+/* Counters behind --stats; bumped unconditionally, printed on request */
+typedef struct {
+    uint32_t bytes_read;
+    uint16_t reader_fills;
+    uint16_t reader_seeks;
+    uint16_t output_writes;
+    uint32_t output_bytes;
+    uint16_t mallocs;
+    uint16_t frees;
+    uint16_t pool_peak;
+    uint16_t free_blocks_at_peak;
+    uint16_t nodes_read;
+    uint16_t nodes_skipped;
+    uint16_t strings_loaded;
+} cc_stats_t;
+
+extern cc_stats_t g_cc_stats;
+
+#define CC_STAT_INC(field) (g_cc_stats.field++)
+#define CC_STAT_ADD(field, n) (g_cc_stats.field += (n))
+void cc_stats_print(const char* stage);
+#else
+#define CC_STAT_INC(field) ((void)0)
+#define CC_STAT_ADD(field, n) ((void)0)
+#endif
+
 #endif /* COMMON_H */
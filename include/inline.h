@@ -0,0 +1,49 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include "common.h"
+#include "parser.h"
+
+/* Body size limits in AST nodes (see src/parser/inline.c) */
+#define INLINE_MAX_NODES 12
+#define INLINE_HINT_MAX_NODES 40
+/* Streamed bodies are held as trees while they may still qualify */
+#define INLINE_HOLD_MAX_NODES (2 * INLINE_HINT_MAX_NODES)
+#define INLINE_HOLD_MAX_STMTS 32
+
+#define INLINE_MAX_CANDIDATES 8
+#define INLINE_MAX_CALLED 32
+#define INLINE_MAX_TEMPS 16
+#define INLINE_MAX_PENDING 24
+#define INLINE_MAX_LOCALS 32
+
+/* Starts a pass over the source; the planning pass also tracks which
+ * functions are still called out of line. */
+void inline_begin(bool planning);
+/* Expands calls to earlier candidates in `fn`, then records `fn` as a
+ * candidate if it qualifies. Returns -1 when out of memory. */
+int8_t inline_function(ast_node_t* fn);
+/* Streaming: whether `fn` may still become a candidate after its next
+ * top-level statement `stmt`; `nodes` accumulates the body size so far. */
+bool inline_may_qualify(const ast_node_t* fn, const ast_node_t* stmt, uint16_t* nodes);
+/* Streaming: starts expanding calls in `fn` one statement at a time */
+int8_t inline_stream_begin(const ast_node_t* fn);
+/* Expands the calls in `*slot` (for if/while/for, only the parts before the
+ * body) and stores in `before` (INLINE_MAX_PENDING entries) the statements
+ * that must run first. Declarations are recorded as locals. */
+int8_t inline_stream_statement(ast_node_t** slot, ast_node_t** before, uint8_t* count);
+/* The temporaries `fn` needs so far, in declaration order */
+uint8_t inline_stream_temps(ast_node_t* const** temps);
+/* Ends the streamed caller. Returns 1 when a later local hid a global of
+ * an expanded callee: the pass must then be repeated. -1 when out of
+ * memory. */
+int8_t inline_stream_end(const ast_node_t* fn);
+/* Records the measured size of `fn` (planning pass only) */
+void inline_note_size(const ast_node_t* fn, uint32_t bytes, uint16_t nodes);
+/* Ends the planning pass: picks the static candidates that no longer have
+ * out-of-line callers and takes their size out of the totals. */
+void inline_plan_drops(uint32_t* bytes, uint16_t* nodes, uint16_t* decls);
+bool inline_is_dropped(const ast_node_t* fn);
+void inline_destroy(void);
+
+#endif /* INLINE_H */
@@ -0,0 +1,161 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "target.h"
+
+/* Linear three-address IR shared by cc_lower (.ast -> .ir) and
+ * cc_isel (.ir -> .asm). See docs/IR_FORMAT.md. */
+
+#define IR_MAGIC "ZIR0"
+#define IR_FORMAT_VERSION 1
+#define IR_HEADER_SIZE 16
+
+#define IR_NONE 0xFFFFu
+
+/* Limits shared by the producer and consumers */
+#define IR_MAX_SLOTS 72
+
+/* Record kinds (u8 prefix of every record after the string table) */
+#define IR_REC_FUNCTION 1
+#define IR_REC_GLOBAL 2
+
+/* Opcodes. Operand meaning is listed as dst, a, b. */
+typedef enum {
+    IR_NOP = 0,
+    IR_CONST,     /* dst = imm(a) */
+    IR_MOV,       /* dst = a */
+    IR_ZEXT,      /* dst(16) = zero-extend a(8) */
+    IR_SEXT,      /* dst(16) = sign-extend a(8) */
+    IR_TRUNC,     /* dst(8) = low byte of a(16) */
+    IR_ADD,       /* dst = a + b */
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_AND,
+    IR_OR,
+    IR_XOR,
+    IR_SHL,
+    IR_SHR,
+    IR_NEG,       /* dst = -a */
+    IR_NOT,       /* dst = ~a */
+    IR_LNOT,      /* dst(8) = !a */
+    IR_SEQ,       /* dst(8) = a == b, width/sign taken from the operands */
+    IR_SNE,
+    IR_SLT,
+    IR_SLE,
+    IR_SGT,
+    IR_SGE,
+    IR_LDL,       /* dst = slot[a] */
+    IR_STL,       /* slot[a] = b */
+    IR_LDG,       /* dst = global named by string a */
+    IR_STG,       /* global named by string a = b */
+    IR_ADDRL,     /* dst = &slot[a] */
+    IR_ADDRG,     /* dst = &global named by string a */
+    IR_ADDRS,     /* dst = &string literal a */
+    IR_LOAD,      /* dst = *(a) */
+    IR_STORE,     /* *(a) = b */
+    IR_ARG,       /* push a (16-bit), arguments are pushed last to first */
+    IR_CALL,      /* dst = call function named by string a with b args */
+    IR_RET,       /* return a (IR_NONE for void) */
+    IR_JMP,       /* goto label a */
+    IR_BZ,        /* if (a == 0) goto label b */
+    IR_BNZ,       /* if (a != 0) goto label b */
+    IR_LABEL,     /* label a, starts a basic block */
+    IR_OP_COUNT
+} ir_op_t;
+
+/* Instruction flags */
+#define IR_F_16 0x01      /* 16-bit operation (8-bit otherwise) */
+#define IR_F_SIGNED 0x02  /* signed operands (compares, shifts, division) */
+
+/* Slot kinds */
+#define IR_SLOT_LOCAL 0
+#define IR_SLOT_PARAM 1
+
+/* Function flags */
+#define IR_FN_RET16 0x01
+
+/* Global kinds */
+#define IR_GLOBAL_BYTE 0        /* .db init */
+#define IR_GLOBAL_WORD 1        /* .dw init */
+#define IR_GLOBAL_SPACE 2       /* .ds size */
+#define IR_GLOBAL_STRING 3      /* char array: string init, padded to size */
+#define IR_GLOBAL_ADDR_STRING 4 /* .dw string literal init */
+#define IR_GLOBAL_ADDR_VAR 5    /* .dw address of global named by init */
+
+typedef struct {
+    uint8_t op;
+    uint8_t flags;
+    uint16_t dst;
+    uint16_t a;
+    uint16_t b;
+} ir_instr_t;
+
+typedef struct {
+    uint16_t name_index;
+    uint8_t kind;
+    uint16_t size;
+} ir_slot_t;
+
+/* One function at a time: the instruction buffer is the only
+ * allocation and is released before the next function is read. */
+typedef struct {
+    uint16_t name_index;
+    uint8_t flags;
+    uint8_t param_count;
+    uint8_t slot_count;
+    uint16_t vreg_count;
+    uint16_t label_count;
+    uint16_t instr_count;
+    uint16_t instr_capacity;
+    ir_slot_t slots[IR_MAX_SLOTS];
+    ir_instr_t* instrs;
+} ir_function_t;
+
+typedef struct {
+    uint16_t name_index;
+    uint8_t kind;
+    uint16_t size;
+    uint16_t init;
+} ir_global_t;
+
+typedef struct {
+    uint8_t format_version;
+    uint16_t record_count;
+    uint16_t function_count;
+    uint16_t string_count;
+    uint32_t string_table_offset;
+} ir_header_t;
+
+/* Writing */
+void ir_write_header(output_t out, const ir_header_t* header);
+void ir_write_strings(output_t out, uint16_t count, const char* (*get)(uint16_t));
+void ir_write_function(output_t out, const ir_function_t* fn);
+void ir_write_global(output_t out, const ir_global_t* global);
+
+/* Building */
+void ir_function_init(ir_function_t* fn, uint16_t name_index);
+int8_t ir_emit(ir_function_t* fn, uint8_t op, uint8_t flags,
+               uint16_t dst, uint16_t a, uint16_t b);
+uint16_t ir_new_vreg(ir_function_t* fn);
+uint16_t ir_new_label(ir_function_t* fn);
+void ir_function_free(ir_function_t* fn);
+bool ir_op_has_dst(uint8_t op);
+/* Stores the vreg operands read by `ins` in a/b (IR_NONE when unused) */
+uint8_t ir_instr_operands(const ir_instr_t* ins, uint16_t* a, uint16_t* b);
+
+/* Reading (uses the shared `reader`) */
+int8_t ir_read_header(ir_header_t* header);
+int8_t ir_seek_records(const ir_header_t* header); /* position at the first record */
+uint8_t ir_read_record_kind(void);
+int8_t ir_read_function(ir_function_t* fn);
+int8_t ir_read_global(ir_global_t* global);
+int8_t ir_skip_record(uint8_t kind);
+
+const char* ir_op_name(uint8_t op);
+
+#endif /* IR_H */
@@ -0,0 +1,38 @@
+#ifndef ISEL_H
+#define ISEL_H
+
+#include "common.h"
+#include "ir.h"
+#include "target.h"
+
+/* Z80 instruction selector state (one function resident at a time) */
+typedef struct {
+    output_t output_handle;
+    ir_header_t header;
+    ir_function_t fn;
+
+    uint16_t label_next;
+    uint16_t label_base;
+    uint16_t end_label;
+    bool has_frame;
+    int16_t frame_size;
+    int16_t slot_offsets[IR_MAX_SLOTS];
+
+    /* Per-vreg tables, sized by fn.vreg_count */
+    int16_t* vreg_offsets;
+    uint8_t* use_counts;
+    uint8_t* def_counts;
+
+    /* Value currently held in A / HL (IR_NONE when unknown) */
+    uint16_t reg_a;
+    uint16_t reg_hl;
+
+    /* One bit per string table entry referenced by code or data */
+    uint8_t* strings_used;
+} isel_t;
+
+isel_t* isel_create(const char* output_file);
+void isel_destroy(isel_t* isel);
+cc_error_t isel_generate_stream(void);
+
+#endif /* ISEL_H */
@@ -32,6 +32,7 @@ typedef enum {
     TOK_FOR,
     TOK_GOTO,
     TOK_IF,
+    TOK_INLINE,
     TOK_INT,
     TOK_LONG,
     TOK_REGISTER,
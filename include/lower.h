@@ -0,0 +1,55 @@
+#ifndef LOWER_H
+#define LOWER_H
+
+#include "common.h"
+#include "ir.h"
+#include "target.h"
+
+typedef uint8_t lower_var_count_t;
+
+enum {
+    LOWER_VAR_IS_16 = 0x01,
+    LOWER_VAR_IS_SIGNED = 0x02,
+    LOWER_VAR_IS_POINTER = 0x04,
+    LOWER_VAR_IS_ARRAY = 0x08,
+    LOWER_VAR_ELEM_SIGNED = 0x10
+};
+
+/* A named storage location: a frame slot or a global */
+typedef struct {
+    uint16_t name_index;
+    uint8_t slot;
+    uint8_t elem_size;
+    uint8_t flags;
+} lower_var_t;
+
+typedef struct {
+    output_t output_handle;
+    ir_function_t fn;
+    bool function_return_is_16;
+
+    lower_var_t locals[IR_MAX_SLOTS];
+    lower_var_count_t local_count;
+    /* Both sized to the declaration count, from the pool */
+    uint16_t decl_capacity;
+    lower_var_t* globals;
+    uint16_t global_count;
+    uint16_t* function_return_flags;
+    uint16_t function_count;
+
+    uint16_t loop_break_labels[8];
+    uint16_t loop_continue_labels[8];
+    uint8_t loop_depth;
+
+    uint16_t named_label_names[32];
+    uint16_t named_label_ids[32];
+    uint8_t named_label_count;
+} lower_t;
+
+lower_t* lower_create(const char* output_file);
+void lower_destroy(lower_t* lower);
+cc_error_t lower_generate_stream(void);
+void lower_narrow(ir_function_t* fn);
+void lower_licm(ir_function_t* fn);
+
+#endif /* LOWER_H */
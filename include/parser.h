@@ -48,6 +48,10 @@ typedef enum {
     OP_PREINC, OP_PREDEC, OP_POSTINC, OP_POSTDEC
 } unary_op_t;
 
+/* Function specifiers; read by the inliner, not written to the AST file */
+#define AST_FUNC_STATIC 0x01
+#define AST_FUNC_INLINE 0x02
+
 /* AST node */
 struct ast_node {
     ast_node_type_t type;
@@ -64,6 +68,7 @@ struct ast_node {
             ast_node_t** params;
             ast_param_count_t param_count;
             ast_node_t* body;
+            uint8_t flags;
         } function;
         
         struct {
@@ -148,11 +153,27 @@ struct ast_node {
     } data;
 };
 
+/* Receives function bodies statement by statement instead of as trees.
+ * function() sees the function with its parameters and no body; open()
+ * sees a block, or an if/while/for with everything before its body, and
+ * is matched by close() (also called for the function itself); branch()
+ * marks the else of an open if. open() and statement() take ownership of
+ * their node; branch() and close() get the opened node back only to name
+ * it. The function itself stays the parser's. */
+typedef struct {
+    void (*function)(ast_node_t* fn);
+    void (*open)(ast_node_t* node);
+    void (*branch)(ast_node_t* node);
+    void (*close)(ast_node_t* node);
+    void (*statement)(ast_node_t* stmt);
+} parser_sink_t;
+
 /* Parser structure */
 typedef struct {
     token_t* current;
     token_t* next;
     uint16_t error_count;
+    const parser_sink_t* sink; /* NULL: bodies are parsed as trees */
 } parser_t;
 
 extern parser_t* parser;
@@ -163,5 +184,6 @@ void parser_destroy(parser_t* parser);
 ast_node_t* parser_parse(void);
 ast_node_t* parser_parse_next(void);
 void ast_node_destroy(ast_node_t* node);
+int8_t parser_parse_unit(const char* input_file, output_t out);
 
 #endif /* PARSER_H */
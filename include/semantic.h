@@ -4,6 +4,8 @@
 #include "ast_reader.h"
 #include "common.h"
 
-cc_error_t semantic_validate(void);
+/* Checks the AST; given an output, also writes it as an analyzed AST
+ * (AST_FLAG_ANALYZED) that cc_codegen reads without its pre-scans. */
+cc_error_t semantic_validate(const output_t* analysis);
 
 #endif /* SEMANTIC_H */
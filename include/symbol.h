@@ -100,5 +100,6 @@ type_t* type_create(type_kind_t kind);
 void type_destroy(type_t* type);
 type_t* type_create_pointer(type_t* base);
 type_t* type_create_array(type_t* element, size_t length);
+type_t* type_clone(const type_t* type);
 
 #endif /* SYMBOL_H */
@@ -12,10 +12,13 @@ typedef struct {
     char* input_file;
     char* output_file;
     uint8_t error;          /* 1 if error occurred, 0 otherwise */
+    uint8_t stats;          /* --stats given (CC_STATS builds only) */
+    char* cost_file;        /* --cost FILE (CC_COST builds only) */
+    uint16_t stack_limit;   /* --stack-limit BYTES (CC_COST builds only) */
 } args_t;
 
 #define ARG_MODE_IN_OUT 0
-#define ARG_MODE_IN_ONLY 1
+#define ARG_MODE_IN_ONLY 1 /* output_file optional */
 
 #ifdef __SDCC
 typedef int16_t output_t;
@@ -54,4 +57,15 @@ void output_close(output_t handle);
 int8_t output_write(output_t handle, const char* data, uint16_t len);
 uint32_t output_tell(output_t handle);
 
+#ifndef __SDCC
+/* Host-only memory backends for the in-process cc driver. The reader
+ * borrows data; the output buffer grows as written and is valid in
+ * data/len after output_close (release it with free()). */
+reader_t* reader_open_memory(const char* data, uint32_t len);
+/* The next len bytes in place, consuming them, or NULL if they are not
+ * contiguous in memory (use reader_next then). */
+const uint8_t* reader_span(reader_t* reader, uint16_t len);
+output_t output_open_memory(char** data, size_t* len);
+#endif
+
 #endif /* TARGET_H */
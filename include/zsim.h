@@ -0,0 +1,66 @@
+#ifndef ZSIM_H
+#define ZSIM_H
+
+/* Host-only Z80 simulator used to run and time generated code.
+ * Not part of the ZOS build. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ZSIM_MEM_SIZE 0x10000
+#define ZSIM_DEFAULT_ORG 0x4000
+#define ZSIM_MAX_FILES 8
+
+#define ZSIM_FLAG_C 0x01
+#define ZSIM_FLAG_N 0x02
+#define ZSIM_FLAG_PV 0x04
+#define ZSIM_FLAG_H 0x10
+#define ZSIM_FLAG_Z 0x40
+#define ZSIM_FLAG_S 0x80
+
+typedef struct {
+    char* name;
+    uint16_t addr;
+    uint8_t is_label; /* defined by "name:" rather than .equ */
+} zsim_symbol_t;
+
+typedef struct {
+    zsim_symbol_t* items;
+    uint16_t count;
+    uint16_t capacity;
+} zsim_symtab_t;
+
+typedef struct zsim {
+    uint8_t a, f, b, c, d, e, h, l;
+    uint8_t a2, f2, b2, c2, d2, e2, h2, l2;
+    uint16_t ix, iy, sp, pc;
+    uint8_t i, r, iff1, iff2, im;
+    uint8_t halted;
+    uint8_t exited;
+    uint8_t exit_code;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint8_t mem[ZSIM_MEM_SIZE];
+    /* Syscall stub state */
+    const char* root;
+    void* files[ZSIM_MAX_FILES];
+    uint64_t syscall_count;
+} zsim_t;
+
+/* CPU */
+void zsim_reset(zsim_t* sim, uint16_t pc, uint16_t sp);
+/* Execute one instruction (including syscall stubs), returns T-states. */
+uint8_t zsim_step(zsim_t* sim);
+void zsim_close_files(zsim_t* sim);
+
+/* Assembler: assemble a Zealasm-compatible source into sim->mem.
+ * Returns 0 on success, -1 on error (message printed to stderr). */
+int zsim_assemble(const char* path, uint8_t* mem, uint16_t* out_start,
+                  uint16_t* out_end, zsim_symtab_t* symbols);
+
+void zsim_symtab_init(zsim_symtab_t* tab);
+void zsim_symtab_free(zsim_symtab_t* tab);
+int zsim_symtab_add(zsim_symtab_t* tab, const char* name, uint16_t addr);
+const zsim_symbol_t* zsim_symtab_find(const zsim_symtab_t* tab, const char* name);
+
+#endif /* ZSIM_H */
@@ -2,32 +2,21 @@
 
 ; Multiply HL by DE (unsigned), result in HL
 __mul_hl_de:
-    ld a, h
-    or d
-    jr nz, __mul_hl_de_f
-    ld a, l
-    ld l, e
-    call __mul_a_l
-    ld l, a
-    ld h, 0
-    ret
-__mul_hl_de_f:
     ld b, h
     ld c, l
     ld hl, 0
-    ld a, 16
 __mul_hl_de_l:
-    bit 0, e
-    jr z, __mul_hl_de_s
+    ld a, d
+    or e
+    ret z           ; stop once the multiplier has no bits left
+    srl d
+    rr e
+    jr nc, __mul_hl_de_s
     add hl, bc
 __mul_hl_de_s:
     sla c
     rl b
-    srl d
-    rr e
-    dec a
-    jr nz, __mul_hl_de_l
-    ret
+    jr __mul_hl_de_l
 
 ; Divide HL by DE (unsigned), quotient in HL
 __div_hl_de:
@@ -0,0 +1,93 @@
+#define _POSIX_C_SOURCE 200809L /* getpid */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast_io.h"
+#include "cache.h"
+#include "common.h"
+
+#define CACHE_FNV_OFFSET 0xcbf29ce484222325ULL
+#define CACHE_FNV_PRIME 0x100000001b3ULL
+
+cache_key_t cache_hash(cache_key_t key, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        key ^= p[i];
+        key *= CACHE_FNV_PRIME;
+    }
+    return key;
+}
+
+cache_key_t cache_seed(void) {
+    static const uint8_t seed[] = {
+        'z', 'c', 'c',
+        CC_VERSION_MAJOR, CC_VERSION_MINOR, CC_VERSION_PATCH,
+        CC_TRUST_SEMANTIC,
+        CC_AST_FORMAT,
+    };
+    return cache_hash(CACHE_FNV_OFFSET, seed, sizeof(seed));
+}
+
+int8_t cache_hash_file(cache_key_t* key, const char* path) {
+    char buffer[4096];
+    size_t n;
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return -1;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        *key = cache_hash(*key, buffer, n);
+    }
+    fclose(fp);
+    return 0;
+}
+
+char* cache_path(const char* dir, cache_key_t key, const char* ext) {
+    size_t len = strlen(dir) + 1 + 16 + 1 + strlen(ext) + 1;
+    char* path = (char*)malloc(len);
+    if (!path) return NULL;
+    snprintf(path, len, "%s/%016llx.%s", dir, (unsigned long long)key, ext);
+    return path;
+}
+
+int8_t cache_load(const char* path, char** data, size_t* len) {
+    FILE* fp = fopen(path, "rb");
+    long size;
+    *data = NULL;
+    *len = 0;
+    if (!fp) return -1;
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    *data = (char*)malloc(size > 0 ? (size_t)size : 1);
+    if (!*data || fread(*data, 1, (size_t)size, fp) != (size_t)size) {
+        free(*data);
+        *data = NULL;
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    *len = (size_t)size;
+    return 0;
+}
+
+int8_t cache_store(const char* path, const char* data, size_t len) {
+    size_t tmp_len = strlen(path) + 24;
+    char* tmp = (char*)malloc(tmp_len);
+    FILE* fp;
+    int8_t err = -1;
+    if (!tmp) return -1;
+    snprintf(tmp, tmp_len, "%s.%ld.tmp", path, (long)getpid());
+    fp = fopen(tmp, "wb");
+    if (fp) {
+        size_t written = len ? fwrite(data, 1, len, fp) : 0;
+        if (fclose(fp) == 0 && written == len && rename(tmp, path) == 0) {
+            err = 0;
+        } else {
+            remove(tmp);
+        }
+    }
+    free(tmp);
+    return err;
+}
@@ -1,7 +1,423 @@
+#ifndef __SDCC
+#define _XOPEN_SOURCE 700 /* fork, waitpid, readlink, realpath */
+#endif
+
 #include "cc_compat.h"
+#include "common.h"
+#include "target.h"
+
+#ifdef __SDCC
 
 int main(int argc, char** argv) {
     (unused)argc;
     (unused)argv;
-    return 0x02; // not yet implemented
+    put_s("cc: run cc_parse, cc_semantic and cc_codegen\n");
+    return 0x02;
+}
+
+#else
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ast_io.h"
+#include "ast_reader.h"
+#include "cache.h"
+#include "codegen.h"
+#include "parser.h"
+#include "semantic.h"
+
+/* Host driver: parse, semantic and codegen in one process. The AST is
+ * kept in a memory buffer between the stages instead of a .ast file.
+ *
+ * The stages keep their state in globals and a single pool, so several
+ * inputs are compiled in forked workers (up to -j at a time), each with
+ * its own copy of that state.
+ *
+ * With --cache DIR, the validated AST is stored under a hash of the source
+ * and the compiler version, and the .asm under a hash of that AST and the
+ * runtime files codegen copies into it. A hit skips parse and semantic, or
+ * all three stages when the AST is unchanged (e.g. after a comment edit). */
+
+#define CC_MAX_INPUTS 256
+
+static const char CC_MSG_USAGE[] =
+    "Usage: cc <input.c> -o <output.asm> [--ast <file.ast>] [--cache <dir>]"
+#if CC_STATS
+    " [--stats]"
+#endif
+    "\n"
+    "       cc [-j N] [--cache <dir>] <input.c>... (writes each input's .asm next to it)\n";
+
+/* Copied verbatim into every .asm by codegen, so part of the asm key */
+static const char* const CC_RUNTIME_FILES[] = {
+    "crt0.asm",
+    "zeal8bit.asm",
+    "math_8.asm",
+    "math_16.asm",
+};
+
+/* runtime/ beside the bin/ directory holding this executable, so cc works
+ * from any directory; "runtime" in the current one if that fails */
+static const char* g_runtime_dir = "runtime";
+
+reader_t* reader;
+ast_reader_t* ast;
+ast_reader_t ast_ctx;
+codegen_t codegen;
+
+typedef struct {
+    const char* inputs[CC_MAX_INPUTS];
+    uint16_t input_count;
+    const char* output_file;
+    const char* ast_file;
+    const char* cache_dir;
+    uint16_t jobs;
+    uint8_t stats;
+    uint8_t error;
+} cc_args_t;
+
+static codegen_t* g_codegen_ctx;
+
+static void cleanup(void) {
+    if (g_codegen_ctx) {
+        codegen_destroy(g_codegen_ctx);
+        g_codegen_ctx = NULL;
+    }
+    ast_reader_destroy();
+    reader_close(reader);
+    reader = NULL;
+}
+
+static void handle_error(char* msg) {
+    log_error(msg);
+    cleanup();
+    exit(1);
+}
+
+static void cc_parse_args(int argc, char** argv, cc_args_t* args) {
+    mem_set(args, 0, sizeof(*args));
+    args->jobs = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            args->output_file = argv[++i];
+        } else if (strcmp(argv[i], "--ast") == 0 && i + 1 < argc) {
+            args->ast_file = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            args->cache_dir = argv[++i];
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            const char* n = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+            int jobs = atoi(n);
+            if (jobs < 1) args->error = 1;
+            args->jobs = (uint16_t)(jobs > CC_MAX_INPUTS ? CC_MAX_INPUTS : jobs);
+#if CC_STATS
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            args->stats = 1;
+#endif
+        } else if (argv[i][0] == '-' || args->input_count == CC_MAX_INPUTS) {
+            args->error = 1;
+        } else {
+            args->inputs[args->input_count++] = argv[i];
+        }
+    }
+    /* The original two-operand form: cc input.c output.asm */
+    if (args->input_count == 2 && !args->output_file) {
+        const char* second = args->inputs[1];
+        size_t len = strlen(second);
+        if (len > 4 && strcmp(second + len - 4, ".asm") == 0) {
+            args->output_file = second;
+            args->input_count = 1;
+        }
+    }
+    if (args->input_count == 0) args->error = 1;
+    /* Without -o even a single input is a batch of one, so a file list
+     * that happens to hold one entry still works */
+    if (!args->output_file && args->ast_file) args->error = 1;
+    if (args->input_count > 1 && args->output_file) args->error = 1;
+}
+
+static void cc_stage_done(const cc_args_t* args, const char* stage) {
+#if CC_STATS
+    if (args->stats) cc_stats_print(stage);
+    mem_set(&g_cc_stats, 0, sizeof(g_cc_stats));
+#else
+    (void)args;
+    (void)stage;
+#endif
+}
+
+static int8_t cc_write_file(const char* path, const char* data, size_t len) {
+    output_t out = output_open(path);
+    int8_t err = 0;
+    if (!out) return -1;
+    while (len > 0 && err == 0) {
+        uint16_t chunk = len > 0x4000 ? 0x4000 : (uint16_t)len;
+        err = output_write(out, data, chunk);
+        data += chunk;
+        len -= chunk;
+    }
+    output_close(out);
+    return err;
+}
+
+/* Opens the in-memory AST for a consuming stage */
+static int8_t cc_open_ast(const char* data, size_t len) {
+    cc_init_pool_default();
+    mem_set(ast, 0, sizeof(ast_ctx));
+    reader = reader_open_memory(data, (uint32_t)len);
+    if (!reader) return -1;
+    if (ast_reader_init() < 0) {
+        log_error("Failed to read AST header\n");
+        return -1;
+    }
+    if (ast_reader_load_strings() < 0) {
+        log_error("Failed to read AST string table\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Parses and validates input_file into a malloc'd analyzed AST buffer */
+static int8_t cc_front_end(const cc_args_t* args, const char* input_file, char** ast_data, size_t* ast_len) {
+    output_t out;
+    char* parsed = NULL;
+    size_t parsed_len = 0;
+    int8_t err = -1;
+
+    cc_init_pool_default();
+    out = output_open_memory(&parsed, &parsed_len);
+    if (!out) return -1;
+    if (parser_parse_unit(input_file, out) < 0) {
+        output_close(out);
+        goto done;
+    }
+    output_close(out);
+    cc_stage_done(args, "cc_parse");
+
+    if (cc_open_ast(parsed, parsed_len) < 0) goto done;
+    out = output_open_memory(ast_data, ast_len);
+    if (!out) goto done;
+    ast_write_handler(handle_error, "Failed to write analyzed AST\n");
+    if (semantic_validate(&out) != CC_OK) {
+        output_close(out);
+        free(*ast_data);
+        *ast_data = NULL;
+        log_error("Semantic validation failed\n");
+        goto done;
+    }
+    output_close(out);
+    cleanup();
+    cc_stage_done(args, "cc_semantic");
+    err = 0;
+
+done:
+    cleanup();
+    free(parsed);
+    return err;
+}
+
+static int8_t cc_back_end(const cc_args_t* args, const char* output_file, const char* ast_data, size_t ast_len) {
+    int8_t err = -1;
+
+    if (cc_open_ast(ast_data, ast_len) < 0) goto done;
+    codegen_set_runtime_dir(g_runtime_dir);
+    g_codegen_ctx = codegen_create(output_file);
+    if (!g_codegen_ctx) {
+        log_error("Failed to open output file\n");
+        goto done;
+    }
+    if (codegen_generate_stream() != CC_OK) {
+        log_error("Code generation failed\n");
+        goto done;
+    }
+    cleanup();
+    cc_stage_done(args, "cc_codegen");
+    err = 0;
+
+done:
+    cleanup();
+    return err;
+}
+
+static void cc_find_runtime_dir(const char* argv0) {
+    char exe[4096];
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    char* path = NULL;
+    char* bin = NULL;
+    char* root = NULL;
+    if (len > 0) {
+        exe[len] = '\0';
+        path = strdup(exe);
+    } else if (argv0 && strchr(argv0, '/')) {
+        path = realpath(argv0, NULL);
+    }
+    if (!path) return;
+    /* <root>/bin/cc -> <root>/runtime */
+    bin = strrchr(path, '/');
+    if (bin) {
+        *bin = '\0';
+        root = strrchr(path, '/');
+    }
+    if (root) {
+        size_t n = (size_t)(root - path) + 1;
+        char* dir = (char*)malloc(n + sizeof("runtime"));
+        if (dir) {
+            memcpy(dir, path, n);
+            memcpy(dir + n, "runtime", sizeof("runtime"));
+            g_runtime_dir = dir;
+        }
+    }
+    free(path);
+}
+
+/* Key for the .asm of a given AST; -1 if a runtime file is missing */
+static int8_t cc_asm_key(const char* ast_data, size_t ast_len, cache_key_t* key) {
+    *key = cache_hash(cache_seed(), ast_data, ast_len);
+    for (size_t i = 0; i < sizeof(CC_RUNTIME_FILES) / sizeof(CC_RUNTIME_FILES[0]); i++) {
+        size_t len = strlen(g_runtime_dir) + 1 + strlen(CC_RUNTIME_FILES[i]) + 1;
+        char* path = (char*)malloc(len);
+        int8_t err;
+        if (!path) return -1;
+        snprintf(path, len, "%s/%s", g_runtime_dir, CC_RUNTIME_FILES[i]);
+        err = cache_hash_file(key, path);
+        if (err < 0) {
+            log_error("Missing runtime file: ");
+            log_error(path);
+            log_error("\n");
+        }
+        free(path);
+        if (err < 0) return -1;
+    }
+    return 0;
+}
+
+/* Compiles one translation unit; returns 0 on success */
+static int8_t cc_compile_unit(const cc_args_t* args, const char* input_file, const char* output_file) {
+    int8_t err = 1;
+    char* ast_data = NULL;
+    size_t ast_len = 0;
+    char* asm_data = NULL;
+    size_t asm_len = 0;
+    char* ast_path = NULL;
+    char* asm_path = NULL;
+    cache_key_t key;
+
+    if (args->cache_dir) {
+        key = cache_seed();
+        if (cache_hash_file(&key, input_file) < 0) {
+            log_error("Failed to open input file\n");
+            goto done;
+        }
+        ast_path = cache_path(args->cache_dir, key, "ast");
+        if (!ast_path) goto done;
+        cache_load(ast_path, &ast_data, &ast_len);
+    }
+    if (!ast_data) {
+        if (cc_front_end(args, input_file, &ast_data, &ast_len) < 0) goto done;
+        if (ast_path) cache_store(ast_path, ast_data, ast_len);
+    }
+
+    if (args->ast_file && cc_write_file(args->ast_file, ast_data, ast_len) < 0) {
+        log_error("Failed to write AST file\n");
+        goto done;
+    }
+
+    if (args->cache_dir) {
+        if (cc_asm_key(ast_data, ast_len, &key) < 0) goto done;
+        asm_path = cache_path(args->cache_dir, key, "asm");
+        if (!asm_path) goto done;
+        cache_load(asm_path, &asm_data, &asm_len);
+    }
+    if (asm_data) {
+        if (cc_write_file(output_file, asm_data, asm_len) < 0) {
+            log_error("Failed to open output file\n");
+            goto done;
+        }
+    } else {
+        if (cc_back_end(args, output_file, ast_data, ast_len) < 0) goto done;
+        if (asm_path && cache_load(output_file, &asm_data, &asm_len) == 0) {
+            cache_store(asm_path, asm_data, asm_len);
+        }
+    }
+
+    log_msg(input_file);
+    log_msg(" -> ");
+    log_msg(output_file);
+    log_msg("\n");
+    err = 0;
+
+done:
+    free(ast_path);
+    free(asm_path);
+    free(ast_data);
+    free(asm_data);
+    return err;
+}
+
+/* Forks a worker for inputs[index], writing <input minus .c>.asm */
+static pid_t cc_spawn_unit(const cc_args_t* args, uint16_t index) {
+    pid_t pid;
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid == 0) {
+        const char* input = args->inputs[index];
+        size_t len = strlen(input);
+        char* output = (char*)malloc(len + 5);
+        int8_t err;
+        if (!output) _exit(1);
+        memcpy(output, input, len + 1);
+        if (len > 2 && strcmp(output + len - 2, ".c") == 0) len -= 2;
+        memcpy(output + len, ".asm", 5);
+        err = cc_compile_unit(args, input, output);
+        fflush(stdout);
+        _exit(err);
+    }
+    return pid;
+}
+
+/* Keeps up to args->jobs workers busy, handing the next input to whichever
+ * finishes first; returns the number of failed units. */
+static uint16_t cc_compile_all(const cc_args_t* args) {
+    uint16_t next = 0;
+    uint16_t running = 0;
+    uint16_t failed = 0;
+
+    while (next < args->input_count || running > 0) {
+        int status = 0;
+        if (next < args->input_count && running < args->jobs) {
+            if (cc_spawn_unit(args, next) < 0) {
+                log_error("cc: fork failed\n");
+                failed++;
+            } else {
+                running++;
+            }
+            next++;
+            continue;
+        }
+        if (wait(&status) < 0) break;
+        running--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+    return failed;
 }
+
+int main(int argc, char** argv) {
+    static cc_args_t args;
+
+    cc_parse_args(argc, argv, &args);
+    if (args.error) {
+        log_error(CC_MSG_USAGE);
+        return 1;
+    }
+    ast = &ast_ctx;
+    ast_read_handler(handle_error, "Failed to read AST\n");
+    cc_find_runtime_dir(argv[0]);
+
+    if (args.output_file) {
+        return cc_compile_unit(&args, args.inputs[0], args.output_file);
+    }
+    return cc_compile_all(&args) ? 1 : 0;
+}
+
+#endif
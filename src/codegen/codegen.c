@@ -1,5 +1,6 @@
 #include "codegen.h"
 
+#include "ast_analysis.h"
 #include "ast_format.h"
 #include "ast_io.h"
 #include "ast_reader.h"
@@ -36,7 +37,7 @@ static cc_error_t codegen_stream_global_var(void);
 static void codegen_emit_ix_offset(int16_t offset);
 static void codegen_emit_hex(uint16_t value);
 static bool codegen_stream_type_is_16bit(uint8_t base, uint8_t depth);
-static void codegen_emit_string_literal(const char* value);
+static void codegen_emit_string_literal(const char* value, uint16_t len);
 
 
 static uint32_t g_arg_offsets[8];
@@ -48,6 +49,10 @@ static codegen_t* gen;
 static bool g_result_in_hl = false;
 /* Forces expression emission to produce a 16-bit result in HL when true. */
 static bool g_expect_result_in_hl = false;
+/* Loop-invariant value held in BC for the loop being emitted: the variable
+   itself, or its address when g_hoist_address (see codegen_hoist_begin). */
+static const char* g_hoist_name = NULL;
+static bool g_hoist_address = false;
 
 /* Helpers */
 
@@ -210,9 +215,28 @@ static void codegen_emit_hex(uint16_t value) {
     codegen_emit(g_emit_buf);
 }
 
-static void codegen_emit_file(const char* path) {
-    if (!gen->output_handle || !path) return;
+/* NULL: "runtime" in the current directory */
+static const char* g_runtime_dir;
+
+void codegen_set_runtime_dir(const char* dir) {
+    g_runtime_dir = dir;
+}
+
+/* Copies runtime/<name> into the output */
+static void codegen_emit_file(const char* name) {
+    const char* dir = g_runtime_dir ? g_runtime_dir : "runtime";
+    size_t dir_len = 0;
+    size_t name_len = 0;
+    char* path;
+    if (!gen->output_handle || !name) return;
+    dir_len = str_len(dir);
+    name_len = str_len(name);
+    path = (char*)cc_malloc(dir_len + name_len + 2);
+    mem_cpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    mem_cpy(path + dir_len + 1, name, name_len + 1);
     reader_t* reader = reader_open(path);
+    cc_free(path);
     if (!reader) {
         cc_error("Failed to open runtime file");
         return;
@@ -299,36 +323,65 @@ static char* codegen_loop_continue_label(void) {
     return gen->loop_continue_labels[gen->loop_depth - 1];
 }
 
-static void codegen_emit_string_literal(const char* value) {
+#if CC_COST
+/* Size and timing of the function being emitted, fed a line at a time */
+static codegen_cost_t g_cost;
+static bool g_cost_on = false;
+static char g_cost_line[48];
+static uint8_t g_cost_len;
+
+static void codegen_cost_feed(const char* text, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        if (text[i] == '\n') {
+            codegen_cost_line(g_cost_line, g_cost_len, &g_cost);
+            g_cost_len = 0;
+        } else if (g_cost_len < sizeof(g_cost_line)) {
+            g_cost_line[g_cost_len++] = text[i];
+        }
+    }
+}
+#endif
+
+static void codegen_emit_text(const char* text, uint16_t len) {
+    if (gen->output_handle && len > 0) {
+        output_write(gen->output_handle, text, len);
+#if CC_COST
+        if (g_cost_on) codegen_cost_feed(text, len);
+#endif
+    }
+}
+
+/* Writes len bytes of value as one .dm line, the runs between escapes in
+ * single writes */
+static void codegen_emit_string_literal(const char* value, uint16_t len) {
+    uint16_t run = 0;
     if (!value) return;
     codegen_emit(CG_STR_DM);
     codegen_emit("\"");
-    for (const char* p = value; *p; ++p) {
-        char c = *p;
+    for (uint16_t i = 0; i < len; i++) {
+        const char* escape = NULL;
+        char c = value[i];
         if (c == '"') {
-            codegen_emit("\\\"");
-            continue;
-        }
-        if (c == '\\') {
-            codegen_emit("\\\\");
-            continue;
-        }
-        if (c == '\n') {
-            codegen_emit("\\n");
-            continue;
+            escape = "\\\"";
+        } else if (c == '\\') {
+            escape = "\\\\";
+        } else if (c == '\n') {
+            escape = "\\n";
         }
-        g_emit_buf[0] = c;
-        g_emit_buf[1] = '\0';
-        codegen_emit(g_emit_buf);
+        if (!escape) continue;
+        codegen_emit_text(value + run, (uint16_t)(i - run));
+        codegen_emit(escape);
+        run = (uint16_t)(i + 1u);
     }
+    codegen_emit_text(value + run, (uint16_t)(len - run));
     codegen_emit("\"\n");
 }
 
 static int8_t codegen_stream_read_name( const char** value) {
     uint16_t index = 0;
     if (!value) return -1;
-    index = ast_read_u16();
-    *value = ast_reader_string(index);
+    index = ast_read_index();
+    *value = ast_reader_name(index);
     return *value ? 0 : -1;
 }
 
@@ -362,26 +415,33 @@ static int16_t codegen_global_index(const char* name) {
     return -1;
 }
 
-static void codegen_record_local(const char* name, uint16_t size,
-                                 bool is_16bit, bool is_signed, bool is_pointer,
-                                 bool is_array, uint8_t elem_size, bool elem_signed) {
-    if (!name) return;
-    if (codegen_local_index(name) >= 0) return;
-    if (gen->local_var_count < DIM(gen->locals)) {
+static int8_t codegen_record_local(const char* name, int16_t offset, uint16_t size,
+                                   uint8_t flags, uint8_t elem_size) {
+    if (!name) return 0;
+    if (codegen_local_index(name) >= 0) return 0;
+    /* Without an analysis section the frame size is not known up front */
+    if (gen->local_var_count == gen->local_capacity) {
+        codegen_local_t* grown = (codegen_local_t*)cc_grow(
+            gen->locals, &gen->local_capacity,
+            gen->local_capacity ? (uint16_t)(gen->local_capacity * 2u) : 8u,
+            sizeof(codegen_local_t));
+        if (!grown) {
+            cc_error(CG_MSG_OUT_OF_MEMORY);
+            return -1;
+        }
+        gen->locals = grown;
+    }
+    if (gen->local_var_count < gen->local_capacity) {
         codegen_local_t local;
         local.name = name;
-        local.offset = gen->stack_offset;
+        local.offset = offset;
         local.elem_size = elem_size;
-        local.flags = 0;
-        if (is_16bit) local.flags |= CG_FLAG_IS_16;
-        if (is_signed) local.flags |= CG_FLAG_IS_SIGNED;
-        if (is_pointer) local.flags |= CG_FLAG_IS_POINTER;
-        if (is_array) local.flags |= CG_FLAG_IS_ARRAY;
-        if (elem_signed) local.flags |= CG_FLAG_ELEM_SIGNED;
+        local.flags = flags;
         mem_cpy(&gen->locals[gen->local_var_count], &local, sizeof(local));
-        gen->stack_offset += size;
+        gen->stack_offset = (int16_t)(offset + size);
         gen->local_var_count++;
     }
+    return 0;
 }
 
 static uint8_t codegen_param_offset(const char* name, int16_t* out_offset) {
@@ -554,16 +614,15 @@ static bool codegen_pointer_elem_signed_by_name(const char* name) {
     return false;
 }
 
-static const char* codegen_get_string_label(const char* value);
+static const char* codegen_get_string_label(uint16_t index);
 
 static uint8_t codegen_peek_array_elem_size(void) {
     uint8_t base_tag = 0;
     uint8_t index_tag = 0;
     uint8_t elem_size = 1;
-    base_tag = ast_read_u8();
+    base_tag = ast_read_tag();
     if (base_tag == AST_TAG_STRING_LITERAL) {
-        const char* base_string = NULL;
-        if (codegen_stream_read_name(&base_string) < 0) return 0;
+        (void)ast_read_index();
     } else if (base_tag == AST_TAG_IDENTIFIER) {
         const char* base_name = NULL;
         if (codegen_stream_read_name(&base_name) < 0) return 0;
@@ -577,13 +636,21 @@ static uint8_t codegen_peek_array_elem_size(void) {
     } else {
         if (ast_reader_skip_tag(base_tag) < 0) return 0;
     }
-    index_tag = ast_read_u8();
+    index_tag = ast_read_tag();
     if (ast_reader_skip_tag(index_tag) < 0) return 0;
     return elem_size;
 }
 
+static bool codegen_is_hoisted(const char* name, bool address) {
+    return g_hoist_name && g_hoist_address == address && codegen_names_equal(name, g_hoist_name);
+}
+
 static cc_error_t codegen_emit_address_of_identifier(const char* name) {
     int16_t offset = 0;
+    if (codegen_is_hoisted(name, true)) {
+        codegen_emit(CG_STR_LD_HL_BC);
+        return CC_OK;
+    }
     if (codegen_local_or_param_offset(name, &offset)) {
         codegen_emit(CG_STR_PUSH_IX_POP_HL);
         if (offset != 0) {
@@ -604,6 +671,10 @@ static cc_error_t codegen_emit_address_of_identifier(const char* name) {
 
 static cc_error_t codegen_load_pointer_to_hl(const char* name) {
     int16_t offset = 0;
+    if (codegen_is_hoisted(name, false)) {
+        codegen_emit(CG_STR_LD_HL_BC);
+        return CC_OK;
+    }
     if (codegen_local_or_param_offset(name, &offset)) {
         codegen_emit("  ld l, (ix");
         codegen_emit_ix_offset(offset);
@@ -653,9 +724,9 @@ static cc_error_t codegen_store_a_to_identifier(const char* name) {
     return CC_OK;
 }
 
-static cc_error_t codegen_load_array_base_to_hl(const char* base_string,
+static cc_error_t codegen_load_array_base_to_hl(bool has_string, uint16_t base_string,
                                                 const char* base_name) {
-    if (base_string) {
+    if (has_string) {
         const char* label = codegen_get_string_label(base_string);
         if (!label) return CC_ERROR_CODEGEN;
         codegen_emit(CG_STR_LD_HL);
@@ -686,11 +757,13 @@ static cc_error_t codegen_emit_array_address(uint8_t* out_elem_size,
     uint8_t base_tag = 0;
     uint8_t index_tag = 0;
     const char* base_name = NULL;
-    const char* base_string = NULL;
+    bool has_string = false;
+    uint16_t base_string = 0;
 
-    base_tag = ast_read_u8();
+    base_tag = ast_read_tag();
     if (base_tag == AST_TAG_STRING_LITERAL) {
-        if (codegen_stream_read_name(&base_string) < 0) return CC_ERROR_CODEGEN;
+        base_string = ast_read_index();
+        has_string = true;
     } else if (base_tag == AST_TAG_IDENTIFIER) {
         if (codegen_stream_read_name(&base_name) < 0) return CC_ERROR_CODEGEN;
     } else {
@@ -700,7 +773,7 @@ static cc_error_t codegen_emit_array_address(uint8_t* out_elem_size,
 #endif
         return CC_ERROR_CODEGEN;
     }
-    index_tag = ast_read_u8();
+    index_tag = ast_read_tag();
 
     uint8_t elem_size = 1;
     bool elem_signed = false;
@@ -735,7 +808,7 @@ static cc_error_t codegen_emit_array_address(uint8_t* out_elem_size,
         "  ld e, a\n"
         "  ld d, 0\n");
 
-    err = codegen_load_array_base_to_hl(base_string, base_name);
+    err = codegen_load_array_base_to_hl(has_string, base_string, base_name);
     if (err != CC_OK) return err;
     codegen_emit(CG_STR_ADD_HL_DE);
 
@@ -764,30 +837,56 @@ static char* codegen_new_label_persist(void) {
     return out ? out : tmp;
 }
 
-static const char* codegen_get_string_label(const char* value) {
-    if (!value) return NULL;
-    for (codegen_string_count_t i = 0; i < gen->string_count; i++) {
-        if (gen->string_literals[i] && str_cmp(gen->string_literals[i], value) == 0) {
-            return gen->string_labels[i];
-        }
-    }
-    if (gen->string_count >= DIM(gen->string_labels)) {
-        return NULL;
+static void codegen_string_insert(uint16_t hash, uint16_t slot) {
+    uint16_t bucket = (uint16_t)(hash & gen->string_bucket_mask);
+    while (gen->string_buckets[bucket]) {
+        bucket = (uint16_t)((bucket + 1u) & gen->string_bucket_mask);
     }
-    char* label = codegen_new_string_label();
-    if (label) {
-        label = cc_strdup(label);
+    gen->string_buckets[bucket] = (uint16_t)(slot + 1u);
+}
+
+/* Literals are kept as string table indices and read back when emitted;
+ * the parser gives identical literals the same index */
+static const char* codegen_get_string_label(uint16_t index) {
+    uint16_t bucket = 0;
+    uint16_t entry = 0;
+    if (gen->string_buckets) {
+        bucket = (uint16_t)(index & gen->string_bucket_mask);
+        while ((entry = gen->string_buckets[bucket]) != 0) {
+            if (gen->strings[entry - 1u].index == index) {
+                return codegen_string_label((uint16_t)(entry - 1u));
+            }
+            bucket = (uint16_t)((bucket + 1u) & gen->string_bucket_mask);
+        }
     }
-    char* copy = cc_strdup(value);
-    if (!label || !copy) {
-        if (label) cc_free(label);
-        if (copy) cc_free(copy);
-        return NULL;
+    /* Names share the string table, so it only bounds the literals: grow
+     * by doubling up to its size, with twice as many buckets */
+    if (gen->string_count == gen->string_capacity) {
+        uint16_t need = gen->string_capacity ? (uint16_t)(gen->string_capacity * 2u) : 8u;
+        uint16_t buckets = 1;
+        codegen_string_t* grown;
+        if (need > ast->string_count) need = ast->string_count;
+        if (need <= gen->string_capacity) return NULL;
+        grown = (codegen_string_t*)cc_grow(gen->strings, &gen->string_capacity, need,
+                                           sizeof(codegen_string_t));
+        if (!grown) {
+            cc_error(CG_MSG_OUT_OF_MEMORY);
+            return NULL;
+        }
+        gen->strings = grown;
+        while (buckets < (uint16_t)(need * 2u)) buckets = (uint16_t)(buckets << 1);
+        cc_free(gen->string_buckets);
+        gen->string_buckets = (uint16_t*)cc_malloc(sizeof(uint16_t) * buckets);
+        if (!gen->string_buckets) return NULL;
+        mem_set(gen->string_buckets, 0, sizeof(uint16_t) * buckets);
+        gen->string_bucket_mask = (uint16_t)(buckets - 1u);
+        for (codegen_string_count_t i = 0; i < gen->string_count; i++) {
+            codegen_string_insert(gen->strings[i].index, i);
+        }
     }
-    gen->string_labels[gen->string_count] = label;
-    gen->string_literals[gen->string_count] = copy;
-    gen->string_count++;
-    return label;
+    gen->strings[gen->string_count].index = index;
+    codegen_string_insert(index, gen->string_count);
+    return codegen_string_label(gen->string_count++);
 }
 
 codegen_t* codegen_create(const char* output_file) {
@@ -811,14 +910,19 @@ void codegen_destroy(codegen_t* gen) {
     if (gen->output_handle) {
         output_close(gen->output_handle);
     }
-    for (codegen_string_count_t i = 0; i < gen->string_count; i++) {
-        if (gen->string_labels[i]) {
-            cc_free((void*)gen->string_labels[i]);
-        }
-        if (gen->string_literals[i]) {
-            cc_free(gen->string_literals[i]);
-        }
+#if CC_COST
+    if (gen->cost_handle) {
+        output_close(gen->cost_handle);
     }
+    cc_free(gen->calls);
+    cc_free(gen->function_costs);
+#endif
+    cc_free(gen->strings);
+    cc_free(gen->string_buckets);
+    cc_free(gen->globals);
+    cc_free(gen->function_return_flags);
+    cc_free(gen->params);
+    cc_free(gen->locals);
 }
 
 void codegen_emit(const char* fmt) {
@@ -828,8 +932,250 @@ void codegen_emit(const char* fmt) {
     while (p[len]) len++;
     if (len > 0) {
         output_write(gen->output_handle, fmt, len);
+#if CC_COST
+        if (g_cost_on) codegen_cost_feed(fmt, len);
+#endif
+    }
+}
+
+#if CC_COST
+int8_t codegen_open_cost(const char* path) {
+    static const char header[] = "function,bytes,min_t,max_t,stack,stack_total\n";
+    gen->cost_handle = output_open(path);
+#ifdef __SDCC
+    if (gen->cost_handle < 0) {
+        gen->cost_handle = 0;
+#else
+    if (!gen->cost_handle) {
+#endif
+        return -1;
+    }
+    return output_write(gen->cost_handle, header, sizeof(header) - 1);
+}
+
+void codegen_set_stack_limit(uint16_t bytes) {
+    gen->stack_limit = bytes;
+}
+
+static uint8_t codegen_format_dec(char* out, uint32_t value) {
+    char digits[10];
+    uint8_t count = 0;
+    uint8_t len = 0;
+    do {
+        digits[count++] = (char)('0' + (char)(value % 10u));
+        value /= 10u;
+    } while (value);
+    while (count) out[len++] = digits[--count];
+    out[len] = '\0';
+    return len;
+}
+
+static int16_t codegen_function_slot(uint16_t name_index) {
+    for (codegen_function_count_t i = 0; i < gen->function_count; i++) {
+        if ((uint16_t)(gen->function_return_flags[i] & 0x7FFFu) == name_index) {
+            return (int16_t)i;
+        }
     }
+    return -1;
+}
+
+static int16_t g_cost_slot;
+
+static void codegen_cost_begin(uint16_t name_index) {
+    mem_set(&g_cost, 0, sizeof(g_cost));
+    g_cost_len = 0;
+    g_cost_on = true;
+    g_cost_slot = codegen_function_slot(name_index);
+    if (g_cost_slot >= 0) {
+        codegen_function_cost_t* fn = &gen->function_costs[g_cost_slot];
+        fn->first_call = gen->call_count;
+        fn->call_count = 0;
+    }
+}
+
+/* The frame moves sp with ld sp, hl, which the line costs do not follow */
+static void codegen_cost_frame(int16_t bytes) {
+    g_cost.sp = (int16_t)(g_cost.sp + bytes);
+    if (g_cost.sp > 0 && (uint16_t)g_cost.sp > g_cost.stack) g_cost.stack = (uint16_t)g_cost.sp;
+}
+
+/* Notes a call site before its call is emitted; one per callee, at the
+ * deepest point it is called from */
+static int8_t codegen_cost_call(uint16_t name_index) {
+    codegen_function_cost_t* fn;
+    int16_t callee;
+    uint16_t depth;
+    if (!g_cost_on || g_cost_slot < 0) return 0;
+    fn = &gen->function_costs[g_cost_slot];
+    callee = codegen_function_slot(name_index);
+    depth = g_cost.sp > 0 ? (uint16_t)g_cost.sp : 0;
+    for (uint16_t i = 0; i < fn->call_count; i++) {
+        codegen_call_t* call = &gen->calls[fn->first_call + i];
+        if (call->callee == (uint16_t)callee) {
+            if (depth > call->depth) call->depth = depth;
+            return 0;
+        }
+    }
+    if (gen->call_count == gen->call_capacity) {
+        codegen_call_t* grown = (codegen_call_t*)cc_grow(
+            gen->calls, &gen->call_capacity,
+            gen->call_capacity ? (uint16_t)(gen->call_capacity * 2u) : 8u,
+            sizeof(codegen_call_t));
+        if (!grown) {
+            cc_error(CG_MSG_OUT_OF_MEMORY);
+            return -1;
+        }
+        gen->calls = grown;
+    }
+    gen->calls[gen->call_count].callee = callee < 0 ? CG_CALL_EXTERNAL : (uint16_t)callee;
+    gen->calls[gen->call_count].depth = depth;
+    gen->call_count++;
+    fn->call_count++;
+    return 0;
+}
+
+/* "; name: N bytes, MIN-MAX T-states, S stack bytes" after the function;
+ * S is its own use, return address included, without its callees */
+static void codegen_cost_end(const char* name) {
+    char text[11];
+    if (g_cost_len) codegen_cost_line(g_cost_line, g_cost_len, &g_cost);
+    g_cost_on = false;
+    codegen_emit("; ");
+    codegen_emit(name);
+    codegen_emit(": ");
+    codegen_format_dec(text, g_cost.bytes);
+    codegen_emit(text);
+    codegen_emit(" bytes, ");
+    codegen_format_dec(text, g_cost.min_t);
+    codegen_emit(text);
+    codegen_emit("-");
+    codegen_format_dec(text, g_cost.max_t);
+    codegen_emit(text);
+    codegen_emit(" T-states, ");
+    codegen_format_dec(text, g_cost.stack + 2u);
+    codegen_emit(text);
+    codegen_emit(" stack bytes\n");
+    if (g_cost_slot >= 0) {
+        codegen_function_cost_t* fn = &gen->function_costs[g_cost_slot];
+        mem_cpy(&fn->cost, &g_cost, sizeof(g_cost));
+        fn->state = CG_COST_BODY;
+    }
+}
+
+static uint16_t g_cost_recursive; /* slot found calling itself back */
+
+/* Worst-case stack of a call to slot: its return address, then the
+ * deeper of its own peak and each call site plus that callee's total */
+static uint16_t codegen_stack_total(uint16_t slot) {
+    codegen_function_cost_t* fn = &gen->function_costs[slot];
+    uint32_t total;
+    if (fn->state == CG_COST_DONE) return fn->total;
+    if (fn->state == CG_COST_VISITING) {
+        g_cost_recursive = slot;
+        return CG_STACK_UNBOUNDED;
+    }
+    fn->state = CG_COST_VISITING;
+    total = fn->cost.stack;
+    for (uint16_t i = 0; i < fn->call_count; i++) {
+        const codegen_call_t* call = &gen->calls[fn->first_call + i];
+        uint16_t callee_total = 2;
+        if (call->callee == CG_CALL_EXTERNAL ||
+            gen->function_costs[call->callee].state == CG_COST_NONE) {
+            fn->external = true;
+        } else {
+            callee_total = codegen_stack_total(call->callee);
+            if (gen->function_costs[call->callee].external) fn->external = true;
+        }
+        if (callee_total == CG_STACK_UNBOUNDED) {
+            total = CG_STACK_UNBOUNDED;
+            break;
+        }
+        if ((uint32_t)call->depth + callee_total > total) {
+            total = (uint32_t)call->depth + callee_total;
+        }
+    }
+    if (total != CG_STACK_UNBOUNDED) total += 2u;
+    fn->total = total >= CG_STACK_UNBOUNDED ? (uint16_t)CG_STACK_UNBOUNDED : (uint16_t)total;
+    fn->state = CG_COST_DONE;
+    return fn->total;
+}
+
+static void codegen_cost_csv_row(const char* name, const codegen_function_cost_t* fn) {
+    char fields[5][11];
+    codegen_format_dec(fields[0], fn->cost.bytes);
+    codegen_format_dec(fields[1], fn->cost.min_t);
+    codegen_format_dec(fields[2], fn->cost.max_t);
+    codegen_format_dec(fields[3], fn->cost.stack + 2u);
+    if (fn->total == CG_STACK_UNBOUNDED) {
+        mem_cpy(fields[4], "unbounded", 10);
+    } else {
+        codegen_format_dec(fields[4], fn->total);
+    }
+    output_write(gen->cost_handle, name, (uint16_t)str_len(name));
+    for (uint8_t i = 0; i < 5; i++) {
+        output_write(gen->cost_handle, ",", 1);
+        output_write(gen->cost_handle, fields[i], (uint16_t)str_len(fields[i]));
+    }
+    output_write(gen->cost_handle, "\n", 1);
+}
+
+/* Totals the call graph once every function is emitted: the deepest call
+ * chain goes in a comment, every function in the CSV, and past the limit
+ * code generation fails */
+static cc_error_t codegen_cost_report(void) {
+    int16_t worst = -1;
+    char text[11];
+    for (codegen_function_count_t i = 0; i < gen->function_count; i++) {
+        codegen_function_cost_t* fn = &gen->function_costs[i];
+        if (fn->state == CG_COST_NONE) continue;
+        codegen_stack_total(i);
+        if (worst < 0 || fn->total > gen->function_costs[worst].total) worst = (int16_t)i;
+    }
+    if (worst < 0) return CC_OK;
+    for (codegen_function_count_t i = 0; gen->cost_handle && i < gen->function_count; i++) {
+        const codegen_function_cost_t* fn = &gen->function_costs[i];
+        if (fn->state == CG_COST_NONE) continue;
+        codegen_cost_csv_row(ast_reader_name(gen->function_return_flags[i] & 0x7FFFu), fn);
+    }
+
+    {
+        const codegen_function_cost_t* fn = &gen->function_costs[worst];
+        const char* name = ast_reader_name(gen->function_return_flags[worst] & 0x7FFFu);
+        const char* recursive =
+            ast_reader_name(gen->function_return_flags[g_cost_recursive] & 0x7FFFu);
+        codegen_emit("; stack: ");
+        if (fn->total == CG_STACK_UNBOUNDED) {
+            codegen_emit("unbounded, ");
+            codegen_emit(recursive);
+            codegen_emit(" is recursive\n");
+            if (gen->stack_limit) {
+                log_error(CG_MSG_STACK_UNBOUNDED);
+                log_error(recursive);
+                log_error(CG_STR_NL);
+                return CC_ERROR_CODEGEN;
+            }
+            return CC_OK;
+        }
+        codegen_format_dec(text, fn->total);
+        codegen_emit(text);
+        codegen_emit(" bytes worst case, from ");
+        codegen_emit(name);
+        codegen_emit(fn->external ? ", calls out of the unit not included\n" : "\n");
+        if (gen->stack_limit && fn->total > gen->stack_limit) {
+            log_error(CG_MSG_STACK_LIMIT);
+            log_error(name);
+            log_error(" needs ");
+            log_error(text);
+            log_error(" bytes, limit ");
+            codegen_format_dec(text, gen->stack_limit);
+            log_error(text);
+            log_error(CG_STR_NL);
+            return CC_ERROR_CODEGEN;
+        }
+    }
+    return CC_OK;
 }
+#endif
 
 char* codegen_new_label(void) {
     static char labels[8][16];
@@ -837,10 +1183,10 @@ char* codegen_new_label(void) {
     return codegen_format_label(labels, &slot, 'l', gen->label_counter++);
 }
 
-char* codegen_new_string_label(void) {
+char* codegen_string_label(uint16_t slot) {
     static char labels[8][16];
-    static uint8_t slot = 0;
-    return codegen_format_label(labels, &slot, 's', (uint16_t)gen->string_count);
+    static uint8_t next = 0;
+    return codegen_format_label(labels, &next, 's', slot);
 }
 
 static bool codegen_function_return_is_16bit(uint16_t name_index);
@@ -914,7 +1260,7 @@ static cc_error_t codegen_emit_binary_op_hl(uint8_t op, uint8_t left_tag, bool o
     codegen_result_to_hl();
     codegen_emit(CG_STR_PUSH_HL);
     uint8_t right_tag = 0;
-    right_tag = ast_read_u8();
+    right_tag = ast_read_tag();
     err = codegen_stream_expression_expect(right_tag, true);
     if (err != CC_OK) return err;
     codegen_result_to_hl();
@@ -1037,7 +1383,7 @@ static cc_error_t codegen_emit_binary_op_a(uint8_t op, uint8_t left_tag) {
     if (err != CC_OK) return err;
     codegen_emit(CG_STR_PUSH_AF);
     uint8_t right_tag = 0;
-    right_tag = ast_read_u8();
+    right_tag = ast_read_tag();
     err = codegen_stream_expression_tag(right_tag);
     if (err != CC_OK) return err;
     codegen_emit(CG_STR_LD_L_A_POP_AF);
@@ -1126,13 +1472,313 @@ static cc_error_t codegen_emit_binary_op_a(uint8_t op, uint8_t left_tag) {
 
 static cc_error_t codegen_read_and_stream_statement(void) {
     uint8_t tag = 0;
-    tag = ast_read_u8();
+    tag = ast_read_tag();
     return codegen_stream_statement_tag(tag);
 }
 
 static cc_error_t codegen_read_and_stream_expression(void) {
     uint8_t tag = 0;
-    tag = ast_read_u8();
+    tag = ast_read_tag();
+    return codegen_stream_expression_tag(tag);
+}
+
+/* Mask operations
+ *
+ * Conditions `x & M` and stores `x = x | M` (also & and ^) with a constant
+ * mask that touches one byte of x work on that byte in place: bit, set and
+ * res for single-bit masks, otherwise ld a / op n / ld. x is a scalar
+ * variable, *p or a[i] with a constant or variable index, so it can be
+ * addressed twice without side effects. */
+
+typedef struct {
+    uint32_t pos;   /* operand node, re-read to emit its address */
+    uint8_t width;  /* 1 or 2 bytes */
+    bool via_hl;    /* address in HL; otherwise (ix+offset) */
+    int16_t offset;
+    uint8_t byte;   /* byte of the operand the mask touches */
+    uint8_t mask;
+} codegen_mask_operand_t;
+
+static bool codegen_mask_constant(uint8_t tag, uint16_t* out) {
+    if (tag == AST_TAG_CONSTANT) {
+        *out = (uint16_t)ast_read_const();
+        return true;
+    }
+    if (tag == AST_TAG_UNARY_OP && ast_read_u8() == OP_NOT &&
+        ast_read_tag() == AST_TAG_CONSTANT) {
+        *out = (uint16_t)~(uint16_t)ast_read_const();
+        return true;
+    }
+    return false;
+}
+
+static bool codegen_mask_operand(uint8_t tag, codegen_mask_operand_t* out) {
+    const char* name = NULL;
+    out->via_hl = true;
+    out->offset = 0;
+    if (tag == AST_TAG_IDENTIFIER) {
+        if (codegen_stream_read_name(&name) < 0 || codegen_name_is_array(name)) return false;
+        out->width = codegen_name_is_16(name) ? 2 : 1;
+        out->via_hl = !codegen_local_or_param_offset(name, &out->offset);
+        return true;
+    }
+    if (tag == AST_TAG_UNARY_OP) {
+        if (ast_read_u8() != OP_DEREF || ast_read_tag() != AST_TAG_IDENTIFIER) return false;
+        if (codegen_stream_read_name(&name) < 0 || !codegen_name_is_pointer(name)) return false;
+        out->width = 1;
+        return true;
+    }
+    if (tag == AST_TAG_ARRAY_ACCESS) {
+        uint8_t index_tag = 0;
+        if (ast_read_tag() != AST_TAG_IDENTIFIER) return false;
+        if (codegen_stream_read_name(&name) < 0) return false;
+        if (codegen_name_is_array(name)) {
+            out->width = codegen_array_elem_size_by_name(name);
+        } else if (codegen_name_is_pointer(name)) {
+            out->width = codegen_pointer_elem_size_by_name(name);
+        } else {
+            return false;
+        }
+        index_tag = ast_read_tag();
+        if (index_tag == AST_TAG_CONSTANT) {
+            (void)ast_read_const();
+        } else if (index_tag == AST_TAG_IDENTIFIER) {
+            (void)ast_read_index();
+        } else {
+            return false;
+        }
+        return out->width == 1 || out->width == 2;
+    }
+    return false;
+}
+
+/* Picks the one byte of the operand that `mask` changes; bytes equal to
+ * `identity` are left alone. */
+static bool codegen_mask_byte(codegen_mask_operand_t* operand, uint16_t mask, uint8_t identity) {
+    uint8_t lo = (uint8_t)mask;
+    uint8_t hi = (uint8_t)(mask >> 8);
+    operand->byte = 0;
+    operand->mask = lo;
+    if (operand->width == 1 || hi == identity) return true;
+    if (lo != identity) return false;
+    operand->byte = 1;
+    operand->mask = hi;
+    return true;
+}
+
+/* Returns the bit number if exactly one bit of `value` is set, else -1 */
+static int8_t codegen_single_bit(uint8_t value) {
+    if (value == 0 || (value & (value - 1u)) != 0) return -1;
+    for (int8_t bit = 0; bit < 8; bit++) {
+        if (value & (1u << bit)) return bit;
+    }
+    return -1;
+}
+
+static cc_error_t codegen_emit_mask_address(const codegen_mask_operand_t* operand) {
+    uint8_t tag = 0;
+    if (reader_seek(reader, operand->pos) < 0) return CC_ERROR_CODEGEN;
+    tag = ast_read_tag();
+    if (operand->via_hl) {
+        const char* name = NULL;
+        cc_error_t err = CC_OK;
+        if (tag == AST_TAG_IDENTIFIER) {
+            if (codegen_stream_read_name(&name) < 0) return CC_ERROR_CODEGEN;
+            err = codegen_emit_address_of_identifier(name);
+        } else if (tag == AST_TAG_UNARY_OP) {
+            (void)ast_read_u8();
+            (void)ast_read_tag();
+            if (codegen_stream_read_name(&name) < 0) return CC_ERROR_CODEGEN;
+            err = codegen_load_pointer_to_hl(name);
+        } else {
+            err = codegen_emit_array_address(NULL, NULL);
+        }
+        if (err != CC_OK) return err;
+        if (operand->byte) codegen_emit("  inc hl\n");
+    }
+    return CC_OK;
+}
+
+static void codegen_emit_mask_target(const codegen_mask_operand_t* operand) {
+    if (operand->via_hl) {
+        codegen_emit("(hl)");
+        return;
+    }
+    codegen_emit("(ix");
+    codegen_emit_ix_offset((int16_t)(operand->offset + operand->byte));
+    codegen_emit(")");
+}
+
+static void codegen_emit_mask_bit_op(const char* mnemonic, int8_t bit,
+                                     const codegen_mask_operand_t* operand) {
+    char digit[2];
+    digit[0] = (char)('0' + bit);
+    digit[1] = '\0';
+    codegen_emit(mnemonic);
+    codegen_emit(digit);
+    codegen_emit(", ");
+    codegen_emit_mask_target(operand);
+    codegen_emit(CG_STR_NL);
+}
+
+static void codegen_emit_mask_load_a(const codegen_mask_operand_t* operand) {
+    codegen_emit("  ld a, ");
+    codegen_emit_mask_target(operand);
+    codegen_emit(CG_STR_NL);
+}
+
+/* Reads `x & M` (either order) with the operand first in the stream or not */
+static bool codegen_mask_and_operands(codegen_mask_operand_t* operand, uint16_t* mask) {
+    uint32_t left_pos = reader_tell(reader);
+    uint8_t tag = ast_read_tag();
+    if (codegen_mask_constant(tag, mask)) {
+        operand->pos = reader_tell(reader);
+        return codegen_mask_operand(ast_read_tag(), operand);
+    }
+    if (reader_seek(reader, left_pos) < 0) return false;
+    operand->pos = left_pos;
+    if (!codegen_mask_operand(ast_read_tag(), operand)) return false;
+    return codegen_mask_constant(ast_read_tag(), mask);
+}
+
+/* Matches `x & M`, `(x & M) != 0`, `(x & M) == 0` and `!(x & M)`. On a match
+ * the stream is left after the condition; `jump_if_set` tells whether the
+ * condition is false when the tested bits are set. */
+static bool codegen_mask_condition(codegen_mask_operand_t* operand, uint16_t* mask,
+                                   bool* jump_if_set) {
+    uint8_t tag = ast_read_tag();
+    uint8_t op = 0;
+    *jump_if_set = false;
+    if (tag == AST_TAG_UNARY_OP) {
+        if (ast_read_u8() != OP_LNOT) return false;
+        *jump_if_set = true;
+        tag = ast_read_tag();
+    }
+    if (tag != AST_TAG_BINARY_OP) return false;
+    op = ast_read_u8();
+    if (op == OP_EQ || op == OP_NE) {
+        uint16_t zero = 0;
+        if (ast_read_tag() != AST_TAG_BINARY_OP || ast_read_u8() != OP_AND) return false;
+        if (!codegen_mask_and_operands(operand, mask)) return false;
+        if (ast_read_tag() != AST_TAG_CONSTANT) return false;
+        zero = (uint16_t)ast_read_const();
+        if (zero != 0) return false;
+        if (op == OP_EQ) *jump_if_set = !*jump_if_set;
+    } else if (op != OP_AND || !codegen_mask_and_operands(operand, mask)) {
+        return false;
+    }
+    if (*mask == 0) return false;
+    /* A char operand is promoted, so a mask beyond its byte is not exact */
+    if (operand->width == 1 && *mask > 0xFF) return false;
+    return codegen_mask_byte(operand, *mask, 0x00);
+}
+
+/* Emits the condition at the stream position and jumps to `false_label`
+ * when it is zero. */
+static cc_error_t codegen_stream_condition(const char* false_label) {
+    uint32_t cond_pos = reader_tell(reader);
+    codegen_mask_operand_t operand;
+    uint16_t mask = 0;
+    bool jump_if_set = false;
+    if (codegen_mask_condition(&operand, &mask, &jump_if_set)) {
+        uint32_t cond_end = reader_tell(reader);
+        int8_t bit = codegen_single_bit(operand.mask);
+        cc_error_t err = codegen_emit_mask_address(&operand);
+        if (err != CC_OK) return err;
+        if (reader_seek(reader, cond_end) < 0) return CC_ERROR_CODEGEN;
+        if (bit >= 0) {
+            codegen_emit_mask_bit_op("  bit ", bit, &operand);
+        } else {
+            codegen_emit_mask_load_a(&operand);
+            codegen_emit("  and ");
+            codegen_emit_hex(operand.mask);
+            codegen_emit(CG_STR_NL);
+        }
+        codegen_emit_jump(jump_if_set ? "  jp nz, " : "  jp z, ", false_label);
+        return CC_OK;
+    }
+    if (reader_seek(reader, cond_pos) < 0) return CC_ERROR_CODEGEN;
+    cc_error_t err = codegen_read_and_stream_expression();
+    if (err != CC_OK) return err;
+    codegen_emit_jump(CG_STR_OR_A_JP_Z, false_label);
+    return CC_OK;
+}
+
+/* True when the nodes at `a` and `b` are encoded identically over `len` */
+static bool codegen_nodes_equal(uint32_t a, uint32_t b, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t byte_a = 0;
+        if (reader_seek(reader, a + i) < 0) return false;
+        byte_a = ast_read_u8();
+        if (reader_seek(reader, b + i) < 0) return false;
+        if (ast_read_u8() != byte_a) return false;
+    }
+    return true;
+}
+
+/* Matches `x = x op M` / `x = M op x` for op in &, |, ^ */
+static bool codegen_mask_assign(codegen_mask_operand_t* operand, uint8_t* op,
+                                uint32_t* end) {
+    uint32_t lvalue_end = 0;
+    uint32_t left_pos = 0;
+    uint32_t len = 0;
+    uint16_t mask = 0;
+    uint8_t tag = 0;
+    operand->pos = reader_tell(reader);
+    if (!codegen_mask_operand(ast_read_tag(), operand)) return false;
+    lvalue_end = reader_tell(reader);
+    len = lvalue_end - operand->pos;
+    if (ast_read_tag() != AST_TAG_BINARY_OP) return false;
+    *op = ast_read_u8();
+    if (*op != OP_AND && *op != OP_OR && *op != OP_XOR) return false;
+    left_pos = reader_tell(reader);
+    tag = ast_read_tag();
+    if (codegen_mask_constant(tag, &mask)) {
+        uint32_t right_pos = reader_tell(reader);
+        if (ast_reader_skip_node() < 0) return false;
+        *end = reader_tell(reader);
+        if (*end - right_pos != len || !codegen_nodes_equal(operand->pos, right_pos, len)) {
+            return false;
+        }
+    } else {
+        if (reader_seek(reader, left_pos) < 0 || ast_reader_skip_node() < 0) return false;
+        if (reader_tell(reader) - left_pos != len) return false;
+        if (!codegen_mask_constant(ast_read_tag(), &mask)) return false;
+        *end = reader_tell(reader);
+        if (!codegen_nodes_equal(operand->pos, left_pos, len)) return false;
+    }
+    return codegen_mask_byte(operand, mask, *op == OP_AND ? 0xFF : 0x00);
+}
+
+static cc_error_t codegen_statement_assign(uint8_t tag) {
+    uint32_t start = reader_tell(reader);
+    codegen_mask_operand_t operand;
+    uint8_t op = 0;
+    uint32_t end = 0;
+    if (codegen_mask_assign(&operand, &op, &end)) {
+        int8_t bit = -1;
+        cc_error_t err = codegen_emit_mask_address(&operand);
+        if (err != CC_OK) return err;
+        if (reader_seek(reader, end) < 0) return CC_ERROR_CODEGEN;
+        if (op == OP_OR) {
+            bit = codegen_single_bit(operand.mask);
+        } else if (op == OP_AND) {
+            bit = codegen_single_bit((uint8_t)~operand.mask);
+        }
+        if (bit >= 0) {
+            codegen_emit_mask_bit_op(op == OP_OR ? "  set " : "  res ", bit, &operand);
+            return CC_OK;
+        }
+        codegen_emit_mask_load_a(&operand);
+        codegen_emit(op == OP_AND ? "  and " : (op == OP_OR ? "  or " : "  xor "));
+        codegen_emit_hex(operand.mask);
+        codegen_emit(CG_STR_NL);
+        codegen_emit("  ld ");
+        codegen_emit_mask_target(&operand);
+        codegen_emit(", a\n");
+        return CC_OK;
+    }
+    if (reader_seek(reader, start) < 0) return CC_ERROR_CODEGEN;
     return codegen_stream_expression_tag(tag);
 }
 
@@ -1150,7 +1796,7 @@ static cc_error_t codegen_statement_return(uint8_t tag) {
     has_expr = ast_read_u8();
     if (has_expr) {
         uint8_t expr_tag = 0;
-        expr_tag = ast_read_u8();
+        expr_tag = ast_read_tag();
         bool expect_hl = gen->function_return_is_16 &&
                          codegen_tag_is_simple_expr(expr_tag);
         cc_error_t err = codegen_stream_expression_expect(expr_tag, expect_hl);
@@ -1225,11 +1871,11 @@ static cc_error_t codegen_statement_var_decl(uint8_t tag) {
     uint8_t depth = 0;
     uint16_t array_len = 0;
     const char* name = NULL;
-    name_index = ast_read_u16();
+    name_index = ast_read_index();
     if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_CODEGEN;
     (void)array_len;
     has_init = ast_read_u8();
-    name = ast_reader_string(name_index);
+    name = ast_reader_name(name_index);
     if (!name) return CC_ERROR_CODEGEN;
     (void)name;
     if (array_len > 0) {
@@ -1244,13 +1890,11 @@ static cc_error_t codegen_statement_var_decl(uint8_t tag) {
     }
     if (has_init) {
         uint8_t init_tag = 0;
-        init_tag = ast_read_u8();
+        init_tag = ast_read_tag();
         bool is_pointer = depth > 0;
         if (is_pointer) {
             if (init_tag == AST_TAG_STRING_LITERAL) {
-                const char* init_str = NULL;
-                if (codegen_stream_read_name(&init_str) < 0) return CC_ERROR_CODEGEN;
-                const char* label = codegen_get_string_label(init_str);
+                const char* label = codegen_get_string_label(ast_read_index());
                 if (!label) return CC_ERROR_CODEGEN;
                 codegen_emit(CG_STR_LD_HL);
                 codegen_emit(label);
@@ -1261,7 +1905,7 @@ static cc_error_t codegen_statement_var_decl(uint8_t tag) {
                 uint8_t op = 0;
                 uint8_t operand_tag = 0;
                 op = ast_read_u8();
-                operand_tag = ast_read_u8();
+                operand_tag = ast_read_tag();
                 if (op == OP_ADDR && operand_tag == AST_TAG_IDENTIFIER) {
                     const char* ident = NULL;
                     if (codegen_stream_read_name(&ident) < 0) return CC_ERROR_CODEGEN;
@@ -1284,7 +1928,7 @@ static cc_error_t codegen_statement_var_decl(uint8_t tag) {
             }
             if (init_tag == AST_TAG_CONSTANT) {
                 int16_t val = 0;
-                val = ast_read_i16();
+                val = ast_read_const();
                 if (val == 0) {
                     codegen_emit(CG_STR_LD_HL_ZERO);
                     return codegen_store_pointer_from_hl(name);
@@ -1294,7 +1938,7 @@ static cc_error_t codegen_statement_var_decl(uint8_t tag) {
             ast_reader_skip_tag(init_tag);
             return CC_ERROR_CODEGEN;
         }
-        bool is_16bit = codegen_stream_type_is_16bit(base, depth);
+        bool is_16bit = codegen_name_is_16(name);
         bool expect_hl = is_16bit &&
                          codegen_tag_is_simple_expr(init_tag);
         cc_error_t err = codegen_stream_expression_expect(init_tag, expect_hl);
@@ -1312,7 +1956,7 @@ static cc_error_t codegen_statement_var_decl(uint8_t tag) {
 static cc_error_t codegen_statement_compound(uint8_t tag) {
     (void)tag;
     uint16_t stmt_count = 0;
-    stmt_count = ast_read_u16();
+    stmt_count = ast_read_index();
     for (uint16_t i = 0; i < stmt_count; i++) {
         cc_error_t err = codegen_read_and_stream_statement();
         if (err != CC_OK) return err;
@@ -1326,15 +1970,16 @@ static cc_error_t codegen_statement_if(uint8_t tag) {
     char* else_label = NULL;
     char* end_label = NULL;
     has_else = ast_read_u8();
-    cc_error_t err = codegen_read_and_stream_expression();
-    if (err != CC_OK) return err;
     else_label = codegen_new_label_persist();
     if (has_else) {
         end_label = codegen_new_label_persist();
     } else {
         end_label = else_label;
     }
-    codegen_emit_jump(CG_STR_OR_A_JP_Z, else_label);
+    cc_error_t err = codegen_stream_condition(else_label);
+    if (err != CC_OK) {
+        goto if_cleanup;
+    }
     err = codegen_read_and_stream_statement();
     if (err != CC_OK) {
         goto if_cleanup;
@@ -1357,62 +2002,329 @@ if_cleanup:
     return err;
 }
 
-static cc_error_t codegen_statement_while(uint8_t tag) {
-    (void)tag;
-    char* loop_label = codegen_new_label_persist();
-    char* end_label = codegen_new_label_persist();
-    cc_error_t err = CC_OK;
-    codegen_emit_label(loop_label);
-    err = codegen_read_and_stream_expression();
-    if (err != CC_OK) {
-        goto while_cleanup;
-    }
-    codegen_emit_jump(CG_STR_OR_A_JP_Z, end_label);
-    codegen_loop_push(end_label, loop_label);
-    err = codegen_read_and_stream_statement();
-    codegen_loop_pop();
-    if (err != CC_OK) {
-        goto while_cleanup;
+/* Loop hoisting
+ *
+ * An innermost loop keeps one invariant 16-bit value in BC: a pointer or
+ * int it never writes, or the address of a local array or &x. Each load
+ * then becomes ld h, b / ld l, c instead of two (ix+o) loads, or
+ * push ix / pop hl / ld bc / add hl, bc for a local address; a global
+ * pointer saves the ld hl, (nn). Global arrays and &global are already
+ * immediates. The loop must leave BC alone, so calls, multiply, divide,
+ * xor, shifts, nested loops and labels rule it out, as does a second
+ * local address (it is formed in BC). A variable is invariant when the
+ * loop does not assign it and nothing can store to it behind its name: a
+ * local whose address is never taken, or a global in a loop without
+ * stores through pointers. */
+
+typedef struct {
+    const char* name;
+    uint8_t uses;
+    bool written;
+} codegen_hoist_use_t;
+
+static codegen_hoist_use_t g_hoist_uses[8];
+static uint8_t g_hoist_use_count = 0;
+static const char* g_hoist_local_address = NULL; /* the one local address formed */
+static bool g_hoist_unsafe = false;
+static bool g_hoist_stores = false;             /* stores through pointers */
+static bool g_hoist_scanned = false;            /* CG_FLAG_ADDR_TAKEN is set */
+static uint32_t g_hoist_body = 0;
+
+static codegen_hoist_use_t* codegen_hoist_use(const char* name) {
+    for (uint8_t i = 0; i < g_hoist_use_count; i++) {
+        if (codegen_names_equal(g_hoist_uses[i].name, name)) return &g_hoist_uses[i];
     }
-    codegen_emit_jump(CG_STR_JP, loop_label);
-    codegen_emit_label(end_label);
-    err = CC_OK;
-while_cleanup:
-    if (loop_label) cc_free(loop_label);
-    if (end_label) cc_free(end_label);
-    return err;
+    if (g_hoist_use_count == DIM(g_hoist_uses)) return NULL;
+    g_hoist_uses[g_hoist_use_count].name = name;
+    g_hoist_uses[g_hoist_use_count].uses = 0;
+    g_hoist_uses[g_hoist_use_count].written = false;
+    return &g_hoist_uses[g_hoist_use_count++];
 }
 
-static cc_error_t codegen_statement_for(uint8_t tag) {
-    (void)tag;
-    uint8_t has_init = 0;
-    uint8_t has_cond = 0;
-    uint8_t has_inc = 0;
-    uint32_t inc_offset = 0;
-    has_init = ast_read_u8();
-    has_cond = ast_read_u8();
-    has_inc = ast_read_u8();
-    char* loop_label = codegen_new_label_persist();
-    char* end_label = codegen_new_label_persist();
-    char* inc_label = has_inc ? codegen_new_label_persist() : NULL;
-    cc_error_t err;
-    if (has_init) {
-        err = codegen_read_and_stream_statement();
-        if (err != CC_OK) {
-            goto for_cleanup;
-        }
+static void codegen_hoist_note_write(const char* name) {
+    codegen_hoist_use_t* use = codegen_hoist_use(name);
+    if (use) use->written = true;
+}
+
+static void codegen_hoist_note_address(const char* name) {
+    int16_t local = codegen_local_index(name);
+    int16_t param = codegen_param_index(name);
+    if (local >= 0) {
+        gen->locals[local].flags |= CG_FLAG_ADDR_TAKEN;
+    } else if (param >= 0) {
+        gen->params[param].flags |= CG_FLAG_ADDR_TAKEN;
+    } else {
+        return;
     }
-    codegen_emit_label(loop_label);
-    if (has_cond) {
-        err = codegen_read_and_stream_expression();
-        if (err != CC_OK) {
-            goto for_cleanup;
-        }
-        codegen_emit_jump(CG_STR_OR_A_JP_Z, end_label);
+    if (g_hoist_local_address && !codegen_names_equal(g_hoist_local_address, name)) {
+        g_hoist_unsafe = true;
     }
-    if (has_inc) {
-        inc_offset = reader_tell(reader);
-        if (ast_reader_skip_node() < 0) {
+    g_hoist_local_address = name;
+}
+
+static void codegen_hoist_note_read(const char* name) {
+    codegen_hoist_use_t* use = NULL;
+    if (codegen_name_is_array(name)) {
+        codegen_hoist_note_address(name);
+        return;
+    }
+    if (!codegen_name_is_16(name) && !codegen_name_is_pointer(name)) return;
+    use = codegen_hoist_use(name);
+    if (use && use->uses < 0xFF) use->uses++;
+}
+
+static int8_t codegen_hoist_walk(uint8_t tag) {
+    const char* name = NULL;
+    switch (tag) {
+        case AST_TAG_VAR_DECL: {
+            uint16_t name_index = 0;
+            uint8_t base = 0;
+            uint8_t depth = 0;
+            uint16_t array_len = 0;
+            name_index = ast_read_index();
+            if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return -1;
+            if (!ast_read_u8()) return 0;
+            name = ast_reader_name(name_index);
+            if (!name || codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            codegen_hoist_note_write(name);
+            return 0;
+        }
+        case AST_TAG_COMPOUND_STMT: {
+            uint16_t stmt_count = 0;
+            stmt_count = ast_read_index();
+            for (uint16_t i = 0; i < stmt_count; i++) {
+                if (codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            }
+            return 0;
+        }
+        case AST_TAG_RETURN_STMT:
+            return ast_read_u8() ? codegen_hoist_walk(ast_read_tag()) : 0;
+        case AST_TAG_IF_STMT: {
+            uint8_t has_else = 0;
+            has_else = ast_read_u8();
+            if (codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            if (codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            return has_else ? codegen_hoist_walk(ast_read_tag()) : 0;
+        }
+        case AST_TAG_WHILE_STMT:
+            g_hoist_unsafe = true;
+            if (codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            return codegen_hoist_walk(ast_read_tag());
+        case AST_TAG_FOR_STMT: {
+            uint8_t has[3];
+            g_hoist_unsafe = true;
+            has[0] = ast_read_u8();
+            has[1] = ast_read_u8();
+            has[2] = ast_read_u8();
+            for (uint8_t i = 0; i < 3; i++) {
+                if (has[i] && codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            }
+            return codegen_hoist_walk(ast_read_tag());
+        }
+        case AST_TAG_LABEL_STMT:
+            g_hoist_unsafe = true;
+            (void)ast_read_index();
+            return 0;
+        case AST_TAG_GOTO_STMT:
+        case AST_TAG_STRING_LITERAL:
+            (void)ast_read_index();
+            return 0;
+        case AST_TAG_BREAK_STMT:
+        case AST_TAG_CONTINUE_STMT:
+            return 0;
+        case AST_TAG_ASSIGN: {
+            uint8_t lvalue_tag = ast_read_tag();
+            if (lvalue_tag == AST_TAG_IDENTIFIER) {
+                if (codegen_stream_read_name(&name) < 0) return -1;
+                codegen_hoist_note_write(name);
+            } else {
+                g_hoist_stores = true;
+                if (codegen_hoist_walk(lvalue_tag) < 0) return -1;
+            }
+            return codegen_hoist_walk(ast_read_tag());
+        }
+        case AST_TAG_CALL: {
+            uint8_t argc = 0;
+            g_hoist_unsafe = true;
+            (void)ast_read_index();
+            argc = ast_read_u8();
+            for (uint8_t i = 0; i < argc; i++) {
+                if (codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            }
+            return 0;
+        }
+        case AST_TAG_BINARY_OP: {
+            uint8_t op = ast_read_u8();
+            if (op == OP_MUL || op == OP_DIV || op == OP_MOD || op == OP_XOR ||
+                op == OP_SHL || op == OP_SHR) {
+                g_hoist_unsafe = true;
+            }
+            if (codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            return codegen_hoist_walk(ast_read_tag());
+        }
+        case AST_TAG_UNARY_OP: {
+            uint8_t op = ast_read_u8();
+            uint8_t operand_tag = ast_read_tag();
+            bool step = op == OP_PREINC || op == OP_PREDEC || op == OP_POSTINC ||
+                        op == OP_POSTDEC;
+            if (operand_tag == AST_TAG_IDENTIFIER && (step || op == OP_ADDR)) {
+                if (codegen_stream_read_name(&name) < 0) return -1;
+                if (step) {
+                    codegen_hoist_note_write(name);
+                } else {
+                    codegen_hoist_note_address(name);
+                }
+                return 0;
+            }
+            if (step) g_hoist_stores = true;
+            return codegen_hoist_walk(operand_tag);
+        }
+        case AST_TAG_IDENTIFIER:
+            if (codegen_stream_read_name(&name) < 0) return -1;
+            codegen_hoist_note_read(name);
+            return 0;
+        case AST_TAG_CONSTANT:
+            (void)ast_read_const();
+            return 0;
+        case AST_TAG_ARRAY_ACCESS:
+            if (codegen_hoist_walk(ast_read_tag()) < 0) return -1;
+            return codegen_hoist_walk(ast_read_tag());
+        default:
+            return -1;
+    }
+}
+
+/* The value worth keeping in BC, if any; *address when it is the address
+ * of a local */
+static const char* codegen_hoist_pick(bool* address) {
+    const char* best = NULL;
+    uint16_t best_gain = 0;
+    if (g_hoist_unsafe) return NULL;
+    if (g_hoist_local_address) {
+        *address = true;
+        return g_hoist_local_address;
+    }
+    *address = false;
+    for (uint8_t i = 0; i < g_hoist_use_count; i++) {
+        const codegen_hoist_use_t* use = &g_hoist_uses[i];
+        int16_t local = codegen_local_index(use->name);
+        int16_t param = codegen_param_index(use->name);
+        uint16_t gain = 0;
+        if (use->written || use->uses == 0) continue;
+        if (local >= 0 || param >= 0) {
+            uint8_t flags = local >= 0 ? gen->locals[local].flags : gen->params[param].flags;
+            if (flags & CG_FLAG_ADDR_TAKEN) continue;
+            gain = (uint16_t)(use->uses * 30u);
+        } else if (!g_hoist_stores) {
+            gain = (uint16_t)(use->uses * 8u);
+        }
+        if (gain > best_gain) {
+            best = use->name;
+            best_gain = gain;
+        }
+    }
+    /* One ld hl, (nn) a pass does not pay for the load ahead of the loop */
+    return best_gain >= 16 ? best : NULL;
+}
+
+/* Scans a loop from its condition on (for: after the init statement) and
+ * loads the value it keeps in BC ahead of the loop label. The reader is
+ * left where it was. */
+static cc_error_t codegen_hoist_begin(uint8_t has_cond, uint8_t has_inc) {
+    uint32_t pos = reader_tell(reader);
+    const char* name = NULL;
+    bool address = false;
+    cc_error_t err = CC_OK;
+    if (!g_hoist_scanned) {
+        /* Marks every local and parameter whose address the body takes */
+        g_hoist_scanned = true;
+        if (reader_seek(reader, g_hoist_body) < 0 || codegen_hoist_walk(ast_read_tag()) < 0 ||
+            reader_seek(reader, pos) < 0) {
+            return CC_ERROR_CODEGEN;
+        }
+    }
+    g_hoist_use_count = 0;
+    g_hoist_local_address = NULL;
+    g_hoist_unsafe = false;
+    g_hoist_stores = false;
+    if ((has_cond && codegen_hoist_walk(ast_read_tag()) < 0) ||
+        (has_inc && codegen_hoist_walk(ast_read_tag()) < 0) ||
+        codegen_hoist_walk(ast_read_tag()) < 0 || reader_seek(reader, pos) < 0) {
+        return CC_ERROR_CODEGEN;
+    }
+    name = codegen_hoist_pick(&address);
+    if (!name) return CC_OK;
+    err = address ? codegen_emit_address_of_identifier(name) : codegen_load_pointer_to_hl(name);
+    if (err != CC_OK) return err;
+    codegen_emit(CG_STR_LD_BC_HL);
+    g_hoist_name = name;
+    g_hoist_address = address;
+    return CC_OK;
+}
+
+static cc_error_t codegen_statement_while(uint8_t tag) {
+    (void)tag;
+    char* loop_label = codegen_new_label_persist();
+    char* end_label = codegen_new_label_persist();
+    cc_error_t err = CC_OK;
+    err = codegen_hoist_begin(1, 0);
+    if (err != CC_OK) {
+        goto while_cleanup;
+    }
+    codegen_emit_label(loop_label);
+    err = codegen_stream_condition(end_label);
+    if (err != CC_OK) {
+        goto while_cleanup;
+    }
+    codegen_loop_push(end_label, loop_label);
+    err = codegen_read_and_stream_statement();
+    codegen_loop_pop();
+    if (err != CC_OK) {
+        goto while_cleanup;
+    }
+    codegen_emit_jump(CG_STR_JP, loop_label);
+    codegen_emit_label(end_label);
+    err = CC_OK;
+while_cleanup:
+    g_hoist_name = NULL;
+    if (loop_label) cc_free(loop_label);
+    if (end_label) cc_free(end_label);
+    return err;
+}
+
+static cc_error_t codegen_statement_for(uint8_t tag) {
+    (void)tag;
+    uint8_t has_init = 0;
+    uint8_t has_cond = 0;
+    uint8_t has_inc = 0;
+    uint32_t inc_offset = 0;
+    has_init = ast_read_u8();
+    has_cond = ast_read_u8();
+    has_inc = ast_read_u8();
+    char* loop_label = codegen_new_label_persist();
+    char* end_label = codegen_new_label_persist();
+    char* inc_label = has_inc ? codegen_new_label_persist() : NULL;
+    cc_error_t err;
+    if (has_init) {
+        err = codegen_read_and_stream_statement();
+        if (err != CC_OK) {
+            goto for_cleanup;
+        }
+    }
+    err = codegen_hoist_begin(has_cond, has_inc);
+    if (err != CC_OK) {
+        goto for_cleanup;
+    }
+    codegen_emit_label(loop_label);
+    if (has_cond) {
+        err = codegen_stream_condition(end_label);
+        if (err != CC_OK) {
+            goto for_cleanup;
+        }
+    }
+    if (has_inc) {
+        inc_offset = reader_tell(reader);
+        if (ast_reader_skip_node() < 0) {
             err = CC_ERROR_CODEGEN;
             goto for_cleanup;
         }
@@ -1443,6 +2355,7 @@ static cc_error_t codegen_statement_for(uint8_t tag) {
     codegen_emit_label(end_label);
     err = CC_OK;
 for_cleanup:
+    g_hoist_name = NULL;
     if (loop_label) cc_free(loop_label);
     if (end_label) cc_free(end_label);
     if (inc_label) cc_free(inc_label);
@@ -1453,7 +2366,7 @@ static bool codegen_expression_is_16bit_at(uint8_t tag) {
     switch (tag) {
         case AST_TAG_CONSTANT: {
             int16_t value = 0;
-            value = ast_read_i16();
+            value = ast_read_const();
             return value < 0 || value > 0xFF;
         }
         case AST_TAG_IDENTIFIER: {
@@ -1465,7 +2378,7 @@ static bool codegen_expression_is_16bit_at(uint8_t tag) {
             uint8_t op = 0;
             uint8_t child_tag = 0;
             op = ast_read_u8();
-            child_tag = ast_read_u8();
+            child_tag = ast_read_tag();
             if (op == OP_DEREF) {
                 if (ast_reader_skip_tag(child_tag) < 0) return false;
                 return false;
@@ -1487,9 +2400,9 @@ static bool codegen_expression_is_16bit_at(uint8_t tag) {
             uint8_t left_tag = 0;
             uint8_t right_tag = 0;
             op = ast_read_u8();
-            left_tag = ast_read_u8();
+            left_tag = ast_read_tag();
             bool left_is_16 = codegen_expression_is_16bit_at(left_tag);
-            right_tag = ast_read_u8();
+            right_tag = ast_read_tag();
             bool right_is_16 = codegen_expression_is_16bit_at(right_tag);
             if (codegen_op_is_compare(op) || op == OP_LAND || op == OP_LOR) {
                 return false;
@@ -1499,11 +2412,11 @@ static bool codegen_expression_is_16bit_at(uint8_t tag) {
         case AST_TAG_CALL: {
             uint16_t name_index = 0;
             uint8_t arg_count = 0;
-            name_index = ast_read_u16();
+            name_index = ast_read_index();
             arg_count = ast_read_u8();
             for (uint8_t i = 0; i < arg_count; i++) {
                 uint8_t arg_tag = 0;
-                arg_tag = ast_read_u8();
+                arg_tag = ast_read_tag();
                 if (ast_reader_skip_tag(arg_tag) < 0) return false;
             }
             return codegen_function_return_is_16bit(name_index);
@@ -1516,7 +2429,7 @@ static bool codegen_expression_is_16bit_at(uint8_t tag) {
             uint8_t ltag = 0;
             uint8_t rtag = 0;
             bool lvalue_is_16 = false;
-            ltag = ast_read_u8();
+            ltag = ast_read_tag();
             if (ltag == AST_TAG_ARRAY_ACCESS) {
                 uint8_t elem_size = codegen_peek_array_elem_size();
                 lvalue_is_16 = elem_size == 2;
@@ -1527,12 +2440,12 @@ static bool codegen_expression_is_16bit_at(uint8_t tag) {
             } else {
                 if (ast_reader_skip_tag(ltag) < 0) return false;
             }
-            rtag = ast_read_u8();
+            rtag = ast_read_tag();
             if (ast_reader_skip_tag(rtag) < 0) return false;
             return lvalue_is_16;
         }
         case AST_TAG_STRING_LITERAL: {
-            (void)ast_read_u16();
+            (void)ast_read_index();
             return true;
         }
         default:
@@ -1541,6 +2454,364 @@ static bool codegen_expression_is_16bit_at(uint8_t tag) {
     }
 }
 
+/* Value ranges
+ *
+ * Conservative [lo, hi] intervals of expression values, used to keep
+ * int-typed work in A when both the operands and the result provably fit
+ * in a byte. EXACT8 means evaluating the expression in A (mod 256) still
+ * yields its exact low byte: false once a division, modulo or right shift
+ * sees an operand wider than a byte. */
+
+#define CG_RANGE_EXACT8 0x01
+#define CG_RANGE_NARROW 0x02 /* reads an int local stored as a byte */
+#define CG_RANGE_MIN (-32768L)
+#define CG_RANGE_MAX 65535L
+
+typedef struct {
+    int32_t lo;
+    int32_t hi;
+    uint8_t flags;
+} codegen_range_t;
+
+typedef struct {
+    const char* name; /* NULL: loop without a usable guard */
+    int16_t lo;
+    int16_t hi;
+} codegen_guard_t;
+
+/* Narrowing pass state (see codegen_narrow_locals) */
+static bool g_narrow_collect = false;
+static bool g_narrow_changed = false;
+static bool g_narrow_has_label = false;
+static const char* g_narrow_count_name = NULL;
+static uint8_t g_narrow_count = 0;
+static uint8_t g_narrow_count_depth = 0;
+static bool g_narrow_count_nested = false;
+static codegen_guard_t g_narrow_guards[8];
+static uint8_t g_narrow_guard_depth = 0;
+static const codegen_guard_t* g_range_override = NULL;
+
+static void codegen_range_set(codegen_range_t* r, int32_t lo, int32_t hi, uint8_t flags) {
+    if (lo < CG_RANGE_MIN || hi > CG_RANGE_MAX) {
+        lo = CG_RANGE_MIN;
+        hi = CG_RANGE_MAX;
+    }
+    r->lo = lo;
+    r->hi = hi;
+    r->flags = flags;
+}
+
+static void codegen_range_full(codegen_range_t* r) {
+    codegen_range_set(r, CG_RANGE_MIN, CG_RANGE_MAX, CG_RANGE_EXACT8);
+}
+
+static bool codegen_range_fits8(const codegen_range_t* r) {
+    return r->lo >= 0 && r->hi <= 0xFF && (r->flags & CG_RANGE_EXACT8);
+}
+
+static int32_t codegen_range_mask(int32_t value) {
+    int32_t mask = 0;
+    while (mask < value) mask = (mask << 1) | 1;
+    return mask;
+}
+
+static void codegen_range_of_name(const char* name, codegen_range_t* out) {
+    int16_t idx = codegen_local_index(name);
+    if (g_range_override && codegen_names_equal(g_range_override->name, name)) {
+        codegen_range_set(out, g_range_override->lo, g_range_override->hi,
+                          CG_RANGE_EXACT8 | CG_RANGE_NARROW);
+        return;
+    }
+    if (idx >= 0 && (gen->locals[idx].flags & CG_FLAG_IS_NARROW)) {
+        codegen_range_set(out, 0, 0xFF, CG_RANGE_EXACT8 | CG_RANGE_NARROW);
+        return;
+    }
+    if (codegen_name_is_array(name) || codegen_name_is_pointer(name)) {
+        codegen_range_set(out, 0, CG_RANGE_MAX, CG_RANGE_EXACT8);
+    } else if (codegen_name_is_16(name)) {
+        if (codegen_name_is_signed(name)) {
+            codegen_range_set(out, CG_RANGE_MIN, 0x7FFF, CG_RANGE_EXACT8);
+        } else {
+            codegen_range_set(out, 0, CG_RANGE_MAX, CG_RANGE_EXACT8);
+        }
+    } else if (codegen_name_is_signed(name)) {
+        codegen_range_set(out, -128, 127, CG_RANGE_EXACT8);
+    } else {
+        codegen_range_set(out, 0, 0xFF, CG_RANGE_EXACT8);
+    }
+}
+
+static void codegen_range_binary(uint8_t op, const codegen_range_t* l,
+                                 const codegen_range_t* r, codegen_range_t* out) {
+    uint8_t narrow = (uint8_t)((l->flags | r->flags) & CG_RANGE_NARROW);
+    uint8_t exact = (uint8_t)(l->flags & r->flags & CG_RANGE_EXACT8);
+    bool l_pos = l->lo >= 0;
+    bool r_pos = r->lo >= 0;
+    if (codegen_op_is_compare(op) || op == OP_LAND || op == OP_LOR) {
+        codegen_range_set(out, 0, 1, CG_RANGE_EXACT8);
+        return;
+    }
+    switch (op) {
+        case OP_ADD:
+            codegen_range_set(out, l->lo + r->lo, l->hi + r->hi, exact | narrow);
+            return;
+        case OP_SUB:
+            codegen_range_set(out, l->lo - r->hi, l->hi - r->lo, exact | narrow);
+            return;
+        case OP_MUL:
+            if (l_pos && r_pos && (r->hi == 0 || l->hi <= CG_RANGE_MAX / r->hi)) {
+                codegen_range_set(out, l->lo * r->lo, l->hi * r->hi, exact | narrow);
+                return;
+            }
+            break;
+        case OP_DIV:
+        case OP_MOD:
+            exact = (codegen_range_fits8(l) && codegen_range_fits8(r)) ? CG_RANGE_EXACT8 : 0;
+            if (l_pos && r->lo >= 1) {
+                if (op == OP_DIV) {
+                    codegen_range_set(out, l->lo / r->hi, l->hi / r->lo, exact | narrow);
+                } else {
+                    codegen_range_set(out, 0, l->hi < r->hi - 1 ? l->hi : r->hi - 1,
+                                      exact | narrow);
+                }
+                return;
+            }
+            codegen_range_full(out);
+            out->flags = (uint8_t)(exact | narrow);
+            return;
+        case OP_AND:
+            if (l_pos || r_pos) {
+                int32_t hi = l_pos ? l->hi : r->hi;
+                if (l_pos && r_pos && r->hi < hi) hi = r->hi;
+                codegen_range_set(out, 0, hi, exact | narrow);
+                return;
+            }
+            break;
+        case OP_OR:
+        case OP_XOR:
+            if (l_pos && r_pos) {
+                codegen_range_set(out, 0,
+                                  codegen_range_mask(l->hi > r->hi ? l->hi : r->hi),
+                                  exact | narrow);
+                return;
+            }
+            break;
+        case OP_SHL:
+            exact = (uint8_t)(l->flags & (codegen_range_fits8(r) ? CG_RANGE_EXACT8 : 0));
+            if (l_pos && r_pos && r->hi <= 15) {
+                codegen_range_set(out, l->lo << r->lo, l->hi << r->hi, exact | narrow);
+                return;
+            }
+            codegen_range_full(out);
+            out->flags = (uint8_t)(exact | narrow);
+            return;
+        case OP_SHR:
+            exact = (codegen_range_fits8(l) && codegen_range_fits8(r)) ? CG_RANGE_EXACT8 : 0;
+            if (l_pos && r_pos) {
+                codegen_range_set(out, r->hi > 16 ? 0 : l->lo >> r->hi,
+                                  r->lo > 16 ? 0 : l->hi >> r->lo, exact | narrow);
+                return;
+            }
+            codegen_range_full(out);
+            out->flags = (uint8_t)(exact | narrow);
+            return;
+        default:
+            break;
+    }
+    codegen_range_full(out);
+    out->flags = (uint8_t)(exact | narrow);
+}
+
+static bool codegen_range_guard_applies(const char* name) {
+    const codegen_guard_t* guard;
+    if (!g_narrow_collect || g_narrow_guard_depth == 0 ||
+        g_narrow_guard_depth > DIM(g_narrow_guards)) {
+        return false;
+    }
+    guard = &g_narrow_guards[g_narrow_guard_depth - 1];
+    return guard->name && codegen_names_equal(guard->name, name);
+}
+
+/* Records a write of `value` to `name` during the narrowing pass */
+static void codegen_range_note_write(const char* name, const codegen_range_t* value) {
+    int16_t idx;
+    if (g_narrow_count_name) {
+        if (codegen_names_equal(g_narrow_count_name, name)) {
+            if (g_narrow_count < 0xFF) g_narrow_count++;
+            if (g_narrow_count_depth > 0) g_narrow_count_nested = true;
+        }
+        return;
+    }
+    if (!g_narrow_collect) return;
+    idx = codegen_local_index(name);
+    if (idx < 0 || !(gen->locals[idx].flags & CG_FLAG_IS_NARROW)) return;
+    if (value && codegen_range_fits8(value)) return;
+    gen->locals[idx].flags &= (uint8_t)~CG_FLAG_IS_NARROW;
+    g_narrow_changed = true;
+}
+
+static void codegen_range_of_tag(uint8_t tag, codegen_range_t* out);
+
+static void codegen_range_read(codegen_range_t* out) {
+    uint8_t tag = ast_read_tag();
+    codegen_range_of_tag(tag, out);
+}
+
+/* Range of the right-hand side of a write to `name`; inside a loop
+ * guarded on `name` the guard bounds the value being updated. */
+static void codegen_range_of_update(const char* name, uint8_t tag, codegen_range_t* out) {
+    const codegen_guard_t* saved = g_range_override;
+    if (codegen_range_guard_applies(name)) {
+        g_range_override = &g_narrow_guards[g_narrow_guard_depth - 1];
+    }
+    if (tag) {
+        codegen_range_of_tag(tag, out);
+    } else {
+        codegen_range_of_name(name, out);
+    }
+    g_range_override = saved;
+}
+
+static void codegen_range_of_tag(uint8_t tag, codegen_range_t* out) {
+    switch (tag) {
+        case AST_TAG_CONSTANT: {
+            int16_t value = ast_read_const();
+            codegen_range_set(out, value, value, CG_RANGE_EXACT8);
+            return;
+        }
+        case AST_TAG_IDENTIFIER: {
+            const char* name = NULL;
+            if (codegen_stream_read_name(&name) < 0) break;
+            codegen_range_of_name(name, out);
+            return;
+        }
+        case AST_TAG_STRING_LITERAL:
+            (void)ast_read_index();
+            codegen_range_set(out, 0, CG_RANGE_MAX, CG_RANGE_EXACT8);
+            return;
+        case AST_TAG_UNARY_OP: {
+            uint8_t op = ast_read_u8();
+            uint8_t child_tag = ast_read_tag();
+            codegen_range_t child;
+            if ((op == OP_PREINC || op == OP_PREDEC || op == OP_POSTINC || op == OP_POSTDEC) &&
+                child_tag == AST_TAG_IDENTIFIER) {
+                const char* name = NULL;
+                codegen_range_t updated;
+                int32_t step = (op == OP_PREINC || op == OP_POSTINC) ? 1 : -1;
+                if (codegen_stream_read_name(&name) < 0) break;
+                codegen_range_of_update(name, 0, &child);
+                codegen_range_set(&updated, child.lo + step, child.hi + step, child.flags);
+                codegen_range_note_write(name, &updated);
+                *out = (op == OP_POSTINC || op == OP_POSTDEC) ? child : updated;
+                return;
+            }
+            if (op == OP_ADDR && child_tag == AST_TAG_IDENTIFIER) {
+                const char* name = NULL;
+                if (codegen_stream_read_name(&name) < 0) break;
+                /* The address escapes; any store through it is unbounded */
+                codegen_range_note_write(name, NULL);
+                codegen_range_set(out, 0, CG_RANGE_MAX, CG_RANGE_EXACT8);
+                return;
+            }
+            codegen_range_of_tag(child_tag, &child);
+            switch (op) {
+                case OP_NEG:
+                    codegen_range_set(out, -child.hi, -child.lo, child.flags);
+                    return;
+                case OP_NOT:
+                    codegen_range_set(out, -child.hi - 1, -child.lo - 1, child.flags);
+                    return;
+                case OP_LNOT:
+                    codegen_range_set(out, 0, 1, CG_RANGE_EXACT8);
+                    return;
+                case OP_DEREF:
+                    /* Dereference always loads a byte */
+                    codegen_range_set(out, -128, 0xFF, CG_RANGE_EXACT8);
+                    return;
+                default:
+                    codegen_range_full(out);
+                    return;
+            }
+        }
+        case AST_TAG_BINARY_OP: {
+            uint8_t op = ast_read_u8();
+            codegen_range_t left;
+            codegen_range_t right;
+            codegen_range_read(&left);
+            codegen_range_read(&right);
+            codegen_range_binary(op, &left, &right, out);
+            return;
+        }
+        case AST_TAG_CALL: {
+            uint16_t name_index = ast_read_index();
+            uint8_t arg_count = ast_read_u8();
+            codegen_range_t arg;
+            uint8_t exact = CG_RANGE_EXACT8;
+            /* Arguments inherit the caller's width; in A they must fit */
+            for (uint8_t i = 0; i < arg_count; i++) {
+                codegen_range_read(&arg);
+                if (!codegen_range_fits8(&arg)) exact = 0;
+            }
+            if (codegen_function_return_is_16bit(name_index)) {
+                codegen_range_full(out);
+                out->flags = exact;
+            } else {
+                codegen_range_set(out, -128, 0xFF, exact);
+            }
+            return;
+        }
+        case AST_TAG_ARRAY_ACCESS: {
+            uint8_t base_tag = ast_read_tag();
+            const char* base_name = NULL;
+            uint8_t elem_size = 1;
+            bool elem_signed = true;
+            codegen_range_t index;
+            if (base_tag == AST_TAG_IDENTIFIER) {
+                if (codegen_stream_read_name(&base_name) < 0) break;
+                if (codegen_name_is_array(base_name)) {
+                    elem_size = codegen_array_elem_size_by_name(base_name);
+                    elem_signed = codegen_array_elem_signed_by_name(base_name);
+                } else {
+                    elem_size = codegen_pointer_elem_size_by_name(base_name);
+                    elem_signed = codegen_pointer_elem_signed_by_name(base_name);
+                }
+            } else {
+                codegen_range_of_tag(base_tag, &index);
+            }
+            codegen_range_read(&index);
+            if (elem_size == 2) {
+                codegen_range_full(out);
+            } else if (elem_signed) {
+                codegen_range_set(out, -128, 127, CG_RANGE_EXACT8);
+            } else {
+                codegen_range_set(out, 0, 0xFF, CG_RANGE_EXACT8);
+            }
+            return;
+        }
+        case AST_TAG_ASSIGN: {
+            uint8_t ltag = ast_read_tag();
+            codegen_range_t value;
+            if (ltag == AST_TAG_IDENTIFIER) {
+                const char* name = NULL;
+                if (codegen_stream_read_name(&name) < 0) break;
+                codegen_range_of_update(name, ast_read_tag(), &value);
+                codegen_range_note_write(name, &value);
+                codegen_range_of_name(name, out);
+                return;
+            }
+            codegen_range_of_tag(ltag, out);
+            codegen_range_read(&value);
+            return;
+        }
+        default:
+            if (ast_reader_skip_tag(tag) < 0) break;
+            codegen_range_full(out);
+            return;
+    }
+    codegen_range_full(out);
+    out->flags = 0;
+}
+
 static bool codegen_stream_type_is_16bit(uint8_t base, uint8_t depth) {
     base = codegen_base_type(base);
     if (depth > 0) return true;
@@ -1565,7 +2836,7 @@ static void codegen_register_function_return(uint16_t name_index, bool is_16bit)
             return;
         }
     }
-    if (gen->function_count >= DIM(gen->function_return_flags)) {
+    if (gen->function_count >= gen->function_capacity) {
         return;
     }
     gen->function_return_flags[gen->function_count] =
@@ -1574,10 +2845,11 @@ static void codegen_register_function_return(uint16_t name_index, bool is_16bit)
 }
 
 static cc_error_t codegen_stream_expression_tag(uint8_t tag) {
+    CC_STAT_INC(nodes_read);
     switch (tag) {
         case AST_TAG_CONSTANT: {
             int16_t value = 0;
-            value = ast_read_i16();
+            value = ast_read_const();
             g_result_in_hl = g_expect_result_in_hl;
             if (g_expect_result_in_hl) {
                 codegen_emit(CG_STR_LD_HL);
@@ -1591,8 +2863,8 @@ static cc_error_t codegen_stream_expression_tag(uint8_t tag) {
         }
         case AST_TAG_IDENTIFIER: {
             uint16_t name_index = 0;
-            name_index = ast_read_u16();
-            const char* name = ast_reader_string(name_index);
+            name_index = ast_read_index();
+            const char* name = ast_reader_name(name_index);
             if (!name) return CC_ERROR_CODEGEN;
             int16_t offset = 0;
             {
@@ -1637,7 +2909,7 @@ static cc_error_t codegen_stream_expression_tag(uint8_t tag) {
             uint8_t op = 0;
             uint8_t child_tag = 0;
             op = ast_read_u8();
-            child_tag = ast_read_u8();
+            child_tag = ast_read_tag();
             if (op == OP_DEREF) {
                 if (child_tag == AST_TAG_IDENTIFIER) {
                     const char* name = NULL;
@@ -1844,7 +3116,7 @@ static cc_error_t codegen_stream_expression_tag(uint8_t tag) {
             uint8_t op = 0;
             op = ast_read_u8();
             uint8_t left_tag = 0;
-            left_tag = ast_read_u8();
+            left_tag = ast_read_tag();
             if (op == OP_LAND || op == OP_LOR) {
                 cc_error_t err = CC_OK;
                 bool output_in_hl = g_expect_result_in_hl;
@@ -1866,7 +3138,7 @@ static cc_error_t codegen_stream_expression_tag(uint8_t tag) {
                 }
                 {
                     uint8_t right_tag = 0;
-                    right_tag = ast_read_u8();
+                    right_tag = ast_read_tag();
                     err = codegen_stream_expression_expect(right_tag, true);
                     if (err != CC_OK) goto logical_cleanup;
                 }
@@ -1891,11 +3163,40 @@ logical_cleanup:
             }
             bool is_compare = codegen_op_is_compare(op);
             bool force_16bit_compare = false;
-            if (is_compare && !g_expect_result_in_hl) {
+            codegen_range_t left_range;
+            codegen_range_t right_range;
+            codegen_range_t result_range;
+            bool operands_fit8 = false;
+            {
+                uint32_t expr_pos = reader_tell(reader);
+                codegen_range_of_tag(left_tag, &left_range);
+                codegen_range_read(&right_range);
+                if (reader_seek(reader, expr_pos) < 0) return CC_ERROR_CODEGEN;
+                codegen_range_binary(op, &left_range, &right_range, &result_range);
+                operands_fit8 = codegen_range_fits8(&left_range) &&
+                                codegen_range_fits8(&right_range);
+            }
+            /* Byte-sized work in an int context stays in A, widened once */
+            if (g_expect_result_in_hl &&
+                (is_compare ? operands_fit8 : codegen_range_fits8(&result_range))) {
+                cc_error_t err;
+                g_expect_result_in_hl = false;
+                err = codegen_emit_binary_op_a(op, left_tag);
+                g_expect_result_in_hl = true;
+                if (err != CC_OK) return err;
+                codegen_result_to_hl();
+                return CC_OK;
+            }
+            if (is_compare && !g_expect_result_in_hl && operands_fit8) {
+                force_16bit_compare = false;
+            } else if (is_compare && !g_expect_result_in_hl &&
+                       ((left_range.flags | right_range.flags) & CG_RANGE_NARROW)) {
+                force_16bit_compare = true;
+            } else if (is_compare && !g_expect_result_in_hl) {
                 uint32_t expr_pos = reader_tell(reader);
                 bool left_is_16 = codegen_expression_is_16bit_at(left_tag);
                 uint8_t right_tag_peek = 0;
-                right_tag_peek = ast_read_u8();
+                right_tag_peek = ast_read_tag();
                 bool right_is_16 = codegen_expression_is_16bit_at(right_tag_peek);
                 if (reader_seek(reader, expr_pos) < 0) return CC_ERROR_CODEGEN;
                 force_16bit_compare = left_is_16 || right_is_16;
@@ -1910,9 +3211,9 @@ logical_cleanup:
         case AST_TAG_CALL: {
             uint16_t name_index = 0;
             uint8_t arg_count = 0;
-            name_index = ast_read_u16();
+            name_index = ast_read_index();
             arg_count = ast_read_u8();
-            const char* name = ast_reader_string(name_index);
+            const char* name = ast_reader_name(name_index);
             if (!name) return CC_ERROR_CODEGEN;
             (void)name;
 
@@ -1931,7 +3232,7 @@ logical_cleanup:
                 for (uint8_t i = arg_count; i-- > 0;) {
                     if (reader_seek(reader, g_arg_offsets[i]) < 0) return CC_ERROR_CODEGEN;
                     uint8_t arg_tag = 0;
-                    arg_tag = ast_read_u8();
+                    arg_tag = ast_read_tag();
                     cc_error_t err = codegen_stream_expression_tag(arg_tag);
                     if (err != CC_OK) return err;
                     /* If the expression left a 16-bit result in HL, push HL directly.
@@ -1942,6 +3243,9 @@ logical_cleanup:
                 if (reader_seek(reader, end_pos) < 0) return CC_ERROR_CODEGEN;
             }
 
+#if CC_COST
+            if (codegen_cost_call(name_index) < 0) return CC_ERROR_CODEGEN;
+#endif
             codegen_emit(CG_STR_CALL);
             codegen_emit_label_name(name);
             codegen_emit(CG_STR_NL);
@@ -1957,7 +3261,7 @@ logical_cleanup:
             return CC_OK;
         }
         case AST_TAG_STRING_LITERAL: {
-            (void)ast_read_u16();
+            (void)ast_read_index();
             cc_error("String literal used without index");
             return CC_ERROR_CODEGEN;
         }
@@ -1993,12 +3297,12 @@ logical_cleanup:
             const char* lvalue_name = NULL;
             bool lvalue_deref = false;
 
-            ltag = ast_read_u8();
+            ltag = ast_read_tag();
             if (ltag == AST_TAG_ARRAY_ACCESS) {
                 uint8_t elem_size = 0;
                 cc_error_t err = codegen_emit_array_address(&elem_size, NULL);
                 if (err != CC_OK) return err;
-                rtag = ast_read_u8();
+                rtag = ast_read_tag();
                 codegen_emit(CG_STR_PUSH_HL);
                 bool expect_hl = (elem_size == 2) &&
                                  codegen_tag_is_simple_expr(rtag);
@@ -2025,7 +3329,7 @@ logical_cleanup:
                 op = ast_read_u8();
                 if (op == OP_DEREF) {
                     uint8_t operand_tag = 0;
-                    operand_tag = ast_read_u8();
+                    operand_tag = ast_read_tag();
                     if (operand_tag == AST_TAG_IDENTIFIER) {
                         if (codegen_stream_read_name(&lvalue_name) < 0) return CC_ERROR_CODEGEN;
                         lvalue_deref = true;
@@ -2047,12 +3351,12 @@ logical_cleanup:
                 if (codegen_stream_read_name(&lvalue_name) < 0) return CC_ERROR_CODEGEN;
             } else {
                 ast_reader_skip_tag(ltag);
-                rtag = ast_read_u8();
+                rtag = ast_read_tag();
                 ast_reader_skip_tag(rtag);
                 return CC_ERROR_CODEGEN;
             }
 
-            rtag = ast_read_u8();
+            rtag = ast_read_tag();
 
             if (lvalue_name && codegen_name_is_array(lvalue_name)) {
                 if (ast_reader_skip_tag(rtag) < 0) return CC_ERROR_CODEGEN;
@@ -2074,9 +3378,7 @@ logical_cleanup:
             if (lvalue_name &&
                 codegen_name_is_16(lvalue_name)) {
                 if (rtag == AST_TAG_STRING_LITERAL) {
-                    const char* rvalue_string = NULL;
-                    if (codegen_stream_read_name(&rvalue_string) < 0) return CC_ERROR_CODEGEN;
-                    const char* label = codegen_get_string_label(rvalue_string);
+                    const char* label = codegen_get_string_label(ast_read_index());
                     if (!label) return CC_ERROR_CODEGEN;
                     codegen_emit(CG_STR_LD_HL);
                     codegen_emit(label);
@@ -2119,10 +3421,12 @@ static cc_error_t codegen_stream_statement_tag(uint8_t tag) {
         { AST_TAG_IF_STMT, codegen_statement_if },
         { AST_TAG_WHILE_STMT, codegen_statement_while },
         { AST_TAG_FOR_STMT, codegen_statement_for },
-        { AST_TAG_ASSIGN, codegen_stream_expression_tag },
+        { AST_TAG_ASSIGN, codegen_statement_assign },
         { AST_TAG_CALL, codegen_stream_expression_tag },
     };
     uint8_t count = (uint8_t)DIM(handlers);
+    /* Call statements are counted by codegen_stream_expression_tag */
+    if (tag != AST_TAG_CALL) CC_STAT_INC(nodes_read);
     for (uint8_t i = 0; i < count; i++) {
         if (handlers[i].tag == tag) {
             return handlers[i].handler(tag);
@@ -2133,7 +3437,7 @@ static cc_error_t codegen_stream_statement_tag(uint8_t tag) {
 
 static int8_t codegen_stream_collect_locals(void) {
     uint8_t tag = 0;
-    tag = ast_read_u8();
+    tag = ast_read_tag();
     switch (tag) {
         case AST_TAG_VAR_DECL: {
             uint16_t name_index = 0;
@@ -2141,40 +3445,22 @@ static int8_t codegen_stream_collect_locals(void) {
             uint8_t base = 0;
             uint8_t depth = 0;
             uint16_t array_len = 0;
-            name_index = ast_read_u16();
+            name_index = ast_read_index();
             if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return -1;
             has_init = ast_read_u8();
-            const char* name = ast_reader_string(name_index);
+            const char* name = ast_reader_name(name_index);
             if (!name) return -1;
-            bool is_array = array_len > 0;
-            bool is_pointer = (!is_array && depth > 0);
             uint8_t elem_size = 0;
-            uint8_t base_kind = codegen_base_type(base);
-            bool is_signed = !codegen_base_is_unsigned(base);
-            if (base_kind == AST_BASE_VOID) {
-                is_signed = true;
-            }
-            bool is_16bit = codegen_stream_type_is_16bit(base, depth);
-            uint16_t size = 0;
-            bool elem_signed = is_signed;
-            if (is_array) {
-                elem_size = codegen_type_size(base, depth);
-                size = (uint16_t)(elem_size * array_len);
-                is_16bit = false;
-            } else {
-                size = is_16bit ? 2u : 1u;
-                if (is_pointer) {
-                    elem_size = codegen_pointer_elem_size(base, depth);
-                }
-            }
-            codegen_record_local(name, size, is_16bit, is_signed, is_pointer,
-                                 is_array, elem_size, elem_signed);
+            uint8_t flags = ast_var_flags(base, depth, array_len, &elem_size);
+            if (codegen_record_local(name, gen->stack_offset,
+                                     ast_var_size(flags, elem_size, array_len),
+                                     flags, elem_size) < 0) return -1;
             if (has_init) return ast_reader_skip_node();
             return 0;
         }
         case AST_TAG_COMPOUND_STMT: {
             uint16_t stmt_count = 0;
-            stmt_count = ast_read_u16();
+            stmt_count = ast_read_index();
             for (uint16_t i = 0; i < stmt_count; i++) {
                 if (codegen_stream_collect_locals() < 0) return -1;
             }
@@ -2214,6 +3500,334 @@ static int8_t codegen_stream_collect_locals(void) {
     }
 }
 
+/* Narrowing
+ *
+ * An int local whose every store provably fits a byte is kept in one
+ * byte. Candidates start narrowed and are widened again until the walk
+ * over the body no longer changes anything. A loop whose condition is
+ * `x < C` (or <=, >, >=, ==) with a byte constant bounds the value of x
+ * at the single store to x inside that loop, which is what lets counters
+ * like `for (i = 0; i < 10; i++)` narrow. */
+
+static int8_t codegen_narrow_statement(void);
+
+static void codegen_narrow_guard(codegen_guard_t* guard) {
+    uint8_t op = 0;
+    const char* name = NULL;
+    int16_t value = 0;
+    int16_t idx = 0;
+    if (ast_read_tag() != AST_TAG_BINARY_OP) return;
+    op = ast_read_u8();
+    if (!codegen_op_is_compare(op) || ast_read_tag() != AST_TAG_IDENTIFIER) return;
+    if (codegen_stream_read_name(&name) < 0) return;
+    if (ast_read_tag() != AST_TAG_CONSTANT) return;
+    value = ast_read_const();
+    idx = codegen_local_index(name);
+    if (idx < 0 || !(gen->locals[idx].flags & CG_FLAG_IS_NARROW)) return;
+    if (value < 0 || value > 0xFF) return;
+    guard->lo = 0;
+    guard->hi = 0xFF;
+    switch (op) {
+        case OP_LT:
+            if (value == 0) return;
+            guard->hi = (int16_t)(value - 1);
+            break;
+        case OP_LE:
+            guard->hi = value;
+            break;
+        case OP_GT:
+            if (value == 0xFF) return;
+            guard->lo = (int16_t)(value + 1);
+            break;
+        case OP_GE:
+            guard->lo = value;
+            break;
+        case OP_EQ:
+            guard->lo = value;
+            guard->hi = value;
+            break;
+        default:
+            return;
+    }
+    guard->name = name;
+}
+
+static int8_t codegen_narrow_loop_body(uint8_t has_inc) {
+    codegen_range_t range;
+    if (has_inc) codegen_range_read(&range);
+    return codegen_narrow_statement();
+}
+
+/* Walks a loop from its condition on (for: after the init statement) */
+static int8_t codegen_narrow_loop(uint8_t has_cond, uint8_t has_inc) {
+    codegen_guard_t guard;
+    codegen_range_t range;
+    int8_t result = 0;
+    guard.name = NULL;
+    guard.lo = 0;
+    guard.hi = 0;
+    if (g_narrow_count_name) {
+        if (has_cond) codegen_range_read(&range);
+        g_narrow_count_depth++;
+        result = codegen_narrow_loop_body(has_inc);
+        g_narrow_count_depth--;
+        return result;
+    }
+    if (has_cond) {
+        uint32_t cond_pos = reader_tell(reader);
+        codegen_narrow_guard(&guard);
+        if (reader_seek(reader, cond_pos) < 0) return -1;
+        codegen_range_read(&range);
+    }
+    if (guard.name && !g_narrow_has_label) {
+        uint32_t body_pos = reader_tell(reader);
+        g_narrow_count_name = guard.name;
+        g_narrow_count = 0;
+        g_narrow_count_depth = 0;
+        g_narrow_count_nested = false;
+        result = codegen_narrow_loop_body(has_inc);
+        g_narrow_count_name = NULL;
+        if (result < 0 || reader_seek(reader, body_pos) < 0) return -1;
+        if (g_narrow_count != 1 || g_narrow_count_nested) guard.name = NULL;
+    } else {
+        guard.name = NULL;
+    }
+    if (g_narrow_guard_depth < DIM(g_narrow_guards)) {
+        g_narrow_guards[g_narrow_guard_depth] = guard;
+    }
+    g_narrow_guard_depth++;
+    result = codegen_narrow_loop_body(has_inc);
+    g_narrow_guard_depth--;
+    return result;
+}
+
+static int8_t codegen_narrow_statement(void) {
+    uint8_t tag = 0;
+    codegen_range_t range;
+    tag = ast_read_tag();
+    switch (tag) {
+        case AST_TAG_VAR_DECL: {
+            uint16_t name_index = 0;
+            uint8_t base = 0;
+            uint8_t depth = 0;
+            uint16_t array_len = 0;
+            name_index = ast_read_index();
+            if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return -1;
+            if (ast_read_u8()) {
+                const char* name = ast_reader_name(name_index);
+                if (!name) return -1;
+                codegen_range_read(&range);
+                codegen_range_note_write(name, &range);
+            }
+            return 0;
+        }
+        case AST_TAG_COMPOUND_STMT: {
+            uint16_t stmt_count = 0;
+            stmt_count = ast_read_index();
+            for (uint16_t i = 0; i < stmt_count; i++) {
+                if (codegen_narrow_statement() < 0) return -1;
+            }
+            return 0;
+        }
+        case AST_TAG_IF_STMT: {
+            uint8_t has_else = 0;
+            has_else = ast_read_u8();
+            codegen_range_read(&range);
+            if (codegen_narrow_statement() < 0) return -1;
+            if (has_else) return codegen_narrow_statement();
+            return 0;
+        }
+        case AST_TAG_WHILE_STMT:
+            return codegen_narrow_loop(1, 0);
+        case AST_TAG_FOR_STMT: {
+            uint8_t has_init = 0;
+            uint8_t has_cond = 0;
+            uint8_t has_inc = 0;
+            has_init = ast_read_u8();
+            has_cond = ast_read_u8();
+            has_inc = ast_read_u8();
+            if (has_init && codegen_narrow_statement() < 0) return -1;
+            return codegen_narrow_loop(has_cond, has_inc);
+        }
+        case AST_TAG_RETURN_STMT:
+            if (ast_read_u8()) codegen_range_read(&range);
+            return 0;
+        case AST_TAG_LABEL_STMT:
+            g_narrow_has_label = true;
+            (void)ast_read_index();
+            return 0;
+        case AST_TAG_GOTO_STMT:
+            (void)ast_read_index();
+            return 0;
+        case AST_TAG_BREAK_STMT:
+        case AST_TAG_CONTINUE_STMT:
+            return 0;
+        default:
+            codegen_range_of_tag(tag, &range);
+            return 0;
+    }
+}
+
+/* Picks the int locals that fit a byte and re-lays out the frame */
+static int8_t codegen_narrow_locals(uint32_t body_start) {
+    bool any = false;
+    bool had_label = false;
+    int8_t result = 0;
+    int16_t shift = 0;
+    for (codegen_local_count_t i = 0; i < gen->local_var_count; i++) {
+        codegen_local_t* local = &gen->locals[i];
+        if ((local->flags & (CG_FLAG_IS_16 | CG_FLAG_IS_POINTER | CG_FLAG_IS_ARRAY)) !=
+            CG_FLAG_IS_16) {
+            continue;
+        }
+        if (codegen_param_index(local->name) >= 0 || codegen_global_index(local->name) >= 0) {
+            continue;
+        }
+        local->flags |= CG_FLAG_IS_NARROW;
+        any = true;
+    }
+    if (!any) return 0;
+
+    g_narrow_collect = true;
+    g_narrow_has_label = false;
+    do {
+        had_label = g_narrow_has_label;
+        g_narrow_changed = false;
+        g_narrow_guard_depth = 0;
+        if (reader_seek(reader, body_start) < 0 || codegen_narrow_statement() < 0) {
+            result = -1;
+            break;
+        }
+    } while (g_narrow_changed || had_label != g_narrow_has_label);
+    g_narrow_collect = false;
+
+    for (codegen_local_count_t i = 0; i < gen->local_var_count; i++) {
+        codegen_local_t* local = &gen->locals[i];
+        int16_t end = (i + 1u < gen->local_var_count) ? gen->locals[i + 1u].offset
+                                                       : gen->stack_offset;
+        int16_t size = (int16_t)(end - local->offset);
+        local->offset = (int16_t)(local->offset - shift);
+        if (!(local->flags & CG_FLAG_IS_NARROW)) continue;
+        if (result < 0) {
+            local->flags &= (uint8_t)~CG_FLAG_IS_NARROW;
+            continue;
+        }
+        local->flags &= (uint8_t)~(CG_FLAG_IS_16 | CG_FLAG_IS_SIGNED);
+        shift = (int16_t)(shift + size - 1);
+    }
+    gen->stack_offset = (int16_t)(gen->stack_offset - shift);
+    return result;
+}
+
+/* Analyzed AST: frames follow the globals and signatures, one per function
+ * in program order, so they are read from a cursor. */
+static uint32_t g_frame_pos;
+
+static void codegen_add_global(const char* name, uint8_t flags, uint8_t elem_size) {
+    if (!name || codegen_global_index(name) >= 0) return;
+    if (gen->global_count < gen->global_capacity) {
+        codegen_global_t global;
+        global.name = name;
+        global.elem_size = elem_size;
+        global.flags = flags;
+        mem_cpy(&gen->globals[gen->global_count], &global, sizeof(global));
+        gen->global_count++;
+    }
+}
+
+/* A full pool leaves the tables as they were */
+static int8_t codegen_alloc_globals(uint16_t count) {
+    codegen_global_t* grown;
+    if (count <= gen->global_capacity) return 0;
+    grown = (codegen_global_t*)cc_grow(gen->globals, &gen->global_capacity, count,
+                                       sizeof(codegen_global_t));
+    if (!grown) {
+        cc_error(CG_MSG_OUT_OF_MEMORY);
+        return -1;
+    }
+    gen->globals = grown;
+    return 0;
+}
+
+static int8_t codegen_alloc_functions(uint16_t count) {
+    if (count > gen->function_capacity) {
+        uint16_t* grown = (uint16_t*)cc_grow(gen->function_return_flags,
+                                             &gen->function_capacity, count, sizeof(uint16_t));
+        if (!grown) {
+            cc_error(CG_MSG_OUT_OF_MEMORY);
+            return -1;
+        }
+        gen->function_return_flags = grown;
+    }
+#if CC_COST
+    if (count > gen->function_cost_capacity) {
+        codegen_function_cost_t* grown = (codegen_function_cost_t*)cc_grow(
+            gen->function_costs, &gen->function_cost_capacity, count,
+            sizeof(codegen_function_cost_t));
+        if (!grown) {
+            cc_error(CG_MSG_OUT_OF_MEMORY);
+            return -1;
+        }
+        gen->function_costs = grown;
+    }
+    if (count > gen->function_count) {
+        mem_set(&gen->function_costs[gen->function_count], 0,
+                (size_t)(count - gen->function_count) * sizeof(codegen_function_cost_t));
+    }
+#endif
+    return 0;
+}
+
+static int8_t codegen_load_analysis(void) {
+    uint16_t count = 0;
+    if (reader_seek(reader, ast->analysis_offset) < 0) return -1;
+    count = ast_read_varint();
+    if (codegen_alloc_globals(count) < 0) return -1;
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t name_index = ast_read_varint();
+        uint8_t flags = ast_read_u8();
+        uint8_t elem_size = ast_read_u8();
+        codegen_add_global(ast_reader_name(name_index), flags, elem_size);
+    }
+    count = ast_read_varint();
+    if (codegen_alloc_functions(count) < 0) return -1;
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t name_index = ast_read_varint();
+        codegen_register_function_return(name_index, ast_read_u8() != 0);
+    }
+    g_frame_pos = reader_tell(reader);
+    return 0;
+}
+
+/* Replaces codegen_stream_collect_locals; leaves the reader at body_start */
+static int8_t codegen_load_frame(uint32_t body_start) {
+    uint16_t count = 0;
+    uint16_t frame_size = 0;
+    if (reader_seek(reader, g_frame_pos) < 0) return -1;
+    count = ast_read_varint();
+    frame_size = ast_read_varint();
+    if (count > gen->local_capacity) {
+        codegen_local_t* grown = (codegen_local_t*)cc_grow(gen->locals, &gen->local_capacity,
+                                                           count, sizeof(codegen_local_t));
+        if (!grown) {
+            cc_error(CG_MSG_OUT_OF_MEMORY);
+            return -1;
+        }
+        gen->locals = grown;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t name_index = ast_read_varint();
+        uint16_t offset = ast_read_varint();
+        uint8_t flags = ast_read_u8();
+        uint8_t elem_size = ast_read_u8();
+        if (codegen_record_local(ast_reader_name(name_index), (int16_t)offset, 0,
+                                 flags, elem_size) < 0) return -1;
+    }
+    gen->stack_offset = (int16_t)frame_size;
+    g_frame_pos = reader_tell(reader);
+    return reader_seek(reader, body_start);
+}
+
 static cc_error_t codegen_stream_function(void) {
     uint16_t name_index = 0;
     uint8_t param_count = 0;
@@ -2221,10 +3835,10 @@ static cc_error_t codegen_stream_function(void) {
     uint8_t depth = 0;
     uint16_t array_len = 0;
     const char* name = NULL;
-    name_index = ast_read_u16();
+    name_index = ast_read_index();
     if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_CODEGEN;
     param_count = ast_read_u8();
-    name = ast_reader_string(name_index);
+    name = ast_reader_name(name_index);
     if (!name) return CC_ERROR_CODEGEN;
 
     gen->current_function_name = name;
@@ -2236,6 +3850,15 @@ static cc_error_t codegen_stream_function(void) {
     gen->function_end_label = NULL;
     gen->stack_offset = 0;
     gen->loop_depth = 0;
+    if (param_count > gen->param_capacity) {
+        codegen_param_t* grown = (codegen_param_t*)cc_grow(gen->params, &gen->param_capacity,
+                                                           param_count, sizeof(codegen_param_t));
+        if (!grown) {
+            cc_error(CG_MSG_OUT_OF_MEMORY);
+            return CC_ERROR_CODEGEN;
+        }
+        gen->params = grown;
+    }
 
     for (uint8_t i = 0; i < param_count; i++) {
         uint8_t tag = 0;
@@ -2244,14 +3867,14 @@ static cc_error_t codegen_stream_function(void) {
         uint8_t param_base = 0;
         uint16_t param_array_len = 0;
         uint8_t has_init = 0;
-        tag = ast_read_u8();
+        tag = ast_read_tag();
         if (tag != AST_TAG_VAR_DECL) return CC_ERROR_CODEGEN;
-        param_name_index = ast_read_u16();
+        param_name_index = ast_read_index();
         if (ast_reader_read_type_info(&param_base, &param_depth,
                                       &param_array_len) < 0) return CC_ERROR_CODEGEN;
         has_init = ast_read_u8();
         if (has_init && ast_reader_skip_node() < 0) return CC_ERROR_CODEGEN;
-        if (gen->param_count < (uint8_t)DIM(gen->params)) {
+        if (gen->param_count < gen->param_capacity) {
             bool is_pointer = (param_depth > 0) || (param_array_len > 0);
             uint8_t param_base_kind = codegen_base_type(param_base);
             bool param_signed = !codegen_base_is_unsigned(param_base);
@@ -2260,7 +3883,7 @@ static cc_error_t codegen_stream_function(void) {
             }
             {
                 codegen_param_t param;
-                param.name = ast_reader_string(param_name_index);
+                param.name = ast_reader_name(param_name_index);
                 param.offset = 0;
                 param.elem_size = 0;
                 param.flags = 0;
@@ -2286,9 +3909,17 @@ static cc_error_t codegen_stream_function(void) {
     }
 
     codegen_emit_label(name);
+#if CC_COST
+    codegen_cost_begin(name_index);
+#endif
 
     uint32_t body_start = reader_tell(reader);
-    if (codegen_stream_collect_locals() < 0) return CC_ERROR_CODEGEN;
+    if (ast->flags & AST_FLAG_ANALYZED) {
+        if (codegen_load_frame(body_start) < 0) return CC_ERROR_CODEGEN;
+    } else if (codegen_stream_collect_locals() < 0) {
+        return CC_ERROR_CODEGEN;
+    }
+    if (codegen_narrow_locals(body_start) < 0) return CC_ERROR_CODEGEN;
 
     for (codegen_param_count_t i = 0; i < gen->param_count; i++) {
         gen->params[i].offset =
@@ -2302,16 +3933,25 @@ static cc_error_t codegen_stream_function(void) {
         codegen_emit_stack_adjust(gen->stack_offset, true);
         codegen_emit(CG_STR_IX_FRAME_SET);
     }
+#if CC_COST
+    codegen_cost_frame(gen->stack_offset);
+#endif
+
+    g_hoist_body = body_start;
+    g_hoist_scanned = false;
 
-    if (reader_seek(reader, body_start) < 0) return CC_ERROR_CODEGEN;
+    /* Already there when the frame came from the analysis and nothing narrowed */
+    if (reader_tell(reader) != body_start && reader_seek(reader, body_start) < 0) {
+        return CC_ERROR_CODEGEN;
+    }
     uint8_t body_tag = 0;
-    body_tag = ast_read_u8();
+    body_tag = ast_read_tag();
     if (body_tag == AST_TAG_COMPOUND_STMT) {
         uint16_t stmt_count = 0;
-        stmt_count = ast_read_u16();
+        stmt_count = ast_read_index();
         for (uint16_t i = 0; i < stmt_count; i++) {
             uint8_t stmt_tag = 0;
-            stmt_tag = ast_read_u8();
+            stmt_tag = ast_read_tag();
             cc_error_t err = codegen_stream_statement_tag(stmt_tag);
             if (err != CC_OK) return err;
         }
@@ -2327,18 +3967,20 @@ static cc_error_t codegen_stream_function(void) {
         bool preserve_hl = gen->function_return_is_16;
         codegen_emit_label(gen->function_end_label);
         if (preserve_hl) {
-            codegen_emit(
-                "  ld b, h\n"
-                "  ld c, l\n");
+            codegen_emit(CG_STR_LD_BC_HL);
         }
         codegen_emit_stack_adjust(gen->stack_offset, false);
+#if CC_COST
+        codegen_cost_frame((int16_t)-gen->stack_offset);
+#endif
         if (preserve_hl) {
-            codegen_emit(
-                "  ld h, b\n"
-                "  ld l, c\n");
+            codegen_emit(CG_STR_LD_HL_BC);
         }
         codegen_emit(CG_STR_POP_IX_RET);
     }
+#if CC_COST
+    codegen_cost_end(name);
+#endif
 
     if (gen->function_end_label) {
         cc_free(gen->function_end_label);
@@ -2356,10 +3998,10 @@ static cc_error_t codegen_stream_global_var(void) {
     uint8_t base = 0;
     uint8_t depth = 0;
     uint16_t array_len = 0;
-    name_index = ast_read_u16();
+    name_index = ast_read_index();
     if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_CODEGEN;
     has_init = ast_read_u8();
-    const char* name = ast_reader_string(name_index);
+    const char* name = ast_reader_name(name_index);
     if (!name) return CC_ERROR_CODEGEN;
     bool is_array = array_len > 0;
     bool is_pointer = (!is_array && depth > 0);
@@ -2379,17 +4021,17 @@ static cc_error_t codegen_stream_global_var(void) {
         }
         if (has_init) {
             uint8_t tag = 0;
-            tag = ast_read_u8();
+            tag = ast_read_tag();
             if (tag == AST_TAG_STRING_LITERAL && base_kind == AST_BASE_CHAR && depth == 0) {
-                const char* init_str = NULL;
+                const char* init_str = ast_reader_string(ast_read_index());
                 uint16_t len = 0;
-                if (codegen_stream_read_name(&init_str) < 0) return CC_ERROR_CODEGEN;
+                if (!init_str) return CC_ERROR_CODEGEN;
                 while (init_str[len]) len++;
                 if ((uint16_t)(len + 1u) > array_len) {
                     cc_error("String literal too long for array");
                     return CC_ERROR_CODEGEN;
                 }
-                codegen_emit_string_literal(init_str);
+                codegen_emit_string_literal(init_str, len);
                 codegen_emit(".db 0\n");
                 if ((uint16_t)(len + 1u) < array_len) {
                     codegen_emit(CG_STR_DS);
@@ -2413,11 +4055,9 @@ static cc_error_t codegen_stream_global_var(void) {
     if (is_pointer) {
         if (has_init) {
             uint8_t tag = 0;
-            tag = ast_read_u8();
+            tag = ast_read_tag();
             if (tag == AST_TAG_STRING_LITERAL) {
-                const char* init_str = NULL;
-                if (codegen_stream_read_name(&init_str) < 0) return CC_ERROR_CODEGEN;
-                const char* label = codegen_get_string_label(init_str);
+                const char* label = codegen_get_string_label(ast_read_index());
                 if (!label) return CC_ERROR_CODEGEN;
                 codegen_emit(CG_STR_COLON);
                 codegen_emit(CG_STR_DW);
@@ -2429,7 +4069,7 @@ static cc_error_t codegen_stream_global_var(void) {
                 uint8_t op = 0;
                 uint8_t operand_tag = 0;
                 op = ast_read_u8();
-                operand_tag = ast_read_u8();
+                operand_tag = ast_read_tag();
                 if (op == OP_ADDR && operand_tag == AST_TAG_IDENTIFIER) {
                     const char* ident = NULL;
                     if (codegen_stream_read_name(&ident) < 0) return CC_ERROR_CODEGEN;
@@ -2442,7 +4082,7 @@ static cc_error_t codegen_stream_global_var(void) {
                 ast_reader_skip_tag(operand_tag);
             }
             if (tag == AST_TAG_CONSTANT) {
-                (void)ast_read_i16();
+                (void)ast_read_const();
             } else {
                 ast_reader_skip_tag(tag);
             }
@@ -2450,16 +4090,17 @@ static cc_error_t codegen_stream_global_var(void) {
         codegen_emit(CG_STR_COLON);
         codegen_emit(CG_STR_DW);
         codegen_emit_hex(0);
+        codegen_emit(CG_STR_NL);
         return CC_OK;
     }
 
     bool is_16bit = codegen_stream_type_is_16bit(base, depth);
     if (has_init) {
         uint8_t tag = 0;
-        tag = ast_read_u8();
+        tag = ast_read_tag();
         if (tag == AST_TAG_CONSTANT) {
             int16_t value = 0;
-            value = ast_read_i16();
+            value = ast_read_const();
             codegen_emit(CG_STR_COLON);
             codegen_emit(is_16bit ? CG_STR_DW : CG_STR_DB);
             {
@@ -2474,116 +4115,202 @@ static cc_error_t codegen_stream_global_var(void) {
     codegen_emit(CG_STR_COLON);
     codegen_emit(is_16bit ? CG_STR_DW : CG_STR_DB);
     codegen_emit_hex(0);
+    codegen_emit(CG_STR_NL);
     return CC_OK;
 }
 
-cc_error_t codegen_generate_stream(void) {
-    uint16_t decl_count = 0;
-    if (!ast) return CC_ERROR_INTERNAL;
+/* String pool
+ *
+ * A literal that ends another one is emitted inside it: its label goes in
+ * front of the shared tail, so "error" costs no bytes next to "parse
+ * error". The text hashes run backwards, which gives every suffix of a
+ * literal its hash in a single pass; identical texts keep the first slot. */
 
-    codegen_emit_file("runtime/crt0.asm");
-    codegen_emit("\n; Program code\n");
+#define CODEGEN_STRING_NONE 0xFFFFu
 
-    if (ast_reader_begin_program(&decl_count) < 0) {
-        return CC_ERROR_CODEGEN;
+static uint16_t codegen_text_hash(uint16_t hash, char c) {
+    return (uint16_t)((hash * 33u) ^ (uint8_t)c);
+}
+
+static int8_t codegen_merge_strings(void) {
+    codegen_string_t* strings = gen->strings;
+    mem_set(gen->string_buckets, 0, sizeof(uint16_t) * (gen->string_bucket_mask + 1u));
+    for (codegen_string_count_t i = 0; i < gen->string_count; i++) {
+        const char* text = ast_reader_string(strings[i].index);
+        uint16_t hash = 0x811c;
+        uint16_t len = 0;
+        if (!text) return -1;
+        while (text[len]) len++;
+        while (len > 0) hash = codegen_text_hash(hash, text[--len]);
+        strings[i].hash = hash;
+        strings[i].host = i;
+        strings[i].offset = 0;
+        strings[i].next = CODEGEN_STRING_NONE;
+        codegen_string_insert(hash, i);
     }
-    for (uint16_t i = 0; i < decl_count; i++) {
-        uint8_t tag = 0;
-        tag = ast_read_u8();
+
+    for (codegen_string_count_t i = 0; i < gen->string_count; i++) {
+        const char* text = ast_reader_string(strings[i].index);
+        uint16_t hash = 0x811c;
+        uint16_t pos = 0;
+        if (!text) return -1;
+        while (text[pos]) pos++;
+        for (;;) {
+            /* hash covers text + pos */
+            uint16_t bucket = (uint16_t)(hash & gen->string_bucket_mask);
+            uint16_t entry = 0;
+            while ((entry = gen->string_buckets[bucket]) != 0) {
+                uint16_t j = (uint16_t)(entry - 1u);
+                bucket = (uint16_t)((bucket + 1u) & gen->string_bucket_mask);
+                if (j == i || strings[j].hash != hash || strings[j].host != j) continue;
+                if (pos == 0 && j < i) continue;
+                if (str_cmp(text + pos, ast_reader_string(strings[j].index)) == 0) {
+                    strings[j].host = i;
+                    strings[j].offset = pos;
+                }
+                /* Lazy strings: the compare may have evicted it */
+                text = ast_reader_string(strings[i].index);
+                if (!text) return -1;
+            }
+            if (pos == 0) break;
+            hash = codegen_text_hash(hash, text[--pos]);
+        }
+    }
+
+    /* Point every slot at the root of its chain and list it there */
+    for (codegen_string_count_t i = 0; i < gen->string_count; i++) {
+        uint16_t root = i;
+        uint16_t offset = 0;
+        uint16_t at = 0;
+        while (strings[root].host != root) {
+            offset = (uint16_t)(offset + strings[root].offset);
+            root = strings[root].host;
+        }
+        if (root == i) continue;
+        strings[i].host = root;
+        strings[i].offset = offset;
+        at = root;
+        while (strings[at].next != CODEGEN_STRING_NONE &&
+               strings[strings[at].next].offset <= offset) {
+            at = strings[at].next;
+        }
+        strings[i].next = strings[at].next;
+        strings[at].next = i;
+    }
+    return 0;
+}
+
+static void codegen_emit_strings(void) {
+    for (codegen_string_count_t i = 0; i < gen->string_count; i++) {
+        const char* text = NULL;
+        uint16_t len = 0;
+        uint16_t pos = 0;
+        if (gen->strings[i].host != i) continue;
+        text = ast_reader_string(gen->strings[i].index);
+        if (!text) continue;
+        while (text[len]) len++;
+        for (uint16_t slot = i; slot != CODEGEN_STRING_NONE; slot = gen->strings[slot].next) {
+            uint16_t offset = gen->strings[slot].offset;
+            if (offset > pos) {
+                codegen_emit_string_literal(text + pos, (uint16_t)(offset - pos));
+                pos = offset;
+            }
+            codegen_emit(codegen_string_label(slot));
+            codegen_emit(":\n");
+        }
+        if (len > pos) codegen_emit_string_literal(text + pos, (uint16_t)(len - pos));
+        codegen_emit("  .db 0\n");
+    }
+}
+
+/* Without an analysis section: globals and function return widths, so
+ * that calls to functions defined further down know them too */
+static int8_t codegen_collect_globals(void) {
+    uint16_t decl_count = 0;
+    int16_t tag = 0;
+    if (ast_reader_begin_program(&decl_count) < 0) return -1;
+    if (codegen_alloc_globals(decl_count) < 0 || codegen_alloc_functions(decl_count) < 0) {
+        return -1;
+    }
+    while ((tag = ast_reader_next_decl(0)) > 0) {
+        uint16_t name_index = 0;
+        uint8_t base = 0;
+        uint8_t depth = 0;
+        uint16_t array_len = 0;
         if (tag == AST_TAG_VAR_DECL) {
-            uint16_t name_index = 0;
-            uint8_t base = 0;
-            uint8_t depth = 0;
             uint8_t has_init = 0;
-            uint16_t array_len = 0;
-            name_index = ast_read_u16();
-            if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_CODEGEN;
+            uint8_t elem_size = 0;
+            uint8_t flags = 0;
+            name_index = ast_read_index();
+            if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return -1;
             has_init = ast_read_u8();
-            const char* name = ast_reader_string(name_index);
-            if (name && codegen_global_index(name) < 0) {
-                if (gen->global_count < DIM(gen->globals)) {
-                    bool is_array = array_len > 0;
-                    bool is_pointer = (!is_array && depth > 0);
-                    bool is_16bit = codegen_stream_type_is_16bit(base, depth);
-                    uint8_t base_kind = codegen_base_type(base);
-                    bool is_signed = !codegen_base_is_unsigned(base);
-                    bool elem_signed = is_signed;
-                    if (base_kind == AST_BASE_VOID) {
-                        is_signed = true;
-                        elem_signed = true;
-                    }
-                    uint8_t elem_size = 0;
-                    if (is_array) {
-                        elem_size = codegen_type_size(base, depth);
-                        is_16bit = false;
-                    } else if (is_pointer) {
-                        elem_size = codegen_pointer_elem_size(base, depth);
-                    }
-                    {
-                        codegen_global_t global;
-                        global.name = name;
-                        global.elem_size = elem_size;
-                        global.flags = 0;
-                        if (is_16bit) global.flags |= CG_FLAG_IS_16;
-                        if (is_signed) global.flags |= CG_FLAG_IS_SIGNED;
-                        if (is_pointer) global.flags |= CG_FLAG_IS_POINTER;
-                        if (is_array) global.flags |= CG_FLAG_IS_ARRAY;
-                        if (elem_signed) global.flags |= CG_FLAG_ELEM_SIGNED;
-                        mem_cpy(&gen->globals[gen->global_count], &global, sizeof(global));
-                    }
-                    gen->global_count++;
-                }
+            flags = ast_var_flags(base, depth, array_len, &elem_size);
+            codegen_add_global(ast_reader_name(name_index), flags, elem_size);
+            if (has_init && !ast->decls && ast_reader_skip_node() < 0) return -1;
+        } else if (tag == AST_TAG_FUNCTION) {
+            uint8_t param_count = 0;
+            name_index = ast_read_index();
+            if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return -1;
+            codegen_register_function_return(name_index, ast_type_is_16(base, depth) != 0);
+            if (ast->decls) continue;
+            param_count = ast_read_u8();
+            /* The parameters, then the body */
+            for (uint8_t p = 0; p <= param_count; p++) {
+                if (ast_reader_skip_node() < 0) return -1;
             }
-            if (has_init && ast_reader_skip_node() < 0) return CC_ERROR_CODEGEN;
         } else {
-            if (ast_reader_skip_tag(tag) < 0) return CC_ERROR_CODEGEN;
+            if (ast_reader_skip_tag((uint8_t)tag) < 0) return -1;
         }
     }
+    return tag < 0 ? -1 : 0;
+}
+
+cc_error_t codegen_generate_stream(void) {
+    uint16_t decl_count = 0;
+    int16_t tag = 0;
+    if (!ast) return CC_ERROR_INTERNAL;
+
+    codegen_emit_file("crt0.asm");
+    codegen_emit("\n; Program code\n");
+
+    if (ast->flags & AST_FLAG_ANALYZED) {
+        if (codegen_load_analysis() < 0) return CC_ERROR_CODEGEN;
+    } else if (codegen_collect_globals() < 0) {
+        return CC_ERROR_CODEGEN;
+    }
 
     if (ast_reader_begin_program(&decl_count) < 0) {
         return CC_ERROR_CODEGEN;
     }
-    for (uint16_t i = 0; i < decl_count; i++) {
-        uint8_t tag = 0;
-        tag = ast_read_u8();
-        if (tag == AST_TAG_FUNCTION) {
-            cc_error_t err = codegen_stream_function();
-            if (err != CC_OK) return err;
-        } else {
-            if (ast_reader_skip_tag(tag) < 0) return CC_ERROR_CODEGEN;
-        }
+    while ((tag = ast_reader_next_decl(AST_TAG_FUNCTION)) > 0) {
+        cc_error_t err = codegen_stream_function();
+        if (err != CC_OK) return err;
     }
+    if (tag < 0) return CC_ERROR_CODEGEN;
+#if CC_COST
+    {
+        cc_error_t err = codegen_cost_report();
+        if (err != CC_OK) return err;
+    }
+#endif
 
     if (ast_reader_begin_program(&decl_count) < 0) {
         return CC_ERROR_CODEGEN;
     }
-    for (uint16_t i = 0; i < decl_count; i++) {
-        uint8_t tag = 0;
-        tag = ast_read_u8();
-        if (tag == AST_TAG_VAR_DECL) {
-            cc_error_t err = codegen_stream_global_var();
-            if (err != CC_OK) return err;
-        } else {
-            if (ast_reader_skip_tag(tag) < 0) return CC_ERROR_CODEGEN;
-        }
+    while ((tag = ast_reader_next_decl(AST_TAG_VAR_DECL)) > 0) {
+        cc_error_t err = codegen_stream_global_var();
+        if (err != CC_OK) return err;
     }
+    if (tag < 0) return CC_ERROR_CODEGEN;
 
     if (gen->string_count > 0) {
         codegen_emit("\n; String literals\n");
-        for (codegen_string_count_t i = 0; i < gen->string_count; i++) {
-            const char* label = gen->string_labels[i];
-            const char* value = gen->string_literals[i];
-            if (!label || !value) continue;
-            codegen_emit(label);
-            codegen_emit(":\n");
-            codegen_emit_string_literal(value);
-            // Emit .db 0
-            codegen_emit("  .db 0\n");
-        }
+        if (codegen_merge_strings() < 0) return CC_ERROR_CODEGEN;
+        codegen_emit_strings();
     }
-    codegen_emit_file("runtime/zeal8bit.asm");
-    codegen_emit_file("runtime/math_8.asm");
-    codegen_emit_file("runtime/math_16.asm");
+    codegen_emit_file("zeal8bit.asm");
+    codegen_emit_file("math_8.asm");
+    codegen_emit_file("math_16.asm");
 
     return CC_OK;
 }
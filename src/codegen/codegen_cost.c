@@ -0,0 +1,354 @@
+#include "codegen_cost.h"
+
+#include "common.h"
+
+/* Z80 sizes and T-states, from the Zilog user manual timing tables. Only
+ * the operand shapes matter, so each operand is classified first and the
+ * mnemonic picks its row from the pair. */
+
+enum {
+    OPD_NONE = 0,
+    OPD_R8,      /* a b c d e h l */
+    OPD_X8,      /* ixh ixl iyh iyl */
+    OPD_IR,      /* i r */
+    OPD_IND_HL,  /* (hl) */
+    OPD_IND_IDX, /* (ix+d) (iy+d) */
+    OPD_IND_RR,  /* (bc) (de) */
+    OPD_IND_SP,  /* (sp) */
+    OPD_IND_C,   /* (c) */
+    OPD_IND_NN,  /* (nn) */
+    OPD_RR,      /* bc de hl sp; reg is the first letter */
+    OPD_AF,
+    OPD_AF_ALT,
+    OPD_IDX,     /* ix iy */
+    OPD_IMM      /* number, label or condition */
+};
+
+typedef struct {
+    uint8_t kind;
+    char reg;
+} cost_operand_t;
+
+enum {
+    COST_OP_LD, COST_OP_PUSH, COST_OP_POP, COST_OP_EX, COST_OP_ADD, COST_OP_ADC,
+    COST_OP_SUB, COST_OP_SBC, COST_OP_AND, COST_OP_XOR, COST_OP_OR, COST_OP_CP,
+    COST_OP_INC, COST_OP_DEC, COST_OP_JP, COST_OP_JR, COST_OP_DJNZ, COST_OP_CALL,
+    COST_OP_RET, COST_OP_RETI, COST_OP_RETN, COST_OP_RST, COST_OP_RLC, COST_OP_RRC,
+    COST_OP_RL, COST_OP_RR, COST_OP_SLA, COST_OP_SRA, COST_OP_SLL, COST_OP_SRL,
+    COST_OP_BIT, COST_OP_SET, COST_OP_RES, COST_OP_RLCA, COST_OP_RRCA, COST_OP_RLA,
+    COST_OP_RRA, COST_OP_CPL, COST_OP_CCF, COST_OP_SCF, COST_OP_NOP, COST_OP_HALT,
+    COST_OP_DI, COST_OP_EI, COST_OP_EXX, COST_OP_DAA, COST_OP_NEG, COST_OP_IM,
+    COST_OP_LDI, COST_OP_LDD, COST_OP_CPI, COST_OP_CPD, COST_OP_LDIR, COST_OP_LDDR,
+    COST_OP_CPIR, COST_OP_CPDR, COST_OP_IN, COST_OP_OUT, COST_OP_RLD, COST_OP_RRD,
+    COST_OP_COUNT
+};
+
+/* Indexed by COST_OP_* */
+static const char* const k_cost_op_mnemonics[COST_OP_COUNT] = {
+    "ld", "push", "pop", "ex", "add", "adc", "sub", "sbc", "and", "xor",
+    "or", "cp", "inc", "dec", "jp", "jr", "djnz", "call", "ret", "reti",
+    "retn", "rst", "rlc", "rrc", "rl", "rr", "sla", "sra", "sll", "srl",
+    "bit", "set", "res", "rlca", "rrca", "rla", "rra", "cpl", "ccf", "scf",
+    "nop", "halt", "di", "ei", "exx", "daa", "neg", "im", "ldi", "ldd",
+    "cpi", "cpd", "ldir", "lddr", "cpir", "cpdr", "in", "out", "rld", "rrd",
+};
+
+static bool cost_is(const char* text, uint8_t len, const char* word) {
+    uint8_t i = 0;
+    while (i < len && word[i] && text[i] == word[i]) i++;
+    return i == len && !word[i];
+}
+
+static bool cost_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void cost_classify(const char* text, uint8_t len, cost_operand_t* out) {
+    out->reg = 0;
+    while (len > 0 && cost_is_space(*text)) {
+        text++;
+        len--;
+    }
+    while (len > 0 && cost_is_space(text[len - 1])) len--;
+    if (len == 0) {
+        out->kind = OPD_NONE;
+    } else if (text[0] == '(' && text[len - 1] == ')') {
+        const char* inner = text + 1;
+        uint8_t n = (uint8_t)(len - 2);
+        while (n > 0 && cost_is_space(*inner)) {
+            inner++;
+            n--;
+        }
+        if (cost_is(inner, n, "hl")) {
+            out->kind = OPD_IND_HL;
+        } else if (cost_is(inner, n, "bc") || cost_is(inner, n, "de")) {
+            out->kind = OPD_IND_RR;
+        } else if (cost_is(inner, n, "sp")) {
+            out->kind = OPD_IND_SP;
+        } else if (cost_is(inner, n, "c")) {
+            out->kind = OPD_IND_C;
+        } else if (n >= 2 && inner[0] == 'i' && (inner[1] == 'x' || inner[1] == 'y') &&
+                   (n == 2 || inner[2] == '+' || inner[2] == '-' || cost_is_space(inner[2]))) {
+            out->kind = OPD_IND_IDX;
+        } else {
+            out->kind = OPD_IND_NN;
+        }
+    } else if (len == 1 && ((text[0] >= 'a' && text[0] <= 'e') || text[0] == 'h' ||
+                            text[0] == 'l')) {
+        out->kind = OPD_R8;
+        out->reg = text[0];
+    } else if (cost_is(text, len, "i") || cost_is(text, len, "r")) {
+        out->kind = OPD_IR;
+    } else if (cost_is(text, len, "ixh") || cost_is(text, len, "ixl") ||
+               cost_is(text, len, "iyh") || cost_is(text, len, "iyl")) {
+        out->kind = OPD_X8;
+    } else if (cost_is(text, len, "bc") || cost_is(text, len, "de") ||
+               cost_is(text, len, "hl") || cost_is(text, len, "sp")) {
+        out->kind = OPD_RR;
+        out->reg = text[0];
+    } else if (cost_is(text, len, "af")) {
+        out->kind = OPD_AF;
+    } else if (cost_is(text, len, "af'")) {
+        out->kind = OPD_AF_ALT;
+    } else if (cost_is(text, len, "ix") || cost_is(text, len, "iy")) {
+        out->kind = OPD_IDX;
+    } else {
+        out->kind = OPD_IMM;
+    }
+}
+
+/* The math runtime's divide and modulo fall back on the 8-bit routines,
+ * so calling them takes a second return address */
+static uint8_t cost_call_stack(const char* target, uint8_t len) {
+    while (len > 0 && cost_is_space(*target)) {
+        target++;
+        len--;
+    }
+    while (len > 0 && cost_is_space(target[len - 1])) len--;
+    return (cost_is(target, len, "__div_hl_de") || cost_is(target, len, "__mod_hl_de")) ? 4 : 2;
+}
+
+static void cost_push(codegen_cost_t* cost, int16_t bytes) {
+    int16_t peak = (int16_t)(cost->sp + bytes);
+    if (peak > 0 && (uint16_t)peak > cost->stack) cost->stack = (uint16_t)peak;
+}
+
+static void cost_add(codegen_cost_t* cost, uint8_t bytes, uint8_t min_t, uint8_t max_t) {
+    cost->bytes = (uint16_t)(cost->bytes + bytes);
+    cost->min_t += min_t;
+    cost->max_t += max_t;
+}
+
+/* r, ixh, n, (hl) or (ix+d) as the source of an 8-bit operation; base is
+ * the r form, which the others extend by a prefix, an operand or both */
+static void cost_add_src8(codegen_cost_t* cost, const cost_operand_t* src,
+                          uint8_t bytes, uint8_t t, uint8_t hl_t, uint8_t idx_t) {
+    switch (src->kind) {
+        case OPD_X8: cost_add(cost, (uint8_t)(bytes + 1u), (uint8_t)(t + 4u), (uint8_t)(t + 4u)); break;
+        case OPD_IMM: cost_add(cost, (uint8_t)(bytes + 1u), (uint8_t)(t + 3u), (uint8_t)(t + 3u)); break;
+        case OPD_IND_HL: cost_add(cost, bytes, hl_t, hl_t); break;
+        case OPD_IND_IDX: cost_add(cost, (uint8_t)(bytes + 2u), idx_t, idx_t); break;
+        default: cost_add(cost, bytes, t, t); break;
+    }
+}
+
+static void cost_add_ld(codegen_cost_t* cost, const cost_operand_t* dst,
+                        const cost_operand_t* src) {
+    uint8_t d = dst->kind;
+    uint8_t s = src->kind;
+    if (d == OPD_RR || d == OPD_IDX) {
+        uint8_t prefix = d == OPD_IDX ? 1 : 0;
+        if (s == OPD_IMM) {
+            cost_add(cost, (uint8_t)(3u + prefix), prefix ? 14 : 10, prefix ? 14 : 10);
+        } else if (s == OPD_IND_NN) {
+            bool hl = d == OPD_RR && dst->reg == 'h';
+            cost_add(cost, hl ? 3 : 4, hl ? 16 : 20, hl ? 16 : 20);
+        } else {
+            /* ld sp, hl / ld sp, ix */
+            cost_add(cost, (uint8_t)(1u + (s == OPD_IDX)), s == OPD_IDX ? 10 : 6,
+                     s == OPD_IDX ? 10 : 6);
+        }
+    } else if (d == OPD_IND_NN) {
+        if (s == OPD_R8) {
+            cost_add(cost, 3, 13, 13);
+        } else {
+            bool hl = s == OPD_RR && src->reg == 'h';
+            cost_add(cost, hl ? 3 : 4, hl ? 16 : 20, hl ? 16 : 20);
+        }
+    } else if (d == OPD_IND_RR || s == OPD_IND_RR) {
+        cost_add(cost, 1, 7, 7);
+    } else if (s == OPD_IND_NN) {
+        cost_add(cost, 3, 13, 13);
+    } else if (d == OPD_IR || s == OPD_IR) {
+        cost_add(cost, 2, 9, 9);
+    } else if (d == OPD_IND_HL) {
+        cost_add(cost, (uint8_t)(1u + (s == OPD_IMM)), s == OPD_IMM ? 10 : 7,
+                 s == OPD_IMM ? 10 : 7);
+    } else if (d == OPD_IND_IDX) {
+        cost_add(cost, (uint8_t)(3u + (s == OPD_IMM)), 19, 19);
+    } else if (d == OPD_X8) {
+        cost_add_src8(cost, src, 2, 8, 8, 8);
+    } else {
+        cost_add_src8(cost, src, 1, 4, 7, 19);
+    }
+}
+
+void codegen_cost_line(const char* line, uint8_t len, codegen_cost_t* cost) {
+    cost_operand_t opd[2];
+    uint8_t opd_count = 0;
+    uint8_t pos = 0;
+    uint8_t start = 0;
+    uint8_t op = 0;
+    uint8_t last_start = 0;
+    const cost_operand_t* last = NULL;
+
+    while (pos < len && cost_is_space(line[pos])) pos++;
+    start = pos;
+    while (pos < len && ((line[pos] >= 'a' && line[pos] <= 'z') ||
+                         (line[pos] >= '0' && line[pos] <= '9') || line[pos] == '_')) {
+        pos++;
+    }
+    if (pos == start || (pos < len && line[pos] == ':')) return;
+    for (op = 0; op < COST_OP_COUNT; op++) {
+        if (cost_is(line + start, (uint8_t)(pos - start), k_cost_op_mnemonics[op])) break;
+    }
+    if (op == COST_OP_COUNT) return;
+
+    opd[0].kind = OPD_NONE;
+    opd[1].kind = OPD_NONE;
+    while (pos < len && line[pos] != ';' && opd_count < 2) {
+        start = pos;
+        while (pos < len && line[pos] != ',' && line[pos] != ';') pos++;
+        cost_classify(line + start, (uint8_t)(pos - start), &opd[opd_count]);
+        if (opd[opd_count].kind != OPD_NONE) {
+            last_start = start;
+            opd_count++;
+        }
+        if (pos < len && line[pos] == ',') pos++;
+    }
+    last = &opd[opd_count ? opd_count - 1 : 0];
+
+    switch (op) {
+        case COST_OP_LD: cost_add_ld(cost, &opd[0], &opd[1]); break;
+        case COST_OP_PUSH:
+            cost_add(cost, opd[0].kind == OPD_IDX ? 2 : 1, opd[0].kind == OPD_IDX ? 15 : 11,
+                     opd[0].kind == OPD_IDX ? 15 : 11);
+            cost_push(cost, 2);
+            cost->sp = (int16_t)(cost->sp + 2);
+            break;
+        case COST_OP_POP:
+            cost_add(cost, opd[0].kind == OPD_IDX ? 2 : 1, opd[0].kind == OPD_IDX ? 14 : 10,
+                     opd[0].kind == OPD_IDX ? 14 : 10);
+            cost->sp = (int16_t)(cost->sp - 2);
+            break;
+        case COST_OP_EX:
+            if (opd[0].kind == OPD_IND_SP) {
+                bool idx = opd[1].kind == OPD_IDX;
+                cost_add(cost, idx ? 2 : 1, idx ? 23 : 19, idx ? 23 : 19);
+            } else {
+                cost_add(cost, 1, 4, 4);
+            }
+            break;
+        case COST_OP_ADD:
+        case COST_OP_ADC:
+        case COST_OP_SBC:
+            if (opd_count == 2 && opd[0].kind == OPD_RR) {
+                bool plain = op == COST_OP_ADD;
+                cost_add(cost, plain ? 1 : 2, plain ? 11 : 15, plain ? 11 : 15);
+                break;
+            }
+            if (opd_count == 2 && opd[0].kind == OPD_IDX) {
+                cost_add(cost, 2, 15, 15);
+                break;
+            }
+            cost_add_src8(cost, last, 1, 4, 7, 19);
+            break;
+        case COST_OP_SUB:
+        case COST_OP_AND:
+        case COST_OP_XOR:
+        case COST_OP_OR:
+        case COST_OP_CP:
+            cost_add_src8(cost, last, 1, 4, 7, 19);
+            break;
+        case COST_OP_INC:
+        case COST_OP_DEC:
+            if (opd[0].kind == OPD_RR) {
+                cost_add(cost, 1, 6, 6);
+                if (opd[0].reg == 's') {
+                    if (op == COST_OP_DEC) cost_push(cost, 1);
+                    cost->sp = (int16_t)(cost->sp + (op == COST_OP_DEC ? 1 : -1));
+                }
+            } else if (opd[0].kind == OPD_IDX) {
+                cost_add(cost, 2, 10, 10);
+            } else {
+                cost_add_src8(cost, &opd[0], 1, 4, 11, 23);
+            }
+            break;
+        case COST_OP_JP:
+            if (opd[0].kind == OPD_IND_HL) {
+                cost_add(cost, 1, 4, 4);
+            } else if (opd[0].kind == OPD_IND_IDX) {
+                cost_add(cost, 2, 8, 8);
+            } else {
+                cost_add(cost, 3, 10, 10);
+            }
+            break;
+        case COST_OP_JR: cost_add(cost, 2, opd_count == 2 ? 7 : 12, 12); break;
+        case COST_OP_DJNZ: cost_add(cost, 2, 8, 13); break;
+        case COST_OP_CALL:
+            cost_add(cost, 3, opd_count == 2 ? 10 : 17, 17);
+            if (opd_count) {
+                cost_push(cost, cost_call_stack(line + last_start, (uint8_t)(pos - last_start)));
+            }
+            break;
+        case COST_OP_RET: cost_add(cost, 1, opd_count ? 5 : 10, opd_count ? 11 : 10); break;
+        case COST_OP_RETI:
+        case COST_OP_RETN: cost_add(cost, 2, 14, 14); break;
+        case COST_OP_RST:
+            cost_add(cost, 1, 11, 11);
+            cost_push(cost, 2);
+            break;
+        case COST_OP_RLC:
+        case COST_OP_RRC:
+        case COST_OP_RL:
+        case COST_OP_RR:
+        case COST_OP_SLA:
+        case COST_OP_SRA:
+        case COST_OP_SLL:
+        case COST_OP_SRL:
+        case COST_OP_SET:
+        case COST_OP_RES:
+            if (last->kind == OPD_IND_IDX) {
+                cost_add(cost, 4, 23, 23);
+            } else {
+                cost_add(cost, 2, last->kind == OPD_IND_HL ? 15 : 8, last->kind == OPD_IND_HL ? 15 : 8);
+            }
+            break;
+        case COST_OP_BIT:
+            if (last->kind == OPD_IND_IDX) {
+                cost_add(cost, 4, 20, 20);
+            } else {
+                cost_add(cost, 2, last->kind == OPD_IND_HL ? 12 : 8, last->kind == OPD_IND_HL ? 12 : 8);
+            }
+            break;
+        case COST_OP_NEG:
+        case COST_OP_IM: cost_add(cost, 2, 8, 8); break;
+        case COST_OP_LDI:
+        case COST_OP_LDD:
+        case COST_OP_CPI:
+        case COST_OP_CPD: cost_add(cost, 2, 16, 16); break;
+        case COST_OP_LDIR:
+        case COST_OP_LDDR:
+        case COST_OP_CPIR:
+        case COST_OP_CPDR: cost_add(cost, 2, 16, 21); break;
+        case COST_OP_IN:
+            cost_add(cost, 2, opd[1].kind == OPD_IND_C ? 12 : 11, opd[1].kind == OPD_IND_C ? 12 : 11);
+            break;
+        case COST_OP_OUT:
+            cost_add(cost, 2, opd[0].kind == OPD_IND_C ? 12 : 11, opd[0].kind == OPD_IND_C ? 12 : 11);
+            break;
+        case COST_OP_RLD:
+        case COST_OP_RRD: cost_add(cost, 2, 18, 18); break;
+        default: cost_add(cost, 1, 4, 4); break; /* rlca ... daa */
+    }
+}
@@ -1,5 +1,7 @@
 #include "codegen_strings.h"
 
+#include "common.h"
+
 const char CG_STR_NL[] = "\n";
 const char CG_STR_OR_A[] = "  or a\n";
 const char CG_STR_LD_A[] = "  ld a, ";
@@ -31,6 +33,8 @@ const char CG_STR_PUSH_AF[] = "  push af\n";
 const char CG_STR_PUSH_IX[] = "  push ix\n";
 const char CG_STR_PUSH_IX_POP_HL[] = "  push ix\n  pop hl\n";
 const char CG_STR_POP_BC[] = "  pop bc\n";
+const char CG_STR_LD_BC_HL[] = "  ld b, h\n  ld c, l\n";
+const char CG_STR_LD_HL_BC[] = "  ld h, b\n  ld l, c\n";
 const char CG_STR_POP_IX_RET[] = "  pop ix\n  ret\n";
 const char CG_STR_COLON[] = ":\n";
 const char CG_STR_DB[] = "  .db ";
@@ -52,6 +56,16 @@ const char CG_MSG_FAILED_READ_AST_HEADER[] = "Failed to read AST header\n";
 const char CG_MSG_FAILED_READ_AST_STRING_TABLE[] = "Failed to read AST string table\n";
 const char CG_MSG_UNSUPPORTED_ARRAY_ACCESS[] = "Unsupported array access";
 const char CG_MSG_ARRAY_INIT_NOT_SUPPORTED[] = "Array initialization not supported";
-const char CG_MSG_USAGE_CODEGEN[] = "Usage: cc_codegen <input.ast> <output.asm>\n";
+const char CG_MSG_USAGE_CODEGEN[] = "Usage: cc_codegen <input.ast> <output.asm>"
+#if CC_COST
+    " [--cost <file.csv>] [--stack-limit <bytes>]"
+#endif
+    "\n";
 const char CG_MSG_FAILED_OPEN_OUTPUT[] = "Failed to open output file\n";
+#if CC_COST
+const char CG_MSG_FAILED_OPEN_COST[] = "Failed to open cost file\n";
+const char CG_MSG_STACK_LIMIT[] = "Stack limit exceeded: ";
+const char CG_MSG_STACK_UNBOUNDED[] = "Stack limit exceeded, recursion is unbounded: ";
+#endif
 const char CG_MSG_CODEGEN_FAILED[] = "Code generation failed\n";
+const char CG_MSG_OUT_OF_MEMORY[] = "Out of memory";
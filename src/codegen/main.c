@@ -56,6 +56,13 @@ int main(int argc, char** argv) {
         log_error(CG_MSG_FAILED_OPEN_OUTPUT);
         goto cleanup;
     }
+#if CC_COST
+    if (args.cost_file && codegen_open_cost(args.cost_file) < 0) {
+        log_error(CG_MSG_FAILED_OPEN_COST);
+        goto cleanup;
+    }
+    codegen_set_stack_limit(args.stack_limit);
+#endif
 
     result = codegen_generate_stream();
     if (result != CC_OK) {
@@ -72,5 +79,8 @@ int main(int argc, char** argv) {
 
 cleanup:
     cleanup();
+#if CC_STATS
+    if (args.stats) cc_stats_print("cc_codegen");
+#endif
     return err;
 }
@@ -0,0 +1,42 @@
+#include "ast_analysis.h"
+
+#include "ast_format.h"
+
+static uint8_t ast_type_size(uint8_t base, uint8_t depth) {
+    base = (uint8_t)(base & AST_BASE_MASK);
+    if (depth > 0) return 2;
+    if (base == AST_BASE_CHAR) return 1;
+    if (base == AST_BASE_INT) return 2;
+    return 0;
+}
+
+uint8_t ast_type_is_16(uint8_t base, uint8_t depth) {
+    if (depth > 0) return 1;
+    return (base & AST_BASE_MASK) == AST_BASE_INT;
+}
+
+uint8_t ast_var_flags(uint8_t base, uint8_t depth, uint16_t array_len, uint8_t* elem_size) {
+    uint8_t flags = AST_VAR_IS_SIGNED | AST_VAR_ELEM_SIGNED;
+    uint8_t size = 0;
+    /* void counts as signed */
+    if ((base & AST_BASE_FLAG_UNSIGNED) && (base & AST_BASE_MASK) != AST_BASE_VOID) {
+        flags = 0;
+    }
+    if (array_len > 0) {
+        flags |= AST_VAR_IS_ARRAY;
+        size = ast_type_size(base, depth);
+    } else {
+        if (ast_type_is_16(base, depth)) flags |= AST_VAR_IS_16;
+        if (depth > 0) {
+            flags |= AST_VAR_IS_POINTER;
+            size = ast_type_size(base, (uint8_t)(depth - 1));
+        }
+    }
+    if (elem_size) *elem_size = size;
+    return flags;
+}
+
+uint16_t ast_var_size(uint8_t flags, uint8_t elem_size, uint16_t array_len) {
+    if (flags & AST_VAR_IS_ARRAY) return (uint16_t)(elem_size * array_len);
+    return (flags & AST_VAR_IS_16) ? 2u : 1u;
+}
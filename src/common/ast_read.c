@@ -1,8 +1,12 @@
 #include "ast_io.h"
 
+#include "ast_format.h"
+
 static error_handler s_handler;
 static char* s_message;
 
+static uint8_t s_compact;
+
 void ast_read_handler(error_handler f, char* msg)
 {
     s_handler = f;
@@ -28,6 +32,13 @@ static int8_t ast_read_u16_unsafe(uint16_t* out)
     uint8_t hi = 0;
     if (!out)
         return -1;
+#ifndef __SDCC
+    const uint8_t* p = reader_span(reader, 2);
+    if (p) {
+        *out = (uint16_t) (p[0] | ((uint16_t) p[1] << 8));
+        return 0;
+    }
+#endif
     if (ast_read_u8_unsafe(&lo) < 0)
         return -1;
     if (ast_read_u8_unsafe(&hi) < 0)
@@ -44,6 +55,13 @@ static int8_t ast_read_u32_unsafe(uint32_t* out)
     uint8_t b3 = 0;
     if (!out)
         return -1;
+#ifndef __SDCC
+    const uint8_t* p = reader_span(reader, 4);
+    if (p) {
+        *out = (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+        return 0;
+    }
+#endif
     if (ast_read_u8_unsafe(&b0) < 0)
         return -1;
     if (ast_read_u8_unsafe(&b1) < 0)
@@ -103,3 +121,62 @@ int16_t ast_read_i16(void)
     }
     return value;
 }
+
+uint16_t ast_read_varint(void)
+{
+    uint16_t value = 0;
+    uint8_t shift = 0;
+    uint8_t byte = 0;
+    do {
+        byte = ast_read_u8();
+        if (shift > 14) {
+            s_handler(s_message);
+            return 0;
+        }
+        value |= (uint16_t) ((uint16_t) (byte & 0x7F) << shift);
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+void ast_read_format(uint8_t version)
+{
+    s_compact = version == AST_FORMAT_COMPACT;
+}
+
+/* A constant's tag is left unread: ast_read_const() reads the whole node,
+ * so a reader that seeks back to just after ast_read_tag() reads it again */
+uint8_t ast_read_tag(void)
+{
+    int16_t tag = reader_peek(reader);
+    if (tag < 0) {
+        s_handler(s_message);
+        return 0;
+    }
+    if (tag == AST_TAG_CONSTANT || (s_compact && (tag & AST_TAG_SMALL_CONST)))
+        return AST_TAG_CONSTANT;
+    return ast_read_u8();
+}
+
+uint16_t ast_read_index(void)
+{
+    return s_compact ? ast_read_varint() : ast_read_u16();
+}
+
+/* Reads a constant node from its tag: the value folded into the tag
+ * byte, or the payload after AST_TAG_CONSTANT */
+int16_t ast_read_const(void)
+{
+    uint8_t tag = ast_read_u8();
+    uint16_t zigzag = 0;
+    if (s_compact && (tag & AST_TAG_SMALL_CONST))
+        return (int16_t) (tag & AST_SMALL_CONST_MAX);
+    if (tag != AST_TAG_CONSTANT) {
+        s_handler(s_message);
+        return 0;
+    }
+    if (!s_compact)
+        return ast_read_i16();
+    zigzag = ast_read_varint();
+    return (int16_t) ((zigzag >> 1) ^ (uint16_t) -(int16_t) (zigzag & 1));
+}
@@ -7,10 +7,11 @@ int8_t ast_reader_begin_program(uint16_t* decl_count) {
     uint8_t tag = 0;
     uint16_t count = 0;
     if (!decl_count) return -1;
-    if (reader_seek(reader, AST_HEADER_SIZE) < 0) return -1;
-    tag = ast_read_u8();
+    if (reader_seek(reader, ast->program_offset) < 0) return -1;
+    tag = ast_read_tag();
     if (tag != AST_TAG_PROGRAM) return -1;
-    count = ast_read_u16();
+    count = ast_read_index();
+    if (ast->decls && count != ast->decl_entry_count) return -1;
     ast->decl_count = count;
     ast->decl_index = 0;
     ast->program_started = 1;
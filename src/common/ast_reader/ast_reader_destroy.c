@@ -10,9 +10,22 @@ void ast_reader_destroy(void) {
         cc_free(ast->strings);
     }
     ast->strings = NULL;
+#if CC_LAZY_STRINGS
+    cc_free(ast->string_offsets);
+    cc_free(ast->string_cache);
+    ast->string_offsets = NULL;
+    ast->string_cache = NULL;
+#endif
+    cc_free(ast->types);
+    ast->types = NULL;
+    ast->type_count = 0;
     ast->string_count = 0;
     ast->node_count = 0;
     ast->string_table_offset = 0;
+    ast->flags = 0;
+    cc_free(ast->decls);
+    ast->decls = NULL;
+    ast->decl_entry_count = 0;
     ast->decl_count = 0;
     ast->decl_index = 0;
     ast->program_started = 0;
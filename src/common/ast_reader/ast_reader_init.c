@@ -8,11 +8,12 @@
 static int8_t ast_read_header(
     reader_t* reader,
     uint8_t* out_version,
+    uint8_t* out_flags,
     uint16_t* node_count,
     uint16_t* string_count,
     uint32_t* string_table_offset
 ) {
-    if (!out_version || !node_count || !string_count || !string_table_offset) return -1;
+    if (!out_version || !out_flags || !node_count || !string_count || !string_table_offset) return -1;
     char magic[4];
     for (uint8_t i = 0; i < 4; i++) {
         int16_t ch = reader_next(reader);
@@ -21,35 +22,66 @@ static int8_t ast_read_header(
     }
     if (mem_cmp(magic, AST_MAGIC, 4) != 0) return -1;
     uint8_t version = 0;
-    uint8_t reserved = 0;
-    uint16_t flags = 0;
+    uint8_t flags = 0;
+    uint16_t reserved = 0;
     version = ast_read_u8();
-    reserved = ast_read_u8();
-    flags = ast_read_u16();
+    flags = ast_read_u8();
+    reserved = ast_read_u16();
+    if (version != AST_FORMAT_VERSION && version != AST_FORMAT_COMPACT) return -1;
     *out_version = version;
+    *out_flags = flags;
     (void)reserved;
-    (void)flags;
     *node_count = ast_read_u16();
     *string_count = ast_read_u16();
     *string_table_offset = ast_read_u32();
     return 0;
 }
 
+/* Compact format: varint count, then base, depth and varint array_len each */
+static int8_t ast_read_type_table(void) {
+    ast->type_count = ast_read_varint();
+    if (ast->type_count == 0) return 0;
+    ast->types = (ast_type_entry_t*)cc_malloc(sizeof(ast_type_entry_t) * ast->type_count);
+    if (!ast->types) return -1;
+    for (uint16_t i = 0; i < ast->type_count; i++) {
+        ast->types[i].base = ast_read_u8();
+        ast->types[i].depth = ast_read_u8();
+        ast->types[i].array_len = ast_read_varint();
+    }
+    return 0;
+}
+
 int8_t ast_reader_init(void) {
     ast->node_count = 0;
     ast->string_count = 0;
     ast->string_table_offset = 0;
     ast->format_version = 0;
+    ast->flags = 0;
+    ast->program_offset = AST_HEADER_SIZE;
+    ast->analysis_offset = 0;
+    ast->types = NULL;
+    ast->type_count = 0;
     ast->strings = NULL;
+#if CC_LAZY_STRINGS
+    ast->string_offsets = NULL;
+    ast->string_cache = NULL;
+#endif
+    ast->decls = NULL;
+    ast->decl_entry_count = 0;
     ast->decl_count = 0;
     ast->decl_index = 0;
     ast->program_started = 0;
 
     if (reader_seek(reader, 0) < 0) return -1;
-    if (ast_read_header(reader, &ast->format_version, &ast->node_count, &ast->string_count,
+    if (ast_read_header(reader, &ast->format_version, &ast->flags, &ast->node_count, &ast->string_count,
                         &ast->string_table_offset) < 0) {
         return -1;
     }
+    ast_read_format(ast->format_version);
+    if (ast->format_version == AST_FORMAT_COMPACT) {
+        if (ast_read_type_table() < 0) return -1;
+        ast->program_offset = reader_tell(reader);
+    }
     if (ast->string_count > 0 && ast->string_table_offset < AST_HEADER_SIZE) return -1;
     return 0;
 }
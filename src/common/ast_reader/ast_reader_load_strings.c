@@ -1,11 +1,72 @@
 #include "ast_reader.h"
 
+#include "ast_format.h"
 #include "ast_io.h"
+#include "cc_compat.h"
 #include "common.h"
 
+/* Reads the declaration index that follows the string table at offset */
+static int8_t ast_reader_load_index(uint32_t offset) {
+    ast->analysis_offset = offset;
+    if (!(ast->flags & AST_FLAG_DECL_INDEX)) return 0;
+    if (reader_seek(reader, offset) < 0) return -1;
+    ast->decl_entry_count = ast_read_u16();
+    ast->analysis_offset = offset + 2u + (uint32_t)ast->decl_entry_count * AST_DECL_ENTRY_SIZE;
+    if (ast->decl_entry_count == 0) return 0;
+    ast->decls = (ast_decl_entry_t*)cc_malloc(sizeof(ast_decl_entry_t) * ast->decl_entry_count);
+    if (!ast->decls) return -1;
+    for (uint16_t i = 0; i < ast->decl_entry_count; i++) {
+        ast_decl_entry_t* decl = &ast->decls[i];
+        decl->tag = ast_read_u8();
+        decl->name_index = ast_read_u16();
+        decl->offset = ast_read_u32();
+        decl->length = ast_read_u32();
+    }
+    return 0;
+}
+
+#if CC_LAZY_STRINGS
+
+/* Records where each string starts; the text is read by ast_reader_string */
+int8_t ast_reader_load_strings(void) {
+    uint16_t offset = 0;
+
+    if (ast->string_count == 0) return ast_reader_load_index(ast->string_table_offset);
+    if (reader_seek(reader, ast->string_table_offset) < 0) return -1;
+    ast->strings = (char**)cc_malloc(sizeof(char*) * ast->string_count);
+    ast->string_offsets = (uint16_t*)cc_malloc(sizeof(uint16_t) * ast->string_count);
+    ast->string_cache = (ast_string_cache_t*)cc_malloc(sizeof(ast_string_cache_t));
+    if (!ast->strings || !ast->string_offsets || !ast->string_cache) {
+        ast_reader_destroy();
+        return -1;
+    }
+    mem_set(ast->string_cache, 0, sizeof(ast_string_cache_t));
+    for (uint16_t i = 0; i < ast->string_count; i++) {
+        uint16_t len = 0;
+        ast->strings[i] = NULL;
+        ast->string_offsets[i] = offset;
+        len = ast_read_u16();
+        /* MAX_AST_STRINGS strings of MAX_STRING_LENGTH fit in 16 bits */
+        if (len >= MAX_STRING_LENGTH || (uint16_t)(offset + 2u + len) < offset) {
+            ast_reader_destroy();
+            return -1;
+        }
+        for (uint16_t j = 0; j < len; j++) {
+            if (reader_next(reader) < 0) {
+                ast_reader_destroy();
+                return -1;
+            }
+        }
+        offset = (uint16_t)(offset + 2u + len);
+    }
+    return ast_reader_load_index(reader_tell(reader));
+}
+
+#else
+
 int8_t ast_reader_load_strings(void) {
 
-    if (ast->string_count == 0) return 0;
+    if (ast->string_count == 0) return ast_reader_load_index(ast->string_table_offset);
     if (reader_seek(reader, ast->string_table_offset) < 0) return -1;
     ast->strings = (char**)cc_malloc(sizeof(char*) * ast->string_count);
     if (!ast->strings) return -1;
@@ -32,5 +93,8 @@ int8_t ast_reader_load_strings(void) {
         buf[len] = '\0';
         ast->strings[i] = buf;
     }
-    return 0;
+    CC_STAT_ADD(strings_loaded, ast->string_count);
+    return ast_reader_load_index(reader_tell(reader));
 }
+
+#endif
@@ -0,0 +1,22 @@
+#include "ast_reader.h"
+
+#include "ast_io.h"
+
+int16_t ast_reader_next_decl(uint8_t tag) {
+    while (ast->decl_index < ast->decl_count) {
+        uint8_t found = 0;
+        if (ast->decls) {
+            const ast_decl_entry_t* decl = &ast->decls[ast->decl_index++];
+            if (tag && decl->tag != tag) continue;
+            /* A seek drops the read buffer, so stay put when already there */
+            if (reader_tell(reader) != decl->offset + 1u &&
+                reader_seek(reader, decl->offset + 1u) < 0) return -1;
+            return decl->tag;
+        }
+        found = ast_read_tag();
+        ast->decl_index++;
+        if (!tag || found == tag) return found;
+        if (ast_reader_skip_tag(found) < 0) return -1;
+    }
+    return 0;
+}
@@ -5,6 +5,14 @@
 int8_t ast_reader_read_type_info(uint8_t* base, uint8_t* depth,
                                  uint16_t* array_len) {
     if (!base || !depth || !array_len) return -1;
+    if (ast->format_version == AST_FORMAT_COMPACT) {
+        uint16_t id = ast_read_varint();
+        if (id >= ast->type_count) return -1;
+        *base = ast->types[id].base;
+        *depth = ast->types[id].depth;
+        *array_len = ast->types[id].array_len;
+        return 0;
+    }
     *base = ast_read_u8();
     *depth = ast_read_u8();
     *array_len = ast_read_u16();
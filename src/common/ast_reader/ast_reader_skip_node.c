@@ -4,6 +4,6 @@
 
 int8_t ast_reader_skip_node() {
     uint8_t tag = 0;
-    tag = ast_read_u8();
+    tag = ast_read_tag();
     return ast_reader_skip_tag(tag);
 }
@@ -2,6 +2,7 @@
 #include "cc_compat.h"
 #include "ast_format.h"
 #include "ast_io.h"
+#include "common.h"
 
 typedef int8_t (*ast_skip_fn)(void);
 
@@ -10,13 +11,13 @@ static int8_t ast_skip_u8(void) {
     return 0;
 }
 
-static int8_t ast_skip_u16(void) {
-    (void)ast_read_u16();
+static int8_t ast_skip_index(void) {
+    (void)ast_read_index();
     return 0;
 }
 
-static int8_t ast_skip_i16(void) {
-    (void)ast_read_i16();
+static int8_t ast_skip_const(void) {
+    (void)ast_read_const();
     return 0;
 }
 
@@ -46,13 +47,13 @@ static int8_t ast_skip_two_nodes(void) {
 
 static int8_t ast_skip_program(void) {
     uint16_t decl_count = 0;
-    decl_count = ast_read_u16();
+    decl_count = ast_read_index();
     return ast_skip_nodes(decl_count);
 }
 
 static int8_t ast_skip_function(void) {
     uint8_t param_count = 0;
-    if (ast_skip_u16() < 0) return -1;
+    if (ast_skip_index() < 0) return -1;
     if (ast_skip_type_info() < 0) return -1;
     param_count = ast_read_u8();
     if (ast_skip_nodes(param_count) < 0) return -1;
@@ -61,7 +62,7 @@ static int8_t ast_skip_function(void) {
 
 static int8_t ast_skip_var_decl(void) {
     uint8_t has_init = 0;
-    if (ast_skip_u16() < 0) return -1;
+    if (ast_skip_index() < 0) return -1;
     if (ast_skip_type_info() < 0) return -1;
     has_init = ast_read_u8();
     return ast_skip_optional(has_init);
@@ -69,7 +70,7 @@ static int8_t ast_skip_var_decl(void) {
 
 static int8_t ast_skip_compound(void) {
     uint16_t stmt_count = 0;
-    stmt_count = ast_read_u16();
+    stmt_count = ast_read_index();
     return ast_skip_nodes(stmt_count);
 }
 
@@ -101,7 +102,7 @@ static int8_t ast_skip_for(void) {
 
 static int8_t ast_skip_call(void) {
     uint8_t arg_count = 0;
-    if (ast_skip_u16() < 0) return -1;
+    if (ast_skip_index() < 0) return -1;
     arg_count = ast_read_u8();
     return ast_skip_nodes(arg_count);
 }
@@ -127,8 +128,8 @@ static const ast_skip_fn g_ast_skip_handlers[AST_TAG_COUNT] = {
     ast_skip_return,     /* AST_TAG_RETURN_STMT */
     NULL,                /* AST_TAG_BREAK_STMT */
     NULL,                /* AST_TAG_CONTINUE_STMT */
-    ast_skip_u16,        /* AST_TAG_GOTO_STMT */
-    ast_skip_u16,        /* AST_TAG_LABEL_STMT */
+    ast_skip_index,      /* AST_TAG_GOTO_STMT */
+    ast_skip_index,      /* AST_TAG_LABEL_STMT */
     ast_skip_if,         /* AST_TAG_IF_STMT */
     ast_skip_two_nodes,  /* AST_TAG_WHILE_STMT */
     ast_skip_for,        /* AST_TAG_FOR_STMT */
@@ -136,15 +137,16 @@ static const ast_skip_fn g_ast_skip_handlers[AST_TAG_COUNT] = {
     ast_skip_call,       /* AST_TAG_CALL */
     ast_skip_binary,     /* AST_TAG_BINARY_OP */
     ast_skip_unary,      /* AST_TAG_UNARY_OP */
-    ast_skip_u16,        /* AST_TAG_IDENTIFIER */
-    ast_skip_i16,        /* AST_TAG_CONSTANT */
-    ast_skip_u16,        /* AST_TAG_STRING_LITERAL */
+    ast_skip_index,      /* AST_TAG_IDENTIFIER */
+    ast_skip_const,      /* AST_TAG_CONSTANT */
+    ast_skip_index,      /* AST_TAG_STRING_LITERAL */
     ast_skip_two_nodes   /* AST_TAG_ARRAY_ACCESS */
 };
 
 int8_t ast_reader_skip_tag(uint8_t tag) {
     if (!ast) return -1;
     if (tag >= AST_TAG_COUNT) return -1;
+    CC_STAT_INC(nodes_skipped);
     ast_skip_fn fn = g_ast_skip_handlers[tag];
     if (!fn) return 0;
     return fn();
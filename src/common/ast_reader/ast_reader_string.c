@@ -1,6 +1,76 @@
 #include "ast_reader.h"
 
+#include "ast_io.h"
+#include "common.h"
+
+#if CC_LAZY_STRINGS
+
+/* Reads string `index` into buf (MAX_STRING_LENGTH bytes) and returns to
+ * the current position in the node stream. */
+static int8_t ast_reader_fetch(uint16_t index, char* buf) {
+    uint32_t pos = reader_tell(reader);
+    uint16_t len = 0;
+
+    if (reader_seek(reader, ast->string_table_offset + ast->string_offsets[index]) < 0) return -1;
+    len = ast_read_u16();
+    if (len >= MAX_STRING_LENGTH) return -1;
+    for (uint16_t i = 0; i < len; i++) {
+        int16_t ch = reader_next(reader);
+        if (ch < 0) return -1;
+        buf[i] = (char)ch;
+    }
+    buf[len] = '\0';
+    CC_STAT_INC(strings_loaded);
+    return reader_seek(reader, pos);
+}
+
+const char* ast_reader_string(uint16_t index) {
+    ast_string_cache_t* cache;
+    uint8_t victim = 0;
+
+    if (!ast || !ast->strings || index >= ast->string_count) return NULL;
+    if (ast->strings[index]) return ast->strings[index];
+    cache = ast->string_cache;
+    if (++cache->tick == 0) {
+        /* Wrapped: restart the ages, keeping only which slots are filled */
+        for (uint8_t i = 0; i < AST_STRING_CACHE_SLOTS; i++) {
+            if (cache->used[i]) cache->used[i] = 1;
+        }
+        cache->tick = 2;
+    }
+    for (uint8_t i = 0; i < AST_STRING_CACHE_SLOTS; i++) {
+        if (cache->used[i] && cache->index[i] == index) {
+            cache->used[i] = cache->tick;
+            return cache->text[i];
+        }
+        if (cache->used[i] < cache->used[victim]) victim = i;
+    }
+    cache->used[victim] = 0;
+    if (ast_reader_fetch(index, cache->text[victim]) < 0) return NULL;
+    cache->index[victim] = index;
+    cache->used[victim] = cache->tick;
+    return cache->text[victim];
+}
+
+const char* ast_reader_name(uint16_t index) {
+    const char* text = ast_reader_string(index);
+    char* copy;
+
+    if (!text || ast->strings[index]) return text;
+    copy = cc_strdup(text);
+    ast->strings[index] = copy;
+    return copy;
+}
+
+#else
+
 const char* ast_reader_string(uint16_t index) {
     if (!ast || !ast->strings || index >= ast->string_count) return NULL;
     return ast->strings[index];
 }
+
+const char* ast_reader_name(uint16_t index) {
+    return ast_reader_string(index);
+}
+
+#endif
@@ -67,3 +67,22 @@ void ast_write_i16(output_t out, int16_t value)
         s_handler(s_message);
     }
 }
+
+uint8_t ast_varint_size(uint16_t value)
+{
+    if (value < 0x80)
+        return 1;
+    if (value < 0x4000)
+        return 2;
+    return 3;
+}
+
+/* LEB128: 7 bits per byte, low bits first, high bit set on all but the last */
+void ast_write_varint(output_t out, uint16_t value)
+{
+    while (value >= 0x80) {
+        ast_write_u8(out, (uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    ast_write_u8(out, (uint8_t) value);
+}
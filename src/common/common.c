@@ -22,6 +22,10 @@ static size_t g_pool_size = 0;
 static size_t g_pool_offset = 0;
 static size_t g_pool_max = 0;
 static cc_block_header_t* g_pool_head = NULL;
+#if CC_STATS
+static uint16_t g_pool_free_blocks = 0;
+cc_stats_t g_cc_stats;
+#endif
 
 static size_t cc_align_size(size_t size) {
     const size_t align = 4;
@@ -39,6 +43,9 @@ void cc_reset_pool(void) {
     g_pool_head->size = g_pool_size - sizeof(cc_block_header_t);
     g_pool_head->free = true;
     g_pool_head->next = NULL;
+#if CC_STATS
+    g_pool_free_blocks = 1;
+#endif
 }
 
 static void cc_coalesce_free_blocks(void) {
@@ -47,13 +54,17 @@ static void cc_coalesce_free_blocks(void) {
         if (cur->free && cur->next->free) {
             cur->size += sizeof(cc_block_header_t) + cur->next->size;
             cur->next = cur->next->next;
+#if CC_STATS
+            g_pool_free_blocks--;
+#endif
             continue;
         }
         cur = cur->next;
     }
 }
 
-void* cc_malloc(size_t size) {
+/* First fit; returns NULL when no free block is large enough */
+static void* cc_pool_take(size_t size) {
     if (size == 0) return NULL;
 
     size = cc_align_size(size);
@@ -72,18 +83,37 @@ void* cc_malloc(size_t size) {
                 cur->next = split;
                 cur->size = size;
             }
+#if CC_STATS
+            else {
+                g_pool_free_blocks--;
+            }
+#endif
+            CC_STAT_INC(mallocs);
             cur->free = false;
             g_pool_offset += cur->size;
             if (g_pool_offset > g_pool_max) {
                 g_pool_max = g_pool_offset;
+#if CC_STATS
+                g_cc_stats.pool_peak = (uint16_t)g_pool_max;
+                g_cc_stats.free_blocks_at_peak = g_pool_free_blocks;
+#endif
             }
             return (char*)cur + sizeof(cc_block_header_t);
         }
         cur = cur->next;
     }
+    return NULL;
+}
 
-    cc_error("Out of memory");
-    exit(1);
+void* cc_malloc(size_t size) {
+    void* ptr;
+    if (size == 0) return NULL;
+    ptr = cc_pool_take(size);
+    if (!ptr) {
+        cc_error("Out of memory");
+        exit(1);
+    }
+    return ptr;
 }
 
 #ifdef __SDCC
@@ -106,7 +136,19 @@ uint16_t cc_init_pool_default(void) {
 #define CC_POOL_SIZE (32 * 1024)
 #endif
 char memory_pool[CC_POOL_SIZE];
+
+/* CC_POOL_REPORT=1 prints the pool high-water mark when the tool exits,
+ * for bench/throughput.py */
+static void cc_report_pool(void) {
+    fprintf(stderr, "pool peak = %lu of %lu\n",
+            (unsigned long)g_pool_max, (unsigned long)g_pool_size);
+}
+
 uint16_t cc_init_pool_default(void) {
+    const char* report = getenv("CC_POOL_REPORT");
+    if (report && report[0] && report[0] != '0') {
+        atexit(cc_report_pool);
+    }
     return cc_init_pool(memory_pool, sizeof(memory_pool));
 }
 #endif
@@ -137,6 +179,10 @@ void cc_free(void* ptr) {
     cc_block_header_t* header = (cc_block_header_t*)((char*)ptr - sizeof(cc_block_header_t));
     if (header->free) return;
     header->free = true;
+#if CC_STATS
+    g_pool_free_blocks++;
+#endif
+    CC_STAT_INC(frees);
     if (g_pool_offset >= header->size) {
         g_pool_offset -= header->size;
     } else {
@@ -145,6 +191,65 @@ void cc_free(void* ptr) {
     cc_coalesce_free_blocks();
 }
 
+/* Grows a block in place when the block after it is free, so a table that
+ * keeps growing does not need its old and new copies side by side;
+ * otherwise moves it. Returns NULL and leaves the block as it was when the
+ * pool has no room. */
+void* cc_realloc(void* ptr, size_t size) {
+    cc_block_header_t* header;
+    cc_block_header_t* next;
+    void* moved;
+    if (!ptr) return cc_pool_take(size);
+    size = cc_align_size(size);
+    header = (cc_block_header_t*)((char*)ptr - sizeof(cc_block_header_t));
+    if (header->size >= size) return ptr;
+    next = header->next;
+    if (next && next->free && header->size + sizeof(cc_block_header_t) + next->size >= size) {
+        size_t remaining = header->size + sizeof(cc_block_header_t) + next->size - size;
+        g_pool_offset += size - header->size;
+        if (remaining > sizeof(cc_block_header_t) + 4) {
+            cc_block_header_t* split = (cc_block_header_t*)((char*)ptr + size);
+            split->size = remaining - sizeof(cc_block_header_t);
+            split->free = true;
+            split->next = next->next;
+            header->next = split;
+            header->size = size;
+        } else {
+            g_pool_offset += remaining;
+            header->size = size + remaining;
+            header->next = next->next;
+#if CC_STATS
+            g_pool_free_blocks--;
+#endif
+        }
+        if (g_pool_offset > g_pool_max) {
+            g_pool_max = g_pool_offset;
+#if CC_STATS
+            g_cc_stats.pool_peak = (uint16_t)g_pool_max;
+            g_cc_stats.free_blocks_at_peak = g_pool_free_blocks;
+#endif
+        }
+        return ptr;
+    }
+    moved = cc_pool_take(size);
+    if (!moved) return NULL;
+    mem_cpy(moved, ptr, header->size);
+    cc_free(ptr);
+    return moved;
+}
+
+/* Grows a pool array of size-byte entries to need entries. Returns the
+ * array, which may have moved, or NULL with the array and *capacity left
+ * untouched. */
+void* cc_grow(void* data, uint16_t* capacity, uint16_t need, size_t size) {
+    void* grown;
+    if (need <= *capacity) return data;
+    grown = cc_realloc(data, (size_t)need * size);
+    if (!grown) return NULL;
+    *capacity = need;
+    return grown;
+}
+
 char* cc_strdup(const char* str) {
     if (!str) return NULL;
 
@@ -161,3 +266,129 @@ char* cc_strdup(const char* str) {
 
     return copy;
 }
+
+struct cc_arena_block {
+    cc_arena_block_t* prev;
+    uint16_t size;
+};
+
+#define CC_ARENA_HEADER cc_align_size(sizeof(cc_arena_block_t))
+
+void* cc_arena_alloc(cc_arena_t* arena, size_t size) {
+    cc_arena_block_t* block = arena->block;
+    size = cc_align_size(size);
+    if (!block || arena->used + size > block->size) {
+        if (arena->spare && size <= arena->spare->size) {
+            block = arena->spare;
+            arena->spare = NULL;
+        } else {
+            size_t block_size = size > CC_ARENA_BLOCK ? size : CC_ARENA_BLOCK;
+            block = (cc_arena_block_t*)cc_malloc(CC_ARENA_HEADER + block_size);
+            if (!block) return NULL;
+            block->size = (uint16_t)block_size;
+        }
+        block->prev = arena->block;
+        arena->block = block;
+        arena->used = 0;
+    }
+    arena->used = (uint16_t)(arena->used + size);
+    return (char*)block + CC_ARENA_HEADER + arena->used - size;
+}
+
+cc_arena_mark_t cc_arena_mark(const cc_arena_t* arena) {
+    cc_arena_mark_t mark;
+    mark.block = arena->block;
+    mark.used = arena->used;
+    return mark;
+}
+
+void cc_arena_release(cc_arena_t* arena, cc_arena_mark_t mark) {
+    while (arena->block && arena->block != mark.block) {
+        cc_arena_block_t* block = arena->block;
+        arena->block = block->prev;
+        if (!arena->spare && block->size == CC_ARENA_BLOCK) {
+            arena->spare = block;
+        } else {
+            cc_free(block);
+        }
+    }
+    arena->used = mark.used;
+}
+
+void cc_arena_reset(cc_arena_t* arena) {
+    cc_arena_mark_t empty = {NULL, 0};
+    cc_arena_release(arena, empty);
+}
+
+void cc_arena_free(cc_arena_t* arena) {
+    cc_arena_reset(arena);
+    cc_free(arena->spare);
+    arena->spare = NULL;
+}
+
+cc_arena_t* g_cc_tree_arena = NULL;
+
+cc_arena_t* cc_tree_arena(cc_arena_t* arena) {
+    cc_arena_t* prev = g_cc_tree_arena;
+    g_cc_tree_arena = arena;
+    return prev;
+}
+
+void* cc_tree_alloc(size_t size) {
+    if (g_cc_tree_arena) return cc_arena_alloc(g_cc_tree_arena, size);
+    return cc_malloc(size);
+}
+
+char* cc_tree_strdup(const char* str) {
+    size_t len;
+    char* copy;
+    if (!str) return NULL;
+    if (!g_cc_tree_arena) return cc_strdup(str);
+    len = str_len(str);
+    copy = (char*)cc_arena_alloc(g_cc_tree_arena, len + 1);
+    if (copy) mem_cpy(copy, str, len + 1);
+    return copy;
+}
+
+void cc_tree_free(void* ptr) {
+    if (!g_cc_tree_arena) cc_free(ptr);
+}
+
+#if CC_STATS
+static void cc_stats_put_u32(uint32_t value) {
+    char digits[11];
+    uint8_t len = 0;
+    do {
+        digits[len++] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value);
+    while (len) {
+        put_c(digits[--len]);
+    }
+}
+
+static void cc_stats_line(const char* label, uint32_t value) {
+    put_s("  ");
+    put_s(label);
+    cc_stats_put_u32(value);
+    put_c('\n');
+}
+
+void cc_stats_print(const char* stage) {
+    put_s("stats ");
+    put_s(stage);
+    put_s(":\n");
+    cc_stats_line("bytes read       ", g_cc_stats.bytes_read);
+    cc_stats_line("reader_fill      ", g_cc_stats.reader_fills);
+    cc_stats_line("reader_seek      ", g_cc_stats.reader_seeks);
+    cc_stats_line("output_write     ", g_cc_stats.output_writes);
+    cc_stats_line("output bytes     ", g_cc_stats.output_bytes);
+    cc_stats_line("cc_malloc        ", g_cc_stats.mallocs);
+    cc_stats_line("cc_free          ", g_cc_stats.frees);
+    cc_stats_line("pool peak        ", g_cc_stats.pool_peak);
+    cc_stats_line("free blocks@peak ", g_cc_stats.free_blocks_at_peak);
+    cc_stats_line("nodes read       ", g_cc_stats.nodes_read);
+    cc_stats_line("nodes skipped    ", g_cc_stats.nodes_skipped);
+    cc_stats_line("strings loaded   ", g_cc_stats.strings_loaded);
+}
+#endif
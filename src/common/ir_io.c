@@ -0,0 +1,257 @@
+#include "ir.h"
+
+#include "ast_io.h"
+#include "cc_compat.h"
+#include "common.h"
+
+#define IR_INSTR_BYTES 8
+#define IR_SLOT_BYTES 5
+#define IR_INITIAL_CAPACITY 64
+
+void ir_write_header(output_t out, const ir_header_t* header) {
+    output_write(out, IR_MAGIC, 4);
+    ast_write_u8(out, IR_FORMAT_VERSION);
+    ast_write_u8(out, 0);
+    ast_write_u16(out, header->record_count);
+    ast_write_u16(out, header->function_count);
+    ast_write_u16(out, header->string_count);
+    ast_write_u32(out, IR_HEADER_SIZE);
+}
+
+void ir_write_strings(output_t out, uint16_t count, const char* (*get)(uint16_t)) {
+    for (uint16_t i = 0; i < count; i++) {
+        const char* str = get(i);
+        uint16_t len = 0;
+        if (!str) str = "";
+        while (str[len]) len++;
+        ast_write_u16(out, len);
+        if (len > 0) {
+            output_write(out, str, len);
+        }
+    }
+}
+
+void ir_write_function(output_t out, const ir_function_t* fn) {
+    ast_write_u8(out, IR_REC_FUNCTION);
+    ast_write_u16(out, fn->name_index);
+    ast_write_u8(out, fn->flags);
+    ast_write_u8(out, fn->param_count);
+    ast_write_u8(out, fn->slot_count);
+    ast_write_u16(out, fn->vreg_count);
+    ast_write_u16(out, fn->label_count);
+    ast_write_u16(out, fn->instr_count);
+    for (uint8_t i = 0; i < fn->slot_count; i++) {
+        ast_write_u16(out, fn->slots[i].name_index);
+        ast_write_u8(out, fn->slots[i].kind);
+        ast_write_u16(out, fn->slots[i].size);
+    }
+    for (uint16_t i = 0; i < fn->instr_count; i++) {
+        const ir_instr_t* ins = &fn->instrs[i];
+        ast_write_u8(out, ins->op);
+        ast_write_u8(out, ins->flags);
+        ast_write_u16(out, ins->dst);
+        ast_write_u16(out, ins->a);
+        ast_write_u16(out, ins->b);
+    }
+}
+
+void ir_write_global(output_t out, const ir_global_t* global) {
+    ast_write_u8(out, IR_REC_GLOBAL);
+    ast_write_u16(out, global->name_index);
+    ast_write_u8(out, global->kind);
+    ast_write_u16(out, global->size);
+    ast_write_u16(out, global->init);
+}
+
+void ir_function_init(ir_function_t* fn, uint16_t name_index) {
+    mem_set(fn, 0, sizeof(*fn));
+    fn->name_index = name_index;
+}
+
+static int8_t ir_reserve(ir_function_t* fn, uint16_t count) {
+    ir_instr_t* grown;
+    uint16_t capacity = fn->instr_capacity ? fn->instr_capacity : IR_INITIAL_CAPACITY;
+    if (count <= fn->instr_capacity) return 0;
+    while (capacity < count) {
+        if (capacity >= 0x4000u) return -1;
+        capacity = (uint16_t)(capacity * 2u);
+    }
+    grown = (ir_instr_t*)cc_realloc(fn->instrs, sizeof(ir_instr_t) * capacity);
+    if (!grown) return -1;
+    fn->instrs = grown;
+    fn->instr_capacity = capacity;
+    return 0;
+}
+
+int8_t ir_emit(ir_function_t* fn, uint8_t op, uint8_t flags,
+               uint16_t dst, uint16_t a, uint16_t b) {
+    ir_instr_t* ins;
+    if (ir_reserve(fn, (uint16_t)(fn->instr_count + 1u)) < 0) return -1;
+    ins = &fn->instrs[fn->instr_count++];
+    ins->op = op;
+    ins->flags = flags;
+    ins->dst = dst;
+    ins->a = a;
+    ins->b = b;
+    return 0;
+}
+
+uint16_t ir_new_vreg(ir_function_t* fn) {
+    return fn->vreg_count++;
+}
+
+uint16_t ir_new_label(ir_function_t* fn) {
+    return fn->label_count++;
+}
+
+bool ir_op_has_dst(uint8_t op) {
+    return op != IR_STL && op != IR_STG && op != IR_STORE && op != IR_ARG &&
+           op != IR_RET && op != IR_JMP && op != IR_BZ && op != IR_BNZ &&
+           op != IR_LABEL && op != IR_NOP;
+}
+
+uint8_t ir_instr_operands(const ir_instr_t* ins, uint16_t* a, uint16_t* b) {
+    *a = IR_NONE;
+    *b = IR_NONE;
+    switch (ins->op) {
+        case IR_MOV: case IR_ZEXT: case IR_SEXT: case IR_TRUNC:
+        case IR_NEG: case IR_NOT: case IR_LNOT: case IR_LOAD:
+        case IR_ARG: case IR_RET: case IR_BZ: case IR_BNZ:
+            *a = ins->a;
+            return 1;
+        case IR_STL: case IR_STG:
+            *a = ins->b;
+            return 1;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_AND: case IR_OR: case IR_XOR: case IR_SHL: case IR_SHR:
+        case IR_SEQ: case IR_SNE: case IR_SLT: case IR_SLE: case IR_SGT: case IR_SGE:
+        case IR_STORE:
+            *a = ins->a;
+            *b = ins->b;
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+void ir_function_free(ir_function_t* fn) {
+    if (fn->instrs) {
+        cc_free(fn->instrs);
+    }
+    fn->instrs = NULL;
+    fn->instr_count = 0;
+    fn->instr_capacity = 0;
+}
+
+int8_t ir_read_header(ir_header_t* header) {
+    char magic[4];
+    if (reader_seek(reader, 0) < 0) return -1;
+    for (uint8_t i = 0; i < 4; i++) {
+        int16_t ch = reader_next(reader);
+        if (ch < 0) return -1;
+        magic[i] = (char)ch;
+    }
+    if (mem_cmp(magic, IR_MAGIC, 4) != 0) return -1;
+    header->format_version = ast_read_u8();
+    (void)ast_read_u8();
+    header->record_count = ast_read_u16();
+    header->function_count = ast_read_u16();
+    header->string_count = ast_read_u16();
+    header->string_table_offset = ast_read_u32();
+    if (header->format_version != IR_FORMAT_VERSION) return -1;
+    if (header->string_table_offset < IR_HEADER_SIZE) return -1;
+    return 0;
+}
+
+int8_t ir_seek_records(const ir_header_t* header) {
+    if (reader_seek(reader, header->string_table_offset) < 0) return -1;
+    for (uint16_t i = 0; i < header->string_count; i++) {
+        uint16_t len = ast_read_u16();
+        if (reader_seek(reader, reader_tell(reader) + len) < 0) return -1;
+    }
+    return 0;
+}
+
+uint8_t ir_read_record_kind(void) {
+    return ast_read_u8();
+}
+
+static void ir_read_function_header(ir_function_t* fn) {
+    fn->name_index = ast_read_u16();
+    fn->flags = ast_read_u8();
+    fn->param_count = ast_read_u8();
+    fn->slot_count = ast_read_u8();
+    fn->vreg_count = ast_read_u16();
+    fn->label_count = ast_read_u16();
+    fn->instr_count = ast_read_u16();
+}
+
+int8_t ir_read_function(ir_function_t* fn) {
+    uint16_t count;
+    ir_function_init(fn, 0);
+    ir_read_function_header(fn);
+    if (fn->slot_count > IR_MAX_SLOTS) return -1;
+    for (uint8_t i = 0; i < fn->slot_count; i++) {
+        fn->slots[i].name_index = ast_read_u16();
+        fn->slots[i].kind = ast_read_u8();
+        fn->slots[i].size = ast_read_u16();
+    }
+    count = fn->instr_count;
+    fn->instr_count = 0;
+    if (ir_reserve(fn, count ? count : 1) < 0) return -1;
+    for (uint16_t i = 0; i < count; i++) {
+        ir_instr_t* ins = &fn->instrs[i];
+        ins->op = ast_read_u8();
+        ins->flags = ast_read_u8();
+        ins->dst = ast_read_u16();
+        ins->a = ast_read_u16();
+        ins->b = ast_read_u16();
+    }
+    fn->instr_count = count;
+    return 0;
+}
+
+int8_t ir_read_global(ir_global_t* global) {
+    global->name_index = ast_read_u16();
+    global->kind = ast_read_u8();
+    global->size = ast_read_u16();
+    global->init = ast_read_u16();
+    return 0;
+}
+
+int8_t ir_skip_record(uint8_t kind) {
+    if (kind == IR_REC_GLOBAL) {
+        ir_global_t global;
+        return ir_read_global(&global);
+    }
+    if (kind == IR_REC_FUNCTION) {
+        uint8_t slot_count;
+        uint16_t instr_count;
+        uint32_t skip;
+        (void)ast_read_u16(); /* name */
+        (void)ast_read_u8();  /* flags */
+        (void)ast_read_u8();  /* param_count */
+        slot_count = ast_read_u8();
+        (void)ast_read_u16(); /* vreg_count */
+        (void)ast_read_u16(); /* label_count */
+        instr_count = ast_read_u16();
+        skip = (uint32_t)slot_count * IR_SLOT_BYTES +
+               (uint32_t)instr_count * IR_INSTR_BYTES;
+        return reader_seek(reader, reader_tell(reader) + skip);
+    }
+    return -1;
+}
+
+const char* ir_op_name(uint8_t op) {
+    static const char* const names[IR_OP_COUNT] = {
+        "nop", "const", "mov", "zext", "sext", "trunc",
+        "add", "sub", "mul", "div", "mod", "and", "or", "xor", "shl", "shr",
+        "neg", "not", "lnot",
+        "seq", "sne", "slt", "sle", "sgt", "sge",
+        "ldl", "stl", "ldg", "stg", "addrl", "addrg", "addrs",
+        "load", "store", "arg", "call", "ret",
+        "jmp", "bz", "bnz", "label"
+    };
+    if (op >= IR_OP_COUNT) return "?";
+    return names[op];
+}
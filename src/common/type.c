@@ -1,5 +1,6 @@
 #include "symbol.h"
 
+#include "cc_compat.h"
 #include "common.h"
 
 typedef void (*type_destroy_fn)(type_t* type);
@@ -17,7 +18,7 @@ static void type_destroy_array(type_t* type) {
 }
 
 type_t* type_create(type_kind_t kind) {
-    type_t* type = (type_t*)cc_malloc(sizeof(type_t));
+    type_t* type = (type_t*)cc_tree_alloc(sizeof(type_t));
     if (!type) return NULL;
 
     type->kind = kind;
@@ -53,7 +54,7 @@ type_t* type_create(type_kind_t kind) {
 }
 
 void type_destroy(type_t* type) {
-    if (!type) return;
+    if (!type || g_cc_tree_arena) return;
 
     {
         #define TYPE_KIND_COUNT ((uint8_t)TYPE_FUNCTION + 1)
@@ -81,7 +82,7 @@ void type_destroy(type_t* type) {
         #undef TYPE_KIND_COUNT
     }
 
-    cc_free(type);
+    cc_tree_free(type);
 }
 
 type_t* type_create_pointer(type_t* base) {
@@ -106,3 +107,25 @@ type_t* type_create_array(type_t* element, size_t length) {
     }
     return type;
 }
+
+type_t* type_clone(const type_t* type) {
+    type_t* copy = NULL;
+    if (!type) return NULL;
+    copy = (type_t*)cc_tree_alloc(sizeof(type_t));
+    if (!copy) return NULL;
+    mem_cpy(copy, type, sizeof(type_t));
+    if (type->kind == TYPE_POINTER) {
+        copy->data.pointer.base_type = type_clone(type->data.pointer.base_type);
+        if (type->data.pointer.base_type && !copy->data.pointer.base_type) {
+            cc_tree_free(copy);
+            return NULL;
+        }
+    } else if (type->kind == TYPE_ARRAY) {
+        copy->data.array.element_type = type_clone(type->data.array.element_type);
+        if (type->data.array.element_type && !copy->data.array.element_type) {
+            cc_tree_free(copy);
+            return NULL;
+        }
+    }
+    return copy;
+}
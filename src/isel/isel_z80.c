@@ -0,0 +1,978 @@
+#include "isel.h"
+
+#include "ast_io.h"
+#include "ast_reader.h"
+#include "cc_compat.h"
+#include "common.h"
+#include "ir.h"
+#include "target.h"
+
+#define ISEL_LABEL_MAX 15 /* Keep in sync with CODEGEN_LABEL_MAX */
+#define ISEL_LABEL_HASH_LEN 4
+#define ISEL_NO_SLOT 0x7FFF
+#define ISEL_SMALL_FRAME 6
+
+extern isel_t isel_ctx;
+static isel_t* isel;
+static char g_emit_buf[ISEL_LABEL_MAX + 1];
+static const char g_hex_digits[] = "0123456789abcdef";
+
+/* Output helpers */
+
+static void isel_emit(const char* text) {
+    uint16_t len = 0;
+    if (!text) return;
+    while (text[len]) len++;
+    if (len > 0) {
+        output_write(isel->output_handle, text, len);
+    }
+}
+
+static void isel_emit_hex(uint16_t value) {
+    char* buf = g_emit_buf;
+    *buf++ = '0';
+    *buf++ = 'x';
+    if (value > 0xFF) {
+        *buf++ = g_hex_digits[(value >> 12) & 0xF];
+        *buf++ = g_hex_digits[(value >> 8) & 0xF];
+    }
+    *buf++ = g_hex_digits[(value >> 4) & 0xF];
+    *buf++ = g_hex_digits[value & 0xF];
+    *buf = '\0';
+    isel_emit(g_emit_buf);
+}
+
+static void isel_emit_number_label(char prefix, uint16_t n) {
+    char* out = g_emit_buf;
+    *out++ = '_';
+    *out++ = prefix;
+    for (uint8_t pos = 0; pos < 6; pos++) {
+        out[5 - pos] = (char)('0' + n % 10);
+        n /= 10;
+    }
+    out[6] = '\0';
+    isel_emit(g_emit_buf);
+}
+
+/* Same truncation/hash scheme as codegen so runtime symbols resolve */
+static void isel_emit_symbol(const char* prefix, const char* name) {
+    uint16_t i = 0;
+    uint16_t hash = 0x811c;
+    bool need_hash = false;
+    char* out = g_emit_buf;
+    while (*prefix) {
+        *out++ = *prefix++;
+        i++;
+    }
+    for (uint16_t n = 0; name[n]; n++) {
+        char c = name[n];
+        if (c >= 'A' && c <= 'Z') {
+            c = (char)(c + ('a' - 'A'));
+        }
+        if (i < ISEL_LABEL_MAX) {
+            *out++ = c;
+        } else {
+            need_hash = true;
+        }
+        hash = (uint16_t)((hash * 33u) ^ (uint8_t)c);
+        i++;
+    }
+    if (need_hash) {
+        out = g_emit_buf + (ISEL_LABEL_MAX - 1 - ISEL_LABEL_HASH_LEN);
+        *out++ = '_';
+        for (int8_t shift = 12; shift >= 0; shift -= 4) {
+            *out++ = g_hex_digits[(hash >> shift) & 0xF];
+        }
+    }
+    *out = '\0';
+    isel_emit(g_emit_buf);
+}
+
+static void isel_emit_name(uint16_t name_index) {
+    const char* name = ast_reader_name(name_index);
+    if (name) isel_emit_symbol("", name);
+}
+
+static void isel_emit_var(uint16_t name_index) {
+    const char* name = ast_reader_name(name_index);
+    if (name) isel_emit_symbol("_v_", name);
+}
+
+static void isel_emit_string_label(uint16_t index) {
+    isel->strings_used[index >> 3] |= (uint8_t)(1u << (index & 7));
+    isel_emit_number_label('s', index);
+}
+
+static void isel_emit_label(uint16_t label) {
+    isel_emit_number_label('l', label);
+    isel_emit(":\n");
+}
+
+static void isel_emit_jump(const char* prefix, uint16_t label) {
+    isel_emit(prefix);
+    isel_emit_number_label('l', label);
+    isel_emit("\n");
+}
+
+static void isel_emit_ix(int16_t offset) {
+    isel_emit("(ix");
+    if (offset < 0) {
+        isel_emit("-");
+        isel_emit_hex((uint8_t)(-offset));
+    } else {
+        isel_emit("+");
+        isel_emit_hex((uint8_t)offset);
+    }
+    isel_emit(")");
+}
+
+static void isel_emit_ix_op(const char* prefix, int16_t offset, const char* suffix) {
+    isel_emit(prefix);
+    isel_emit_ix(offset);
+    isel_emit(suffix);
+}
+
+static void isel_emit_file(const char* path) {
+    reader_t* file = reader_open(path);
+    int16_t ch;
+    if (!file) {
+        cc_error("Failed to open runtime file");
+        return;
+    }
+    ch = reader_next(file);
+    while (ch >= 0) {
+        char c = (char)ch;
+        output_write(isel->output_handle, &c, 1);
+        ch = reader_next(file);
+    }
+    reader_close(file);
+}
+
+static void isel_emit_string_literal(const char* value) {
+    char c[2];
+    isel_emit("  .dm \"");
+    c[1] = '\0';
+    for (const char* p = value; *p; ++p) {
+        if (*p == '"') {
+            isel_emit("\\\"");
+        } else if (*p == '\\') {
+            isel_emit("\\\\");
+        } else if (*p == '\n') {
+            isel_emit("\\n");
+        } else {
+            c[0] = *p;
+            isel_emit(c);
+        }
+    }
+    isel_emit("\"\n");
+}
+
+static uint16_t isel_new_label(void) {
+    return isel->label_next++;
+}
+
+static uint16_t isel_label(uint16_t ir_label) {
+    return (uint16_t)(isel->label_base + ir_label);
+}
+
+/* Frame layout */
+
+static void isel_note_use(uint16_t reg) {
+    if (reg != IR_NONE && reg < isel->fn.vreg_count && isel->use_counts[reg] < 0xFF) {
+        isel->use_counts[reg]++;
+    }
+}
+
+/* A transient value is defined once and consumed only by the next
+ * instruction, so it stays in A/HL and never touches the frame. */
+static bool isel_is_transient(uint16_t reg, uint16_t def_index) {
+    uint16_t a;
+    uint16_t b;
+    const ir_function_t* fn = &isel->fn;
+    if (isel->def_counts[reg] != 1 || isel->use_counts[reg] != 1) return false;
+    if ((uint16_t)(def_index + 1u) >= fn->instr_count) return false;
+    ir_instr_operands(&fn->instrs[def_index + 1], &a, &b);
+    return a == reg || b == reg;
+}
+
+static cc_error_t isel_layout_frame(void) {
+    ir_function_t* fn = &isel->fn;
+    uint16_t vregs = fn->vreg_count;
+    uint16_t* first_def = NULL;
+    uint16_t* last_use = NULL;
+    uint16_t* label_pos = NULL;
+    uint16_t* temp_busy = NULL;
+    uint16_t temp_count = 0;
+    int16_t locals_size = 0;
+    cc_error_t err = CC_OK;
+    bool changed = true;
+
+    isel->vreg_offsets = NULL;
+    isel->use_counts = NULL;
+    isel->def_counts = NULL;
+    if (vregs > 0) {
+        isel->vreg_offsets = (int16_t*)cc_malloc(sizeof(int16_t) * vregs);
+        isel->use_counts = (uint8_t*)cc_malloc(vregs);
+        isel->def_counts = (uint8_t*)cc_malloc(vregs);
+        first_def = (uint16_t*)cc_malloc(sizeof(uint16_t) * vregs);
+        last_use = (uint16_t*)cc_malloc(sizeof(uint16_t) * vregs);
+        temp_busy = (uint16_t*)cc_malloc(sizeof(uint16_t) * vregs);
+        mem_set(isel->use_counts, 0, vregs);
+        mem_set(isel->def_counts, 0, vregs);
+    }
+    if (fn->label_count > 0) {
+        label_pos = (uint16_t*)cc_malloc(sizeof(uint16_t) * fn->label_count);
+    }
+
+    for (uint16_t v = 0; v < vregs; v++) {
+        isel->vreg_offsets[v] = ISEL_NO_SLOT;
+        first_def[v] = IR_NONE;
+        last_use[v] = 0;
+    }
+    for (uint16_t i = 0; i < fn->instr_count; i++) {
+        const ir_instr_t* ins = &fn->instrs[i];
+        uint16_t a;
+        uint16_t b;
+        if (ins->op == IR_LABEL && ins->a < fn->label_count) {
+            label_pos[ins->a] = i;
+        }
+        ir_instr_operands(ins, &a, &b);
+        isel_note_use(a);
+        isel_note_use(b);
+        if (a != IR_NONE && a < vregs) last_use[a] = i;
+        if (b != IR_NONE && b < vregs) last_use[b] = i;
+        if (ir_op_has_dst(ins->op) && ins->dst < vregs) {
+            if (isel->def_counts[ins->dst] < 0xFF) isel->def_counts[ins->dst]++;
+            if (first_def[ins->dst] == IR_NONE) first_def[ins->dst] = i;
+            if (last_use[ins->dst] < i) last_use[ins->dst] = i;
+        }
+    }
+
+    /* Values live across a loop back edge must survive the whole loop */
+    while (changed) {
+        changed = false;
+        for (uint16_t i = 0; i < fn->instr_count; i++) {
+            const ir_instr_t* ins = &fn->instrs[i];
+            uint16_t target;
+            if (ins->op == IR_JMP) {
+                target = ins->a;
+            } else if (ins->op == IR_BZ || ins->op == IR_BNZ) {
+                target = ins->b;
+            } else {
+                continue;
+            }
+            if (target >= fn->label_count || label_pos[target] > i) continue;
+            for (uint16_t v = 0; v < vregs; v++) {
+                if (first_def[v] < label_pos[target] && last_use[v] >= label_pos[target] &&
+                    last_use[v] < i) {
+                    last_use[v] = i;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    /* Named slots: locals grow down from IX, parameters sit above the
+     * saved IX and return address. */
+    for (uint8_t s = 0; s < fn->slot_count; s++) {
+        if (fn->slots[s].kind == IR_SLOT_PARAM) {
+            isel->slot_offsets[s] = (int16_t)(4 + 2 * s);
+        } else {
+            locals_size = (int16_t)(locals_size + fn->slots[s].size);
+            isel->slot_offsets[s] = (int16_t)-locals_size;
+        }
+    }
+
+    /* Temporaries share 2-byte frame cells by live range */
+    for (uint16_t i = 0; i < fn->instr_count; i++) {
+        const ir_instr_t* ins = &fn->instrs[i];
+        uint16_t v = ins->dst;
+        uint16_t cell;
+        if (!ir_op_has_dst(ins->op) || v >= vregs || first_def[v] != i) continue;
+        if (isel->use_counts[v] == 0 || isel_is_transient(v, i)) continue;
+        for (cell = 0; cell < temp_count; cell++) {
+            if (temp_busy[cell] < i) break;
+        }
+        if (cell == temp_count) temp_count++;
+        temp_busy[cell] = last_use[v];
+        isel->vreg_offsets[v] = (int16_t)(-locals_size - 2 * (int16_t)(cell + 1u));
+    }
+
+    isel->frame_size = (int16_t)(locals_size + 2 * (int16_t)temp_count);
+    if (isel->frame_size > 128 || (fn->param_count > 0 && 4 + 2 * fn->param_count > 128)) {
+        cc_error("Stack frame too large");
+        err = CC_ERROR_CODEGEN;
+    }
+    isel->has_frame = isel->frame_size > 0 || fn->param_count > 0;
+
+    if (first_def) cc_free(first_def);
+    if (last_use) cc_free(last_use);
+    if (temp_busy) cc_free(temp_busy);
+    if (label_pos) cc_free(label_pos);
+    return err;
+}
+
+static void isel_release_frame(void) {
+    if (isel->vreg_offsets) cc_free(isel->vreg_offsets);
+    if (isel->use_counts) cc_free(isel->use_counts);
+    if (isel->def_counts) cc_free(isel->def_counts);
+    isel->vreg_offsets = NULL;
+    isel->use_counts = NULL;
+    isel->def_counts = NULL;
+}
+
+/* Register cache */
+
+static void isel_forget(void) {
+    isel->reg_a = IR_NONE;
+    isel->reg_hl = IR_NONE;
+}
+
+static int16_t isel_vreg_offset(uint16_t reg) {
+    int16_t offset = isel->vreg_offsets[reg];
+    if (offset == ISEL_NO_SLOT) {
+        cc_error("Internal error: value not available");
+    }
+    return offset;
+}
+
+static void isel_load_a(uint16_t reg) {
+    if (isel->reg_a == reg) return;
+    isel_emit_ix_op("  ld a, ", isel_vreg_offset(reg), "\n");
+    isel->reg_a = reg;
+}
+
+static void isel_load_hl(uint16_t reg) {
+    int16_t offset;
+    if (isel->reg_hl == reg) return;
+    offset = isel_vreg_offset(reg);
+    isel_emit_ix_op("  ld l, ", offset, "\n");
+    isel_emit_ix_op("  ld h, ", (int16_t)(offset + 1), "\n");
+    isel->reg_hl = reg;
+}
+
+static void isel_load(uint16_t reg, bool is_16) {
+    if (is_16) {
+        isel_load_hl(reg);
+    } else {
+        isel_load_a(reg);
+    }
+}
+
+/* a -> A, b -> L */
+static void isel_load_pair8(uint16_t a, uint16_t b) {
+    if (isel->reg_a == b && a != b) {
+        isel_emit("  ld l, a\n");
+        isel->reg_hl = IR_NONE;
+        isel->reg_a = IR_NONE;
+        isel_load_a(a);
+        return;
+    }
+    isel_load_a(a);
+    if (a == b) {
+        isel_emit("  ld l, a\n");
+    } else {
+        isel_emit_ix_op("  ld l, ", isel_vreg_offset(b), "\n");
+    }
+    isel->reg_hl = IR_NONE;
+}
+
+/* a -> HL, b -> DE */
+static void isel_load_pair16(uint16_t a, uint16_t b) {
+    if (isel->reg_hl == b && a != b) {
+        isel_emit("  ex de, hl\n");
+        isel->reg_hl = IR_NONE;
+        isel_load_hl(a);
+        return;
+    }
+    isel_load_hl(a);
+    if (a == b) {
+        isel_emit(
+            "  ld d, h\n"
+            "  ld e, l\n");
+    } else {
+        int16_t offset = isel_vreg_offset(b);
+        isel_emit_ix_op("  ld e, ", offset, "\n");
+        isel_emit_ix_op("  ld d, ", (int16_t)(offset + 1), "\n");
+    }
+}
+
+/* Record that the result of instruction `index` is in A or HL */
+static void isel_result(uint16_t index, bool is_16) {
+    uint16_t reg = isel->fn.instrs[index].dst;
+    int16_t offset;
+    if (reg >= isel->fn.vreg_count) return;
+    if (is_16) {
+        isel->reg_hl = reg;
+        isel->reg_a = IR_NONE;
+    } else {
+        isel->reg_a = reg;
+    }
+    offset = isel->vreg_offsets[reg];
+    if (offset == ISEL_NO_SLOT) return;
+    if (is_16) {
+        isel_emit_ix_op("  ld ", offset, ", l\n");
+        isel_emit_ix_op("  ld ", (int16_t)(offset + 1), ", h\n");
+    } else {
+        isel_emit_ix_op("  ld ", offset, ", a\n");
+    }
+}
+
+/* Instruction emission */
+
+static const char* isel_invert_condition(const char* cc) {
+    static const char* const pairs[][2] = {
+        { "z", "nz" }, { "c", "nc" }, { "m", "p" }
+    };
+    for (uint8_t i = 0; i < DIM(pairs); i++) {
+        if (str_cmp(pairs[i][0], cc) == 0) return pairs[i][1];
+        if (str_cmp(pairs[i][1], cc) == 0) return pairs[i][0];
+    }
+    return cc;
+}
+
+/* Emits a compare and returns the condition code that holds when it is true */
+static const char* isel_emit_compare(const ir_instr_t* ins) {
+    bool is_16 = (ins->flags & IR_F_16) != 0;
+    bool is_signed = (ins->flags & IR_F_SIGNED) != 0;
+    uint16_t a = ins->a;
+    uint16_t b = ins->b;
+    uint8_t op = ins->op;
+    if (op == IR_SGT || op == IR_SLE) {
+        uint16_t tmp = a;
+        a = b;
+        b = tmp;
+        op = (op == IR_SGT) ? IR_SLT : IR_SGE;
+    }
+    if (is_16) {
+        isel_load_pair16(a, b);
+        isel_emit(
+            "  or a\n"
+            "  sbc hl, de\n");
+    } else {
+        isel_load_pair8(a, b);
+        isel_emit((op == IR_SEQ || op == IR_SNE || !is_signed) ? "  cp l\n" : "  sub l\n");
+    }
+    isel_forget();
+    if (op == IR_SEQ) return "z";
+    if (op == IR_SNE) return "nz";
+    if (!is_signed) return op == IR_SLT ? "c" : "nc";
+    {
+        uint16_t skip = isel_new_label();
+        isel_emit_jump("  jp po, ", skip);
+        if (is_16) {
+            isel_emit("  ld a, h\n");
+        }
+        isel_emit("  xor 0x80\n");
+        isel_emit_label(skip);
+    }
+    return op == IR_SLT ? "m" : "p";
+}
+
+static void isel_emit_set_condition(const char* cc) {
+    uint16_t done = isel_new_label();
+    bool short_jump = cc[0] != 'm' && cc[0] != 'p';
+    isel_emit("  ld a, 0\n");
+    isel_emit(short_jump ? "  jr " : "  jp ");
+    isel_emit(isel_invert_condition(cc));
+    isel_emit_jump(", ", done);
+    isel_emit("  inc a\n");
+    isel_emit_label(done);
+}
+
+static void isel_emit_shift(bool is_16, bool left, bool is_signed) {
+    uint16_t loop = isel_new_label();
+    uint16_t test = isel_new_label();
+    isel_emit(is_16 ? "  ld b, e\n" : "  ld b, l\n");
+    isel_emit("  inc b\n");
+    isel_emit_jump("  jr ", test);
+    isel_emit_label(loop);
+    if (is_16) {
+        if (left) {
+            isel_emit("  add hl, hl\n");
+        } else {
+            isel_emit(is_signed ? "  sra h\n" : "  srl h\n");
+            isel_emit("  rr l\n");
+        }
+    } else {
+        if (left) {
+            isel_emit("  add a, a\n");
+        } else {
+            isel_emit(is_signed ? "  sra a\n" : "  srl a\n");
+        }
+    }
+    isel_emit_label(test);
+    isel_emit_jump("  djnz ", loop);
+}
+
+static void isel_emit_binary(const ir_instr_t* ins) {
+    bool is_16 = (ins->flags & IR_F_16) != 0;
+    static const char* const ops8[] = {
+        "  add a, l\n", "  sub l\n", "  call __mul_a_l\n", "  call __div_a_l\n",
+        "  call __mod_a_l\n", "  and l\n", "  or l\n", "  xor l\n"
+    };
+    static const char* const ops16[] = {
+        "  add hl, de\n",
+        "  or a\n"
+        "  sbc hl, de\n",
+        "  call __mul_hl_de\n",
+        "  call __div_hl_de\n",
+        "  call __mod_hl_de\n",
+        "  ld a, h\n"
+        "  and d\n"
+        "  ld h, a\n"
+        "  ld a, l\n"
+        "  and e\n"
+        "  ld l, a\n",
+        "  ld a, h\n"
+        "  or d\n"
+        "  ld h, a\n"
+        "  ld a, l\n"
+        "  or e\n"
+        "  ld l, a\n",
+        "  ld a, h\n"
+        "  xor d\n"
+        "  ld h, a\n"
+        "  ld a, l\n"
+        "  xor e\n"
+        "  ld l, a\n"
+    };
+    if (is_16) {
+        isel_load_pair16(ins->a, ins->b);
+    } else {
+        isel_load_pair8(ins->a, ins->b);
+    }
+    if (ins->op == IR_SHL || ins->op == IR_SHR) {
+        isel_emit_shift(is_16, ins->op == IR_SHL, (ins->flags & IR_F_SIGNED) != 0);
+    } else {
+        uint8_t index = (uint8_t)(ins->op - IR_ADD);
+        isel_emit(is_16 ? ops16[index] : ops8[index]);
+    }
+    isel_forget();
+}
+
+static void isel_emit_store(const ir_instr_t* ins) {
+    bool is_16 = (ins->flags & IR_F_16) != 0;
+    if (!is_16) {
+        if (isel->reg_a == ins->b) {
+            isel_load_hl(ins->a);
+        } else {
+            isel_load_hl(ins->a);
+            isel_load_a(ins->b);
+        }
+        isel_emit("  ld (hl), a\n");
+    } else {
+        isel_load_pair16(ins->a, ins->b);
+        isel_emit(
+            "  ld (hl), e\n"
+            "  inc hl\n"
+            "  ld (hl), d\n");
+    }
+    isel_forget();
+}
+
+static void isel_emit_slot_address(int16_t offset) {
+    isel_emit("  push ix\n  pop hl\n");
+    if (offset != 0) {
+        isel_emit("  ld de, ");
+        isel_emit_hex((uint16_t)offset);
+        isel_emit("\n  add hl, de\n");
+    }
+}
+
+/* Emits instruction `i`; returns the number of instructions consumed */
+static uint8_t isel_instruction(uint16_t i) {
+    const ir_function_t* fn = &isel->fn;
+    const ir_instr_t* ins = &fn->instrs[i];
+    bool is_16 = (ins->flags & IR_F_16) != 0;
+    switch (ins->op) {
+        case IR_NOP:
+            return 1;
+        case IR_CONST:
+            if (is_16) {
+                isel_emit("  ld hl, ");
+                isel_emit_hex(ins->a);
+            } else if ((uint8_t)ins->a == 0) {
+                isel_emit("  xor a");
+            } else {
+                isel_emit("  ld a, ");
+                isel_emit_hex((uint8_t)ins->a);
+            }
+            isel_emit("\n");
+            isel_result(i, is_16);
+            return 1;
+        case IR_MOV:
+            isel_load(ins->a, is_16);
+            isel_result(i, is_16);
+            return 1;
+        case IR_ZEXT:
+        case IR_SEXT:
+            isel_load_a(ins->a);
+            isel_emit(ins->op == IR_ZEXT
+                ? "  ld l, a\n"
+                  "  ld h, 0\n"
+                : "  ld l, a\n"
+                  "  add a, a\n"
+                  "  sbc a, a\n"
+                  "  ld h, a\n");
+            if (ins->op == IR_SEXT) isel->reg_a = IR_NONE;
+            isel_result(i, true);
+            return 1;
+        case IR_TRUNC:
+            isel_load_hl(ins->a);
+            isel_emit("  ld a, l\n");
+            isel_result(i, false);
+            return 1;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_AND: case IR_OR: case IR_XOR: case IR_SHL: case IR_SHR:
+            isel_emit_binary(ins);
+            isel_result(i, is_16);
+            return 1;
+        case IR_NEG:
+        case IR_NOT:
+            isel_load(ins->a, is_16);
+            if (!is_16) {
+                isel_emit(ins->op == IR_NEG ? "  neg\n" : "  cpl\n");
+            } else if (ins->op == IR_NEG) {
+                isel_emit(
+                    "  xor a\n"
+                    "  sub l\n"
+                    "  ld l, a\n"
+                    "  sbc a, a\n"
+                    "  sub h\n"
+                    "  ld h, a\n");
+            } else {
+                isel_emit(
+                    "  ld a, h\n"
+                    "  cpl\n"
+                    "  ld h, a\n"
+                    "  ld a, l\n"
+                    "  cpl\n"
+                    "  ld l, a\n");
+            }
+            isel_forget();
+            isel_result(i, is_16);
+            return 1;
+        case IR_LNOT:
+            isel_load(ins->a, is_16);
+            isel_emit(is_16 ? "  ld a, h\n  or l\n" : "  or a\n");
+            isel_forget();
+            isel_emit_set_condition("z");
+            isel_result(i, false);
+            return 1;
+        case IR_SEQ: case IR_SNE: case IR_SLT: case IR_SLE: case IR_SGT: case IR_SGE: {
+            const char* cc = isel_emit_compare(ins);
+            if ((uint16_t)(i + 1u) < fn->instr_count &&
+                isel->vreg_offsets[ins->dst] == ISEL_NO_SLOT) {
+                const ir_instr_t* next = &fn->instrs[i + 1];
+                if ((next->op == IR_BZ || next->op == IR_BNZ) && next->a == ins->dst) {
+                    /* Fuse compare + branch */
+                    isel_emit("  jp ");
+                    isel_emit(next->op == IR_BNZ ? cc : isel_invert_condition(cc));
+                    isel_emit_jump(", ", isel_label(next->b));
+                    return 2;
+                }
+            }
+            isel_emit_set_condition(cc);
+            isel_result(i, false);
+            return 1;
+        }
+        case IR_LDL: {
+            int16_t offset = isel->slot_offsets[ins->a];
+            if (is_16) {
+                isel_emit_ix_op("  ld l, ", offset, "\n");
+                isel_emit_ix_op("  ld h, ", (int16_t)(offset + 1), "\n");
+            } else {
+                isel_emit_ix_op("  ld a, ", offset, "\n");
+            }
+            isel_result(i, is_16);
+            return 1;
+        }
+        case IR_STL: {
+            int16_t offset = isel->slot_offsets[ins->a];
+            isel_load(ins->b, is_16);
+            if (is_16) {
+                isel_emit_ix_op("  ld ", offset, ", l\n");
+                isel_emit_ix_op("  ld ", (int16_t)(offset + 1), ", h\n");
+            } else {
+                isel_emit_ix_op("  ld ", offset, ", a\n");
+            }
+            return 1;
+        }
+        case IR_LDG:
+            isel_emit(is_16 ? "  ld hl, (" : "  ld a, (");
+            isel_emit_var(ins->a);
+            isel_emit(")\n");
+            isel_result(i, is_16);
+            return 1;
+        case IR_STG:
+            isel_load(ins->b, is_16);
+            isel_emit("  ld (");
+            isel_emit_var(ins->a);
+            isel_emit(is_16 ? "), hl\n" : "), a\n");
+            return 1;
+        case IR_ADDRL:
+            isel_emit_slot_address(isel->slot_offsets[ins->a]);
+            isel_result(i, true);
+            return 1;
+        case IR_ADDRG:
+        case IR_ADDRS:
+            isel_emit("  ld hl, ");
+            if (ins->op == IR_ADDRG) {
+                isel_emit_var(ins->a);
+            } else {
+                isel_emit_string_label(ins->a);
+            }
+            isel_emit("\n");
+            isel_result(i, true);
+            return 1;
+        case IR_LOAD:
+            isel_load_hl(ins->a);
+            isel_emit(is_16
+                ? "  ld a, (hl)\n"
+                  "  inc hl\n"
+                  "  ld h, (hl)\n"
+                  "  ld l, a\n"
+                : "  ld a, (hl)\n");
+            isel_forget();
+            isel_result(i, is_16);
+            return 1;
+        case IR_STORE:
+            isel_emit_store(ins);
+            return 1;
+        case IR_ARG:
+            if (is_16) {
+                isel_load_hl(ins->a);
+            } else {
+                isel_load_a(ins->a);
+                isel_emit("  ld l, a\n  ld h, 0\n");
+                isel->reg_hl = IR_NONE;
+            }
+            isel_emit("  push hl\n");
+            return 1;
+        case IR_CALL:
+            isel_emit("  call ");
+            isel_emit_name(ins->a);
+            isel_emit("\n");
+            for (uint16_t n = 0; n < ins->b; n++) {
+                isel_emit("  pop bc\n");
+            }
+            isel_forget();
+            isel_result(i, is_16);
+            return 1;
+        case IR_RET:
+            if (ins->a != IR_NONE) {
+                isel_load(ins->a, is_16);
+            }
+            if ((uint16_t)(i + 1u) < fn->instr_count) {
+                if (isel->has_frame) {
+                    isel_emit_jump("  jp ", isel->end_label);
+                } else {
+                    isel_emit("  ret\n");
+                }
+            }
+            return 1;
+        case IR_JMP:
+            if ((uint16_t)(i + 1u) < fn->instr_count &&
+                fn->instrs[i + 1].op == IR_LABEL && fn->instrs[i + 1].a == ins->a) {
+                return 1;
+            }
+            isel_emit_jump("  jp ", isel_label(ins->a));
+            return 1;
+        case IR_BZ:
+        case IR_BNZ:
+            isel_load(ins->a, is_16);
+            if (is_16) {
+                isel_emit("  ld a, h\n  or l\n");
+                isel->reg_a = IR_NONE;
+            } else {
+                isel_emit("  or a\n");
+            }
+            isel_emit_jump(ins->op == IR_BZ ? "  jp z, " : "  jp nz, ", isel_label(ins->b));
+            return 1;
+        case IR_LABEL:
+            isel_forget();
+            isel_emit_label(isel_label(ins->a));
+            return 1;
+        default:
+            cc_error("Unsupported IR op");
+            return 0;
+    }
+}
+
+static cc_error_t isel_function(void) {
+    ir_function_t* fn = &isel->fn;
+    cc_error_t err;
+    if (ir_read_function(fn) < 0) return CC_ERROR_CODEGEN;
+    err = isel_layout_frame();
+    if (err != CC_OK) goto function_cleanup;
+
+    isel->label_base = isel->label_next;
+    isel->label_next = (uint16_t)(isel->label_next + fn->label_count);
+    isel->end_label = isel_new_label();
+    isel_forget();
+
+    isel_emit_name(fn->name_index);
+    isel_emit(":\n");
+    if (isel->has_frame) {
+        isel_emit(
+            "  push ix\n"
+            "  ld ix, 0\n"
+            "  add ix, sp\n");
+        if (isel->frame_size > 0 && isel->frame_size <= ISEL_SMALL_FRAME) {
+            for (int16_t n = isel->frame_size; n >= 2; n -= 2) {
+                isel_emit("  push hl\n");
+            }
+            if (isel->frame_size & 1) {
+                isel_emit("  dec sp\n");
+            }
+        } else if (isel->frame_size > 0) {
+            isel_emit("  ld hl, ");
+            isel_emit_hex((uint16_t)-isel->frame_size);
+            isel_emit(
+                "\n"
+                "  add hl, sp\n"
+                "  ld sp, hl\n");
+        }
+    }
+
+    for (uint16_t i = 0; i < fn->instr_count;) {
+        uint8_t used = isel_instruction(i);
+        if (used == 0) {
+            err = CC_ERROR_CODEGEN;
+            goto function_cleanup;
+        }
+        i = (uint16_t)(i + used);
+    }
+
+    if (isel->has_frame) {
+        isel_emit_label(isel->end_label);
+        isel_emit(
+            "  ld sp, ix\n"
+            "  pop ix\n");
+    }
+    isel_emit("  ret\n\n");
+    err = CC_OK;
+
+function_cleanup:
+    isel_release_frame();
+    ir_function_free(fn);
+    return err;
+}
+
+static void isel_global(void) {
+    ir_global_t global;
+    ir_read_global(&global);
+    isel_emit_var(global.name_index);
+    isel_emit(":\n");
+    switch (global.kind) {
+        case IR_GLOBAL_BYTE:
+            isel_emit("  .db ");
+            isel_emit_hex((uint8_t)global.init);
+            break;
+        case IR_GLOBAL_WORD:
+            isel_emit("  .dw ");
+            isel_emit_hex(global.init);
+            break;
+        case IR_GLOBAL_SPACE:
+            isel_emit("  .ds ");
+            isel_emit_hex(global.size);
+            break;
+        case IR_GLOBAL_STRING: {
+            const char* value = ast_reader_string(global.init);
+            uint16_t len = value ? (uint16_t)str_len(value) : 0;
+            isel_emit_string_literal(value ? value : "");
+            isel_emit("  .db 0");
+            if ((uint16_t)(len + 1u) < global.size) {
+                isel_emit("\n  .ds ");
+                isel_emit_hex((uint16_t)(global.size - len - 1u));
+            }
+            break;
+        }
+        case IR_GLOBAL_ADDR_STRING:
+            isel_emit("  .dw ");
+            isel_emit_string_label(global.init);
+            break;
+        case IR_GLOBAL_ADDR_VAR:
+            isel_emit("  .dw ");
+            isel_emit_var(global.init);
+            break;
+        default:
+            break;
+    }
+    isel_emit("\n");
+}
+
+isel_t* isel_create(const char* output_file) {
+    isel = &isel_ctx;
+    mem_set(isel, 0, sizeof(*isel));
+    isel->output_handle = output_open(output_file);
+#ifdef __SDCC
+    if (isel->output_handle < 0) {
+#else
+    if (!isel->output_handle) {
+#endif
+        return NULL;
+    }
+    return isel;
+}
+
+void isel_destroy(isel_t* s) {
+    if (!s) return;
+    if (s->strings_used) {
+        cc_free(s->strings_used);
+        s->strings_used = NULL;
+    }
+    if (s->output_handle) {
+        output_close(s->output_handle);
+    }
+}
+
+cc_error_t isel_generate_stream(void) {
+    ir_header_t* header = &isel->header;
+    if (ir_read_header(header) < 0) return CC_ERROR_CODEGEN;
+    ast->string_count = header->string_count;
+    ast->string_table_offset = header->string_table_offset;
+    if (ast_reader_load_strings() < 0) return CC_ERROR_CODEGEN;
+    isel->strings_used = (uint8_t*)cc_malloc((size_t)(header->string_count / 8u + 1u));
+    mem_set(isel->strings_used, 0, (size_t)(header->string_count / 8u + 1u));
+
+    isel_emit_file("runtime/crt0.asm");
+    isel_emit("\n; Program code\n");
+
+    /* Code first, then data, mirroring cc_codegen's layout */
+    if (ir_seek_records(header) < 0) return CC_ERROR_CODEGEN;
+    for (uint16_t i = 0; i < header->record_count; i++) {
+        uint8_t kind = ir_read_record_kind();
+        if (kind == IR_REC_FUNCTION) {
+            cc_error_t err = isel_function();
+            if (err != CC_OK) return err;
+        } else if (ir_skip_record(kind) < 0) {
+            return CC_ERROR_CODEGEN;
+        }
+    }
+    if (ir_seek_records(header) < 0) return CC_ERROR_CODEGEN;
+    for (uint16_t i = 0; i < header->record_count; i++) {
+        uint8_t kind = ir_read_record_kind();
+        if (kind == IR_REC_GLOBAL) {
+            isel_global();
+        } else if (ir_skip_record(kind) < 0) {
+            return CC_ERROR_CODEGEN;
+        }
+    }
+
+    isel_emit("\n; String literals\n");
+    for (uint16_t i = 0; i < header->string_count; i++) {
+        const char* value;
+        if (!(isel->strings_used[i >> 3] & (1u << (i & 7)))) continue;
+        value = ast_reader_string(i);
+        isel_emit_number_label('s', i);
+        isel_emit(":\n");
+        isel_emit_string_literal(value ? value : "");
+        isel_emit("  .db 0\n");
+    }
+    isel_emit_file("runtime/zeal8bit.asm");
+    isel_emit_file("runtime/math_8.asm");
+    isel_emit_file("runtime/math_16.asm");
+    return CC_OK;
+}
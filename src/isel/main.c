@@ -0,0 +1,74 @@
+#include "ast_io.h"
+#include "ast_reader.h"
+#include "cc_compat.h"
+#include "common.h"
+#include "isel.h"
+#include "target.h"
+
+static const char ISEL_MSG_USAGE[] = "Usage: cc_isel <input.ir> <output.asm>\n";
+static const char ISEL_MSG_FAILED_OPEN_OUTPUT[] = "Failed to open output file\n";
+static const char ISEL_MSG_FAILED[] = "Instruction selection failed\n";
+
+reader_t* reader;
+ast_reader_t* ast;
+ast_reader_t ast_ctx;
+isel_t isel_ctx;
+static isel_t* isel_handle;
+
+static void cleanup(void) {
+    isel_destroy(isel_handle);
+    ast_reader_destroy();
+    reader_close(reader);
+}
+
+static void handle_error(char* msg) {
+    log_error(msg);
+    cleanup();
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    int8_t err = 1;
+    args_t args;
+    cc_error_t result;
+
+    ast = &ast_ctx;
+    mem_set(ast, 0, sizeof(ast_ctx));
+    cc_init_pool_default();
+
+    args = parse_args(argc, argv, ARG_MODE_IN_OUT);
+    if (args.error) {
+        log_error(ISEL_MSG_USAGE);
+        return 1;
+    }
+
+    reader = reader_open(args.input_file);
+    if (!reader) return 1;
+
+    ast_read_handler(handle_error, "Failed to read IR\n");
+    isel_handle = isel_create(args.output_file);
+    if (!isel_handle) {
+        log_error(ISEL_MSG_FAILED_OPEN_OUTPUT);
+        goto cleanup;
+    }
+
+    result = isel_generate_stream();
+    if (result != CC_OK) {
+        log_error(ISEL_MSG_FAILED);
+        goto cleanup;
+    }
+
+    log_msg(args.input_file);
+    log_msg(" -> ");
+    log_msg(args.output_file);
+    log_msg("\n");
+
+    err = 0;
+
+cleanup:
+    cleanup();
+#if CC_STATS
+    if (args.stats) cc_stats_print("cc_isel");
+#endif
+    return err;
+}
@@ -0,0 +1,1113 @@
+#include "lower.h"
+
+#include "ast_format.h"
+#include "ast_io.h"
+#include "ast_reader.h"
+#include "cc_compat.h"
+#include "common.h"
+#include "ir.h"
+#include "parser.h"
+#include "target.h"
+
+/* Expression values: a virtual register plus enough type information to
+ * pick widths, sign handling and pointer scaling. */
+typedef struct {
+    uint16_t reg;
+    uint8_t flags;       /* IR_F_16 | IR_F_SIGNED */
+    uint8_t elem_size;   /* non-zero when the value is a pointer */
+    bool elem_signed;
+    bool is_const;       /* produced by the most recent IR_CONST */
+    int16_t value;
+} lower_value_t;
+
+enum {
+    LOWER_LV_SLOT = 0,
+    LOWER_LV_GLOBAL,
+    LOWER_LV_MEM
+};
+
+/* Assignable location */
+typedef struct {
+    uint8_t kind;
+    uint16_t ref;        /* slot index, global name index or address vreg */
+    uint8_t flags;
+    uint8_t elem_size;
+    bool elem_signed;
+} lower_lvalue_t;
+
+static cc_error_t lower_expression_tag(uint8_t tag, lower_value_t* out);
+static cc_error_t lower_statement_tag(uint8_t tag);
+static cc_error_t lower_branch(uint8_t tag, bool when_true, uint16_t label);
+
+extern lower_t lower_ctx;
+static lower_t* lower;
+
+#define LOWER_EMIT(op, flags, dst, a, b)                                   \
+    do {                                                                   \
+        if (ir_emit(&lower->fn, (op), (flags), (dst), (a), (b)) < 0) {     \
+            cc_error("IR buffer overflow");                                \
+            return CC_ERROR_CODEGEN;                                       \
+        }                                                                  \
+    } while (0)
+
+/* Helpers */
+
+static uint8_t lower_base_type(uint8_t base) {
+    return (uint8_t)(base & AST_BASE_MASK);
+}
+
+static uint8_t lower_type_size(uint8_t base, uint8_t depth) {
+    base = lower_base_type(base);
+    if (depth > 0) return 2;
+    if (base == AST_BASE_CHAR) return 1;
+    if (base == AST_BASE_INT) return 2;
+    return 0;
+}
+
+static bool lower_type_is_16bit(uint8_t base, uint8_t depth) {
+    if (depth > 0) return true;
+    return lower_base_type(base) == AST_BASE_INT;
+}
+
+static uint8_t lower_var_flags(uint8_t base, uint8_t depth, uint16_t array_len,
+                               uint8_t* out_elem_size) {
+    bool is_array = array_len > 0;
+    bool is_pointer = !is_array && depth > 0;
+    bool is_signed = (base & AST_BASE_FLAG_UNSIGNED) == 0;
+    uint8_t flags = 0;
+    uint8_t elem_size = 0;
+    if (is_array) {
+        elem_size = lower_type_size(base, depth);
+        flags |= LOWER_VAR_IS_ARRAY;
+    } else {
+        if (lower_type_is_16bit(base, depth)) flags |= LOWER_VAR_IS_16;
+        if (is_pointer) {
+            elem_size = lower_type_size(base, (uint8_t)(depth - 1));
+            flags |= LOWER_VAR_IS_POINTER;
+        }
+    }
+    if (is_signed) {
+        flags |= LOWER_VAR_IS_SIGNED | LOWER_VAR_ELEM_SIGNED;
+    }
+    /* Pointers of pointers have 16-bit unsigned elements */
+    if ((is_array && depth > 0) || (is_pointer && depth > 1)) {
+        flags &= (uint8_t)~LOWER_VAR_ELEM_SIGNED;
+    }
+    *out_elem_size = elem_size;
+    return flags;
+}
+
+static const lower_var_t* lower_find_local(uint16_t name_index) {
+    for (lower_var_count_t i = 0; i < lower->local_count; i++) {
+        if (lower->locals[i].name_index == name_index) return &lower->locals[i];
+    }
+    return NULL;
+}
+
+static const lower_var_t* lower_find_global(uint16_t name_index) {
+    for (uint16_t i = 0; i < lower->global_count; i++) {
+        if (lower->globals[i].name_index == name_index) return &lower->globals[i];
+    }
+    return NULL;
+}
+
+static const lower_var_t* lower_find_var(uint16_t name_index) {
+    const lower_var_t* var = lower_find_local(name_index);
+    return var ? var : lower_find_global(name_index);
+}
+
+static bool lower_function_return_is_16bit(uint16_t name_index) {
+    for (uint16_t i = 0; i < lower->function_count; i++) {
+        uint16_t flags = lower->function_return_flags[i];
+        if ((uint16_t)(flags & 0x7FFFu) == name_index) {
+            return (flags & 0x8000u) != 0;
+        }
+    }
+    return false;
+}
+
+static void lower_register_function(uint16_t name_index, bool is_16bit) {
+    if (lower->function_count >= lower->decl_capacity) return;
+    lower->function_return_flags[lower->function_count++] =
+        (uint16_t)((name_index & 0x7FFFu) | (is_16bit ? 0x8000u : 0));
+}
+
+static int8_t lower_add_slot(uint16_t name_index, uint8_t kind, uint16_t size,
+                             uint8_t flags, uint8_t elem_size) {
+    ir_function_t* fn = &lower->fn;
+    lower_var_t* var;
+    if (lower_find_local(name_index)) return 0;
+    if (fn->slot_count >= IR_MAX_SLOTS) {
+        cc_error("Too many locals");
+        return -1;
+    }
+    fn->slots[fn->slot_count].name_index = name_index;
+    fn->slots[fn->slot_count].kind = kind;
+    fn->slots[fn->slot_count].size = size;
+    var = &lower->locals[lower->local_count++];
+    var->name_index = name_index;
+    var->slot = fn->slot_count;
+    var->flags = flags;
+    var->elem_size = elem_size;
+    fn->slot_count++;
+    return 0;
+}
+
+static uint16_t lower_named_label(uint16_t name_index) {
+    for (uint8_t i = 0; i < lower->named_label_count; i++) {
+        if (lower->named_label_names[i] == name_index) {
+            return lower->named_label_ids[i];
+        }
+    }
+    if (lower->named_label_count >= DIM(lower->named_label_names)) {
+        cc_error("Too many labels");
+        return IR_NONE;
+    }
+    lower->named_label_names[lower->named_label_count] = name_index;
+    lower->named_label_ids[lower->named_label_count] = ir_new_label(&lower->fn);
+    return lower->named_label_ids[lower->named_label_count++];
+}
+
+static void lower_value_init(lower_value_t* v, uint16_t reg, uint8_t flags) {
+    v->reg = reg;
+    v->flags = flags;
+    v->elem_size = 0;
+    v->elem_signed = false;
+    v->is_const = false;
+    v->value = 0;
+}
+
+static cc_error_t lower_const(lower_value_t* out, int16_t value, bool is_16) {
+    uint16_t reg = ir_new_vreg(&lower->fn);
+    uint8_t flags = is_16 ? IR_F_16 : 0;
+    if (value <= 127) flags |= IR_F_SIGNED;
+    LOWER_EMIT(IR_CONST, flags & IR_F_16, reg, (uint16_t)value, 0);
+    lower_value_init(out, reg, flags);
+    out->is_const = true;
+    out->value = value;
+    return CC_OK;
+}
+
+/* Folds `left op right` when both operands are constants. Arithmetic is
+ * done at int width, so 0xFF + 1 is 0x100 rather than an 8-bit wrap. */
+static bool lower_fold(uint8_t op, const lower_value_t* left, const lower_value_t* right,
+                       int16_t* result) {
+    int16_t l = left->value;
+    int16_t r = right->value;
+    ir_function_t* fn = &lower->fn;
+    if (!left->is_const || !right->is_const || fn->instr_count < 2) return false;
+    if (fn->instrs[fn->instr_count - 2].dst != left->reg ||
+        fn->instrs[fn->instr_count - 1].dst != right->reg) {
+        return false;
+    }
+    switch (op) {
+        case OP_ADD: *result = (int16_t)(l + r); break;
+        case OP_SUB: *result = (int16_t)(l - r); break;
+        case OP_MUL: *result = (int16_t)(l * r); break;
+        case OP_DIV:
+            if (r == 0) return false;
+            *result = (int16_t)(l / r);
+            break;
+        case OP_MOD:
+            if (r == 0) return false;
+            *result = (int16_t)(l % r);
+            break;
+        case OP_AND: *result = (int16_t)(l & r); break;
+        case OP_OR: *result = (int16_t)(l | r); break;
+        case OP_XOR: *result = (int16_t)(l ^ r); break;
+        case OP_SHL: *result = (int16_t)((uint16_t)l << (r & 15)); break;
+        case OP_SHR: *result = (int16_t)(l >> (r & 15)); break;
+        case OP_EQ: *result = l == r; break;
+        case OP_NE: *result = l != r; break;
+        case OP_LT: *result = l < r; break;
+        case OP_LE: *result = l <= r; break;
+        case OP_GT: *result = l > r; break;
+        case OP_GE: *result = l >= r; break;
+        default: return false;
+    }
+    /* Both constants were the last two instructions; drop them */
+    fn->instr_count = (uint16_t)(fn->instr_count - 2);
+    return true;
+}
+
+/* Widen or narrow a value; widening follows the value's signedness */
+static cc_error_t lower_convert(lower_value_t* v, bool to_16) {
+    bool is_16 = (v->flags & IR_F_16) != 0;
+    uint16_t reg;
+    if (is_16 == to_16) return CC_OK;
+    if (v->is_const && lower->fn.instr_count > 0 &&
+        lower->fn.instrs[lower->fn.instr_count - 1].dst == v->reg) {
+        /* Re-emit a just-materialized constant at the new width */
+        ir_instr_t* ins = &lower->fn.instrs[lower->fn.instr_count - 1];
+        ins->flags = to_16 ? IR_F_16 : 0;
+        ins->a = to_16 ? (uint16_t)v->value : (uint8_t)v->value;
+        v->flags = (uint8_t)(to_16 ? (v->flags | IR_F_16) : (v->flags & ~IR_F_16));
+        return CC_OK;
+    }
+    reg = ir_new_vreg(&lower->fn);
+    if (to_16) {
+        LOWER_EMIT((v->flags & IR_F_SIGNED) ? IR_SEXT : IR_ZEXT, IR_F_16, reg, v->reg, 0);
+        v->flags |= IR_F_16;
+    } else {
+        LOWER_EMIT(IR_TRUNC, 0, reg, v->reg, 0);
+        v->flags &= (uint8_t)~IR_F_16;
+        v->elem_size = 0;
+    }
+    v->reg = reg;
+    return CC_OK;
+}
+
+static bool lower_is_byte_const(const lower_value_t* v) {
+    return v->is_const && v->value >= 0 && v->value <= 127;
+}
+
+static cc_error_t lower_read_expression(lower_value_t* out) {
+    uint8_t tag = ast_read_tag();
+    return lower_expression_tag(tag, out);
+}
+
+/* Lvalues */
+
+static void lower_lvalue_from_var(const lower_var_t* var, lower_lvalue_t* lv) {
+    lv->kind = (var->slot == 0xFF) ? LOWER_LV_GLOBAL : LOWER_LV_SLOT;
+    lv->ref = (var->slot == 0xFF) ? var->name_index : var->slot;
+    lv->flags = 0;
+    if (var->flags & LOWER_VAR_IS_16) lv->flags |= IR_F_16;
+    if (var->flags & LOWER_VAR_IS_SIGNED) lv->flags |= IR_F_SIGNED;
+    lv->elem_size = (var->flags & LOWER_VAR_IS_POINTER) ? var->elem_size : 0;
+    lv->elem_signed = (var->flags & LOWER_VAR_ELEM_SIGNED) != 0;
+}
+
+static cc_error_t lower_address_of_var(const lower_var_t* var, lower_value_t* out) {
+    uint16_t reg = ir_new_vreg(&lower->fn);
+    if (var->slot == 0xFF) {
+        LOWER_EMIT(IR_ADDRG, IR_F_16, reg, var->name_index, 0);
+    } else {
+        LOWER_EMIT(IR_ADDRL, IR_F_16, reg, var->slot, 0);
+    }
+    lower_value_init(out, reg, IR_F_16);
+    if (var->flags & LOWER_VAR_IS_ARRAY) {
+        out->elem_size = var->elem_size;
+    } else {
+        out->elem_size = (var->flags & LOWER_VAR_IS_16) ? 2 : 1;
+    }
+    out->elem_signed = (var->flags & LOWER_VAR_ELEM_SIGNED) != 0;
+    return CC_OK;
+}
+
+/* base[index] -> address value; reads both children */
+static cc_error_t lower_element_address(lower_value_t* out) {
+    lower_value_t base;
+    lower_value_t index;
+    uint16_t reg;
+    cc_error_t err = lower_read_expression(&base);
+    if (err != CC_OK) return err;
+    err = lower_read_expression(&index);
+    if (err != CC_OK) return err;
+    err = lower_convert(&base, true);
+    if (err != CC_OK) return err;
+    err = lower_convert(&index, true);
+    if (err != CC_OK) return err;
+    if (base.elem_size == 2) {
+        reg = ir_new_vreg(&lower->fn);
+        LOWER_EMIT(IR_ADD, IR_F_16, reg, index.reg, index.reg);
+        index.reg = reg;
+    }
+    reg = ir_new_vreg(&lower->fn);
+    LOWER_EMIT(IR_ADD, IR_F_16, reg, base.reg, index.reg);
+    lower_value_init(out, reg, IR_F_16);
+    out->elem_size = base.elem_size ? base.elem_size : 1;
+    out->elem_signed = base.elem_signed;
+    return CC_OK;
+}
+
+static void lower_lvalue_from_address(const lower_value_t* addr, lower_lvalue_t* lv) {
+    lv->kind = LOWER_LV_MEM;
+    lv->ref = addr->reg;
+    lv->flags = 0;
+    if (addr->elem_size == 2) lv->flags |= IR_F_16;
+    if (addr->elem_signed) lv->flags |= IR_F_SIGNED;
+    lv->elem_size = 0;
+    lv->elem_signed = false;
+}
+
+static cc_error_t lower_read_lvalue(uint8_t tag, lower_lvalue_t* lv) {
+    if (tag == AST_TAG_IDENTIFIER) {
+        uint16_t name_index = ast_read_index();
+        const lower_var_t* var = lower_find_var(name_index);
+        if (!var || (var->flags & LOWER_VAR_IS_ARRAY)) {
+            cc_error("Unsupported assignment target");
+            return CC_ERROR_CODEGEN;
+        }
+        lower_lvalue_from_var(var, lv);
+        return CC_OK;
+    }
+    if (tag == AST_TAG_ARRAY_ACCESS) {
+        lower_value_t addr;
+        cc_error_t err = lower_element_address(&addr);
+        if (err != CC_OK) return err;
+        lower_lvalue_from_address(&addr, lv);
+        return CC_OK;
+    }
+    if (tag == AST_TAG_UNARY_OP) {
+        uint8_t op = ast_read_u8();
+        if (op == OP_DEREF) {
+            lower_value_t addr;
+            cc_error_t err = lower_read_expression(&addr);
+            if (err != CC_OK) return err;
+            err = lower_convert(&addr, true);
+            if (err != CC_OK) return err;
+            lower_lvalue_from_address(&addr, lv);
+            return CC_OK;
+        }
+    }
+    cc_error("Unsupported assignment target");
+    return CC_ERROR_CODEGEN;
+}
+
+static cc_error_t lower_load_lvalue(const lower_lvalue_t* lv, lower_value_t* out) {
+    uint16_t reg = ir_new_vreg(&lower->fn);
+    uint8_t width = lv->flags & IR_F_16;
+    if (lv->kind == LOWER_LV_SLOT) {
+        LOWER_EMIT(IR_LDL, width, reg, lv->ref, 0);
+    } else if (lv->kind == LOWER_LV_GLOBAL) {
+        LOWER_EMIT(IR_LDG, width, reg, lv->ref, 0);
+    } else {
+        LOWER_EMIT(IR_LOAD, width, reg, lv->ref, 0);
+    }
+    lower_value_init(out, reg, lv->flags);
+    out->elem_size = lv->elem_size;
+    out->elem_signed = lv->elem_signed;
+    return CC_OK;
+}
+
+static cc_error_t lower_store_lvalue(const lower_lvalue_t* lv, lower_value_t* value) {
+    cc_error_t err = lower_convert(value, (lv->flags & IR_F_16) != 0);
+    uint8_t width = lv->flags & IR_F_16;
+    if (err != CC_OK) return err;
+    if (lv->kind == LOWER_LV_SLOT) {
+        LOWER_EMIT(IR_STL, width, IR_NONE, lv->ref, value->reg);
+    } else if (lv->kind == LOWER_LV_GLOBAL) {
+        LOWER_EMIT(IR_STG, width, IR_NONE, lv->ref, value->reg);
+    } else {
+        LOWER_EMIT(IR_STORE, width, IR_NONE, lv->ref, value->reg);
+    }
+    value->flags = (uint8_t)((value->flags & (uint8_t)~IR_F_SIGNED) |
+                             (lv->flags & IR_F_SIGNED));
+    return CC_OK;
+}
+
+/* Expressions */
+
+static bool lower_op_is_compare(uint8_t op) {
+    return op == OP_EQ || op == OP_NE || op == OP_LT ||
+           op == OP_GT || op == OP_LE || op == OP_GE;
+}
+
+static uint8_t lower_binary_ir_op(uint8_t op) {
+    static const uint8_t table[] = {
+        IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD, IR_AND, IR_OR, IR_XOR,
+        IR_SHL, IR_SHR, IR_SEQ, IR_SNE, IR_SLT, IR_SLE, IR_SGT, IR_SGE
+    };
+    if (op >= DIM(table)) return IR_NOP;
+    return table[op];
+}
+
+static cc_error_t lower_logical(uint8_t op, lower_value_t* out) {
+    ir_function_t* fn = &lower->fn;
+    uint16_t short_label = ir_new_label(fn);
+    uint16_t end_label = ir_new_label(fn);
+    uint16_t reg = ir_new_vreg(fn);
+    bool is_and = op == OP_LAND;
+    uint8_t tag = ast_read_tag();
+    cc_error_t err = lower_branch(tag, !is_and, short_label);
+    if (err != CC_OK) return err;
+    tag = ast_read_tag();
+    err = lower_branch(tag, !is_and, short_label);
+    if (err != CC_OK) return err;
+    LOWER_EMIT(IR_CONST, 0, reg, is_and ? 1 : 0, 0);
+    LOWER_EMIT(IR_JMP, 0, IR_NONE, end_label, 0);
+    LOWER_EMIT(IR_LABEL, 0, IR_NONE, short_label, 0);
+    LOWER_EMIT(IR_CONST, 0, reg, is_and ? 0 : 1, 0);
+    LOWER_EMIT(IR_LABEL, 0, IR_NONE, end_label, 0);
+    lower_value_init(out, reg, IR_F_SIGNED);
+    return CC_OK;
+}
+
+static cc_error_t lower_binary(uint8_t op, lower_value_t* out) {
+    lower_value_t left;
+    lower_value_t right;
+    uint8_t ir_op = lower_binary_ir_op(op);
+    uint16_t reg;
+    bool is_16;
+    uint8_t flags;
+    cc_error_t err;
+    if (op == OP_LAND || op == OP_LOR) {
+        return lower_logical(op, out);
+    }
+    if (ir_op == IR_NOP) {
+        cc_error("Unsupported binary op");
+        return CC_ERROR_CODEGEN;
+    }
+    err = lower_read_expression(&left);
+    if (err != CC_OK) return err;
+    err = lower_read_expression(&right);
+    if (err != CC_OK) return err;
+    {
+        int16_t folded;
+        if (lower_fold(op, &left, &right, &folded)) {
+            return lower_const(out, folded, folded < 0 || folded > 0xFF);
+        }
+    }
+
+    /* Bytes are promoted to int as in C. A sum, difference, product or
+     * left shift of bytes can need 16 bits, and so can anything mixing a
+     * signed and an unsigned byte; lower_narrow redoes the op at 8 bits
+     * where only the low byte is kept. Other ops on two bytes give the int
+     * result exactly at 8 bits, and a constant 0..127 reads the same as
+     * either kind of byte. */
+    is_16 = op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_SHL ||
+            ((left.flags | right.flags) & IR_F_16) != 0 ||
+            (((left.flags ^ right.flags) & IR_F_SIGNED) != 0 &&
+             !lower_is_byte_const(&left) && !lower_is_byte_const(&right));
+    flags = (uint8_t)(left.flags & right.flags & IR_F_SIGNED);
+    /* Right first: a constant there is the last instruction and can be
+     * re-emitted at 16 bits instead of extended */
+    err = lower_convert(&right, is_16);
+    if (err != CC_OK) return err;
+    err = lower_convert(&left, is_16);
+    if (err != CC_OK) return err;
+    if (is_16) flags |= IR_F_16;
+
+    /* Pointer arithmetic scales the integer side by the element size */
+    if ((op == OP_ADD || op == OP_SUB) && left.elem_size != right.elem_size) {
+        lower_value_t* scaled = left.elem_size ? &right : &left;
+        const lower_value_t* ptr = left.elem_size ? &left : &right;
+        if (ptr->elem_size == 2 && scaled->elem_size == 0) {
+            reg = ir_new_vreg(&lower->fn);
+            LOWER_EMIT(IR_ADD, IR_F_16, reg, scaled->reg, scaled->reg);
+            scaled->reg = reg;
+        }
+    }
+
+    reg = ir_new_vreg(&lower->fn);
+    LOWER_EMIT(ir_op, flags, reg, left.reg, right.reg);
+    if (lower_op_is_compare(op)) {
+        lower_value_init(out, reg, IR_F_SIGNED);
+        return CC_OK;
+    }
+    lower_value_init(out, reg, flags);
+    if (op == OP_ADD || op == OP_SUB) {
+        const lower_value_t* ptr = left.elem_size ? &left : &right;
+        if (op == OP_SUB && left.elem_size && right.elem_size) {
+            if (left.elem_size == 2) {
+                uint16_t one = ir_new_vreg(&lower->fn);
+                uint16_t scaled = ir_new_vreg(&lower->fn);
+                LOWER_EMIT(IR_CONST, IR_F_16, one, 1, 0);
+                LOWER_EMIT(IR_SHR, IR_F_16 | IR_F_SIGNED, scaled, reg, one);
+                out->reg = scaled;
+            }
+            out->flags |= IR_F_SIGNED;
+        } else {
+            out->elem_size = ptr->elem_size;
+            out->elem_signed = ptr->elem_signed;
+        }
+    }
+    return CC_OK;
+}
+
+static cc_error_t lower_incdec(uint8_t op, uint8_t child_tag, lower_value_t* out) {
+    bool is_post = (op == OP_POSTINC || op == OP_POSTDEC);
+    bool is_inc = (op == OP_PREINC || op == OP_POSTINC);
+    lower_lvalue_t lv;
+    lower_value_t old_value;
+    lower_value_t step;
+    lower_value_t new_value;
+    uint8_t width;
+    cc_error_t err = lower_read_lvalue(child_tag, &lv);
+    if (err != CC_OK) return err;
+    err = lower_load_lvalue(&lv, &old_value);
+    if (err != CC_OK) return err;
+    width = lv.flags & IR_F_16;
+    err = lower_const(&step, (int16_t)(lv.elem_size == 2 ? 2 : 1), width != 0);
+    if (err != CC_OK) return err;
+    new_value = old_value;
+    new_value.reg = ir_new_vreg(&lower->fn);
+    LOWER_EMIT(is_inc ? IR_ADD : IR_SUB, width, new_value.reg, old_value.reg, step.reg);
+    err = lower_store_lvalue(&lv, &new_value);
+    if (err != CC_OK) return err;
+    *out = is_post ? old_value : new_value;
+    return CC_OK;
+}
+
+static cc_error_t lower_unary(uint8_t op, lower_value_t* out) {
+    uint8_t child_tag = ast_read_tag();
+    lower_value_t value;
+    uint16_t reg;
+    cc_error_t err;
+    if (op == OP_PREINC || op == OP_PREDEC || op == OP_POSTINC || op == OP_POSTDEC) {
+        return lower_incdec(op, child_tag, out);
+    }
+    if (op == OP_ADDR) {
+        if (child_tag == AST_TAG_IDENTIFIER) {
+            const lower_var_t* var = lower_find_var(ast_read_index());
+            if (!var) return CC_ERROR_CODEGEN;
+            return lower_address_of_var(var, out);
+        }
+        if (child_tag == AST_TAG_ARRAY_ACCESS) {
+            return lower_element_address(out);
+        }
+        cc_error("Unsupported address-of operand");
+        return CC_ERROR_CODEGEN;
+    }
+    if (op == OP_DEREF) {
+        lower_lvalue_t lv;
+        err = lower_expression_tag(child_tag, &value);
+        if (err != CC_OK) return err;
+        err = lower_convert(&value, true);
+        if (err != CC_OK) return err;
+        lower_lvalue_from_address(&value, &lv);
+        return lower_load_lvalue(&lv, out);
+    }
+    err = lower_expression_tag(child_tag, &value);
+    if (err != CC_OK) return err;
+    if (op == OP_LNOT) {
+        reg = ir_new_vreg(&lower->fn);
+        LOWER_EMIT(IR_LNOT, value.flags & IR_F_16, reg, value.reg, 0);
+        lower_value_init(out, reg, IR_F_SIGNED);
+        return CC_OK;
+    }
+    if (op == OP_NEG || op == OP_NOT) {
+        /* Promoted like a binary operand: -(signed char)-128 and ~(char)0
+         * do not fit the byte */
+        uint8_t flags = (uint8_t)(value.flags | IR_F_16);
+        err = lower_convert(&value, true);
+        if (err != CC_OK) return err;
+        reg = ir_new_vreg(&lower->fn);
+        LOWER_EMIT(op == OP_NEG ? IR_NEG : IR_NOT, IR_F_16, reg, value.reg, 0);
+        lower_value_init(out, reg, flags);
+        if (op == OP_NEG) out->flags |= IR_F_SIGNED;
+        return CC_OK;
+    }
+    cc_error("Unsupported unary op");
+    return CC_ERROR_CODEGEN;
+}
+
+static cc_error_t lower_call(lower_value_t* out) {
+    uint16_t name_index = ast_read_index();
+    uint8_t arg_count = ast_read_u8();
+    uint16_t args[8];
+    uint16_t reg;
+    bool ret16 = lower_function_return_is_16bit(name_index);
+    if (arg_count > DIM(args)) {
+        cc_error("Too many call arguments");
+        return CC_ERROR_CODEGEN;
+    }
+    for (uint8_t i = 0; i < arg_count; i++) {
+        lower_value_t arg;
+        cc_error_t err = lower_read_expression(&arg);
+        if (err != CC_OK) return err;
+        err = lower_convert(&arg, true);
+        if (err != CC_OK) return err;
+        args[i] = arg.reg;
+    }
+    for (uint8_t i = arg_count; i-- > 0;) {
+        LOWER_EMIT(IR_ARG, IR_F_16, IR_NONE, args[i], 0);
+    }
+    reg = ir_new_vreg(&lower->fn);
+    LOWER_EMIT(IR_CALL, ret16 ? IR_F_16 : 0, reg, name_index, arg_count);
+    lower_value_init(out, reg, (uint8_t)((ret16 ? IR_F_16 : 0) | IR_F_SIGNED));
+    return CC_OK;
+}
+
+static cc_error_t lower_expression_tag(uint8_t tag, lower_value_t* out) {
+    CC_STAT_INC(nodes_read);
+    switch (tag) {
+        case AST_TAG_CONSTANT: {
+            int16_t value = ast_read_const();
+            return lower_const(out, value, value < 0 || value > 0xFF);
+        }
+        case AST_TAG_IDENTIFIER: {
+            uint16_t name_index = ast_read_index();
+            const lower_var_t* var = lower_find_var(name_index);
+            lower_lvalue_t lv;
+            if (!var) {
+                cc_error("Unknown identifier");
+                return CC_ERROR_CODEGEN;
+            }
+            if (var->flags & LOWER_VAR_IS_ARRAY) {
+                return lower_address_of_var(var, out);
+            }
+            lower_lvalue_from_var(var, &lv);
+            return lower_load_lvalue(&lv, out);
+        }
+        case AST_TAG_STRING_LITERAL: {
+            uint16_t reg = ir_new_vreg(&lower->fn);
+            LOWER_EMIT(IR_ADDRS, IR_F_16, reg, ast_read_index(), 0);
+            lower_value_init(out, reg, IR_F_16);
+            out->elem_size = 1;
+            out->elem_signed = true;
+            return CC_OK;
+        }
+        case AST_TAG_UNARY_OP:
+            return lower_unary(ast_read_u8(), out);
+        case AST_TAG_BINARY_OP:
+            return lower_binary(ast_read_u8(), out);
+        case AST_TAG_CALL:
+            return lower_call(out);
+        case AST_TAG_ARRAY_ACCESS: {
+            lower_value_t addr;
+            lower_lvalue_t lv;
+            cc_error_t err = lower_element_address(&addr);
+            if (err != CC_OK) return err;
+            lower_lvalue_from_address(&addr, &lv);
+            return lower_load_lvalue(&lv, out);
+        }
+        case AST_TAG_ASSIGN: {
+            lower_lvalue_t lv;
+            uint8_t ltag = ast_read_tag();
+            cc_error_t err = lower_read_lvalue(ltag, &lv);
+            if (err != CC_OK) return err;
+            err = lower_read_expression(out);
+            if (err != CC_OK) return err;
+            return lower_store_lvalue(&lv, out);
+        }
+        default:
+            cc_error("Unsupported expression");
+            return CC_ERROR_CODEGEN;
+    }
+}
+
+/* Branch to `label` when the condition is `when_true`, falling through
+ * otherwise. && / || / ! are lowered to jumps without materializing. */
+static cc_error_t lower_branch(uint8_t tag, bool when_true, uint16_t label) {
+    lower_value_t value;
+    cc_error_t err;
+    if (tag == AST_TAG_BINARY_OP) {
+        uint8_t op = ast_read_u8();
+        if (op == OP_LAND || op == OP_LOR) {
+            bool is_and = op == OP_LAND;
+            if (is_and != when_true) {
+                /* && jumping on false / || jumping on true: either side decides */
+                err = lower_branch(ast_read_tag(), when_true, label);
+                if (err != CC_OK) return err;
+                return lower_branch(ast_read_tag(), when_true, label);
+            }
+            {
+                uint16_t skip = ir_new_label(&lower->fn);
+                err = lower_branch(ast_read_tag(), !when_true, skip);
+                if (err != CC_OK) return err;
+                err = lower_branch(ast_read_tag(), when_true, label);
+                if (err != CC_OK) return err;
+                LOWER_EMIT(IR_LABEL, 0, IR_NONE, skip, 0);
+                return CC_OK;
+            }
+        }
+        err = lower_binary(op, &value);
+    } else if (tag == AST_TAG_UNARY_OP) {
+        uint8_t op = ast_read_u8();
+        if (op == OP_LNOT) {
+            return lower_branch(ast_read_tag(), !when_true, label);
+        }
+        err = lower_unary(op, &value);
+    } else {
+        err = lower_expression_tag(tag, &value);
+    }
+    if (err != CC_OK) return err;
+    LOWER_EMIT(when_true ? IR_BNZ : IR_BZ, value.flags & IR_F_16, IR_NONE, value.reg, label);
+    return CC_OK;
+}
+
+/* Statements */
+
+static cc_error_t lower_read_statement(void) {
+    uint8_t tag = ast_read_tag();
+    return lower_statement_tag(tag);
+}
+
+static cc_error_t lower_statement_var_decl(void) {
+    uint16_t name_index = ast_read_index();
+    uint8_t base = 0;
+    uint8_t depth = 0;
+    uint16_t array_len = 0;
+    uint8_t has_init;
+    uint8_t flags;
+    uint8_t elem_size = 0;
+    uint16_t size;
+    if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_CODEGEN;
+    has_init = ast_read_u8();
+    flags = lower_var_flags(base, depth, array_len, &elem_size);
+    if (flags & LOWER_VAR_IS_ARRAY) {
+        size = (uint16_t)(elem_size * array_len);
+    } else {
+        size = (flags & LOWER_VAR_IS_16) ? 2u : 1u;
+    }
+    if (lower_add_slot(name_index, IR_SLOT_LOCAL, size, flags, elem_size) < 0) {
+        return CC_ERROR_CODEGEN;
+    }
+    if (has_init) {
+        lower_lvalue_t lv;
+        lower_value_t value;
+        cc_error_t err;
+        if (flags & LOWER_VAR_IS_ARRAY) {
+            cc_error("Array initializers not supported");
+            return CC_ERROR_CODEGEN;
+        }
+        lower_lvalue_from_var(lower_find_local(name_index), &lv);
+        err = lower_read_expression(&value);
+        if (err != CC_OK) return err;
+        return lower_store_lvalue(&lv, &value);
+    }
+    return CC_OK;
+}
+
+static cc_error_t lower_statement_return(void) {
+    uint8_t has_expr = ast_read_u8();
+    lower_value_t value;
+    cc_error_t err;
+    if (has_expr) {
+        err = lower_read_expression(&value);
+    } else {
+        err = lower_const(&value, 0, false);
+    }
+    if (err != CC_OK) return err;
+    err = lower_convert(&value, lower->function_return_is_16);
+    if (err != CC_OK) return err;
+    LOWER_EMIT(IR_RET, lower->function_return_is_16 ? IR_F_16 : 0, IR_NONE, value.reg, 0);
+    return CC_OK;
+}
+
+static cc_error_t lower_statement_if(void) {
+    uint8_t has_else = ast_read_u8();
+    uint16_t else_label = ir_new_label(&lower->fn);
+    uint16_t end_label = has_else ? ir_new_label(&lower->fn) : else_label;
+    cc_error_t err = lower_branch(ast_read_tag(), false, else_label);
+    if (err != CC_OK) return err;
+    err = lower_read_statement();
+    if (err != CC_OK) return err;
+    if (has_else) {
+        LOWER_EMIT(IR_JMP, 0, IR_NONE, end_label, 0);
+    }
+    LOWER_EMIT(IR_LABEL, 0, IR_NONE, else_label, 0);
+    if (has_else) {
+        err = lower_read_statement();
+        if (err != CC_OK) return err;
+        LOWER_EMIT(IR_LABEL, 0, IR_NONE, end_label, 0);
+    }
+    return CC_OK;
+}
+
+static cc_error_t lower_loop_push(uint16_t break_label, uint16_t continue_label) {
+    if (lower->loop_depth >= DIM(lower->loop_break_labels)) {
+        cc_error("Loop nesting too deep");
+        return CC_ERROR_CODEGEN;
+    }
+    lower->loop_break_labels[lower->loop_depth] = break_label;
+    lower->loop_continue_labels[lower->loop_depth] = continue_label;
+    lower->loop_depth++;
+    return CC_OK;
+}
+
+static cc_error_t lower_statement_while(void) {
+    uint16_t loop_label = ir_new_label(&lower->fn);
+    uint16_t end_label = ir_new_label(&lower->fn);
+    cc_error_t err;
+    LOWER_EMIT(IR_LABEL, 0, IR_NONE, loop_label, 0);
+    err = lower_branch(ast_read_tag(), false, end_label);
+    if (err != CC_OK) return err;
+    err = lower_loop_push(end_label, loop_label);
+    if (err != CC_OK) return err;
+    err = lower_read_statement();
+    lower->loop_depth--;
+    if (err != CC_OK) return err;
+    LOWER_EMIT(IR_JMP, 0, IR_NONE, loop_label, 0);
+    LOWER_EMIT(IR_LABEL, 0, IR_NONE, end_label, 0);
+    return CC_OK;
+}
+
+static cc_error_t lower_statement_for(void) {
+    uint8_t has_init = ast_read_u8();
+    uint8_t has_cond = ast_read_u8();
+    uint8_t has_inc = ast_read_u8();
+    uint16_t loop_label = ir_new_label(&lower->fn);
+    uint16_t end_label = ir_new_label(&lower->fn);
+    uint16_t inc_label = has_inc ? ir_new_label(&lower->fn) : loop_label;
+    uint32_t inc_offset = 0;
+    cc_error_t err;
+    if (has_init) {
+        err = lower_read_statement();
+        if (err != CC_OK) return err;
+    }
+    LOWER_EMIT(IR_LABEL, 0, IR_NONE, loop_label, 0);
+    if (has_cond) {
+        err = lower_branch(ast_read_tag(), false, end_label);
+        if (err != CC_OK) return err;
+    }
+    if (has_inc) {
+        inc_offset = reader_tell(reader);
+        if (ast_reader_skip_node() < 0) return CC_ERROR_CODEGEN;
+    }
+    err = lower_loop_push(end_label, inc_label);
+    if (err != CC_OK) return err;
+    err = lower_read_statement();
+    lower->loop_depth--;
+    if (err != CC_OK) return err;
+    if (has_inc) {
+        uint32_t body_end = reader_tell(reader);
+        lower_value_t value;
+        if (reader_seek(reader, inc_offset) < 0) return CC_ERROR_CODEGEN;
+        LOWER_EMIT(IR_LABEL, 0, IR_NONE, inc_label, 0);
+        err = lower_read_expression(&value);
+        if (err != CC_OK) return err;
+        if (reader_seek(reader, body_end) < 0) return CC_ERROR_CODEGEN;
+    }
+    LOWER_EMIT(IR_JMP, 0, IR_NONE, loop_label, 0);
+    LOWER_EMIT(IR_LABEL, 0, IR_NONE, end_label, 0);
+    return CC_OK;
+}
+
+static cc_error_t lower_statement_tag(uint8_t tag) {
+    /* Expression statements are counted by lower_expression_tag */
+    if (tag <= AST_TAG_FOR_STMT) CC_STAT_INC(nodes_read);
+    switch (tag) {
+        case AST_TAG_VAR_DECL:
+            return lower_statement_var_decl();
+        case AST_TAG_COMPOUND_STMT: {
+            uint16_t stmt_count = ast_read_index();
+            for (uint16_t i = 0; i < stmt_count; i++) {
+                cc_error_t err = lower_read_statement();
+                if (err != CC_OK) return err;
+            }
+            return CC_OK;
+        }
+        case AST_TAG_RETURN_STMT:
+            return lower_statement_return();
+        case AST_TAG_IF_STMT:
+            return lower_statement_if();
+        case AST_TAG_WHILE_STMT:
+            return lower_statement_while();
+        case AST_TAG_FOR_STMT:
+            return lower_statement_for();
+        case AST_TAG_BREAK_STMT:
+        case AST_TAG_CONTINUE_STMT: {
+            uint16_t label;
+            if (lower->loop_depth == 0) {
+                cc_error("break/continue used outside of loop");
+                return CC_ERROR_CODEGEN;
+            }
+            label = (tag == AST_TAG_BREAK_STMT)
+                ? lower->loop_break_labels[lower->loop_depth - 1]
+                : lower->loop_continue_labels[lower->loop_depth - 1];
+            LOWER_EMIT(IR_JMP, 0, IR_NONE, label, 0);
+            return CC_OK;
+        }
+        case AST_TAG_GOTO_STMT:
+        case AST_TAG_LABEL_STMT: {
+            uint16_t label = lower_named_label(ast_read_index());
+            if (label == IR_NONE) return CC_ERROR_CODEGEN;
+            LOWER_EMIT(tag == AST_TAG_GOTO_STMT ? IR_JMP : IR_LABEL, 0, IR_NONE,
+                       label, 0);
+            return CC_OK;
+        }
+        default: {
+            lower_value_t value;
+            return lower_expression_tag(tag, &value);
+        }
+    }
+}
+
+static cc_error_t lower_function(void) {
+    uint16_t name_index = ast_read_index();
+    uint8_t base = 0;
+    uint8_t depth = 0;
+    uint16_t array_len = 0;
+    uint8_t param_count;
+    cc_error_t err;
+    if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_CODEGEN;
+    param_count = ast_read_u8();
+
+    ir_function_init(&lower->fn, name_index);
+    lower->function_return_is_16 = lower_type_is_16bit(base, depth);
+    lower->fn.flags = lower->function_return_is_16 ? IR_FN_RET16 : 0;
+    lower->local_count = 0;
+    lower->loop_depth = 0;
+    lower->named_label_count = 0;
+
+    for (uint8_t i = 0; i < param_count; i++) {
+        uint16_t param_name;
+        uint8_t param_base = 0;
+        uint8_t param_depth = 0;
+        uint16_t param_array_len = 0;
+        uint8_t elem_size = 0;
+        uint8_t flags;
+        if (ast_read_tag() != AST_TAG_VAR_DECL) return CC_ERROR_CODEGEN;
+        param_name = ast_read_index();
+        if (ast_reader_read_type_info(&param_base, &param_depth,
+                                      &param_array_len) < 0) return CC_ERROR_CODEGEN;
+        if (ast_read_u8() && ast_reader_skip_node() < 0) return CC_ERROR_CODEGEN;
+        flags = lower_var_flags(param_base, param_depth, param_array_len, &elem_size);
+        if (flags & LOWER_VAR_IS_ARRAY) {
+            /* Array parameters decay to pointers */
+            flags = (uint8_t)((flags & (uint8_t)~LOWER_VAR_IS_ARRAY) |
+                              LOWER_VAR_IS_POINTER | LOWER_VAR_IS_16);
+        }
+        if (lower_add_slot(param_name, IR_SLOT_PARAM, 2, flags, elem_size) < 0) {
+            return CC_ERROR_CODEGEN;
+        }
+    }
+    lower->fn.param_count = lower->fn.slot_count;
+
+    err = lower_read_statement();
+    if (err == CC_OK) {
+        lower_narrow(&lower->fn);
+        lower_licm(&lower->fn);
+        ir_write_function(lower->output_handle, &lower->fn);
+    }
+    ir_function_free(&lower->fn);
+    return err;
+}
+
+static cc_error_t lower_global_var(void) {
+    ir_global_t global;
+    uint8_t base = 0;
+    uint8_t depth = 0;
+    uint16_t array_len = 0;
+    uint8_t has_init;
+    uint8_t flags;
+    uint8_t elem_size = 0;
+    global.name_index = ast_read_index();
+    if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_CODEGEN;
+    has_init = ast_read_u8();
+    flags = lower_var_flags(base, depth, array_len, &elem_size);
+    global.init = 0;
+    if (flags & LOWER_VAR_IS_ARRAY) {
+        global.kind = IR_GLOBAL_SPACE;
+        global.size = (uint16_t)(elem_size * array_len);
+    } else {
+        global.kind = (flags & LOWER_VAR_IS_16) ? IR_GLOBAL_WORD : IR_GLOBAL_BYTE;
+        global.size = (flags & LOWER_VAR_IS_16) ? 2u : 1u;
+    }
+    if (has_init) {
+        uint8_t tag = ast_read_tag();
+        if (tag == AST_TAG_CONSTANT) {
+            global.init = (uint16_t)ast_read_const();
+            if (flags & LOWER_VAR_IS_ARRAY) {
+                cc_error("Array initializers not supported");
+                return CC_ERROR_CODEGEN;
+            }
+        } else if (tag == AST_TAG_STRING_LITERAL) {
+            global.init = ast_read_index();
+            if (flags & LOWER_VAR_IS_ARRAY) {
+                const char* value = ast_reader_string(global.init);
+                if (!value || str_len(value) + 1u > array_len) {
+                    cc_error("String literal too long for array");
+                    return CC_ERROR_CODEGEN;
+                }
+                global.kind = IR_GLOBAL_STRING;
+            } else {
+                global.kind = IR_GLOBAL_ADDR_STRING;
+            }
+        } else if (tag == AST_TAG_UNARY_OP && ast_read_u8() == OP_ADDR &&
+                   ast_read_tag() == AST_TAG_IDENTIFIER) {
+            global.kind = IR_GLOBAL_ADDR_VAR;
+            global.init = ast_read_index();
+        } else {
+            cc_error("Unsupported global initializer");
+            return CC_ERROR_CODEGEN;
+        }
+    }
+    ir_write_global(lower->output_handle, &global);
+    return CC_OK;
+}
+
+lower_t* lower_create(const char* output_file) {
+    lower = &lower_ctx;
+    mem_set(lower, 0, sizeof(*lower));
+    lower->output_handle = output_open(output_file);
+#ifdef __SDCC
+    if (lower->output_handle < 0) {
+#else
+    if (!lower->output_handle) {
+#endif
+        return NULL;
+    }
+    return lower;
+}
+
+void lower_destroy(lower_t* l) {
+    if (!l) return;
+    if (l->globals) cc_free(l->globals);
+    if (l->function_return_flags) cc_free(l->function_return_flags);
+    if (l->output_handle) {
+        output_close(l->output_handle);
+    }
+}
+
+cc_error_t lower_generate_stream(void) {
+    uint16_t decl_count = 0;
+    int16_t tag = 0;
+    ir_header_t header;
+    if (!ast) return CC_ERROR_INTERNAL;
+
+    /* Pass 1: collect globals and function return widths */
+    if (ast_reader_begin_program(&decl_count) < 0) return CC_ERROR_CODEGEN;
+    if (decl_count) {
+        lower->globals = (lower_var_t*)cc_malloc(sizeof(lower_var_t) * decl_count);
+        lower->function_return_flags = (uint16_t*)cc_malloc(sizeof(uint16_t) * decl_count);
+        if (!lower->globals || !lower->function_return_flags) return CC_ERROR_MEMORY;
+        lower->decl_capacity = decl_count;
+    }
+    header.record_count = 0;
+    header.function_count = 0;
+    while ((tag = ast_reader_next_decl(0)) > 0) {
+        uint16_t name_index = 0;
+        uint8_t base = 0;
+        uint8_t depth = 0;
+        uint16_t array_len = 0;
+        if (tag != AST_TAG_FUNCTION && tag != AST_TAG_VAR_DECL) {
+            if (ast_reader_skip_tag((uint8_t)tag) < 0) return CC_ERROR_CODEGEN;
+            continue;
+        }
+        name_index = ast_read_index();
+        if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_CODEGEN;
+        header.record_count++;
+        if (tag == AST_TAG_FUNCTION) {
+            uint8_t param_count = ast_read_u8();
+            lower_register_function(name_index, lower_type_is_16bit(base, depth));
+            header.function_count++;
+            if (ast->decls) continue;
+            for (uint8_t p = 0; p <= param_count; p++) {
+                if (ast_reader_skip_node() < 0) return CC_ERROR_CODEGEN;
+            }
+            continue;
+        }
+        if (lower->global_count < lower->decl_capacity) {
+            lower_var_t* var = &lower->globals[lower->global_count++];
+            var->name_index = name_index;
+            var->slot = 0xFF;
+            var->flags = lower_var_flags(base, depth, array_len, &var->elem_size);
+        }
+        if (ast_read_u8() && !ast->decls && ast_reader_skip_node() < 0) return CC_ERROR_CODEGEN;
+    }
+    if (tag < 0) return CC_ERROR_CODEGEN;
+
+    header.string_count = ast->string_count;
+    ir_write_header(lower->output_handle, &header);
+    ir_write_strings(lower->output_handle, ast->string_count, ast_reader_string);
+
+    /* Pass 2: one record per declaration, functions lowered one at a time */
+    if (ast_reader_begin_program(&decl_count) < 0) return CC_ERROR_CODEGEN;
+    for (uint16_t i = 0; i < decl_count; i++) {
+        uint8_t tag = ast_read_tag();
+        cc_error_t err = CC_OK;
+        if (tag == AST_TAG_FUNCTION) {
+            err = lower_function();
+        } else if (tag == AST_TAG_VAR_DECL) {
+            err = lower_global_var();
+        } else if (ast_reader_skip_tag(tag) < 0) {
+            err = CC_ERROR_CODEGEN;
+        }
+        if (err != CC_OK) return err;
+    }
+    return CC_OK;
+}
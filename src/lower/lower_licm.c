@@ -0,0 +1,279 @@
+#include "lower.h"
+
+#include "cc_compat.h"
+#include "common.h"
+#include "ir.h"
+
+/* Loop-invariant code motion over the lowered IR of one function.
+ *
+ * A loop is the range [header label .. back-edge jump]. Instructions
+ * in it whose operands do not change across iterations are moved in
+ * front of the header label (the pre-header), where cc_isel gives the
+ * result a frame cell that lives across the loop. Only pure ops are
+ * moved: loads through pointers, calls and division stay in place. */
+
+#define LICM_MULTI_DEF 0xFFFE
+
+enum {
+    LICM_INVARIANT = 0x01,
+    LICM_NEEDED = 0x02,
+    LICM_HOIST = 0x04
+};
+
+typedef struct {
+    ir_function_t* fn;
+    uint16_t* def_pos;
+    uint16_t* label_pos;
+    uint8_t* marks;
+    uint8_t addr_taken[(IR_MAX_SLOTS + 7) / 8];
+    uint8_t stored[(IR_MAX_SLOTS + 7) / 8];
+    bool has_call;
+    bool has_store;
+} licm_t;
+
+static bool licm_bit(const uint8_t* bits, uint16_t index) {
+    return (bits[index >> 3] & (1u << (index & 7))) != 0;
+}
+
+static void licm_set_bit(uint8_t* bits, uint16_t index) {
+    bits[index >> 3] |= (uint8_t)(1u << (index & 7));
+}
+
+static void licm_index(licm_t* licm) {
+    ir_function_t* fn = licm->fn;
+    for (uint16_t v = 0; v < fn->vreg_count; v++) {
+        licm->def_pos[v] = IR_NONE;
+    }
+    for (uint16_t l = 0; l < fn->label_count; l++) {
+        licm->label_pos[l] = IR_NONE;
+    }
+    for (uint16_t i = 0; i < fn->instr_count; i++) {
+        const ir_instr_t* ins = &fn->instrs[i];
+        if (ins->op == IR_LABEL && ins->a < fn->label_count) {
+            licm->label_pos[ins->a] = i;
+        }
+        if (ir_op_has_dst(ins->op) && ins->dst < fn->vreg_count) {
+            licm->def_pos[ins->dst] = licm->def_pos[ins->dst] == IR_NONE ? i : LICM_MULTI_DEF;
+        }
+    }
+}
+
+static uint16_t licm_jump_target(const ir_instr_t* ins) {
+    if (ins->op == IR_JMP) return ins->a;
+    if (ins->op == IR_BZ || ins->op == IR_BNZ) return ins->b;
+    return IR_NONE;
+}
+
+/* Approximate T-states cc_isel spends producing the value */
+static uint16_t licm_cost(const ir_instr_t* ins) {
+    bool is_16 = (ins->flags & IR_F_16) != 0;
+    switch (ins->op) {
+        case IR_CONST: return is_16 ? 10 : 7;
+        case IR_LDL: return is_16 ? 38 : 19;
+        case IR_LDG: return is_16 ? 16 : 13;
+        case IR_ADDRG:
+        case IR_ADDRS: return 10;
+        case IR_ADDRL: return 42;
+        case IR_ZEXT: return 11;
+        case IR_SEXT: return 23;
+        case IR_TRUNC: return 4;
+        case IR_ADD:
+        case IR_SUB: return is_16 ? 19 : 11;
+        case IR_AND:
+        case IR_OR:
+        case IR_XOR:
+        case IR_NEG:
+        case IR_NOT: return is_16 ? 30 : 11;
+        case IR_MUL: return 200;
+        case IR_SHL:
+        case IR_SHR: return is_16 ? 60 : 40;
+        default: return 0;
+    }
+}
+
+static bool licm_candidate_op(uint8_t op) {
+    switch (op) {
+        case IR_CONST: case IR_ZEXT: case IR_SEXT: case IR_TRUNC:
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_AND: case IR_OR:
+        case IR_XOR: case IR_SHL: case IR_SHR: case IR_NEG: case IR_NOT:
+        case IR_LDL: case IR_LDG: case IR_ADDRL: case IR_ADDRG: case IR_ADDRS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool licm_operand_invariant(const licm_t* licm, uint16_t reg,
+                                   uint16_t start, uint16_t end) {
+    uint16_t pos;
+    if (reg == IR_NONE) return true;
+    pos = licm->def_pos[reg];
+    if (pos == IR_NONE || pos == LICM_MULTI_DEF) return false;
+    if (pos < start || pos > end) return true;
+    return (licm->marks[pos - start] & LICM_INVARIANT) != 0;
+}
+
+static bool licm_memory_invariant(const licm_t* licm, const ir_instr_t* ins,
+                                  uint16_t start, uint16_t end) {
+    if (ins->op == IR_LDL) {
+        if (licm_bit(licm->stored, ins->a)) return false;
+        return !licm_bit(licm->addr_taken, ins->a) || (!licm->has_call && !licm->has_store);
+    }
+    if (ins->op == IR_LDG) {
+        if (licm->has_call || licm->has_store) return false;
+        for (uint16_t i = start; i <= end; i++) {
+            const ir_instr_t* other = &licm->fn->instrs[i];
+            if (other->op == IR_STG && other->a == ins->a) return false;
+        }
+    }
+    return true;
+}
+
+/* Hoists the invariant work of loop [start, end]; returns true if
+ * anything moved. */
+static bool licm_loop(licm_t* licm, uint16_t start, uint16_t end) {
+    ir_function_t* fn = licm->fn;
+    uint16_t length = (uint16_t)(end - start + 1u);
+    uint16_t hoisted = 0;
+    ir_instr_t* moved;
+    bool changed = true;
+
+    /* The pre-header must dominate the loop: no jumps in from outside */
+    for (uint16_t i = 0; i < fn->instr_count; i++) {
+        uint16_t target = licm_jump_target(&fn->instrs[i]);
+        uint16_t pos;
+        if (target == IR_NONE || (i >= start && i <= end)) continue;
+        pos = licm->label_pos[target];
+        if (pos >= start && pos <= end) return false;
+    }
+
+    mem_set(licm->stored, 0, sizeof(licm->stored));
+    licm->has_call = false;
+    licm->has_store = false;
+    for (uint16_t i = start; i <= end; i++) {
+        const ir_instr_t* ins = &fn->instrs[i];
+        if (ins->op == IR_STL) licm_set_bit(licm->stored, ins->a);
+        if (ins->op == IR_CALL) licm->has_call = true;
+        if (ins->op == IR_STORE) licm->has_store = true;
+    }
+
+    mem_set(licm->marks, 0, length);
+    while (changed) {
+        changed = false;
+        for (uint16_t i = start; i <= end; i++) {
+            const ir_instr_t* ins = &fn->instrs[i];
+            uint16_t a;
+            uint16_t b;
+            if (licm->marks[i - start] & LICM_INVARIANT) continue;
+            if (!licm_candidate_op(ins->op) || licm->def_pos[ins->dst] != i) continue;
+            ir_instr_operands(ins, &a, &b);
+            if (!licm_operand_invariant(licm, a, start, end) ||
+                !licm_operand_invariant(licm, b, start, end) ||
+                !licm_memory_invariant(licm, ins, start, end)) {
+                continue;
+            }
+            licm->marks[i - start] |= LICM_INVARIANT;
+            changed = true;
+        }
+    }
+
+    /* An invariant value read by a variant instruction roots a tree; move
+     * the tree only when recomputing it costs more than a frame reload. */
+    for (uint16_t i = start; i <= end; i++) {
+        const ir_instr_t* ins = &fn->instrs[i];
+        uint16_t ops[2];
+        if (licm->marks[i - start] & LICM_INVARIANT) continue;
+        ir_instr_operands(ins, &ops[0], &ops[1]);
+        for (uint8_t k = 0; k < 2; k++) {
+            uint16_t root = ops[k] == IR_NONE ? IR_NONE : licm->def_pos[ops[k]];
+            uint16_t cost = 0;
+            const ir_instr_t* root_ins;
+            if (root == IR_NONE || root == LICM_MULTI_DEF || root < start || root > end) continue;
+            if ((licm->marks[root - start] & (LICM_INVARIANT | LICM_HOIST)) != LICM_INVARIANT) {
+                continue;
+            }
+            licm->marks[root - start] |= LICM_NEEDED;
+            for (uint16_t j = root + 1u; j-- > start;) {
+                uint16_t a;
+                uint16_t b;
+                if (!(licm->marks[j - start] & LICM_NEEDED)) continue;
+                cost = (uint16_t)(cost + licm_cost(&fn->instrs[j]));
+                ir_instr_operands(&fn->instrs[j], &a, &b);
+                if (a != IR_NONE && licm->def_pos[a] >= start && licm->def_pos[a] <= end) {
+                    licm->marks[licm->def_pos[a] - start] |= LICM_NEEDED;
+                }
+                if (b != IR_NONE && licm->def_pos[b] >= start && licm->def_pos[b] <= end) {
+                    licm->marks[licm->def_pos[b] - start] |= LICM_NEEDED;
+                }
+            }
+            root_ins = &fn->instrs[root];
+            for (uint16_t j = start; j <= root; j++) {
+                uint8_t* mark = &licm->marks[j - start];
+                if (!(*mark & LICM_NEEDED)) continue;
+                *mark &= (uint8_t)~LICM_NEEDED;
+                if (cost > ((root_ins->flags & IR_F_16) ? 38u : 19u) && !(*mark & LICM_HOIST)) {
+                    *mark |= LICM_HOIST;
+                    hoisted++;
+                }
+            }
+        }
+    }
+    if (hoisted == 0) return false;
+
+    /* Region becomes: hoisted instructions, then the loop as before */
+    moved = (ir_instr_t*)cc_malloc(sizeof(ir_instr_t) * length);
+    if (!moved) return false;
+    {
+        uint16_t front = 0;
+        uint16_t back = hoisted;
+        for (uint16_t i = start; i <= end; i++) {
+            if (licm->marks[i - start] & LICM_HOIST) {
+                moved[front++] = fn->instrs[i];
+            } else {
+                moved[back++] = fn->instrs[i];
+            }
+        }
+    }
+    mem_cpy(&fn->instrs[start], moved, sizeof(ir_instr_t) * length);
+    cc_free(moved);
+    return true;
+}
+
+void lower_licm(ir_function_t* fn) {
+    licm_t licm;
+    bool changed = true;
+    uint16_t rounds = 0;
+    if (fn->instr_count == 0 || fn->label_count == 0 || fn->vreg_count == 0) return;
+
+    mem_set(&licm, 0, sizeof(licm));
+    licm.fn = fn;
+    licm.def_pos = (uint16_t*)cc_malloc(sizeof(uint16_t) * fn->vreg_count);
+    licm.label_pos = (uint16_t*)cc_malloc(sizeof(uint16_t) * fn->label_count);
+    licm.marks = (uint8_t*)cc_malloc(fn->instr_count);
+    if (!licm.def_pos || !licm.label_pos || !licm.marks) goto licm_cleanup;
+
+    for (uint16_t i = 0; i < fn->instr_count; i++) {
+        if (fn->instrs[i].op == IR_ADDRL) licm_set_bit(licm.addr_taken, fn->instrs[i].a);
+    }
+
+    /* Inner loops hoist into outer loops, which are then revisited */
+    while (changed && rounds++ < fn->instr_count) {
+        changed = false;
+        licm_index(&licm);
+        /* Scanning backwards finds the last back edge of each header, so
+         * `continue` jumps fall inside the region */
+        for (uint16_t j = fn->instr_count; j-- > 0 && !changed;) {
+            uint16_t target = licm_jump_target(&fn->instrs[j]);
+            uint16_t start;
+            if (target == IR_NONE || target >= fn->label_count) continue;
+            start = licm.label_pos[target];
+            if (start == IR_NONE || start >= j) continue;
+            changed = licm_loop(&licm, start, j);
+        }
+    }
+
+licm_cleanup:
+    if (licm.def_pos) cc_free(licm.def_pos);
+    if (licm.label_pos) cc_free(licm.label_pos);
+    if (licm.marks) cc_free(licm.marks);
+}
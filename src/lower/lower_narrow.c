@@ -0,0 +1,127 @@
+#include "lower.h"
+
+#include "cc_compat.h"
+#include "common.h"
+#include "ir.h"
+
+/* Narrowing over the lowered IR of one function.
+ *
+ * Lowering promotes byte arithmetic to int as C does, so `char c = a + b`
+ * becomes trunc(add.16(zext a, zext b)). The low byte of a sum,
+ * difference, product, bitwise op, negation or left shift depends only on
+ * the low bytes of its operands, so when a value is only ever truncated
+ * the whole tree is redone at 8 bits: extensions are dropped, constants
+ * lose their high byte and the trunc becomes the op itself. */
+
+#define NARROW_MULTI_DEF 0xFFFE
+
+typedef struct {
+    ir_function_t* fn;
+    uint16_t* def_pos;
+    uint8_t* uses;
+} narrow_t;
+
+static void narrow_index(narrow_t* narrow) {
+    ir_function_t* fn = narrow->fn;
+    for (uint16_t v = 0; v < fn->vreg_count; v++) {
+        narrow->def_pos[v] = IR_NONE;
+        narrow->uses[v] = 0;
+    }
+    for (uint16_t i = 0; i < fn->instr_count; i++) {
+        const ir_instr_t* ins = &fn->instrs[i];
+        uint16_t a;
+        uint16_t b;
+        if (ir_op_has_dst(ins->op) && ins->dst < fn->vreg_count) {
+            narrow->def_pos[ins->dst] =
+                narrow->def_pos[ins->dst] == IR_NONE ? i : NARROW_MULTI_DEF;
+        }
+        ir_instr_operands(ins, &a, &b);
+        if (a != IR_NONE && a < fn->vreg_count && narrow->uses[a] < 0xFF) narrow->uses[a]++;
+        if (b != IR_NONE && b < fn->vreg_count && narrow->uses[b] < 0xFF) narrow->uses[b]++;
+    }
+}
+
+static bool narrow_wraps(uint8_t op) {
+    switch (op) {
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_AND: case IR_OR:
+        case IR_XOR: case IR_SHL: case IR_NEG: case IR_NOT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* The 16-bit instruction defining reg, if only one use reads it */
+static ir_instr_t* narrow_def(const narrow_t* narrow, uint16_t reg) {
+    uint16_t pos;
+    if (reg == IR_NONE || reg >= narrow->fn->vreg_count || narrow->uses[reg] != 1) return NULL;
+    pos = narrow->def_pos[reg];
+    if (pos == IR_NONE || pos == NARROW_MULTI_DEF) return NULL;
+    if (!(narrow->fn->instrs[pos].flags & IR_F_16)) return NULL;
+    return &narrow->fn->instrs[pos];
+}
+
+static bool narrow_check(const narrow_t* narrow, uint16_t reg) {
+    const ir_instr_t* ins = narrow_def(narrow, reg);
+    if (!ins) return false;
+    if (ins->op == IR_ZEXT || ins->op == IR_SEXT || ins->op == IR_CONST) return true;
+    if (!narrow_wraps(ins->op)) return false;
+    if (!narrow_check(narrow, ins->a)) return false;
+    return ins->op == IR_NEG || ins->op == IR_NOT || narrow_check(narrow, ins->b);
+}
+
+/* Redoes a checked tree at 8 bits; returns the register now holding its
+ * low byte */
+static uint16_t narrow_apply(narrow_t* narrow, uint16_t reg) {
+    ir_instr_t* ins = narrow_def(narrow, reg);
+    if (ins->op == IR_ZEXT || ins->op == IR_SEXT) {
+        ins->op = IR_NOP;
+        return ins->a;
+    }
+    ins->flags &= (uint8_t)~IR_F_16;
+    if (ins->op == IR_CONST) {
+        ins->a = (uint8_t)ins->a;
+        return reg;
+    }
+    ins->a = narrow_apply(narrow, ins->a);
+    if (ins->op != IR_NEG && ins->op != IR_NOT) ins->b = narrow_apply(narrow, ins->b);
+    return reg;
+}
+
+void lower_narrow(ir_function_t* fn) {
+    narrow_t narrow;
+    bool changed = false;
+    if (fn->instr_count == 0 || fn->vreg_count == 0) return;
+
+    narrow.fn = fn;
+    narrow.def_pos = (uint16_t*)cc_malloc(sizeof(uint16_t) * fn->vreg_count);
+    narrow.uses = (uint8_t*)cc_malloc(fn->vreg_count);
+    if (!narrow.def_pos || !narrow.uses) goto narrow_cleanup;
+
+    narrow_index(&narrow);
+    for (uint16_t i = 0; i < fn->instr_count; i++) {
+        ir_instr_t* trunc = &fn->instrs[i];
+        ir_instr_t* op;
+        if (trunc->op != IR_TRUNC || !narrow_check(&narrow, trunc->a)) continue;
+        op = narrow_def(&narrow, trunc->a);
+        if (op->op == IR_ZEXT || op->op == IR_SEXT || op->op == IR_CONST) continue;
+        /* The op writes the trunc's register itself */
+        narrow_apply(&narrow, trunc->a);
+        op->dst = trunc->dst;
+        trunc->op = IR_NOP;
+        changed = true;
+    }
+
+    /* Drop the dead extensions and truncs so isel sees adjacent pairs */
+    if (changed) {
+        uint16_t kept = 0;
+        for (uint16_t i = 0; i < fn->instr_count; i++) {
+            if (fn->instrs[i].op != IR_NOP) fn->instrs[kept++] = fn->instrs[i];
+        }
+        fn->instr_count = kept;
+    }
+
+narrow_cleanup:
+    if (narrow.def_pos) cc_free(narrow.def_pos);
+    if (narrow.uses) cc_free(narrow.uses);
+}
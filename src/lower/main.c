@@ -0,0 +1,85 @@
+#include "ast_io.h"
+#include "ast_reader.h"
+#include "cc_compat.h"
+#include "common.h"
+#include "lower.h"
+#include "target.h"
+
+static const char LOWER_MSG_USAGE[] = "Usage: cc_lower <input.ast> <output.ir>\n";
+static const char LOWER_MSG_FAILED_READ_AST_HEADER[] = "Failed to read AST header\n";
+static const char LOWER_MSG_FAILED_READ_AST_STRING_TABLE[] = "Failed to read AST string table\n";
+static const char LOWER_MSG_FAILED_OPEN_OUTPUT[] = "Failed to open output file\n";
+static const char LOWER_MSG_FAILED[] = "Lowering failed\n";
+
+reader_t* reader;
+ast_reader_t* ast;
+ast_reader_t ast_ctx;
+lower_t lower_ctx;
+static lower_t* lower_handle;
+
+static void cleanup(void) {
+    lower_destroy(lower_handle);
+    ast_reader_destroy();
+    reader_close(reader);
+}
+
+static void handle_error(char* msg) {
+    log_error(msg);
+    cleanup();
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    int8_t err = 1;
+    args_t args;
+    cc_error_t result;
+
+    ast = &ast_ctx;
+    mem_set(ast, 0, sizeof(ast_ctx));
+    cc_init_pool_default();
+
+    args = parse_args(argc, argv, ARG_MODE_IN_OUT);
+    if (args.error) {
+        log_error(LOWER_MSG_USAGE);
+        return 1;
+    }
+
+    reader = reader_open(args.input_file);
+    if (!reader) return 1;
+
+    ast_read_handler(handle_error, "Failed to read AST\n");
+    ast_write_handler(handle_error, "Failed to write IR\n");
+    if (ast_reader_init() < 0) {
+        log_error(LOWER_MSG_FAILED_READ_AST_HEADER);
+        goto cleanup;
+    }
+    if (ast_reader_load_strings() < 0) {
+        log_error(LOWER_MSG_FAILED_READ_AST_STRING_TABLE);
+        goto cleanup;
+    }
+    lower_handle = lower_create(args.output_file);
+    if (!lower_handle) {
+        log_error(LOWER_MSG_FAILED_OPEN_OUTPUT);
+        goto cleanup;
+    }
+
+    result = lower_generate_stream();
+    if (result != CC_OK) {
+        log_error(LOWER_MSG_FAILED);
+        goto cleanup;
+    }
+
+    log_msg(args.input_file);
+    log_msg(" -> ");
+    log_msg(args.output_file);
+    log_msg("\n");
+
+    err = 0;
+
+cleanup:
+    cleanup();
+#if CC_STATS
+    if (args.stats) cc_stats_print("cc_lower");
+#endif
+    return err;
+}
@@ -0,0 +1,1106 @@
+#include "inline.h"
+
+#include "cc_compat.h"
+#include "common.h"
+#include "parser.h"
+#include "symbol.h"
+
+/* Call-site inlining on the parsed AST, one declaration at a time.
+ *
+ * A function becomes a candidate once it has been parsed if its body is
+ * either a single `return E;` or a run of assignments and calls, and it is
+ * small (INLINE_MAX_NODES, or INLINE_HINT_MAX_NODES when declared
+ * `inline`). Calls to candidates in later functions are replaced by the
+ * body: arguments are bound to `__a<i>_<type>` temporaries, the value of
+ * E goes to a `__r<k>_<type>` temporary, and both assignments are placed
+ * in front of the statement holding the call. The temporaries become
+ * locals at the top of the caller.
+ *
+ * Calls whose evaluation is conditional (the right side of && / ||, a
+ * while condition, a for condition or increment) stay out of line.
+ *
+ * Streamed callers (inline_stream_begin) are expanded statement by
+ * statement and only know the locals declared so far. A callee reading a
+ * global that a later local hides is caught when the caller ends; the
+ * caller is then remembered, and on the repeated pass it only takes
+ * callees that read nothing but their parameters. */
+
+#define INLINE_MAX_PARAMS 8
+#define INLINE_MAX_STMTS 255
+#define INLINE_HASH_BITS 256
+#define INLINE_MAX_SHADOWED 8
+
+typedef struct {
+    ast_node_t* fn;
+    bool is_void;
+    uint32_t bytes;
+    uint16_t nodes;
+} inline_candidate_t;
+
+typedef struct {
+    ast_node_t* items[INLINE_MAX_PENDING];
+    uint8_t count;
+    uint8_t result_next;
+} inline_pending_t;
+
+typedef struct {
+    bool planning;
+    inline_candidate_t candidates[INLINE_MAX_CANDIDATES];
+    uint8_t candidate_count;
+    cc_arena_t arena; /* the candidates' copies, outliving each caller */
+    /* Hashed names of functions still called out of line */
+    uint8_t called[INLINE_HASH_BITS / 8];
+    char* dropped[INLINE_MAX_CANDIDATES];
+    uint8_t dropped_count;
+
+    /* Streamed callers where a later local hid a callee's global */
+    char* shadowed[INLINE_MAX_SHADOWED];
+    uint8_t shadowed_count;
+    bool shadowed_all;
+
+    /* Current caller */
+    const char* locals[INLINE_MAX_LOCALS];
+    uint8_t local_count;
+    bool locals_overflow;
+    ast_node_t* temps[INLINE_MAX_TEMPS];
+    uint8_t temp_count;
+    cc_arena_t temp_arena; /* with the trees in an arena: the temps, per caller */
+    /* Streamed caller: locals are copies, expanded is a bit per candidate */
+    bool streaming;
+    bool strict;
+    uint8_t expanded;
+} inline_state_t;
+
+static inline_state_t g_inline;
+
+static uint8_t inline_hash(const char* name) {
+    uint8_t hash = 0;
+    while (*name) {
+        hash = (uint8_t)((hash << 3) + (hash >> 5) + (uint8_t)*name++);
+    }
+    return hash;
+}
+
+static void inline_note_call(const char* name) {
+    uint8_t hash;
+    if (!g_inline.planning || !name) return;
+    hash = inline_hash(name);
+    g_inline.called[hash >> 3] |= (uint8_t)(1u << (hash & 7));
+}
+
+static bool inline_is_called(const char* name) {
+    uint8_t hash = inline_hash(name);
+    return (g_inline.called[hash >> 3] & (1u << (hash & 7))) != 0;
+}
+
+static inline_candidate_t* inline_find(const char* name) {
+    for (uint8_t i = 0; i < g_inline.candidate_count; i++) {
+        if (str_cmp(g_inline.candidates[i].fn->data.function.name, name) == 0) {
+            return &g_inline.candidates[i];
+        }
+    }
+    return NULL;
+}
+
+static void inline_clear_candidates(void) {
+    for (uint8_t i = 0; i < g_inline.candidate_count; i++) {
+        g_inline.candidates[i].fn = NULL;
+    }
+    g_inline.candidate_count = 0;
+    cc_arena_free(&g_inline.arena);
+}
+
+static ast_node_t* inline_node(ast_node_type_t type) {
+    ast_node_t* node = (ast_node_t*)cc_tree_alloc(sizeof(ast_node_t));
+    if (!node) return NULL;
+    mem_set(node, 0, sizeof(ast_node_t));
+    node->type = type;
+    return node;
+}
+
+static ast_node_t* inline_ident(const char* name) {
+    ast_node_t* node = inline_node(AST_IDENTIFIER);
+    if (!node) return NULL;
+    node->data.identifier.name = cc_tree_strdup(name);
+    if (!node->data.identifier.name) {
+        cc_tree_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+/* ---- AST walks ---- */
+
+static uint16_t inline_count_nodes(const ast_node_t* node) {
+    uint16_t count;
+    if (!node) return 0;
+    count = 1;
+    switch (node->type) {
+        case AST_COMPOUND_STMT:
+            for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
+                count = (uint16_t)(count + inline_count_nodes(node->data.compound.statements[i]));
+            }
+            break;
+        case AST_RETURN_STMT:
+            count = (uint16_t)(count + inline_count_nodes(node->data.return_stmt.expr));
+            break;
+        case AST_ASSIGN:
+            count = (uint16_t)(count + inline_count_nodes(node->data.assign.lvalue));
+            count = (uint16_t)(count + inline_count_nodes(node->data.assign.rvalue));
+            break;
+        case AST_CALL:
+            for (ast_arg_count_t i = 0; i < node->data.call.arg_count; i++) {
+                count = (uint16_t)(count + inline_count_nodes(node->data.call.args[i]));
+            }
+            break;
+        case AST_BINARY_OP:
+            count = (uint16_t)(count + inline_count_nodes(node->data.binary_op.left));
+            count = (uint16_t)(count + inline_count_nodes(node->data.binary_op.right));
+            break;
+        case AST_UNARY_OP:
+            count = (uint16_t)(count + inline_count_nodes(node->data.unary_op.operand));
+            break;
+        case AST_ARRAY_ACCESS:
+            count = (uint16_t)(count + inline_count_nodes(node->data.array_access.base));
+            count = (uint16_t)(count + inline_count_nodes(node->data.array_access.index));
+            break;
+        default:
+            break;
+    }
+    return count;
+}
+
+/* Walks an expression or simple statement; returns true as soon as
+ * `visit` does. */
+typedef bool (*inline_visit_fn)(const ast_node_t* node, const void* arg);
+
+static bool inline_any(const ast_node_t* node, inline_visit_fn visit, const void* arg) {
+    if (!node) return false;
+    if (visit(node, arg)) return true;
+    switch (node->type) {
+        case AST_COMPOUND_STMT:
+            for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
+                if (inline_any(node->data.compound.statements[i], visit, arg)) return true;
+            }
+            return false;
+        case AST_RETURN_STMT:
+            return inline_any(node->data.return_stmt.expr, visit, arg);
+        case AST_ASSIGN:
+            return inline_any(node->data.assign.lvalue, visit, arg) ||
+                   inline_any(node->data.assign.rvalue, visit, arg);
+        case AST_CALL:
+            for (ast_arg_count_t i = 0; i < node->data.call.arg_count; i++) {
+                if (inline_any(node->data.call.args[i], visit, arg)) return true;
+            }
+            return false;
+        case AST_BINARY_OP:
+            return inline_any(node->data.binary_op.left, visit, arg) ||
+                   inline_any(node->data.binary_op.right, visit, arg);
+        case AST_UNARY_OP:
+            return inline_any(node->data.unary_op.operand, visit, arg);
+        case AST_ARRAY_ACCESS:
+            return inline_any(node->data.array_access.base, visit, arg) ||
+                   inline_any(node->data.array_access.index, visit, arg);
+        default:
+            return false;
+    }
+}
+
+static bool inline_visit_calls_name(const ast_node_t* node, const void* arg) {
+    return node->type == AST_CALL && str_cmp(node->data.call.name, (const char*)arg) == 0;
+}
+
+static bool inline_is_param(const ast_node_t* fn, const char* name) {
+    for (ast_param_count_t i = 0; i < fn->data.function.param_count; i++) {
+        if (str_cmp(fn->data.function.params[i]->data.var_decl.name, name) == 0) return true;
+    }
+    return false;
+}
+
+static bool inline_is_local(const char* name) {
+    for (uint8_t i = 0; i < g_inline.local_count; i++) {
+        if (str_cmp(g_inline.locals[i], name) == 0) return true;
+    }
+    return false;
+}
+
+/* A global read by the callee must not be hidden by a caller local */
+static bool inline_visit_shadowed(const ast_node_t* node, const void* arg) {
+    if (node->type != AST_IDENTIFIER) return false;
+    if (inline_is_param((const ast_node_t*)arg, node->data.identifier.name)) return false;
+    return inline_is_local(node->data.identifier.name);
+}
+
+/* Strict callers: any name that is not a parameter may be hidden later */
+static bool inline_visit_global(const ast_node_t* node, const void* arg) {
+    if (node->type != AST_IDENTIFIER) return false;
+    return !inline_is_param((const ast_node_t*)arg, node->data.identifier.name);
+}
+
+static bool inline_visit_writes(const ast_node_t* node, const void* arg) {
+    const ast_node_t* target = NULL;
+    if (node->type == AST_ASSIGN) {
+        target = node->data.assign.lvalue;
+    } else if (node->type == AST_UNARY_OP &&
+               (node->data.unary_op.op == OP_ADDR || node->data.unary_op.op == OP_PREINC ||
+                node->data.unary_op.op == OP_PREDEC || node->data.unary_op.op == OP_POSTINC ||
+                node->data.unary_op.op == OP_POSTDEC)) {
+        target = node->data.unary_op.operand;
+    }
+    return target && target->type == AST_IDENTIFIER &&
+           str_cmp(target->data.identifier.name, (const char*)arg) == 0;
+}
+
+static void inline_collect_locals(const ast_node_t* node) {
+    if (!node) return;
+    switch (node->type) {
+        case AST_VAR_DECL:
+            if (g_inline.local_count >= INLINE_MAX_LOCALS) {
+                g_inline.locals_overflow = true;
+                return;
+            }
+            g_inline.locals[g_inline.local_count++] = node->data.var_decl.name;
+            return;
+        case AST_COMPOUND_STMT:
+            for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
+                inline_collect_locals(node->data.compound.statements[i]);
+            }
+            return;
+        case AST_IF_STMT:
+            inline_collect_locals(node->data.if_stmt.then_branch);
+            inline_collect_locals(node->data.if_stmt.else_branch);
+            return;
+        case AST_WHILE_STMT:
+            inline_collect_locals(node->data.while_stmt.body);
+            return;
+        case AST_FOR_STMT:
+            inline_collect_locals(node->data.for_stmt.init);
+            inline_collect_locals(node->data.for_stmt.body);
+            return;
+        default:
+            return;
+    }
+}
+
+/* Streamed callers keep copies: their declarations are freed once written */
+static int8_t inline_stream_local(const ast_node_t* decl) {
+    char* name;
+    if (decl->type != AST_VAR_DECL) return 0;
+    if (g_inline.local_count >= INLINE_MAX_LOCALS) {
+        g_inline.locals_overflow = true;
+        return 0;
+    }
+    name = cc_strdup(decl->data.var_decl.name);
+    if (!name) return -1;
+    g_inline.locals[g_inline.local_count++] = name;
+    return 0;
+}
+
+static void inline_free_locals(void) {
+    if (g_inline.streaming) {
+        while (g_inline.local_count > 0) {
+            cc_free((void*)g_inline.locals[--g_inline.local_count]);
+        }
+    }
+    g_inline.local_count = 0;
+    g_inline.streaming = false;
+}
+
+/* Records every call (and bare function name) left in `node` */
+static bool inline_visit_note(const ast_node_t* node, const void* arg) {
+    (void)arg;
+    if (node->type == AST_CALL) {
+        inline_note_call(node->data.call.name);
+    } else if (node->type == AST_IDENTIFIER && inline_find(node->data.identifier.name)) {
+        inline_note_call(node->data.identifier.name);
+    }
+    return false;
+}
+
+static void inline_note_all(const ast_node_t* node) {
+    if (g_inline.planning) inline_any(node, inline_visit_note, NULL);
+}
+
+/* ---- Cloning with parameter substitution ---- */
+
+typedef struct {
+    const ast_node_t* fn;
+    ast_node_t* const* bindings;
+} inline_subst_t;
+
+static ast_node_t* inline_clone(const ast_node_t* node, const inline_subst_t* subst) {
+    ast_node_t* copy;
+    if (!node) return NULL;
+    if (node->type == AST_IDENTIFIER && subst) {
+        for (ast_param_count_t i = 0; i < subst->fn->data.function.param_count; i++) {
+            if (str_cmp(subst->fn->data.function.params[i]->data.var_decl.name,
+                        node->data.identifier.name) == 0) {
+                return inline_clone(subst->bindings[i], NULL);
+            }
+        }
+    }
+    copy = inline_node(node->type);
+    if (!copy) return NULL;
+    switch (node->type) {
+        case AST_IDENTIFIER:
+            copy->data.identifier.name = cc_tree_strdup(node->data.identifier.name);
+            if (!copy->data.identifier.name) goto clone_fail;
+            break;
+        case AST_CONSTANT:
+            copy->data.constant.int_value = node->data.constant.int_value;
+            break;
+        case AST_STRING_LITERAL:
+            copy->data.string_literal.value = cc_tree_strdup(node->data.string_literal.value);
+            if (!copy->data.string_literal.value) goto clone_fail;
+            break;
+        case AST_ASSIGN:
+            copy->data.assign.lvalue = inline_clone(node->data.assign.lvalue, subst);
+            copy->data.assign.rvalue = inline_clone(node->data.assign.rvalue, subst);
+            if (!copy->data.assign.lvalue || !copy->data.assign.rvalue) goto clone_fail;
+            break;
+        case AST_BINARY_OP:
+            copy->data.binary_op.op = node->data.binary_op.op;
+            copy->data.binary_op.left = inline_clone(node->data.binary_op.left, subst);
+            copy->data.binary_op.right = inline_clone(node->data.binary_op.right, subst);
+            if (!copy->data.binary_op.left || !copy->data.binary_op.right) goto clone_fail;
+            break;
+        case AST_UNARY_OP:
+            copy->data.unary_op.op = node->data.unary_op.op;
+            copy->data.unary_op.operand = inline_clone(node->data.unary_op.operand, subst);
+            if (!copy->data.unary_op.operand) goto clone_fail;
+            break;
+        case AST_ARRAY_ACCESS:
+            copy->data.array_access.base = inline_clone(node->data.array_access.base, subst);
+            copy->data.array_access.index = inline_clone(node->data.array_access.index, subst);
+            if (!copy->data.array_access.base || !copy->data.array_access.index) goto clone_fail;
+            break;
+        case AST_CALL:
+            copy->data.call.name = cc_tree_strdup(node->data.call.name);
+            if (!copy->data.call.name) goto clone_fail;
+            if (node->data.call.arg_count > 0) {
+                copy->data.call.args = (ast_node_t**)cc_tree_alloc(
+                    sizeof(ast_node_t*) * node->data.call.arg_count);
+                if (!copy->data.call.args) goto clone_fail;
+                for (ast_arg_count_t i = 0; i < node->data.call.arg_count; i++) {
+                    copy->data.call.args[i] = inline_clone(node->data.call.args[i], subst);
+                    copy->data.call.arg_count = (ast_arg_count_t)(i + 1);
+                    if (!copy->data.call.args[i]) goto clone_fail;
+                }
+            }
+            if (subst) inline_note_call(node->data.call.name);
+            break;
+        case AST_RETURN_STMT:
+            if (node->data.return_stmt.expr) {
+                copy->data.return_stmt.expr = inline_clone(node->data.return_stmt.expr, subst);
+                if (!copy->data.return_stmt.expr) goto clone_fail;
+            }
+            break;
+        case AST_VAR_DECL:
+            copy->data.var_decl.name = cc_tree_strdup(node->data.var_decl.name);
+            copy->data.var_decl.var_type = type_clone(node->data.var_decl.var_type);
+            if (!copy->data.var_decl.name || !copy->data.var_decl.var_type) goto clone_fail;
+            break;
+        case AST_COMPOUND_STMT:
+            if (node->data.compound.stmt_count > 0) {
+                copy->data.compound.statements = (ast_node_t**)cc_tree_alloc(
+                    sizeof(ast_node_t*) * node->data.compound.stmt_count);
+                if (!copy->data.compound.statements) goto clone_fail;
+                for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
+                    copy->data.compound.statements[i] =
+                        inline_clone(node->data.compound.statements[i], subst);
+                    copy->data.compound.stmt_count = (ast_stmt_count_t)(i + 1);
+                    if (!copy->data.compound.statements[i]) goto clone_fail;
+                }
+            }
+            break;
+        default:
+            /* Candidates only hold the node kinds above */
+            goto clone_fail;
+    }
+    return copy;
+
+clone_fail:
+    ast_node_destroy(copy);
+    return NULL;
+}
+
+/* Clones the parts of `fn` a call site needs: name, types, params, body */
+static ast_node_t* inline_clone_function(const ast_node_t* fn) {
+    ast_node_t* copy = inline_node(AST_FUNCTION);
+    if (!copy) return NULL;
+    copy->data.function.flags = fn->data.function.flags;
+    copy->data.function.name = cc_tree_strdup(fn->data.function.name);
+    copy->data.function.return_type = type_clone(fn->data.function.return_type);
+    if (!copy->data.function.name || !copy->data.function.return_type) goto clone_fail;
+    if (fn->data.function.param_count > 0) {
+        copy->data.function.params = (ast_node_t**)cc_tree_alloc(
+            sizeof(ast_node_t*) * fn->data.function.param_count);
+        if (!copy->data.function.params) goto clone_fail;
+        for (ast_param_count_t i = 0; i < fn->data.function.param_count; i++) {
+            copy->data.function.params[i] = inline_clone(fn->data.function.params[i], NULL);
+            copy->data.function.param_count = (ast_param_count_t)(i + 1);
+            if (!copy->data.function.params[i]) goto clone_fail;
+        }
+    }
+    copy->data.function.body = inline_clone(fn->data.function.body, NULL);
+    if (!copy->data.function.body) goto clone_fail;
+    return copy;
+
+clone_fail:
+    ast_node_destroy(copy);
+    return NULL;
+}
+
+/* ---- Candidates ---- */
+
+static bool inline_qualifies(const ast_node_t* fn, bool* out_void) {
+    const ast_node_t* body = fn->data.function.body;
+    const type_t* ret = fn->data.function.return_type;
+    bool is_void = ret && ret->kind == TYPE_VOID;
+    uint16_t limit = (fn->data.function.flags & AST_FUNC_INLINE) ?
+        INLINE_HINT_MAX_NODES : INLINE_MAX_NODES;
+
+    if (!body || body->type != AST_COMPOUND_STMT || !ret) return false;
+    if (str_cmp(fn->data.function.name, "main") == 0) return false;
+    if (fn->data.function.param_count > INLINE_MAX_PARAMS) return false;
+    if (inline_count_nodes(body) - 1u > limit) return false;
+    if (inline_any(body, inline_visit_calls_name, fn->data.function.name)) return false;
+    for (ast_param_count_t i = 0; i < fn->data.function.param_count; i++) {
+        const ast_node_t* param = fn->data.function.params[i];
+        if (!param || param->type != AST_VAR_DECL || !param->data.var_decl.var_type) return false;
+    }
+
+    if (!is_void) {
+        const ast_node_t* stmt;
+        if (body->data.compound.stmt_count != 1) return false;
+        stmt = body->data.compound.statements[0];
+        if (stmt->type != AST_RETURN_STMT || !stmt->data.return_stmt.expr) return false;
+        *out_void = false;
+        return true;
+    }
+    for (ast_stmt_count_t i = 0; i < body->data.compound.stmt_count; i++) {
+        const ast_node_t* stmt = body->data.compound.statements[i];
+        bool is_last = (ast_stmt_count_t)(i + 1) == body->data.compound.stmt_count;
+        if (stmt->type == AST_ASSIGN || stmt->type == AST_CALL) continue;
+        if (is_last && stmt->type == AST_RETURN_STMT && !stmt->data.return_stmt.expr) continue;
+        return false;
+    }
+    *out_void = true;
+    return true;
+}
+
+static int8_t inline_consider(const ast_node_t* fn) {
+    bool is_void = false;
+    cc_arena_t* prev;
+    ast_node_t* copy;
+    if (g_inline.candidate_count >= INLINE_MAX_CANDIDATES) return 0;
+    if (inline_find(fn->data.function.name)) return 0;
+    if (!inline_qualifies(fn, &is_void)) return 0;
+    prev = cc_tree_arena(&g_inline.arena);
+    copy = inline_clone_function(fn);
+    cc_tree_arena(prev);
+    if (!copy) return -1;
+    g_inline.candidates[g_inline.candidate_count].fn = copy;
+    g_inline.candidates[g_inline.candidate_count].is_void = is_void;
+    g_inline.candidates[g_inline.candidate_count].bytes = 0;
+    g_inline.candidates[g_inline.candidate_count].nodes = 0;
+    g_inline.candidate_count++;
+    return 0;
+}
+
+/* ---- Temporaries ---- */
+
+/* Builds `__<kind><index>_<type>`; the type suffix keeps one temporary per
+ * slot and type, so call sites in the same caller share them. */
+static void inline_temp_name(char* out, char kind, uint8_t index, const type_t* type) {
+    uint8_t depth = 0;
+    uint8_t n = 0;
+    char base = 'i';
+    while (type && (type->kind == TYPE_POINTER || type->kind == TYPE_ARRAY)) {
+        depth++;
+        type = type->kind == TYPE_POINTER ? type->data.pointer.base_type :
+                                            type->data.array.element_type;
+    }
+    if (type && type->kind == TYPE_CHAR) base = 'c';
+    if (type && type->kind == TYPE_VOID) base = 'v';
+    out[n++] = '_';
+    out[n++] = '_';
+    out[n++] = kind;
+    if (index >= 10) out[n++] = (char)('0' + index / 10);
+    out[n++] = (char)('0' + index % 10);
+    out[n++] = '_';
+    out[n++] = (type && type->is_signed) ? 's' : 'u';
+    out[n++] = base;
+    out[n++] = (char)('0' + depth);
+    out[n] = '\0';
+}
+
+static bool inline_has_temp(const char* name) {
+    for (uint8_t i = 0; i < g_inline.temp_count; i++) {
+        if (str_cmp(g_inline.temps[i]->data.var_decl.name, name) == 0) return true;
+    }
+    return false;
+}
+
+/* Declares temporary `name` of `type` (arrays decay to pointers) */
+static int8_t inline_add_temp(const char* name, const type_t* type) {
+    ast_node_t* decl;
+    cc_arena_t* prev = g_cc_tree_arena;
+    if (inline_has_temp(name)) return 0;
+    if (g_inline.temp_count >= INLINE_MAX_TEMPS) return -1;
+    /* The caller's arena is released statement by statement */
+    if (prev) cc_tree_arena(&g_inline.temp_arena);
+    decl = inline_node(AST_VAR_DECL);
+    if (decl) {
+        decl->data.var_decl.name = cc_tree_strdup(name);
+        if (type->kind == TYPE_ARRAY) {
+            type_t* element = type_clone(type->data.array.element_type);
+            decl->data.var_decl.var_type = element ? type_create_pointer(element) : NULL;
+            if (element && !decl->data.var_decl.var_type) type_destroy(element);
+        } else {
+            decl->data.var_decl.var_type = type_clone(type);
+        }
+        if (!decl->data.var_decl.name || !decl->data.var_decl.var_type) {
+            ast_node_destroy(decl);
+            decl = NULL;
+        }
+    }
+    if (prev) cc_tree_arena(prev);
+    if (!decl) return -1;
+    g_inline.temps[g_inline.temp_count++] = decl;
+    return 0;
+}
+
+static ast_node_t* inline_assign(const char* name, ast_node_t* value) {
+    ast_node_t* node = inline_node(AST_ASSIGN);
+    if (!node) return NULL;
+    node->data.assign.lvalue = inline_ident(name);
+    node->data.assign.rvalue = value;
+    if (!node->data.assign.lvalue || !value) {
+        ast_node_destroy(node);
+        return NULL;
+    }
+    return node;
+}
+
+/* A constant argument can replace the parameter outright when the
+ * parameter is read-only and the value survives conversion to it. */
+static bool inline_bind_constant(const ast_node_t* callee, const ast_node_t* param,
+                                 const ast_node_t* arg) {
+    const type_t* type = param->data.var_decl.var_type;
+    int16_t value;
+    if (arg->type != AST_CONSTANT) return false;
+    if (type->kind != TYPE_CHAR && type->kind != TYPE_INT) return false;
+    value = arg->data.constant.int_value;
+    if (type->kind == TYPE_CHAR && (value < 0 || value > 127)) return false;
+    if (type->kind == TYPE_INT && !type->is_signed && value < 0) return false;
+    return !inline_any(callee->data.function.body, inline_visit_writes,
+                       param->data.var_decl.name);
+}
+
+/* ---- Call sites ---- */
+
+static void inline_drop_pending(inline_pending_t* pending, uint8_t mark) {
+    while (pending->count > mark) {
+        ast_node_destroy(pending->items[--pending->count]);
+    }
+}
+
+/* Replaces call `*slot` with the callee body. Statements go to `pending`;
+ * a value-returning call leaves its result temporary in `*slot`. Returns
+ * 1 when expanded, 0 when the call stays, -1 when out of memory. */
+static int8_t inline_call(ast_node_t** slot, inline_pending_t* pending, bool as_statement) {
+    ast_node_t* call = *slot;
+    const inline_candidate_t* cand = inline_find(call->data.call.name);
+    const ast_node_t* callee;
+    ast_node_t* bindings[INLINE_MAX_PARAMS];
+    uint8_t arg_stmt[INLINE_MAX_PARAMS];
+    ast_param_count_t param_count;
+    uint8_t mark = pending->count;
+    uint8_t temps_mark = g_inline.temp_count;
+    char name[12];
+    inline_subst_t subst;
+
+    if (!cand || g_inline.locals_overflow) return 0;
+    callee = cand->fn;
+    param_count = callee->data.function.param_count;
+    if (call->data.call.arg_count != param_count) return 0;
+    if (cand->is_void && !as_statement) return 0;
+    if (inline_any(callee->data.function.body, inline_visit_shadowed, callee)) return 0;
+    if (g_inline.strict && inline_any(callee->data.function.body, inline_visit_global, callee)) {
+        return 0;
+    }
+    if ((uint16_t)pending->count + param_count + callee->data.function.body->data.compound.stmt_count
+        > INLINE_MAX_PENDING) {
+        return 0;
+    }
+
+    mem_set(bindings, 0, sizeof(bindings));
+    mem_set(arg_stmt, 0xFF, sizeof(arg_stmt));
+    for (ast_param_count_t i = 0; i < param_count; i++) {
+        const ast_node_t* param = callee->data.function.params[i];
+        ast_node_t* stmt;
+        if (inline_bind_constant(callee, param, call->data.call.args[i])) {
+            bindings[i] = call->data.call.args[i];
+            continue;
+        }
+        inline_temp_name(name, 'a', (uint8_t)i, param->data.var_decl.var_type);
+        if (inline_add_temp(name, param->data.var_decl.var_type) < 0) goto call_undo;
+        bindings[i] = inline_ident(name);
+        stmt = inline_assign(name, call->data.call.args[i]);
+        if (!bindings[i] || !stmt) {
+            ast_node_destroy(bindings[i]);
+            bindings[i] = NULL;
+            goto call_undo;
+        }
+        call->data.call.args[i] = NULL;
+        arg_stmt[i] = pending->count;
+        pending->items[pending->count++] = stmt;
+    }
+
+    subst.fn = callee;
+    subst.bindings = bindings;
+    if (cand->is_void) {
+        const ast_node_t* body = callee->data.function.body;
+        for (ast_stmt_count_t i = 0; i < body->data.compound.stmt_count; i++) {
+            const ast_node_t* stmt = body->data.compound.statements[i];
+            ast_node_t* copy;
+            if (stmt->type == AST_RETURN_STMT) break;
+            copy = inline_clone(stmt, &subst);
+            if (!copy) goto call_undo;
+            pending->items[pending->count++] = copy;
+        }
+        ast_node_destroy(call);
+        *slot = NULL;
+    } else {
+        const ast_node_t* expr = callee->data.function.body->data.compound.statements[0]
+                                     ->data.return_stmt.expr;
+        ast_node_t* result;
+        ast_node_t* stmt;
+        inline_temp_name(name, 'r', pending->result_next, callee->data.function.return_type);
+        if (inline_add_temp(name, callee->data.function.return_type) < 0) goto call_undo;
+        stmt = inline_assign(name, inline_clone(expr, &subst));
+        result = inline_ident(name);
+        if (!stmt || !result) {
+            ast_node_destroy(stmt);
+            ast_node_destroy(result);
+            goto call_undo;
+        }
+        pending->items[pending->count++] = stmt;
+        pending->result_next++;
+        ast_node_destroy(call);
+        *slot = result;
+    }
+    g_inline.expanded |= (uint8_t)(1u << (uint8_t)(cand - g_inline.candidates));
+    for (ast_param_count_t i = 0; i < param_count; i++) {
+        if (bindings[i] && bindings[i]->type == AST_IDENTIFIER) ast_node_destroy(bindings[i]);
+    }
+    return 1;
+
+call_undo:
+    /* Hand the arguments back to the call before dropping the partial body */
+    for (ast_param_count_t i = 0; i < param_count; i++) {
+        if (arg_stmt[i] != 0xFF) {
+            call->data.call.args[i] = pending->items[arg_stmt[i]]->data.assign.rvalue;
+            pending->items[arg_stmt[i]]->data.assign.rvalue = NULL;
+        }
+        if (bindings[i] && bindings[i] != call->data.call.args[i]) ast_node_destroy(bindings[i]);
+    }
+    inline_drop_pending(pending, mark);
+    while (g_inline.temp_count > temps_mark) {
+        ast_node_destroy(g_inline.temps[--g_inline.temp_count]);
+    }
+    return 0;
+}
+
+/* Expands the calls in expression `*slot` whose evaluation is unconditional */
+static int8_t inline_expr(ast_node_t** slot, inline_pending_t* pending) {
+    ast_node_t* node = *slot;
+    int8_t rc;
+    if (!node) return 0;
+    switch (node->type) {
+        case AST_CALL:
+            for (ast_arg_count_t i = 0; i < node->data.call.arg_count; i++) {
+                if (inline_expr(&node->data.call.args[i], pending) < 0) return -1;
+            }
+            rc = inline_call(slot, pending, false);
+            if (rc == 0) inline_note_call(node->data.call.name);
+            return rc < 0 ? -1 : 0;
+        case AST_IDENTIFIER:
+            inline_visit_note(node, NULL);
+            return 0;
+        case AST_ASSIGN:
+            if (inline_expr(&node->data.assign.lvalue, pending) < 0) return -1;
+            return inline_expr(&node->data.assign.rvalue, pending);
+        case AST_BINARY_OP:
+            if (inline_expr(&node->data.binary_op.left, pending) < 0) return -1;
+            if (node->data.binary_op.op == OP_LAND || node->data.binary_op.op == OP_LOR) {
+                inline_note_all(node->data.binary_op.right);
+                return 0;
+            }
+            return inline_expr(&node->data.binary_op.right, pending);
+        case AST_UNARY_OP:
+            return inline_expr(&node->data.unary_op.operand, pending);
+        case AST_ARRAY_ACCESS:
+            if (inline_expr(&node->data.array_access.base, pending) < 0) return -1;
+            return inline_expr(&node->data.array_access.index, pending);
+        default:
+            return 0;
+    }
+}
+
+static int8_t inline_compound(ast_node_t* compound);
+static int8_t inline_substatement(ast_node_t** slot);
+
+/* Expands the calls in statement `*slot`; code that must run first goes
+ * to `pending`. A statement left with no effect is removed (NULL). */
+static int8_t inline_statement(ast_node_t** slot, inline_pending_t* pending) {
+    ast_node_t* node = *slot;
+    int8_t rc;
+    switch (node->type) {
+        case AST_COMPOUND_STMT:
+            return inline_compound(node);
+        case AST_IF_STMT:
+            if (inline_expr(&node->data.if_stmt.condition, pending) < 0) return -1;
+            if (inline_substatement(&node->data.if_stmt.then_branch) < 0) return -1;
+            if (!node->data.if_stmt.else_branch) return 0;
+            return inline_substatement(&node->data.if_stmt.else_branch);
+        case AST_WHILE_STMT:
+            inline_note_all(node->data.while_stmt.condition);
+            return inline_substatement(&node->data.while_stmt.body);
+        case AST_FOR_STMT:
+            if (node->data.for_stmt.init &&
+                inline_statement(&node->data.for_stmt.init, pending) < 0) {
+                return -1;
+            }
+            inline_note_all(node->data.for_stmt.condition);
+            inline_note_all(node->data.for_stmt.increment);
+            return inline_substatement(&node->data.for_stmt.body);
+        case AST_RETURN_STMT:
+            return inline_expr(&node->data.return_stmt.expr, pending);
+        case AST_VAR_DECL:
+            return inline_expr(&node->data.var_decl.initializer, pending);
+        case AST_CALL:
+            for (ast_arg_count_t i = 0; i < node->data.call.arg_count; i++) {
+                if (inline_expr(&node->data.call.args[i], pending) < 0) return -1;
+            }
+            rc = inline_call(slot, pending, true);
+            if (rc < 0) return -1;
+            if (rc == 0) {
+                inline_note_call(node->data.call.name);
+                return 0;
+            }
+            break;
+        default:
+            if (inline_expr(slot, pending) < 0) return -1;
+            break;
+    }
+    /* A value-returning call used as a statement leaves only its temporary */
+    if (*slot && (*slot)->type == AST_IDENTIFIER) {
+        ast_node_destroy(*slot);
+        *slot = NULL;
+    }
+    return 0;
+}
+
+/* Wraps a non-compound body in a compound when its calls were expanded */
+static int8_t inline_substatement(ast_node_t** slot) {
+    inline_pending_t pending;
+    ast_node_t* block;
+    uint8_t count;
+    if (!*slot) return 0;
+    if ((*slot)->type == AST_COMPOUND_STMT) return inline_compound(*slot);
+    pending.count = 0;
+    pending.result_next = 0;
+    if (inline_statement(slot, &pending) < 0) {
+        inline_drop_pending(&pending, 0);
+        return -1;
+    }
+    if (pending.count == 0 && *slot) return 0;
+
+    block = inline_node(AST_COMPOUND_STMT);
+    count = (uint8_t)(pending.count + (*slot ? 1 : 0));
+    if (block && count > 0) {
+        block->data.compound.statements = (ast_node_t**)cc_tree_alloc(sizeof(ast_node_t*) * count);
+        if (!block->data.compound.statements) {
+            cc_tree_free(block);
+            block = NULL;
+        }
+    }
+    if (!block) {
+        inline_drop_pending(&pending, 0);
+        return -1;
+    }
+    mem_cpy(block->data.compound.statements, pending.items, sizeof(ast_node_t*) * pending.count);
+    if (*slot) block->data.compound.statements[pending.count] = *slot;
+    block->data.compound.stmt_count = count;
+    *slot = block;
+    return 0;
+}
+
+static int8_t inline_compound(ast_node_t* compound) {
+    for (uint16_t i = 0; i < compound->data.compound.stmt_count; i++) {
+        inline_pending_t pending;
+        ast_node_t** statements;
+        uint16_t old_count = compound->data.compound.stmt_count;
+        uint16_t new_count;
+        uint8_t keep;
+
+        pending.count = 0;
+        pending.result_next = 0;
+        if (inline_statement(&compound->data.compound.statements[i], &pending) < 0) {
+            inline_drop_pending(&pending, 0);
+            return -1;
+        }
+        keep = compound->data.compound.statements[i] ? 1 : 0;
+        if (pending.count == 0 && keep) continue;
+
+        new_count = (uint16_t)(old_count - 1u + pending.count + keep);
+        if (new_count > INLINE_MAX_STMTS) {
+            /* Expansions never grow a block past what the AST can count */
+            inline_drop_pending(&pending, 0);
+            cc_error("Inlined block too large");
+            return -1;
+        }
+        statements = new_count > 0 ?
+            (ast_node_t**)cc_tree_alloc(sizeof(ast_node_t*) * new_count) : NULL;
+        if (new_count > 0 && !statements) {
+            inline_drop_pending(&pending, 0);
+            return -1;
+        }
+        if (i > 0) {
+            mem_cpy(statements, compound->data.compound.statements, sizeof(ast_node_t*) * i);
+        }
+        mem_cpy(statements + i, pending.items, sizeof(ast_node_t*) * pending.count);
+        if (keep) statements[i + pending.count] = compound->data.compound.statements[i];
+        if (old_count > i + 1u) {
+            mem_cpy(statements + i + pending.count + keep,
+                    compound->data.compound.statements + i + 1,
+                    sizeof(ast_node_t*) * (old_count - i - 1u));
+        }
+        cc_tree_free(compound->data.compound.statements);
+        compound->data.compound.statements = statements;
+        compound->data.compound.stmt_count = (ast_stmt_count_t)new_count;
+        /* The expanded statements were already walked */
+        i = (uint16_t)(i + pending.count + keep - 1u);
+    }
+    return 0;
+}
+
+/* Puts the temporaries at the top of the caller body */
+static int8_t inline_declare_temps(ast_node_t* body) {
+    ast_node_t** statements;
+    uint16_t count = (uint16_t)(body->data.compound.stmt_count + g_inline.temp_count);
+    if (g_inline.temp_count == 0) return 0;
+    if (count > INLINE_MAX_STMTS) {
+        cc_error("Inlined block too large");
+        return -1;
+    }
+    statements = (ast_node_t**)cc_tree_alloc(sizeof(ast_node_t*) * count);
+    if (!statements) return -1;
+    mem_cpy(statements, g_inline.temps, sizeof(ast_node_t*) * g_inline.temp_count);
+    if (body->data.compound.stmt_count > 0) {
+        mem_cpy(statements + g_inline.temp_count, body->data.compound.statements,
+                sizeof(ast_node_t*) * body->data.compound.stmt_count);
+    }
+    cc_tree_free(body->data.compound.statements);
+    body->data.compound.statements = statements;
+    body->data.compound.stmt_count = (ast_stmt_count_t)count;
+    g_inline.temp_count = 0;
+    return 0;
+}
+
+/* ---- Public interface ---- */
+
+void inline_begin(bool planning) {
+    inline_clear_candidates();
+    g_inline.planning = planning;
+    if (planning) {
+        mem_set(g_inline.called, 0, sizeof(g_inline.called));
+        for (uint8_t i = 0; i < g_inline.dropped_count; i++) {
+            cc_free(g_inline.dropped[i]);
+        }
+        g_inline.dropped_count = 0;
+    }
+}
+
+int8_t inline_function(ast_node_t* fn) {
+    ast_node_t* body;
+    int8_t rc;
+    if (!fn || fn->type != AST_FUNCTION) return 0;
+    body = fn->data.function.body;
+    if (!body || body->type != AST_COMPOUND_STMT) return 0;
+
+    inline_free_locals();
+    g_inline.locals_overflow = false;
+    g_inline.temp_count = 0;
+    cc_arena_reset(&g_inline.temp_arena);
+    g_inline.strict = false;
+    for (ast_param_count_t i = 0; i < fn->data.function.param_count; i++) {
+        inline_collect_locals(fn->data.function.params[i]);
+    }
+    inline_collect_locals(body);
+
+    rc = inline_compound(body);
+    if (rc == 0) rc = inline_declare_temps(body);
+    while (g_inline.temp_count > 0) {
+        ast_node_destroy(g_inline.temps[--g_inline.temp_count]);
+    }
+    if (rc < 0) return -1;
+    return inline_consider(fn);
+}
+
+bool inline_may_qualify(const ast_node_t* fn, const ast_node_t* stmt, uint16_t* nodes) {
+    if (str_cmp(fn->data.function.name, "main") == 0) return false;
+    if (fn->data.function.param_count > INLINE_MAX_PARAMS) return false;
+    if (stmt->type != AST_ASSIGN && stmt->type != AST_CALL && stmt->type != AST_RETURN_STMT) {
+        return false;
+    }
+    *nodes = (uint16_t)(*nodes + inline_count_nodes(stmt));
+    return *nodes <= INLINE_HOLD_MAX_NODES;
+}
+
+static bool inline_is_shadowed(const char* name) {
+    if (g_inline.shadowed_all) return true;
+    for (uint8_t i = 0; i < g_inline.shadowed_count; i++) {
+        if (str_cmp(g_inline.shadowed[i], name) == 0) return true;
+    }
+    return false;
+}
+
+int8_t inline_stream_begin(const ast_node_t* fn) {
+    inline_free_locals();
+    g_inline.streaming = true;
+    g_inline.locals_overflow = false;
+    g_inline.temp_count = 0;
+    cc_arena_reset(&g_inline.temp_arena);
+    g_inline.expanded = 0;
+    g_inline.strict = inline_is_shadowed(fn->data.function.name);
+    for (ast_param_count_t i = 0; i < fn->data.function.param_count; i++) {
+        if (inline_stream_local(fn->data.function.params[i]) < 0) return -1;
+    }
+    return 0;
+}
+
+int8_t inline_stream_statement(ast_node_t** slot, ast_node_t** before, uint8_t* count) {
+    ast_node_t* node = *slot;
+    inline_pending_t pending;
+    int8_t rc = 0;
+
+    pending.count = 0;
+    pending.result_next = 0;
+    switch (node->type) {
+        case AST_COMPOUND_STMT:
+            break;
+        case AST_IF_STMT:
+            rc = inline_expr(&node->data.if_stmt.condition, &pending);
+            break;
+        case AST_WHILE_STMT:
+            inline_note_all(node->data.while_stmt.condition);
+            break;
+        case AST_FOR_STMT:
+            if (node->data.for_stmt.init) {
+                rc = inline_stream_local(node->data.for_stmt.init);
+                if (rc == 0) rc = inline_statement(&node->data.for_stmt.init, &pending);
+            }
+            inline_note_all(node->data.for_stmt.condition);
+            inline_note_all(node->data.for_stmt.increment);
+            break;
+        default:
+            rc = inline_stream_local(node);
+            if (rc == 0) rc = inline_statement(slot, &pending);
+            break;
+    }
+    if (rc < 0) {
+        inline_drop_pending(&pending, 0);
+        return -1;
+    }
+    mem_cpy(before, pending.items, sizeof(ast_node_t*) * pending.count);
+    *count = pending.count;
+    return 0;
+}
+
+uint8_t inline_stream_temps(ast_node_t* const** temps) {
+    *temps = g_inline.temps;
+    return g_inline.temp_count;
+}
+
+int8_t inline_stream_end(const ast_node_t* fn) {
+    int8_t rc = 0;
+    bool hidden = false;
+
+    for (uint8_t i = 0; i < g_inline.candidate_count && !g_inline.strict; i++) {
+        const ast_node_t* callee = g_inline.candidates[i].fn;
+        if (!(g_inline.expanded & (1u << i))) continue;
+        if (g_inline.locals_overflow ||
+            inline_any(callee->data.function.body, inline_visit_shadowed, callee)) {
+            hidden = true;
+        }
+    }
+    if (hidden) {
+        rc = 1;
+        if (g_inline.shadowed_count < INLINE_MAX_SHADOWED) {
+            char* name = cc_strdup(fn->data.function.name);
+            if (!name) rc = -1;
+            else g_inline.shadowed[g_inline.shadowed_count++] = name;
+        } else {
+            g_inline.shadowed_all = true;
+        }
+    }
+    while (g_inline.temp_count > 0) {
+        ast_node_destroy(g_inline.temps[--g_inline.temp_count]);
+    }
+    inline_free_locals();
+    return rc;
+}
+
+void inline_note_size(const ast_node_t* fn, uint32_t bytes, uint16_t nodes) {
+    inline_candidate_t* cand;
+    if (!g_inline.planning || !fn || fn->type != AST_FUNCTION) return;
+    cand = inline_find(fn->data.function.name);
+    if (!cand) return;
+    cand->bytes = bytes;
+    cand->nodes = nodes;
+}
+
+void inline_plan_drops(uint32_t* bytes, uint16_t* nodes, uint16_t* decls) {
+    for (uint8_t i = 0; i < g_inline.candidate_count; i++) {
+        const inline_candidate_t* cand = &g_inline.candidates[i];
+        const char* name = cand->fn->data.function.name;
+        char* copy;
+        if (!(cand->fn->data.function.flags & AST_FUNC_STATIC)) continue;
+        if (inline_is_called(name)) continue;
+        copy = cc_strdup(name);
+        if (!copy) continue;
+        g_inline.dropped[g_inline.dropped_count++] = copy;
+        *bytes -= cand->bytes;
+        *nodes = (uint16_t)(*nodes - cand->nodes);
+        *decls = (uint16_t)(*decls - 1u);
+    }
+}
+
+bool inline_is_dropped(const ast_node_t* fn) {
+    if (!fn || fn->type != AST_FUNCTION) return false;
+    for (uint8_t i = 0; i < g_inline.dropped_count; i++) {
+        if (str_cmp(g_inline.dropped[i], fn->data.function.name) == 0) return true;
+    }
+    return false;
+}
+
+void inline_destroy(void) {
+    inline_clear_candidates();
+    while (g_inline.temp_count > 0) {
+        ast_node_destroy(g_inline.temps[--g_inline.temp_count]);
+    }
+    cc_arena_free(&g_inline.temp_arena);
+    inline_free_locals();
+    for (uint8_t i = 0; i < g_inline.shadowed_count; i++) {
+        cc_free(g_inline.shadowed[i]);
+    }
+    g_inline.shadowed_count = 0;
+    g_inline.shadowed_all = false;
+    for (uint8_t i = 0; i < g_inline.dropped_count; i++) {
+        cc_free(g_inline.dropped[i]);
+    }
+    g_inline.dropped_count = 0;
+}
@@ -32,6 +32,7 @@ static const struct {
     {"for", TOK_FOR},
     {"goto", TOK_GOTO},
     {"if", TOK_IF},
+    {"inline", TOK_INLINE},
     {"int", TOK_INT},
     {"long", TOK_LONG},
     // {"register", TOK_REGISTER},
@@ -39,7 +40,7 @@ static const struct {
     // {"short", TOK_SHORT},
     {"signed", TOK_SIGNED},
     // {"sizeof", TOK_SIZEOF},
-    // {"static", TOK_STATIC},
+    {"static", TOK_STATIC},
     // {"struct", TOK_STRUCT},
     {"switch", TOK_SWITCH},
     // {"typedef", TOK_TYPEDEF},
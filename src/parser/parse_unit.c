@@ -0,0 +1,1447 @@
+#include "ast_format.h"
+#include "ast_io.h"
+#include "common.h"
+#include "inline.h"
+#include "lexer.h"
+#include "parser.h"
+#include "symbol.h"
+#include "target.h"
+#include "cc_compat.h"
+
+#define MAX_AST_STRINGS 512
+
+typedef struct {
+    uint8_t base;
+    uint8_t depth;
+    uint16_t array_len;
+} ast_type_key_t;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+    uint16_t name_index;
+    uint8_t tag;
+} ast_decl_key_t;
+
+/* Facts about the body the size pass records for the write pass, which
+ * reads them back in the same order (see "Streamed function bodies") */
+typedef struct {
+    uint8_t* data;
+    uint16_t length;
+    uint16_t capacity;
+    uint16_t next; /* read position in the write pass */
+} ast_plan_t;
+
+/* A block, if, while or for opened by the parser */
+typedef struct {
+    uint8_t type;  /* ast_node_type_t */
+    uint8_t count; /* statements so far in a block; an if's else flag */
+    uint16_t slot; /* plan byte with the final count or flag */
+} ast_frame_t;
+
+typedef struct {
+    output_t out;
+    bool writing; /* second pass */
+    bool failed;
+    bool replan;  /* a streamed caller must be inlined more strictly */
+    uint32_t nodes_bytes;
+    uint16_t node_count;
+    uint16_t decl_count;
+    uint16_t string_count;
+    bool strings_frozen;
+    uint32_t header_node_count_offset;
+    uint32_t header_string_count_offset;
+    uint32_t header_string_table_offset;
+    uint32_t program_decl_count_offset;
+    const char* strings[MAX_AST_STRINGS];
+    ast_type_key_t* types; /* version 2 type table, grown from the pool */
+    uint16_t type_count;
+    uint16_t type_capacity;
+    ast_decl_key_t* decls; /* decl_count entries, filled by the write pass */
+    uint16_t total_decls;
+
+    ast_plan_t shape; /* block counts and else flags */
+    ast_plan_t temps; /* per streamed function: count, then name u16, base, depth */
+    ast_frame_t* frames; /* frames[0] is the function body */
+    uint8_t depth;
+    uint8_t frame_capacity;
+    ast_node_t* fn;
+    bool streaming;
+    ast_decl_key_t* fn_decl;
+    ast_node_t* held[INLINE_HOLD_MAX_STMTS];
+    uint8_t held_count;
+    uint16_t held_nodes;
+
+    cc_arena_t arena;        /* the parser's trees */
+    cc_arena_mark_t fn_mark; /* arena top once the function head is parsed */
+} ast_writer_t;
+
+ast_writer_t* writer;
+parser_t* parser;
+lexer_t* lexer;
+
+static int16_t ast_string_index(const char* value) {
+    if (!writer || !value) return -1;
+    for (uint16_t i = 0; i < writer->string_count; i++) {
+        if (str_cmp(writer->strings[i], value) == 0) {
+            return (int16_t)i;
+        }
+    }
+    if (writer->strings_frozen) {
+        cc_error("AST string table missing value");
+        return -1;
+    }
+    if (writer->string_count >= MAX_AST_STRINGS) {
+        cc_error("AST string table overflow");
+        return -1;
+    }
+    char* copy = cc_strdup(value);
+    if (!copy) return -1;
+    writer->strings[writer->string_count] = copy;
+    return (int16_t)(writer->string_count++);
+}
+
+static void ast_free_strings(void) {
+    if (!writer) return;
+    for (uint16_t i = 0; i < writer->string_count; i++) {
+        cc_free((void*)writer->strings[i]);
+        writer->strings[i] = NULL;
+    }
+    writer->string_count = 0;
+}
+
+static int8_t ast_type_encode(const type_t* type, ast_type_key_t* key) {
+    const type_t* cur = type;
+    uint16_t array_len = 0;
+    if (cur && cur->kind == TYPE_ARRAY) {
+        array_len = (uint16_t)cur->data.array.length;
+        cur = cur->data.array.element_type;
+    }
+    uint8_t depth = 0;
+    while (cur && cur->kind == TYPE_POINTER) {
+        depth++;
+        cur = cur->data.pointer.base_type;
+    }
+    if (!cur) return -1;
+    if (cur->kind == TYPE_ARRAY) {
+        cc_error("Unsupported array type in AST writer");
+        return -1;
+    }
+
+    {
+        #define TYPE_KIND_COUNT ((uint8_t)TYPE_FUNCTION + 1)
+        static const uint8_t k_type_base[TYPE_KIND_COUNT] = {
+            AST_BASE_VOID, /* TYPE_VOID */
+            AST_BASE_CHAR, /* TYPE_CHAR */
+            0,             /* TYPE_SHORT */
+            AST_BASE_INT,  /* TYPE_INT */
+            0,             /* TYPE_LONG */
+            0,             /* TYPE_FLOAT */
+            0,             /* TYPE_DOUBLE */
+            0,             /* TYPE_POINTER */
+            0,             /* TYPE_ARRAY */
+            0,             /* TYPE_STRUCT */
+            0,             /* TYPE_UNION */
+            0,             /* TYPE_ENUM */
+            0              /* TYPE_FUNCTION */
+        };
+        uint8_t base = 0;
+        if ((uint8_t)cur->kind < TYPE_KIND_COUNT) {
+            base = k_type_base[cur->kind];
+        }
+        if (base == 0) {
+            cc_error("Unsupported type in AST writer");
+            return -1;
+        }
+        if (cur->kind != TYPE_VOID && !cur->is_signed) {
+            base |= AST_BASE_FLAG_UNSIGNED;
+        }
+        key->base = base;
+        #undef TYPE_KIND_COUNT
+    }
+    key->depth = depth;
+    key->array_len = array_len;
+    return 0;
+}
+
+/* Compact format: index of the type in the table written after the header */
+static int32_t ast_type_index(const ast_type_key_t* key) {
+    for (uint16_t i = 0; i < writer->type_count; i++) {
+        const ast_type_key_t* t = &writer->types[i];
+        if (t->base == key->base && t->depth == key->depth && t->array_len == key->array_len) {
+            return (int32_t)i;
+        }
+    }
+    if (writer->strings_frozen) {
+        cc_error("AST type table missing value");
+        return -1;
+    }
+    if (writer->type_count == writer->type_capacity) {
+        ast_type_key_t* grown;
+        if (writer->type_capacity >= 0x8000u) {
+            cc_error("AST type table overflow");
+            return -1;
+        }
+        grown = (ast_type_key_t*)cc_grow(writer->types, &writer->type_capacity,
+                                         writer->type_capacity ? (uint16_t)(writer->type_capacity * 2u) : 16u,
+                                         sizeof(ast_type_key_t));
+        if (!grown) {
+            cc_error("Out of memory for AST types");
+            return -1;
+        }
+        writer->types = grown;
+    }
+    writer->types[writer->type_count] = *key;
+    return (int32_t)(writer->type_count++);
+}
+
+static int8_t ast_write_type_key(const ast_type_key_t* key) {
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+    int32_t index = ast_type_index(key);
+    if (index < 0) return -1;
+    ast_write_varint(writer->out, (uint16_t)index);
+#else
+    ast_write_u8(writer->out, key->base);
+    ast_write_u8(writer->out, key->depth);
+    ast_write_u16(writer->out, key->array_len);
+#endif
+    return 0;
+}
+
+static int8_t ast_write_type(const type_t* type) {
+    ast_type_key_t key;
+    if (ast_type_encode(type, &key) < 0) return -1;
+    return ast_write_type_key(&key);
+}
+
+static int8_t ast_type_size(const type_t* type, uint32_t* out_size) {
+    ast_type_key_t key;
+    if (ast_type_encode(type, &key) < 0) return -1;
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+    {
+        int32_t index = ast_type_index(&key);
+        if (index < 0) return -1;
+        *out_size = ast_varint_size((uint16_t)index);
+    }
+#else
+    *out_size = 4;
+#endif
+    return 0;
+}
+
+/* String indices and child counts */
+static void ast_write_index(uint16_t value) {
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+    ast_write_varint(writer->out, value);
+#else
+    ast_write_u16(writer->out, value);
+#endif
+}
+
+static uint32_t ast_index_size(uint16_t value) {
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+    return ast_varint_size(value);
+#else
+    (void)value;
+    return 2;
+#endif
+}
+
+
+
+#define AST_NODE_TYPE_COUNT ((uint8_t)AST_ARRAY_ACCESS + 1)
+
+typedef int8_t (*ast_write_fn)(const ast_node_t* node);
+
+static int8_t ast_write_node(const ast_node_t* node);
+
+/* Everything before the body */
+static int8_t ast_write_function_head(const ast_node_t* node) {
+    int16_t name_index = ast_string_index(node->data.function.name);
+    if (name_index < 0) return -1;
+    ast_write_u8(writer->out, AST_TAG_FUNCTION);
+    ast_write_index((uint16_t)name_index);
+    ast_write_type(node->data.function.return_type);
+    ast_write_u8(writer->out, (uint8_t)node->data.function.param_count);
+    for (ast_param_count_t i = 0; i < node->data.function.param_count; i++) {
+        ast_write_node(node->data.function.params[i]);
+    }
+    return 0;
+}
+
+static int8_t ast_write_function(const ast_node_t* node) {
+    if (ast_write_function_head(node) < 0) return -1;
+    ast_write_node(node->data.function.body);
+    return 0;
+}
+
+static int8_t ast_write_var_decl(const ast_node_t* node) {
+    int16_t name_index = ast_string_index(node->data.var_decl.name);
+    if (name_index < 0) return -1;
+    ast_write_u8(writer->out, AST_TAG_VAR_DECL);
+    ast_write_index((uint16_t)name_index);
+    if (ast_write_type(node->data.var_decl.var_type) < 0) return -1;
+    if (node->data.var_decl.initializer) {
+        ast_write_u8(writer->out, 1);
+        return ast_write_node(node->data.var_decl.initializer);
+    }
+    ast_write_u8(writer->out, 0);
+    return 0;
+}
+
+static int8_t ast_write_compound(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_COMPOUND_STMT);
+    ast_write_index((uint16_t)node->data.compound.stmt_count);
+    for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
+        ast_write_node(node->data.compound.statements[i]);
+    }
+    return 0;
+}
+
+static int8_t ast_write_return(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_RETURN_STMT);
+    if (node->data.return_stmt.expr) {
+        ast_write_u8(writer->out, 1);
+        ast_write_node(node->data.return_stmt.expr);
+        return 0;
+    }
+    ast_write_u8(writer->out, 0);
+    return 0;
+}
+
+static int8_t ast_write_break(const ast_node_t* node) {
+    (void)node;
+    ast_write_u8(writer->out, AST_TAG_BREAK_STMT);
+    return 0;
+}
+
+static int8_t ast_write_continue(const ast_node_t* node) {
+    (void)node;
+    ast_write_u8(writer->out, AST_TAG_CONTINUE_STMT);
+    return 0;
+}
+
+static int8_t ast_write_goto(const ast_node_t* node) {
+    int16_t name_index = ast_string_index(node->data.goto_stmt.label);
+    if (name_index < 0) return -1;
+    ast_write_u8(writer->out, AST_TAG_GOTO_STMT);
+    ast_write_index((uint16_t)name_index);
+    return 0;
+}
+
+static int8_t ast_write_label(const ast_node_t* node) {
+    int16_t name_index = ast_string_index(node->data.label_stmt.label);
+    if (name_index < 0) return -1;
+    ast_write_u8(writer->out, AST_TAG_LABEL_STMT);
+    ast_write_index((uint16_t)name_index);
+    return 0;
+}
+
+static int8_t ast_write_if(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_IF_STMT);
+    ast_write_u8(writer->out, node->data.if_stmt.else_branch ? 1 : 0);
+    ast_write_node(node->data.if_stmt.condition);
+    ast_write_node(node->data.if_stmt.then_branch);
+    if (node->data.if_stmt.else_branch) {
+        ast_write_node(node->data.if_stmt.else_branch);
+    }
+    return 0;
+}
+
+static int8_t ast_write_while(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_WHILE_STMT);
+    if (ast_write_node(node->data.while_stmt.condition) < 0) return -1;
+    return ast_write_node(node->data.while_stmt.body);
+}
+
+static int8_t ast_write_for(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_FOR_STMT);
+    ast_write_u8(writer->out, node->data.for_stmt.init ? 1 : 0);
+    ast_write_u8(writer->out, node->data.for_stmt.condition ? 1 : 0);
+    ast_write_u8(writer->out, node->data.for_stmt.increment ? 1 : 0);
+    if (node->data.for_stmt.init) {
+        if (ast_write_node(node->data.for_stmt.init) < 0) return -1;
+    }
+    if (node->data.for_stmt.condition) {
+        if (ast_write_node(node->data.for_stmt.condition) < 0) return -1;
+    }
+    if (node->data.for_stmt.increment) {
+        if (ast_write_node(node->data.for_stmt.increment) < 0) return -1;
+    }
+    return ast_write_node(node->data.for_stmt.body);
+}
+
+static int8_t ast_write_assign(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_ASSIGN);
+    if (ast_write_node(node->data.assign.lvalue) < 0) return -1;
+    return ast_write_node(node->data.assign.rvalue);
+}
+
+static int8_t ast_write_call(const ast_node_t* node) {
+    int16_t name_index = ast_string_index(node->data.call.name);
+    if (name_index < 0) return -1;
+    ast_write_u8(writer->out, AST_TAG_CALL);
+    ast_write_index((uint16_t)name_index);
+    ast_write_u8(writer->out, (uint8_t)node->data.call.arg_count);
+    for (ast_arg_count_t i = 0; i < node->data.call.arg_count; i++) {
+        if (ast_write_node(node->data.call.args[i]) < 0) return -1;
+    }
+    return 0;
+}
+
+static int8_t ast_write_binary(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_BINARY_OP);
+    ast_write_u8(writer->out, (uint8_t)node->data.binary_op.op);
+    if (ast_write_node(node->data.binary_op.left) < 0) return -1;
+    return ast_write_node(node->data.binary_op.right);
+}
+
+static int8_t ast_write_unary(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_UNARY_OP);
+    ast_write_u8(writer->out, (uint8_t)node->data.unary_op.op);
+    return ast_write_node(node->data.unary_op.operand);
+}
+
+static int8_t ast_write_identifier(const ast_node_t* node) {
+    int16_t name_index = ast_string_index(node->data.identifier.name);
+    if (name_index < 0) return -1;
+    ast_write_u8(writer->out, AST_TAG_IDENTIFIER);
+    ast_write_index((uint16_t)name_index);
+    return 0;
+}
+
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+/* Small magnitudes of either sign get short varints */
+static uint16_t ast_zigzag(int16_t value) {
+    return (uint16_t)(((uint16_t)value << 1) ^ (uint16_t)(value < 0 ? 0xFFFF : 0));
+}
+#endif
+
+static int8_t ast_write_constant(const ast_node_t* node) {
+    int16_t value = (int16_t)node->data.constant.int_value;
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+    if (value >= 0 && value <= AST_SMALL_CONST_MAX) {
+        ast_write_u8(writer->out, (uint8_t)(AST_TAG_SMALL_CONST | value));
+        return 0;
+    }
+    ast_write_u8(writer->out, AST_TAG_CONSTANT);
+    ast_write_varint(writer->out, ast_zigzag(value));
+#else
+    ast_write_u8(writer->out, AST_TAG_CONSTANT);
+    ast_write_i16(writer->out, value);
+#endif
+    return 0;
+}
+
+static int8_t ast_write_string(const ast_node_t* node) {
+    int16_t value_index = ast_string_index(node->data.string_literal.value);
+    if (value_index < 0) return -1;
+    ast_write_u8(writer->out, AST_TAG_STRING_LITERAL);
+    ast_write_index((uint16_t)value_index);
+    return 0;
+}
+
+static int8_t ast_write_array_access(const ast_node_t* node) {
+    ast_write_u8(writer->out, AST_TAG_ARRAY_ACCESS);
+    if (ast_write_node(node->data.array_access.base) < 0) return -1;
+    return ast_write_node(node->data.array_access.index);
+}
+
+static const ast_write_fn g_ast_write_handlers[AST_NODE_TYPE_COUNT] = {
+    NULL,                   /* AST_PROGRAM */
+    ast_write_function,     /* AST_FUNCTION */
+    ast_write_var_decl,     /* AST_VAR_DECL */
+    ast_write_compound,     /* AST_COMPOUND_STMT */
+    ast_write_if,           /* AST_IF_STMT */
+    ast_write_while,        /* AST_WHILE_STMT */
+    ast_write_for,          /* AST_FOR_STMT */
+    ast_write_return,       /* AST_RETURN_STMT */
+    ast_write_break,        /* AST_BREAK_STMT */
+    ast_write_continue,     /* AST_CONTINUE_STMT */
+    ast_write_goto,         /* AST_GOTO_STMT */
+    ast_write_label,        /* AST_LABEL_STMT */
+    ast_write_assign,       /* AST_ASSIGN */
+    ast_write_call,         /* AST_CALL */
+    ast_write_binary,       /* AST_BINARY_OP */
+    ast_write_unary,        /* AST_UNARY_OP */
+    ast_write_identifier,   /* AST_IDENTIFIER */
+    ast_write_constant,     /* AST_CONSTANT */
+    ast_write_string,       /* AST_STRING_LITERAL */
+    ast_write_array_access, /* AST_ARRAY_ACCESS */
+};
+
+static int8_t ast_write_node(const ast_node_t* node) {
+    if (!writer || !node) return -1;
+    writer->node_count++;
+    if (node->type >= AST_NODE_TYPE_COUNT) {
+        cc_error("Unsupported AST node in writer");
+        return -1;
+    }
+    ast_write_fn fn = g_ast_write_handlers[node->type];
+    if (!fn) {
+        cc_error("Unsupported AST node in writer");
+        return -1;
+    }
+    return fn(node);
+}
+
+static int8_t ast_write_header_full(
+    uint16_t node_count,
+    uint16_t string_count,
+    uint32_t string_table_offset
+) {
+    if (output_write(writer->out, AST_MAGIC, 4) < 0) return -1;
+    ast_write_u8(writer->out, CC_AST_FORMAT);
+    ast_write_u8(writer->out, AST_FLAG_DECL_INDEX);
+    ast_write_u16(writer->out, 0);
+    ast_write_u16(writer->out, node_count);
+    ast_write_u16(writer->out, string_count);
+    ast_write_u32(writer->out, string_table_offset);
+    return 0;
+}
+
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+static uint32_t ast_type_table_size(void) {
+    uint32_t size = ast_varint_size(writer->type_count);
+    for (uint16_t i = 0; i < writer->type_count; i++) {
+        size += 2u + ast_varint_size(writer->types[i].array_len);
+    }
+    return size;
+}
+
+static void ast_write_type_table(void) {
+    ast_write_varint(writer->out, writer->type_count);
+    for (uint16_t i = 0; i < writer->type_count; i++) {
+        ast_write_u8(writer->out, writer->types[i].base);
+        ast_write_u8(writer->out, writer->types[i].depth);
+        ast_write_varint(writer->out, writer->types[i].array_len);
+    }
+}
+#endif
+
+static int8_t ast_write_string_table(uint32_t* out_offset) {
+    if (!writer || !out_offset) return -1;
+    *out_offset = output_tell(writer->out);
+    for (uint16_t i = 0; i < writer->string_count; i++) {
+        const char* str = writer->strings[i];
+        uint16_t len = 0;
+        while (str[len]) len++;
+        ast_write_u16(writer->out, (uint16_t)len);
+        if (len > 0) {
+            if (output_write(writer->out, str, (uint16_t)len) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+/* Records a top-level declaration about to be written for the index;
+ * its length is filled in once it has been */
+static ast_decl_key_t* ast_decl_begin(const ast_node_t* node) {
+    ast_decl_key_t* decl = &writer->decls[writer->decl_count++];
+    const char* name = node->type == AST_FUNCTION ? node->data.function.name
+                                                  : node->data.var_decl.name;
+    decl->tag = node->type == AST_FUNCTION ? AST_TAG_FUNCTION : AST_TAG_VAR_DECL;
+    decl->name_index = (uint16_t)ast_string_index(name);
+    decl->offset = output_tell(writer->out);
+    return decl;
+}
+
+static void ast_write_decl(const ast_node_t* node) {
+    ast_decl_key_t* decl = ast_decl_begin(node);
+    ast_write_node(node);
+    decl->length = output_tell(writer->out) - decl->offset;
+}
+
+static void ast_write_decl_index(void) {
+    ast_write_u16(writer->out, writer->decl_count);
+    for (uint16_t i = 0; i < writer->decl_count; i++) {
+        const ast_decl_key_t* decl = &writer->decls[i];
+        ast_write_u8(writer->out, decl->tag);
+        ast_write_u16(writer->out, decl->name_index);
+        ast_write_u32(writer->out, decl->offset);
+        ast_write_u32(writer->out, decl->length);
+    }
+}
+
+typedef int8_t (*ast_measure_fn)(const ast_node_t* node, uint32_t* out_size);
+
+static int8_t ast_measure_node(const ast_node_t* node, uint32_t* out_size);
+
+static int8_t ast_measure_function_head(const ast_node_t* node, uint32_t* out_size) {
+    int16_t name_index = ast_string_index(node->data.function.name);
+    uint32_t type_size = 0;
+    if (name_index < 0) return -1;
+    if (ast_type_size(node->data.function.return_type, &type_size) < 0) return -1;
+    uint32_t size = 1 + ast_index_size((uint16_t)name_index) + type_size + 1;
+    for (ast_param_count_t i = 0; i < node->data.function.param_count; i++) {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.function.params[i], &child_size) < 0) return -1;
+        size += child_size;
+    }
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_function(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 0;
+    uint32_t child_size = 0;
+    if (ast_measure_function_head(node, &size) < 0) return -1;
+    if (ast_measure_node(node->data.function.body, &child_size) < 0) return -1;
+    *out_size = size + child_size;
+    return 0;
+}
+
+static int8_t ast_measure_var_decl(const ast_node_t* node, uint32_t* out_size) {
+    int16_t name_index = ast_string_index(node->data.var_decl.name);
+    uint32_t type_size = 0;
+    if (name_index < 0) return -1;
+    if (ast_type_size(node->data.var_decl.var_type, &type_size) < 0) return -1;
+    uint32_t size = 1 + ast_index_size((uint16_t)name_index) + type_size + 1;
+    if (node->data.var_decl.initializer) {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.var_decl.initializer, &child_size) < 0) return -1;
+        size += child_size;
+    }
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_compound(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1 + ast_index_size((uint16_t)node->data.compound.stmt_count);
+    for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.compound.statements[i], &child_size) < 0) return -1;
+        size += child_size;
+    }
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_return(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1 + 1;
+    if (node->data.return_stmt.expr) {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.return_stmt.expr, &child_size) < 0) return -1;
+        size += child_size;
+    }
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_tag_only(const ast_node_t* node, uint32_t* out_size) {
+    (void)writer;
+    (void)node;
+    *out_size = 1;
+    return 0;
+}
+
+static int8_t ast_measure_goto(const ast_node_t* node, uint32_t* out_size) {
+    int16_t name_index = ast_string_index(node->data.goto_stmt.label);
+    if (name_index < 0) return -1;
+    *out_size = 1 + ast_index_size((uint16_t)name_index);
+    return 0;
+}
+
+static int8_t ast_measure_label(const ast_node_t* node, uint32_t* out_size) {
+    int16_t name_index = ast_string_index(node->data.label_stmt.label);
+    if (name_index < 0) return -1;
+    *out_size = 1 + ast_index_size((uint16_t)name_index);
+    return 0;
+}
+
+static int8_t ast_measure_if(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1 + 1;
+    uint32_t child_size = 0;
+    if (ast_measure_node(node->data.if_stmt.condition, &child_size) < 0) return -1;
+    size += child_size;
+    if (ast_measure_node(node->data.if_stmt.then_branch, &child_size) < 0) return -1;
+    size += child_size;
+    if (node->data.if_stmt.else_branch) {
+        if (ast_measure_node(node->data.if_stmt.else_branch, &child_size) < 0) return -1;
+        size += child_size;
+    }
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_while(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1;
+    uint32_t child_size = 0;
+    if (ast_measure_node(node->data.while_stmt.condition, &child_size) < 0) return -1;
+    size += child_size;
+    if (ast_measure_node(node->data.while_stmt.body, &child_size) < 0) return -1;
+    size += child_size;
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_for(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1 + 3;
+    if (node->data.for_stmt.init) {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.for_stmt.init, &child_size) < 0) return -1;
+        size += child_size;
+    }
+    if (node->data.for_stmt.condition) {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.for_stmt.condition, &child_size) < 0) return -1;
+        size += child_size;
+    }
+    if (node->data.for_stmt.increment) {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.for_stmt.increment, &child_size) < 0) return -1;
+        size += child_size;
+    }
+    {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.for_stmt.body, &child_size) < 0) return -1;
+        size += child_size;
+    }
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_assign(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1;
+    uint32_t child_size = 0;
+    if (ast_measure_node(node->data.assign.lvalue, &child_size) < 0) return -1;
+    size += child_size;
+    if (ast_measure_node(node->data.assign.rvalue, &child_size) < 0) return -1;
+    size += child_size;
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_call(const ast_node_t* node, uint32_t* out_size) {
+    int16_t name_index = ast_string_index(node->data.call.name);
+    if (name_index < 0) return -1;
+    uint32_t size = 1 + ast_index_size((uint16_t)name_index) + 1;
+    for (ast_arg_count_t i = 0; i < node->data.call.arg_count; i++) {
+        uint32_t child_size = 0;
+        if (ast_measure_node(node->data.call.args[i], &child_size) < 0) return -1;
+        size += child_size;
+    }
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_binary(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1 + 1;
+    uint32_t child_size = 0;
+    if (ast_measure_node(node->data.binary_op.left, &child_size) < 0) return -1;
+    size += child_size;
+    if (ast_measure_node(node->data.binary_op.right, &child_size) < 0) return -1;
+    size += child_size;
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_unary(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1 + 1;
+    uint32_t child_size = 0;
+    if (ast_measure_node(node->data.unary_op.operand, &child_size) < 0) return -1;
+    size += child_size;
+    *out_size = size;
+    return 0;
+}
+
+static int8_t ast_measure_identifier(const ast_node_t* node, uint32_t* out_size) {
+    int16_t name_index = ast_string_index(node->data.identifier.name);
+    if (name_index < 0) return -1;
+    *out_size = 1 + ast_index_size((uint16_t)name_index);
+    return 0;
+}
+
+static int8_t ast_measure_constant(const ast_node_t* node, uint32_t* out_size) {
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+    int16_t value = (int16_t)node->data.constant.int_value;
+    if (value >= 0 && value <= AST_SMALL_CONST_MAX) {
+        *out_size = 1;
+    } else {
+        *out_size = 1u + ast_varint_size(ast_zigzag(value));
+    }
+#else
+    (void)node;
+    *out_size = 1 + 2;
+#endif
+    return 0;
+}
+
+static int8_t ast_measure_string(const ast_node_t* node, uint32_t* out_size) {
+    int16_t value_index = ast_string_index(node->data.string_literal.value);
+    if (value_index < 0) return -1;
+    *out_size = 1 + ast_index_size((uint16_t)value_index);
+    return 0;
+}
+
+static int8_t ast_measure_array_access(const ast_node_t* node, uint32_t* out_size) {
+    uint32_t size = 1;
+    uint32_t child_size = 0;
+    if (ast_measure_node(node->data.array_access.base, &child_size) < 0) return -1;
+    size += child_size;
+    if (ast_measure_node(node->data.array_access.index, &child_size) < 0) return -1;
+    size += child_size;
+    *out_size = size;
+    return 0;
+}
+
+static const ast_measure_fn g_ast_measure_handlers[AST_NODE_TYPE_COUNT] = {
+    NULL,                     /* AST_PROGRAM */
+    ast_measure_function,     /* AST_FUNCTION */
+    ast_measure_var_decl,     /* AST_VAR_DECL */
+    ast_measure_compound,     /* AST_COMPOUND_STMT */
+    ast_measure_if,           /* AST_IF_STMT */
+    ast_measure_while,        /* AST_WHILE_STMT */
+    ast_measure_for,          /* AST_FOR_STMT */
+    ast_measure_return,       /* AST_RETURN_STMT */
+    ast_measure_tag_only,     /* AST_BREAK_STMT */
+    ast_measure_tag_only,     /* AST_CONTINUE_STMT */
+    ast_measure_goto,         /* AST_GOTO_STMT */
+    ast_measure_label,        /* AST_LABEL_STMT */
+    ast_measure_assign,       /* AST_ASSIGN */
+    ast_measure_call,         /* AST_CALL */
+    ast_measure_binary,       /* AST_BINARY_OP */
+    ast_measure_unary,        /* AST_UNARY_OP */
+    ast_measure_identifier,   /* AST_IDENTIFIER */
+    ast_measure_constant,     /* AST_CONSTANT */
+    ast_measure_string,       /* AST_STRING_LITERAL */
+    ast_measure_array_access, /* AST_ARRAY_ACCESS */
+};
+
+static int8_t ast_measure_node(const ast_node_t* node, uint32_t* out_size) {
+    if (!writer || !node || !out_size) return -1;
+    writer->node_count++;
+    if (node->type >= AST_NODE_TYPE_COUNT) {
+        cc_error("Unsupported AST node in size pass");
+        return -1;
+    }
+    ast_measure_fn fn = g_ast_measure_handlers[node->type];
+    if (!fn) {
+        cc_error("Unsupported AST node in size pass");
+        return -1;
+    }
+    return fn(node, out_size);
+}
+
+/* ---- Streamed function bodies ----
+ *
+ * With the sink installed the parser hands function bodies over one
+ * statement at a time, and each is written (or sized, in the first pass)
+ * and freed at once, so memory follows nesting depth rather than function
+ * length. The output only goes forwards, so what a header needs before its
+ * children are known is planned by the size pass: one byte per block for
+ * its statement count and one per if for its else, plus the temporaries
+ * inlining declares at the top of each body.
+ *
+ * A body that may still become an inlining candidate is held as a tree
+ * until one of its statements rules that out.
+ *
+ * The parser allocates from writer->arena, which is emptied after every
+ * declaration. Within a body, what an opened node still needs is kept in
+ * its frame, so once a sink event is over nothing parsed since the head is
+ * alive but held statements: unless some are held, the arena goes back to
+ * fn_mark. (Inlining keeps its temporaries in an arena of its own.) */
+
+static void ast_unit_fail(const char* msg) {
+    if (!writer->failed) log_error(msg);
+    writer->failed = true;
+}
+
+/* Size pass: appends a byte to fill in later. Write pass: takes the next
+ * one. Returns its position, or -1. */
+static int32_t ast_plan_take(ast_plan_t* plan) {
+    if (writer->writing) {
+        if (plan->next >= plan->length) {
+            ast_unit_fail("AST plan changed between passes\n");
+            return -1;
+        }
+        return plan->next++;
+    }
+    if (plan->length == 0xFFFF) {
+        ast_unit_fail("AST plan overflow\n");
+        return -1;
+    }
+    if (plan->length == plan->capacity) {
+        uint16_t need = plan->capacity >= 0x8000u ? 0xFFFFu
+                      : plan->capacity ? (uint16_t)(plan->capacity * 2u) : 32u;
+        uint8_t* grown = (uint8_t*)cc_grow(plan->data, &plan->capacity, need, 1);
+        if (!grown) {
+            ast_unit_fail("Out of memory for AST plan\n");
+            return -1;
+        }
+        plan->data = grown;
+    }
+    plan->data[plan->length] = 0;
+    return plan->length++;
+}
+
+/* Size pass: stores the final value. Write pass: checks it was planned. */
+static void ast_plan_settle(ast_plan_t* plan, uint16_t slot, uint8_t value) {
+    if (!writer->writing) {
+        plan->data[slot] = value;
+    } else if (plan->data[slot] != value) {
+        ast_unit_fail("AST plan changed between passes\n");
+    }
+}
+
+/* Sizes or writes a complete node */
+static void ast_unit_emit(const ast_node_t* node) {
+    uint32_t size = 0;
+    if (writer->writing) {
+        ast_write_node(node);
+        return;
+    }
+    if (ast_measure_node(node, &size) < 0) {
+        ast_unit_fail("Failed to size AST node\n");
+        return;
+    }
+    writer->nodes_bytes += size;
+}
+
+/* Emits and frees a child of an opened node */
+static void ast_unit_emit_part(ast_node_t** part) {
+    if (!*part) return;
+    ast_unit_emit(*part);
+    ast_node_destroy(*part);
+    *part = NULL;
+}
+
+static void ast_unit_emit_block(uint8_t count) {
+    if (writer->writing) {
+        ast_write_u8(writer->out, AST_TAG_COMPOUND_STMT);
+        ast_write_index(count);
+        return;
+    }
+    writer->node_count++;
+    writer->nodes_bytes += 1 + ast_index_size(count);
+}
+
+static ast_frame_t* ast_unit_push(uint8_t type) {
+    ast_frame_t* frame;
+    uint16_t capacity = writer->frame_capacity;
+    if (writer->depth == 0xFF) {
+        ast_unit_fail("Statements nested too deeply\n");
+        return NULL;
+    }
+    if (writer->depth == capacity) {
+        ast_frame_t* grown = (ast_frame_t*)cc_grow(writer->frames, &capacity,
+                                                   capacity ? (uint16_t)(capacity * 2u) : 32u,
+                                                   sizeof(ast_frame_t));
+        if (!grown) {
+            ast_unit_fail("Out of memory for AST frames\n");
+            return NULL;
+        }
+        writer->frames = grown;
+        writer->frame_capacity = capacity > 0xFF ? 0xFF : (uint8_t)capacity;
+    }
+    frame = &writer->frames[writer->depth++];
+    frame->type = type;
+    frame->count = 0;
+    frame->slot = 0;
+    return frame;
+}
+
+/* Ends a sink event within a body */
+static void ast_unit_release(void) {
+    if (writer->held_count == 0) cc_arena_release(&writer->arena, writer->fn_mark);
+}
+
+/* Opens `node`: emits what comes before its body and frees those parts */
+static void ast_unit_open(ast_node_t* node) {
+    ast_frame_t* frame = ast_unit_push((uint8_t)node->type);
+    int32_t slot;
+    if (!frame) return;
+    if (!writer->writing) writer->node_count++;
+    switch (node->type) {
+        case AST_COMPOUND_STMT:
+            slot = ast_plan_take(&writer->shape);
+            if (slot < 0) return;
+            frame->slot = (uint16_t)slot;
+            if (writer->writing) {
+                ast_write_u8(writer->out, AST_TAG_COMPOUND_STMT);
+                ast_write_index(writer->shape.data[slot]);
+            } else {
+                writer->nodes_bytes += 1; /* and the count, at close */
+            }
+            return;
+        case AST_IF_STMT:
+            slot = ast_plan_take(&writer->shape);
+            if (slot < 0) return;
+            frame->slot = (uint16_t)slot;
+            if (writer->writing) {
+                ast_write_u8(writer->out, AST_TAG_IF_STMT);
+                ast_write_u8(writer->out, writer->shape.data[slot]);
+            } else {
+                writer->nodes_bytes += 2;
+            }
+            ast_unit_emit_part(&node->data.if_stmt.condition);
+            return;
+        case AST_WHILE_STMT:
+            if (writer->writing) {
+                ast_write_u8(writer->out, AST_TAG_WHILE_STMT);
+            } else {
+                writer->nodes_bytes += 1;
+            }
+            ast_unit_emit_part(&node->data.while_stmt.condition);
+            return;
+        default: /* AST_FOR_STMT */
+            if (writer->writing) {
+                ast_write_u8(writer->out, AST_TAG_FOR_STMT);
+                ast_write_u8(writer->out, node->data.for_stmt.init ? 1 : 0);
+                ast_write_u8(writer->out, node->data.for_stmt.condition ? 1 : 0);
+                ast_write_u8(writer->out, node->data.for_stmt.increment ? 1 : 0);
+            } else {
+                writer->nodes_bytes += 4;
+            }
+            ast_unit_emit_part(&node->data.for_stmt.init);
+            ast_unit_emit_part(&node->data.for_stmt.condition);
+            ast_unit_emit_part(&node->data.for_stmt.increment);
+            return;
+    }
+}
+
+/* Emits `node` (NULL when inlining removed it) into the innermost open
+ * node after the `count` statements inlining put in front of it. A block
+ * counts them all; the body of an if/while/for gets a block of its own
+ * when it is more than the one statement. */
+static void ast_unit_place(ast_node_t** before, uint8_t count, ast_node_t* node, bool open) {
+    ast_frame_t* parent = &writer->frames[writer->depth - 1];
+    uint16_t total = (uint16_t)(count + (node ? 1u : 0u));
+    if (parent->type == AST_COMPOUND_STMT) {
+        if (parent->count + total > 0xFF) {
+            ast_unit_fail("Too many statements in block\n");
+        }
+        parent->count = (uint8_t)(parent->count + total);
+    } else if (count > 0 || !node) {
+        ast_unit_emit_block((uint8_t)total);
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        ast_unit_emit(before[i]);
+        ast_node_destroy(before[i]);
+    }
+    if (!node) return;
+    if (open) {
+        ast_unit_open(node);
+    } else {
+        ast_unit_emit(node);
+    }
+}
+
+/* Expands calls in `node`, then places it; a statement is freed after */
+static void ast_unit_stream(ast_node_t* node, bool open) {
+    ast_node_t* before[INLINE_MAX_PENDING];
+    uint8_t count = 0;
+    if (inline_stream_statement(&node, before, &count) < 0) {
+        ast_unit_fail("Failed to inline calls\n");
+    } else {
+        ast_unit_place(before, count, node, open);
+    }
+    if (!open) ast_node_destroy(node);
+}
+
+/* The body is no candidate: emits the function up to the body, then the
+ * statements held so far */
+static void ast_unit_flush(void) {
+    const ast_node_t* fn = writer->fn;
+    ast_frame_t* body = &writer->frames[0];
+    int32_t slot;
+
+    writer->streaming = true;
+    if (inline_stream_begin(fn) < 0) {
+        ast_unit_fail("Failed to inline calls\n");
+        return;
+    }
+    slot = ast_plan_take(&writer->shape);
+    if (slot < 0) return;
+    body->slot = (uint16_t)slot;
+    if (writer->writing) {
+        int32_t at = ast_plan_take(&writer->temps);
+        uint8_t temp_count;
+        if (at < 0) return;
+        temp_count = writer->temps.data[at];
+        if (writer->decl_count >= writer->total_decls ||
+            (uint32_t)writer->temps.next + 4u * temp_count > writer->temps.length) {
+            ast_unit_fail("AST declaration count changed between passes\n");
+            return;
+        }
+        writer->fn_decl = ast_decl_begin(fn);
+        ast_write_function_head(fn);
+        ast_write_u8(writer->out, AST_TAG_COMPOUND_STMT);
+        ast_write_index(writer->shape.data[slot]);
+        for (uint8_t i = 0; i < temp_count; i++) {
+            const uint8_t* temp = &writer->temps.data[writer->temps.next];
+            ast_type_key_t key;
+            key.base = temp[2];
+            key.depth = temp[3];
+            key.array_len = 0;
+            ast_write_u8(writer->out, AST_TAG_VAR_DECL);
+            ast_write_index((uint16_t)(temp[0] | (temp[1] << 8)));
+            ast_write_type_key(&key);
+            ast_write_u8(writer->out, 0);
+            writer->temps.next = (uint16_t)(writer->temps.next + 4u);
+        }
+        body->count = temp_count;
+    } else {
+        uint32_t size = 0;
+        if (ast_measure_function_head(fn, &size) < 0) {
+            ast_unit_fail("Failed to size AST node\n");
+            return;
+        }
+        writer->node_count += 2; /* the function and its body */
+        writer->nodes_bytes += size + 1;
+    }
+    for (uint8_t i = 0; i < writer->held_count; i++) {
+        ast_unit_stream(writer->held[i], false);
+    }
+    writer->held_count = 0;
+}
+
+/* Size pass: plans the temporaries of the streamed function */
+static void ast_unit_plan_temps(void) {
+    ast_node_t* const* temps;
+    uint8_t count = inline_stream_temps(&temps);
+    int32_t at = ast_plan_take(&writer->temps);
+    if (at < 0) return;
+    writer->temps.data[at] = count;
+    for (uint8_t i = 0; i < count; i++) {
+        ast_type_key_t key;
+        int16_t name_index;
+        int32_t slot = 0;
+        ast_unit_emit(temps[i]);
+        name_index = ast_string_index(temps[i]->data.var_decl.name);
+        if (name_index < 0 || ast_type_encode(temps[i]->data.var_decl.var_type, &key) < 0) {
+            ast_unit_fail("Failed to size AST node\n");
+            return;
+        }
+        for (uint8_t b = 0; b < 4 && slot >= 0; b++) slot = ast_plan_take(&writer->temps);
+        if (slot < 0) return;
+        writer->temps.data[slot - 3] = (uint8_t)name_index;
+        writer->temps.data[slot - 2] = (uint8_t)((uint16_t)name_index >> 8);
+        writer->temps.data[slot - 1] = key.base;
+        writer->temps.data[slot] = key.depth;
+    }
+    if ((uint16_t)writer->frames[0].count + count > 0xFF) {
+        ast_unit_fail("Inlined block too large\n");
+        return;
+    }
+    writer->frames[0].count = (uint8_t)(writer->frames[0].count + count);
+}
+
+/* A held body: inlined and written as a tree, as before streaming */
+static void ast_unit_emit_held(ast_node_t* fn) {
+    ast_node_t* body = (ast_node_t*)cc_tree_alloc(sizeof(ast_node_t));
+    uint32_t size = 0;
+    uint16_t node_count = writer->node_count;
+
+    if (body) {
+        body->type = AST_COMPOUND_STMT;
+        body->data.compound.stmt_count = writer->held_count;
+        body->data.compound.statements = NULL;
+        if (writer->held_count > 0) {
+            body->data.compound.statements =
+                (ast_node_t**)cc_tree_alloc(sizeof(ast_node_t*) * writer->held_count);
+            if (!body->data.compound.statements) {
+                cc_tree_free(body);
+                body = NULL;
+            }
+        }
+    }
+    if (!body) {
+        ast_unit_fail("Out of memory for function body\n");
+        return;
+    }
+    mem_cpy(body->data.compound.statements, writer->held,
+            sizeof(ast_node_t*) * writer->held_count);
+    writer->held_count = 0;
+    fn->data.function.body = body;
+
+    if (inline_function(fn) < 0) {
+        ast_unit_fail("Failed to inline calls\n");
+        return;
+    }
+    if (writer->writing) {
+        if (inline_is_dropped(fn)) return;
+        if (writer->decl_count >= writer->total_decls) {
+            ast_unit_fail("AST declaration count changed between passes\n");
+            return;
+        }
+        ast_write_decl(fn);
+        return;
+    }
+    if (ast_measure_node(fn, &size) < 0) {
+        ast_unit_fail("Failed to size AST node\n");
+        return;
+    }
+    writer->nodes_bytes += size;
+    inline_note_size(fn, size, (uint16_t)(writer->node_count - node_count));
+    writer->decl_count++;
+}
+
+static void ast_unit_function_end(ast_node_t* fn) {
+    if (writer->failed || writer->depth == 0) {
+        /* no body: the parser has reported it */
+    } else if (!writer->streaming) {
+        ast_unit_emit_held(fn);
+    } else {
+        ast_frame_t* body = &writer->frames[0];
+        int8_t rc;
+        if (!writer->writing) {
+            ast_unit_plan_temps();
+            ast_plan_settle(&writer->shape, body->slot, body->count);
+            writer->nodes_bytes += ast_index_size(body->count);
+            writer->decl_count++;
+        } else {
+            ast_plan_settle(&writer->shape, body->slot, body->count);
+            writer->fn_decl->length = output_tell(writer->out) - writer->fn_decl->offset;
+        }
+        rc = inline_stream_end(fn);
+        if (rc < 0) {
+            ast_unit_fail("Failed to inline calls\n");
+        } else if (rc > 0) {
+            if (writer->writing) ast_unit_fail("AST plan changed between passes\n");
+            writer->replan = true;
+        }
+    }
+    while (writer->held_count > 0) {
+        ast_node_destroy(writer->held[--writer->held_count]);
+    }
+    writer->fn = NULL;
+    writer->depth = 0;
+}
+
+static void ast_sink_function(ast_node_t* fn) {
+    writer->fn = fn;
+    writer->streaming = false;
+    writer->held_count = 0;
+    writer->held_nodes = 0;
+    writer->depth = 0;
+    writer->fn_mark = cc_arena_mark(&writer->arena);
+}
+
+static void ast_sink_open(ast_node_t* node) {
+    if (writer->failed) {
+        /* nothing to write */
+    } else if (writer->depth == 0) {
+        ast_unit_push(AST_COMPOUND_STMT); /* the body, emitted on flush */
+    } else {
+        if (!writer->streaming) ast_unit_flush();
+        if (!writer->failed) ast_unit_stream(node, true);
+    }
+    ast_unit_release();
+}
+
+static void ast_sink_branch(ast_node_t* node) {
+    (void)node;
+    if (writer->failed || writer->depth == 0) return;
+    writer->frames[writer->depth - 1].count = 1;
+}
+
+static void ast_sink_close(ast_node_t* node) {
+    ast_frame_t* frame;
+    if (node == writer->fn) {
+        ast_unit_function_end(node);
+        return;
+    }
+    ast_node_destroy(node); /* already released when in the arena */
+    /* The body itself closes with the function */
+    if (writer->failed || writer->depth <= 1) return;
+    frame = &writer->frames[--writer->depth];
+    if (frame->type == AST_COMPOUND_STMT) {
+        ast_plan_settle(&writer->shape, frame->slot, frame->count);
+        if (!writer->writing) writer->nodes_bytes += ast_index_size(frame->count);
+    } else if (frame->type == AST_IF_STMT) {
+        ast_plan_settle(&writer->shape, frame->slot, frame->count);
+    }
+}
+
+static void ast_sink_statement(ast_node_t* stmt) {
+    if (writer->failed || writer->depth == 0) {
+        ast_node_destroy(stmt);
+    } else if (!writer->streaming && writer->held_count < INLINE_HOLD_MAX_STMTS &&
+               inline_may_qualify(writer->fn, stmt, &writer->held_nodes)) {
+        writer->held[writer->held_count++] = stmt;
+    } else {
+        if (!writer->streaming) ast_unit_flush();
+        ast_unit_stream(stmt, false);
+    }
+    ast_unit_release();
+}
+
+static const parser_sink_t k_ast_sink = {
+    ast_sink_function,
+    ast_sink_open,
+    ast_sink_branch,
+    ast_sink_close,
+    ast_sink_statement,
+};
+
+static void ast_writer_reset_counts(void) {
+    if (!writer) return;
+    writer->node_count = 0;
+    writer->decl_count = 0;
+}
+
+static void parse_unit_close_source(void) {
+    if (parser) {
+        parser_destroy(parser);
+        parser = NULL;
+    }
+    if (lexer) {
+        lexer_destroy(lexer);
+        lexer = NULL;
+    }
+    if (reader) {
+        reader_close(reader);
+        reader = NULL;
+    }
+}
+
+static int8_t parse_unit_open_source(const char* input_file) {
+    parse_unit_close_source();
+    reader = reader_open(input_file);
+    if (!reader) return -1;
+    lexer = lexer_create(input_file);
+    if (!lexer) return -1;
+    parser = parser_create();
+    if (!parser) return -1;
+    parser->sink = &k_ast_sink;
+    return 0;
+}
+
+static void parse_unit_cleanup(void) {
+    inline_destroy();
+    if (writer) {
+        writer->held_count = 0;
+        cc_tree_arena(NULL);
+        cc_arena_free(&writer->arena);
+        ast_free_strings();
+        cc_free(writer->decls);
+        cc_free(writer->shape.data);
+        cc_free(writer->temps.data);
+        cc_free(writer->frames);
+        cc_free(writer->types);
+        cc_free(writer);
+        writer = NULL;
+    }
+    parse_unit_close_source();
+}
+
+static void handle_error(char* msg) {
+    log_error(msg);
+    parse_unit_cleanup();
+    exit(1);
+}
+
+/* Parses the source once: function bodies go through the sink, global
+ * variables are sized or written here */
+static int8_t parse_unit_pass(void) {
+    ast_node_t* ast;
+    while ((ast = parser_parse_next()) != NULL) {
+        if (ast->type == AST_VAR_DECL && !writer->failed) {
+            if (!writer->writing) {
+                ast_unit_emit(ast);
+                writer->decl_count++;
+            } else if (writer->decl_count >= writer->total_decls) {
+                ast_unit_fail("AST declaration count changed between passes\n");
+            } else {
+                ast_write_decl(ast);
+            }
+        }
+        ast_node_destroy(ast);
+        cc_arena_reset(&writer->arena);
+    }
+    if (writer->failed) return -1;
+    if (parser->error_count > 0) {
+        log_error("Parsing failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Parses input_file (two passes over the source) and writes its AST to
+ * out. The caller owns out; returns 0 on success, -1 on error. */
+int8_t parser_parse_unit(const char* input_file, output_t out) {
+    int8_t err = -1;
+    uint32_t string_table_offset = 0;
+    uint16_t total_nodes = 0;
+    uint16_t total_strings = 0;
+    uint16_t total_decls = 0;
+    uint32_t program_bytes = 0;
+
+    writer = (ast_writer_t*)cc_malloc(sizeof(*writer));
+    if (!writer) return -1;
+    mem_set(writer, 0, sizeof(*writer));
+    cc_tree_arena(&writer->arena);
+
+    /* Repeated while a streamed caller turns out to need strict inlining */
+    do {
+        if (parse_unit_open_source(input_file) < 0) goto cleanup;
+        ast_free_strings();
+        ast_writer_reset_counts();
+        writer->type_count = 0;
+        writer->nodes_bytes = 0;
+        writer->shape.length = 0;
+        writer->temps.length = 0;
+        writer->replan = false;
+        inline_begin(true);
+        if (parse_unit_pass() < 0) goto cleanup;
+    } while (writer->replan);
+
+    /* Static functions inlined at every call site are not written */
+    inline_plan_drops(&writer->nodes_bytes, &writer->node_count, &writer->decl_count);
+
+    total_nodes = (uint16_t)(writer->node_count + 1);
+    total_strings = writer->string_count;
+    total_decls = writer->decl_count;
+    program_bytes = 1 + ast_index_size(total_decls);
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+    program_bytes += ast_type_table_size();
+#endif
+    string_table_offset = AST_HEADER_SIZE + program_bytes + writer->nodes_bytes;
+    if (total_decls > 0) {
+        writer->decls = (ast_decl_key_t*)cc_malloc(sizeof(ast_decl_key_t) * total_decls);
+        if (!writer->decls) goto cleanup;
+    }
+    writer->total_decls = total_decls;
+
+    if (parse_unit_open_source(input_file) < 0) goto cleanup;
+
+    writer->out = out;
+    writer->writing = true;
+
+    writer->strings_frozen = true;
+    ast_writer_reset_counts();
+
+    if (ast_write_header_full(total_nodes, total_strings, string_table_offset) < 0) {
+        log_error("Failed to write AST header\n");
+        goto cleanup;
+    }
+
+#if CC_AST_FORMAT == AST_FORMAT_COMPACT
+    ast_write_handler(handle_error, "Failed to write AST type table\n");
+    ast_write_type_table();
+#endif
+
+    ast_write_handler(handle_error, "Failed to write AST program tag\n");
+    ast_write_u8(writer->out, AST_TAG_PROGRAM);
+
+    ast_write_handler(handle_error, "Failed to write AST program decl count\n");
+    ast_write_index(total_decls);
+
+    ast_write_handler(handle_error, "Failed to write AST node\n");
+    inline_begin(false);
+    if (parse_unit_pass() < 0) goto cleanup;
+
+    if (ast_write_string_table(&string_table_offset) < 0) {
+        log_error("Failed to write AST string table\n");
+        goto cleanup;
+    }
+    ast_write_handler(handle_error, "Failed to write AST declaration index\n");
+    ast_write_decl_index();
+
+    err = 0;
+
+cleanup:
+    parse_unit_cleanup();
+    return err;
+}
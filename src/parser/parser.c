@@ -17,7 +17,7 @@ static ast_node_t* parse_variable_decl_after_name(
 static token_t* parser_current(void);
 static bool parser_match(token_type_t type);
 static ast_node_t* ast_node_create(ast_node_type_t type);
-static ast_node_t* parse_function_after_name(char* name, type_t* return_type);
+static ast_node_t* parse_function_after_name(char* name, type_t* return_type, uint8_t flags);
 static type_t* parse_type(void);
 
 
@@ -129,6 +129,7 @@ parser_t* parser_create(void) {
     parser->current = lexer_next_token();
     parser->next = lexer_next_token();
     parser->error_count = 0;
+    parser->sink = NULL;
 
     return parser;
 }
@@ -196,8 +197,17 @@ static bool parser_consume_expected(
     return false;
 }
 
+/* Names and literals move from the token into the tree; into an arena they
+ * are copied, as tokens stay in the pool */
+static char* parser_take_value(token_t* tok) {
+    char* value = tok->value;
+    if (g_cc_tree_arena) return cc_tree_strdup(value);
+    tok->value = NULL;
+    return value;
+}
+
 static ast_node_t* ast_node_create(ast_node_type_t type) {
-    ast_node_t* node = (ast_node_t*)cc_malloc(sizeof(ast_node_t));
+    ast_node_t* node = (ast_node_t*)cc_tree_alloc(sizeof(ast_node_t));
     if (!node) return NULL;
 
     node->type = type;
@@ -306,19 +316,19 @@ static ast_node_t* parse_variable_decl_after_name(
     int8_t array_suffix = parse_array_suffix(&array_len, false);
     if (array_suffix < 0) {
         type_destroy(var_type);
-        cc_free(name);
+        cc_tree_free(name);
         return NULL;
     }
     var_type = parse_array_type(var_type, array_len, array_suffix, false);
     if (!var_type) {
-        cc_free(name);
+        cc_tree_free(name);
         return NULL;
     }
 
     ast_node_t* node = ast_node_create(AST_VAR_DECL);
     if (!node) {
         type_destroy(var_type);
-        cc_free(name);
+        cc_tree_free(name);
         return NULL;
     }
     node->data.var_decl.name = name;
@@ -342,8 +352,7 @@ static ast_node_t* parse_primary(void) {
     ast_node_t* base = NULL;
 
     if (tok->type == TOK_IDENTIFIER) {
-        char* name = tok->value;
-        tok->value = NULL;
+        char* name = parser_take_value(tok);
         parser_advance();
 
         /* Check for function call: identifier '(' args ')' */
@@ -352,7 +361,7 @@ static ast_node_t* parse_primary(void) {
 
             ast_node_t* call = ast_node_create(AST_CALL);
             if (!call) {
-                cc_free(name);
+                cc_tree_free(name);
                 return NULL;
             }
 
@@ -389,7 +398,7 @@ static ast_node_t* parse_primary(void) {
                 } while (!parser_check(TOK_RPAREN) && !parser_check(TOK_EOF));
 
                 if (arg_count > 0) {
-                    ast_node_t** args = (ast_node_t**)cc_malloc(sizeof(ast_node_t*) * arg_count);
+                    ast_node_t** args = (ast_node_t**)cc_tree_alloc(sizeof(ast_node_t*) * arg_count);
                     if (!args) {
                         for (uint16_t i = 0; i < arg_count; i++) {
                             ast_node_destroy(args_tmp[i]);
@@ -417,7 +426,7 @@ static ast_node_t* parse_primary(void) {
             if (node) {
                 node->data.identifier.name = name;
             } else {
-                cc_free(name);
+                cc_tree_free(name);
             }
             base = node;
         }
@@ -438,14 +447,13 @@ static ast_node_t* parse_primary(void) {
         }
         base = node;
     } else if (tok->type == TOK_STRING) {
-        char* value = tok->value;
-        tok->value = NULL;
+        char* value = parser_take_value(tok);
         parser_advance();
         ast_node_t* node = ast_node_create(AST_STRING_LITERAL);
         if (node) {
             node->data.string_literal.value = value;
         } else {
-            cc_free(value);
+            cc_tree_free(value);
         }
         base = node;
     } else if (parser_match(TOK_LPAREN)) {
@@ -496,53 +504,69 @@ static ast_node_t* parse_primary(void) {
     return base;
 }
 
-/* Operator precedence parsing:
- * factor: primary (*, /, %) factor | primary
- * term: factor (+, -) term | factor
- * expression: term
+/* Binary expressions by precedence climbing: one loop reads operators of
+ * at least a given precedence and only recurses for an operand that is
+ * followed by a tighter-binding operator. All operators are
+ * left-associative; precedences, loosest first:
+ *   || , && , | , ^ , & , (== != < > <= >=) , (<< >>) , (+ -) , (* / %)
  */
 static ast_node_t* parse_unary(void);
-static ast_node_t* parse_factor(void);
-static ast_node_t* parse_term(void);
-static ast_node_t* parse_shift(void);
-static ast_node_t* parse_comparison(void);
-static ast_node_t* parse_bitwise_and(void);
-static ast_node_t* parse_bitwise_xor(void);
-static ast_node_t* parse_bitwise_or(void);
-static ast_node_t* parse_logical_and(void);
-static ast_node_t* parse_logical_or(void);
-
-typedef struct {
-    token_type_t token;
-    binary_op_t op;
-} binop_map_t;
 
 typedef struct {
     token_type_t token;
     unary_op_t op;
 } unary_op_map_t;
 
-static ast_node_t* parse_binary_left(ast_node_t* (*next)(void),
-                                     const binop_map_t* ops,
-                                     uint8_t op_count) {
-    ast_node_t* left = next();
+typedef struct {
+    uint8_t prec; /* 0: not a binary operator */
+    uint8_t op;   /* binary_op_t */
+} binop_info_t;
+
+#define BINOP_FIRST_TOKEN TOK_PLUS
+#define BINOP_LAST_TOKEN TOK_OR
+
+static const binop_info_t k_binop_info[BINOP_LAST_TOKEN - BINOP_FIRST_TOKEN + 1] = {
+    { 9, OP_ADD },  /* TOK_PLUS */
+    { 9, OP_SUB },  /* TOK_MINUS */
+    { 10, OP_MUL }, /* TOK_STAR */
+    { 10, OP_DIV }, /* TOK_SLASH */
+    { 10, OP_MOD }, /* TOK_PERCENT */
+    { 6, OP_AND },  /* TOK_AMPERSAND */
+    { 4, OP_OR },   /* TOK_PIPE */
+    { 5, OP_XOR },  /* TOK_CARET */
+    { 0, 0 },       /* TOK_TILDE */
+    { 0, 0 },       /* TOK_EXCLAIM */
+    { 0, 0 },       /* TOK_ASSIGN */
+    { 7, OP_LT },   /* TOK_LT */
+    { 7, OP_GT },   /* TOK_GT */
+    { 0, 0 },       /* TOK_PLUS_PLUS */
+    { 0, 0 },       /* TOK_MINUS_MINUS */
+    { 8, OP_SHL },  /* TOK_LSHIFT */
+    { 8, OP_SHR },  /* TOK_RSHIFT */
+    { 7, OP_EQ },   /* TOK_EQ */
+    { 7, OP_NE },   /* TOK_NE */
+    { 7, OP_LE },   /* TOK_LE */
+    { 7, OP_GE },   /* TOK_GE */
+    { 3, OP_LAND }, /* TOK_AND */
+    { 2, OP_LOR },  /* TOK_OR */
+};
+
+static const binop_info_t* parser_binop(void) {
+    token_type_t tok = parser_current()->type;
+    if (tok < BINOP_FIRST_TOKEN || tok > BINOP_LAST_TOKEN) return NULL;
+    return &k_binop_info[tok - BINOP_FIRST_TOKEN];
+}
+
+static ast_node_t* parse_binary(uint8_t min_prec) {
+    ast_node_t* left = parse_unary();
     if (!left) return NULL;
 
     while (1) {
-        token_type_t tok = parser_current()->type;
-        bool matched = false;
-        binary_op_t op = OP_ADD;
-        for (uint8_t i = 0; i < op_count; i++) {
-            if (tok == ops[i].token) {
-                matched = true;
-                op = ops[i].op;
-                break;
-            }
-        }
-        if (!matched) break;
+        const binop_info_t* info = parser_binop();
+        if (!info || info->prec < min_prec) break;
 
         parser_advance();
-        ast_node_t* right = next();
+        ast_node_t* right = parse_binary((uint8_t)(info->prec + 1));
         if (!right) {
             ast_node_destroy(left);
             return NULL;
@@ -555,7 +579,7 @@ static ast_node_t* parse_binary_left(ast_node_t* (*next)(void),
             return NULL;
         }
 
-        binop->data.binary_op.op = op;
+        binop->data.binary_op.op = (binary_op_t)info->op;
         binop->data.binary_op.left = left;
         binop->data.binary_op.right = right;
         left = binop;
@@ -596,96 +620,8 @@ static ast_node_t* parse_unary(void) {
     return parse_primary();
 }
 
-static ast_node_t* parse_factor(void) {
-    static const binop_map_t ops[] = {
-        { TOK_STAR, OP_MUL },
-        { TOK_SLASH, OP_DIV },
-        { TOK_PERCENT, OP_MOD },
-    };
-    return parse_binary_left(parse_unary, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
-static ast_node_t* parse_term(void) {
-    static const binop_map_t ops[] = {
-        { TOK_PLUS, OP_ADD },
-        { TOK_MINUS, OP_SUB },
-    };
-    return parse_binary_left(parse_factor, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
-/* Shift operators: <<, >> */
-static ast_node_t* parse_shift(void) {
-    static const binop_map_t ops[] = {
-        { TOK_LSHIFT, OP_SHL },
-        { TOK_RSHIFT, OP_SHR },
-    };
-    return parse_binary_left(parse_term, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
-/* Comparison operators: ==, !=, <, >, <=, >= */
-static ast_node_t* parse_comparison(void) {
-    static const binop_map_t ops[] = {
-        { TOK_LT, OP_LT },
-        { TOK_GT, OP_GT },
-        { TOK_LE, OP_LE },
-        { TOK_GE, OP_GE },
-        { TOK_EQ, OP_EQ },
-        { TOK_NE, OP_NE },
-    };
-    return parse_binary_left(parse_shift, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
-/* Bitwise AND: & */
-static ast_node_t* parse_bitwise_and(void) {
-    static const binop_map_t ops[] = {
-        { TOK_AMPERSAND, OP_AND },
-    };
-    return parse_binary_left(parse_comparison, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
-/* Bitwise XOR: ^ */
-static ast_node_t* parse_bitwise_xor(void) {
-    static const binop_map_t ops[] = {
-        { TOK_CARET, OP_XOR },
-    };
-    return parse_binary_left(parse_bitwise_and, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
-/* Bitwise OR: | */
-static ast_node_t* parse_bitwise_or(void) {
-    static const binop_map_t ops[] = {
-        { TOK_PIPE, OP_OR },
-    };
-    return parse_binary_left(parse_bitwise_xor, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
-/* Logical AND: && */
-static ast_node_t* parse_logical_and(void) {
-    static const binop_map_t ops[] = {
-        { TOK_AND, OP_LAND },
-    };
-    return parse_binary_left(parse_bitwise_or, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
-/* Logical OR: || */
-static ast_node_t* parse_logical_or(void) {
-    static const binop_map_t ops[] = {
-        { TOK_OR, OP_LOR },
-    };
-    return parse_binary_left(parse_logical_and, ops,
-                             (uint8_t)(sizeof(ops) / sizeof(ops[0])));
-}
-
 static ast_node_t* parse_expression(void) {
-    ast_node_t* left = parse_logical_or();
+    ast_node_t* left = parse_binary(1);
     if (!left) return NULL;
 
     /* Assignment is right-associative: a = b = c */
@@ -712,6 +648,97 @@ static ast_node_t* parse_expression(void) {
     return left;
 }
 
+/* if/while/for up to their body (the keyword already consumed), shared by
+ * the tree and streaming statement parsers. The bodies are left NULL. */
+static ast_node_t* parse_if_header(void) {
+    ast_node_t* node = ast_node_create(AST_IF_STMT);
+    if (!node) return NULL;
+
+    node->data.if_stmt.then_branch = NULL;
+    node->data.if_stmt.else_branch = NULL;
+    if (!parser_consume_expected(TOK_LPAREN, ERR_AFTER_IF)) {
+        cc_tree_free(node);
+        return NULL;
+    }
+
+    node->data.if_stmt.condition = parse_expression();
+    if (!node->data.if_stmt.condition) {
+        cc_tree_free(node);
+        return NULL;
+    }
+
+    if (!parser_consume_expected(TOK_RPAREN, ERR_AFTER_IF)) {
+        ast_node_destroy(node);
+        return NULL;
+    }
+    return node;
+}
+
+static ast_node_t* parse_while_header(void) {
+    ast_node_t* node = ast_node_create(AST_WHILE_STMT);
+    if (!node) return NULL;
+
+    node->data.while_stmt.body = NULL;
+    if (!parser_consume_expected(TOK_LPAREN, ERR_AFTER_WHILE)) {
+        cc_tree_free(node);
+        return NULL;
+    }
+
+    node->data.while_stmt.condition = parse_expression();
+    if (!node->data.while_stmt.condition) {
+        cc_tree_free(node);
+        return NULL;
+    }
+
+    if (!parser_consume_expected(TOK_RPAREN, ERR_AFTER_WHILE)) {
+        ast_node_destroy(node);
+        return NULL;
+    }
+    return node;
+}
+
+static ast_node_t* parse_for_header(void) {
+    ast_node_t* node = ast_node_create(AST_FOR_STMT);
+    if (!node) return NULL;
+
+    node->data.for_stmt.body = NULL;
+    if (!parser_consume_expected(TOK_LPAREN, ERR_AFTER_FOR)) {
+        cc_tree_free(node);
+        return NULL;
+    }
+
+    /* Init expression (or declaration) */
+    if (!parser_check(TOK_SEMICOLON)) {
+        node->data.for_stmt.init = parse_statement();
+    } else {
+        node->data.for_stmt.init = NULL;
+        parser_advance(); /* consume ; */
+    }
+
+    /* Condition */
+    if (!parser_check(TOK_SEMICOLON)) {
+        node->data.for_stmt.condition = parse_expression();
+    } else {
+        node->data.for_stmt.condition = NULL;
+    }
+    node->data.for_stmt.increment = NULL;
+    if (!parser_consume_expected(TOK_SEMICOLON, ERR_AFTER_FOR_COND)) {
+        ast_node_destroy(node);
+        return NULL;
+    }
+
+    /* Increment */
+    if (!parser_check(TOK_RPAREN)) {
+        node->data.for_stmt.increment = parse_expression();
+    }
+
+    if (!parser_consume_expected(TOK_RPAREN, ERR_AFTER_FOR)) {
+        ast_node_destroy(node);
+        return NULL;
+    }
+    return node;
+}
+
 static ast_node_t* parse_statement(void) {
     /* Variable declaration: int x; or int x = 5; */
     type_t* var_type = parse_type();
@@ -721,11 +748,10 @@ static ast_node_t* parse_statement(void) {
         }
 
         token_t* name_tok = parser_current();
-        char* name = name_tok->value;
-        name_tok->value = NULL;
+        char* name = parser_take_value(name_tok);
         if (!parser_consume(TOK_IDENTIFIER, ERR_EXPECT_IDENT)) {
             type_destroy(var_type);
-            cc_free(name);
+            cc_tree_free(name);
             return NULL;
         }
         return parse_variable_decl_after_name(
@@ -733,25 +759,9 @@ static ast_node_t* parse_statement(void) {
     }
 
     if (parser_match(TOK_IF)) {
-        ast_node_t* node = ast_node_create(AST_IF_STMT);
+        ast_node_t* node = parse_if_header();
         if (!node) return NULL;
 
-        if (!parser_consume_expected(TOK_LPAREN, ERR_AFTER_IF)) {
-            cc_free(node);
-            return NULL;
-        }
-
-        node->data.if_stmt.condition = parse_expression();
-        if (!node->data.if_stmt.condition) {
-            cc_free(node);
-            return NULL;
-        }
-
-        if (!parser_consume_expected(TOK_RPAREN, ERR_AFTER_IF)) {
-            ast_node_destroy(node);
-            return NULL;
-        }
-
         node->data.if_stmt.then_branch = parse_statement();
         if (!node->data.if_stmt.then_branch) {
             ast_node_destroy(node);
@@ -760,33 +770,15 @@ static ast_node_t* parse_statement(void) {
 
         if (parser_match(TOK_ELSE)) {
             node->data.if_stmt.else_branch = parse_statement();
-        } else {
-            node->data.if_stmt.else_branch = NULL;
         }
 
         return node;
     }
 
     if (parser_match(TOK_WHILE)) {
-        ast_node_t* node = ast_node_create(AST_WHILE_STMT);
+        ast_node_t* node = parse_while_header();
         if (!node) return NULL;
 
-        if (!parser_consume_expected(TOK_LPAREN, ERR_AFTER_WHILE)) {
-            cc_free(node);
-            return NULL;
-        }
-
-        node->data.while_stmt.condition = parse_expression();
-        if (!node->data.while_stmt.condition) {
-            cc_free(node);
-            return NULL;
-        }
-
-        if (!parser_consume_expected(TOK_RPAREN, ERR_AFTER_WHILE)) {
-            ast_node_destroy(node);
-            return NULL;
-        }
-
         node->data.while_stmt.body = parse_statement();
         if (!node->data.while_stmt.body) {
             ast_node_destroy(node);
@@ -797,45 +789,9 @@ static ast_node_t* parse_statement(void) {
     }
 
     if (parser_match(TOK_FOR)) {
-        ast_node_t* node = ast_node_create(AST_FOR_STMT);
+        ast_node_t* node = parse_for_header();
         if (!node) return NULL;
 
-        if (!parser_consume_expected(TOK_LPAREN, ERR_AFTER_FOR)) {
-            cc_free(node);
-            return NULL;
-        }
-
-        /* Init expression (or declaration) */
-        if (!parser_check(TOK_SEMICOLON)) {
-            node->data.for_stmt.init = parse_statement();
-        } else {
-            node->data.for_stmt.init = NULL;
-            parser_advance(); /* consume ; */
-        }
-
-        /* Condition */
-        if (!parser_check(TOK_SEMICOLON)) {
-            node->data.for_stmt.condition = parse_expression();
-        } else {
-            node->data.for_stmt.condition = NULL;
-        }
-        if (!parser_consume_expected(TOK_SEMICOLON, ERR_AFTER_FOR_COND)) {
-            ast_node_destroy(node);
-            return NULL;
-        }
-
-        /* Increment */
-        if (!parser_check(TOK_RPAREN)) {
-            node->data.for_stmt.increment = parse_expression();
-        } else {
-            node->data.for_stmt.increment = NULL;
-        }
-
-        if (!parser_consume_expected(TOK_RPAREN, ERR_AFTER_FOR)) {
-            ast_node_destroy(node);
-            return NULL;
-        }
-
         /* Body */
         node->data.for_stmt.body = parse_statement();
         if (!node->data.for_stmt.body) {
@@ -871,15 +827,14 @@ static ast_node_t* parse_statement(void) {
 
     if (parser_match(TOK_GOTO)) {
         token_t* name_tok = parser_current();
-        char* name = name_tok->value;
-        name_tok->value = NULL;
+        char* name = parser_take_value(name_tok);
         if (!parser_consume(TOK_IDENTIFIER, ERR_EXPECT_IDENT)) {
-            cc_free(name);
+            cc_tree_free(name);
             return NULL;
         }
         ast_node_t* node = ast_node_create(AST_GOTO_STMT);
         if (!node) {
-            cc_free(name);
+            cc_tree_free(name);
             return NULL;
         }
         node->data.goto_stmt.label = name;
@@ -889,16 +844,15 @@ static ast_node_t* parse_statement(void) {
 
     if (parser_check(TOK_IDENTIFIER) && parser_peek_type() == TOK_COLON) {
         token_t* name_tok = parser_current();
-        char* name = name_tok->value;
-        name_tok->value = NULL;
+        char* name = parser_take_value(name_tok);
         parser_advance();
         if (!parser_consume_expected(TOK_COLON, NULL)) {
-            cc_free(name);
+            cc_tree_free(name);
             return NULL;
         }
         ast_node_t* node = ast_node_create(AST_LABEL_STMT);
         if (!node) {
-            cc_free(name);
+            cc_tree_free(name);
             return NULL;
         }
         node->data.label_stmt.label = name;
@@ -921,13 +875,13 @@ static ast_node_t* parse_statement(void) {
             }
         }
         if (node->data.compound.stmt_count > 0) {
-            node->data.compound.statements = (ast_node_t**)cc_malloc(
+            node->data.compound.statements = (ast_node_t**)cc_tree_alloc(
                 sizeof(ast_node_t*) * node->data.compound.stmt_count);
             if (!node->data.compound.statements) {
                 for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
                     ast_node_destroy(stmts_tmp[i]);
                 }
-                cc_free(node);
+                cc_tree_free(node);
                 return NULL;
             }
             for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
@@ -949,6 +903,54 @@ static ast_node_t* parse_statement(void) {
     return NULL;
 }
 
+/* Streaming counterpart of parse_statement for function bodies: blocks and
+ * if/while/for are opened on the sink with the parts before their body,
+ * and any other statement is handed over as soon as it is parsed, so only
+ * the open headers stay in memory. Every node opened is also closed. */
+static void parse_statement_stream(void) {
+    const parser_sink_t* sink = parser->sink;
+    ast_node_t* node;
+
+    if (parser_match(TOK_LBRACE)) {
+        node = ast_node_create(AST_COMPOUND_STMT);
+        if (!node) {
+            parser->error_count++;
+            return;
+        }
+        node->data.compound.statements = NULL;
+        node->data.compound.stmt_count = 0;
+        sink->open(node);
+        while (!parser_check(TOK_RBRACE) && !parser_check(TOK_EOF)) {
+            parse_statement_stream();
+        }
+        parser_consume_expected(TOK_RBRACE, NULL);
+    } else if (parser_match(TOK_IF)) {
+        node = parse_if_header();
+        if (!node) return;
+        sink->open(node);
+        parse_statement_stream();
+        if (parser_match(TOK_ELSE)) {
+            sink->branch(node);
+            parse_statement_stream();
+        }
+    } else if (parser_match(TOK_WHILE)) {
+        node = parse_while_header();
+        if (!node) return;
+        sink->open(node);
+        parse_statement_stream();
+    } else if (parser_match(TOK_FOR)) {
+        node = parse_for_header();
+        if (!node) return;
+        sink->open(node);
+        parse_statement_stream();
+    } else {
+        node = parse_statement();
+        if (node) sink->statement(node);
+        return;
+    }
+    sink->close(node);
+}
+
 static ast_node_t* parse_parameter(void) {
     ast_node_t* param = ast_node_create(AST_VAR_DECL);
     if (!param) return NULL;
@@ -964,11 +966,10 @@ static ast_node_t* parse_parameter(void) {
     }
 
     token_t* name_tok = parser_current();
-    char* name = name_tok->value;
-    name_tok->value = NULL;
+    char* name = parser_take_value(name_tok);
     if (!parser_consume(TOK_IDENTIFIER, ERR_EXPECT_PARAM_NAME)) {
         type_destroy(var_type);
-        cc_free(name);
+        cc_tree_free(name);
         ast_node_destroy(param);
         return NULL;
     }
@@ -977,13 +978,13 @@ static ast_node_t* parse_parameter(void) {
     int8_t array_suffix = parse_array_suffix(&array_len, true);
     if (array_suffix < 0) {
         type_destroy(var_type);
-        cc_free(name);
+        cc_tree_free(name);
         ast_node_destroy(param);
         return NULL;
     }
     var_type = parse_array_type(var_type, array_len, array_suffix, true);
     if (!var_type) {
-        cc_free(name);
+        cc_tree_free(name);
         ast_node_destroy(param);
         return NULL;
     }
@@ -995,6 +996,17 @@ static ast_node_t* parse_parameter(void) {
 }
 
 static ast_node_t* parse_declaration(void) {
+    uint8_t flags = 0;
+    while (1) {
+        if (parser_match(TOK_STATIC)) {
+            flags |= AST_FUNC_STATIC;
+        } else if (parser_match(TOK_INLINE)) {
+            flags |= AST_FUNC_INLINE;
+        } else {
+            break;
+        }
+    }
+
     type_t* decl_type = parse_type();
     if (decl_type) {
         while (parser_match(TOK_STAR)) {
@@ -1002,16 +1014,15 @@ static ast_node_t* parse_declaration(void) {
         }
 
         token_t* name_tok = parser_current();
-        char* name = name_tok->value;
-        name_tok->value = NULL;
+        char* name = parser_take_value(name_tok);
         if (!parser_consume(TOK_IDENTIFIER, ERR_EXPECT_FUNC_OR_VAR)) {
             type_destroy(decl_type);
-            cc_free(name);
+            cc_tree_free(name);
             return NULL;
         }
 
         if (parser_check(TOK_LPAREN)) {
-            return parse_function_after_name(name, decl_type);
+            return parse_function_after_name(name, decl_type, flags);
         }
         return parse_variable_decl_after_name(
             decl_type, name, ERR_AFTER_GLOBAL_DECL);
@@ -1022,11 +1033,11 @@ static ast_node_t* parse_declaration(void) {
     return NULL;
 }
 
-static ast_node_t* parse_function_after_name(char* name, type_t* return_type) {
+static ast_node_t* parse_function_after_name(char* name, type_t* return_type, uint8_t flags) {
     ast_node_t* node = ast_node_create(AST_FUNCTION);
     if (!node) {
         type_destroy(return_type);
-        cc_free(name);
+        cc_tree_free(name);
         return NULL;
     }
 
@@ -1034,6 +1045,8 @@ static ast_node_t* parse_function_after_name(char* name, type_t* return_type) {
     node->data.function.return_type = return_type;
     node->data.function.params = NULL;
     node->data.function.param_count = 0;
+    node->data.function.body = NULL;
+    node->data.function.flags = flags;
 
     if (!parser_consume_expected(TOK_LPAREN, NULL)) {
         ast_node_destroy(node);
@@ -1076,7 +1089,7 @@ static ast_node_t* parse_function_after_name(char* name, type_t* return_type) {
             parser_advance();
         }
         if (node->data.function.param_count > 0) {
-            node->data.function.params = (ast_node_t**)cc_malloc(
+            node->data.function.params = (ast_node_t**)cc_tree_alloc(
                 sizeof(ast_node_t*) * node->data.function.param_count);
             if (!node->data.function.params) {
                 for (ast_param_count_t i = 0; i < node->data.function.param_count; i++) {
@@ -1096,6 +1109,16 @@ static ast_node_t* parse_function_after_name(char* name, type_t* return_type) {
         return NULL;
     }
 
+    if (parser->sink) {
+        parser->sink->function(node);
+        if (parser_check(TOK_LBRACE)) {
+            parse_statement_stream();
+        } else {
+            parser_consume_expected(TOK_LBRACE, NULL);
+        }
+        parser->sink->close(node);
+        return node;
+    }
     node->data.function.body = parse_statement();
     return node;
 }
@@ -1124,13 +1147,13 @@ ast_node_t* parser_parse(void) {
     }
 
     if (program->data.program.decl_count > 0) {
-        program->data.program.declarations = (ast_node_t**)cc_malloc(
+        program->data.program.declarations = (ast_node_t**)cc_tree_alloc(
             sizeof(ast_node_t*) * program->data.program.decl_count);
         if (!program->data.program.declarations) {
             for (ast_decl_count_t i = 0; i < program->data.program.decl_count; i++) {
                 ast_node_destroy(decls_tmp[i]);
             }
-            cc_free(program);
+            cc_tree_free(program);
             return NULL;
         }
         for (ast_decl_count_t i = 0; i < program->data.program.decl_count; i++) {
@@ -1153,7 +1176,7 @@ static void ast_destroy_program(ast_node_t* node) {
         for (ast_decl_count_t i = 0; i < node->data.program.decl_count; i++) {
             ast_node_destroy(node->data.program.declarations[i]);
         }
-        cc_free(node->data.program.declarations);
+        cc_tree_free(node->data.program.declarations);
     }
 }
 
@@ -1162,7 +1185,7 @@ static void ast_destroy_compound(ast_node_t* node) {
         for (ast_stmt_count_t i = 0; i < node->data.compound.stmt_count; i++) {
             ast_node_destroy(node->data.compound.statements[i]);
         }
-        cc_free(node->data.compound.statements);
+        cc_tree_free(node->data.compound.statements);
     }
 }
 
@@ -1194,13 +1217,13 @@ static void ast_destroy_for(ast_node_t* node) {
 
 static void ast_destroy_identifier(ast_node_t* node) {
     if (node->data.identifier.name) {
-        cc_free(node->data.identifier.name);
+        cc_tree_free(node->data.identifier.name);
     }
 }
 
 static void ast_destroy_function(ast_node_t* node) {
     if (node->data.function.name) {
-        cc_free(node->data.function.name);
+        cc_tree_free(node->data.function.name);
     }
     if (node->data.function.return_type) {
         type_destroy(node->data.function.return_type);
@@ -1209,7 +1232,7 @@ static void ast_destroy_function(ast_node_t* node) {
         for (ast_param_count_t i = 0; i < node->data.function.param_count; i++) {
             ast_node_destroy(node->data.function.params[i]);
         }
-        cc_free(node->data.function.params);
+        cc_tree_free(node->data.function.params);
     }
     if (node->data.function.body) {
         ast_node_destroy(node->data.function.body);
@@ -1218,7 +1241,7 @@ static void ast_destroy_function(ast_node_t* node) {
 
 static void ast_destroy_string(ast_node_t* node) {
     if (node->data.string_literal.value) {
-        cc_free(node->data.string_literal.value);
+        cc_tree_free(node->data.string_literal.value);
     }
 }
 
@@ -1239,19 +1262,19 @@ static void ast_destroy_return(ast_node_t* node) {
 
 static void ast_destroy_goto(ast_node_t* node) {
     if (node->data.goto_stmt.label) {
-        cc_free(node->data.goto_stmt.label);
+        cc_tree_free(node->data.goto_stmt.label);
     }
 }
 
 static void ast_destroy_label(ast_node_t* node) {
     if (node->data.label_stmt.label) {
-        cc_free(node->data.label_stmt.label);
+        cc_tree_free(node->data.label_stmt.label);
     }
 }
 
 static void ast_destroy_var_decl(ast_node_t* node) {
     if (node->data.var_decl.name) {
-        cc_free(node->data.var_decl.name);
+        cc_tree_free(node->data.var_decl.name);
     }
     if (node->data.var_decl.var_type) {
         type_destroy(node->data.var_decl.var_type);
@@ -1268,13 +1291,13 @@ static void ast_destroy_assign(ast_node_t* node) {
 
 static void ast_destroy_call(ast_node_t* node) {
     if (node->data.call.name) {
-        cc_free(node->data.call.name);
+        cc_tree_free(node->data.call.name);
     }
     if (node->data.call.args) {
         for (ast_arg_count_t i = 0; i < node->data.call.arg_count; i++) {
             ast_node_destroy(node->data.call.args[i]);
         }
-        cc_free(node->data.call.args);
+        cc_tree_free(node->data.call.args);
     }
 }
 
@@ -1307,7 +1330,8 @@ static const ast_destroy_fn g_ast_destroy_handlers[AST_NODE_TYPE_COUNT] = {
 };
 
 void ast_node_destroy(ast_node_t* node) {
-    if (!node) return;
+    /* Trees in an arena go when their owner releases it */
+    if (!node || g_cc_tree_arena) return;
 
     if (node->type < AST_NODE_TYPE_COUNT) {
         ast_destroy_fn fn = g_ast_destroy_handlers[node->type];
@@ -1316,5 +1340,5 @@ void ast_node_destroy(ast_node_t* node) {
         }
     }
 
-    cc_free(node);
+    cc_tree_free(node);
 }
@@ -5,19 +5,24 @@
 #include "semantic.h"
 #include "target.h"
 
-static const char SEM_MSG_USAGE[] = "Usage: cc_semantic <input.ast>\n";
+static const char SEM_MSG_USAGE[] = "Usage: cc_semantic <input.ast> [<analyzed.ast>]\n";
 static const char SEM_MSG_FAILED_READ_AST_HEADER[] = "Failed to read AST header\n";
 static const char SEM_MSG_FAILED_READ_AST_STRING_TABLE[] = "Failed to read AST string table\n";
 static const char SEM_MSG_FAILED_SEMANTIC[] = "Semantic validation failed\n";
 static const char SEM_MSG_FAILED_OPEN_INPUT[] = "Failed to open input file\n";
+static const char SEM_MSG_FAILED_OPEN_OUTPUT[] = "Failed to open output file\n";
 
 reader_t* reader;
 ast_reader_t* ast;
 ast_reader_t ast_ctx;
+static output_t out;
+static uint8_t out_open;
 
 static void cleanup(void) {
     ast_reader_destroy();
     reader_close(reader);
+    if (out_open) output_close(out);
+    out_open = 0;
 }
 
 static void handle_error(char* msg) {
@@ -57,21 +62,35 @@ int main(int argc, char** argv) {
         goto cleanup;
     }
 
-    result = semantic_validate();
+    if (args.output_file) {
+        out = output_open(args.output_file);
+#ifdef __SDCC
+        if (out < 0) {
+#else
+        if (!out) {
+#endif
+            log_error(SEM_MSG_FAILED_OPEN_OUTPUT);
+            goto cleanup;
+        }
+        out_open = 1;
+        ast_write_handler(handle_error, "Failed to write analyzed AST\n");
+    }
+
+    result = semantic_validate(out_open ? &out : NULL);
     if (result != CC_OK) {
         log_error(SEM_MSG_FAILED_SEMANTIC);
         goto cleanup;
     }
 
-    cleanup();
-
     log_msg(args.input_file);
     log_msg(" OK\n");
 
     err = 0;
-    return err;
 
 cleanup:
     cleanup();
+#if CC_STATS
+    if (args.stats) cc_stats_print("cc_semantic");
+#endif
     return err;
 }
@@ -1,5 +1,6 @@
 #include "semantic.h"
 
+#include "ast_analysis.h"
 #include "ast_format.h"
 #include "ast_io.h"
 #include "cc_compat.h"
@@ -8,7 +9,7 @@
 #define SEM_MAX_LABELS 64
 #define SEM_MAX_GOTOS 64
 #define SEM_MAX_SCOPES 8
-#define SEM_MAX_SYMBOLS 32
+#define SEM_SYMBOLS_INITIAL 16
 #define SEM_MAX_PARAMS 8
 
 static const char SEM_ERR_BREAK_OUTSIDE_LOOP[] = "break not within loop\n";
@@ -22,7 +23,6 @@ static const char SEM_ERR_IDENT_DUPLICATE[] = "Duplicate identifier: ";
 static const char SEM_ERR_IDENT_UNDEFINED[] = "Undefined identifier: ";
 static const char SEM_ERR_FUNC_UNDEFINED[] = "Undefined function: ";
 static const char SEM_ERR_SCOPE_OVERFLOW[] = "Too many scopes\n";
-static const char SEM_ERR_SYMBOL_OVERFLOW[] = "Too many symbols in scope\n";
 static const char SEM_ERR_EXPECT_LVALUE[] = "Expected lvalue\n";
 static const char SEM_ERR_RETURN_VALUE_VOID[] = "Return value in void function\n";
 static const char SEM_ERR_RETURN_MISSING_VALUE[] = "Missing return value\n";
@@ -43,6 +43,7 @@ static const char SEM_ERR_CALL_ARG_COUNT[] = "Argument count mismatch\n";
 static const char SEM_ERR_CALL_ARG_TYPE[] = "Argument type mismatch\n";
 static const char SEM_ERR_VOID_VALUE[] = "Void value not allowed\n";
 static const char SEM_ERR_PARAM_OVERFLOW[] = "Too many parameters\n";
+static const char SEM_ERR_OUT_OF_MEMORY[] = "Out of memory for symbols\n";
 
 typedef struct {
     const char* labels[SEM_MAX_LABELS];
@@ -64,23 +65,47 @@ typedef struct {
     uint16_t array_len;
 } semantic_type_t;
 
+/* Symbols live on one stack; scope_base[] marks where each open scope
+ * starts. Names are AST string indices (the table is deduplicated), and
+ * bindings[index] is the innermost visible symbol for that name, so a
+ * lookup is one array access. Popping a scope restores the bindings it
+ * shadowed. */
 typedef struct {
-    const char* name;
-    semantic_symbol_kind_t kind;
+    uint16_t name;
+    uint16_t shadowed;      /* previous binding of name, 0 if none */
     semantic_type_t type;
+    uint8_t kind;
     uint8_t param_count;
-    semantic_type_t params[SEM_MAX_PARAMS];
+    uint16_t params;        /* first entry in state->params */
 } semantic_symbol_t;
 
+/* A local in the frame of the current function; the first declaration of
+ * a name gets the slot, later ones (in other blocks) share it */
 typedef struct {
-    semantic_symbol_t symbols[SEM_MAX_SYMBOLS];
-    uint8_t count;
-} semantic_scope_t;
+    uint16_t name;
+    uint16_t offset;
+    uint8_t flags;          /* AST_VAR_* */
+    uint8_t elem_size;
+} semantic_local_t;
 
 typedef struct {
-    semantic_scope_t scopes[SEM_MAX_SCOPES];
+    semantic_symbol_t* symbols;
+    uint16_t symbol_count;
+    uint16_t symbol_capacity;
+    semantic_type_t* params; /* function signatures */
+    uint16_t param_count;
+    uint16_t param_capacity;
+    uint16_t* bindings;     /* per string index: symbol + 1, 0 if unbound */
+    uint16_t scope_base[SEM_MAX_SCOPES];
     uint8_t scope_depth;
     uint8_t in_function;
+    output_t out;           /* analysis section, if analyze */
+    uint8_t analyze;
+    semantic_local_t* frame; /* locals of the current function body */
+    uint16_t frame_count;
+    uint16_t frame_capacity;
+    uint16_t frame_size;
+    uint8_t frame_open;     /* past the parameters */
     semantic_ctx_t* label_ctx;
     semantic_type_t return_type;
     uint8_t return_is_void;
@@ -227,12 +252,23 @@ static int8_t semantic_check_tag_with_lvalue(
     uint8_t* out_const_zero
 );
 
+/* Pool arrays double when full */
+static uint16_t semantic_next_capacity(uint16_t capacity) {
+    return capacity ? (uint16_t)(capacity * 2u) : SEM_SYMBOLS_INITIAL;
+}
+
+static void semantic_name_error(const char* msg, uint16_t name) {
+    log_error(msg);
+    log_error(ast_reader_string(name));
+    log_error("\n");
+}
+
 static int8_t semantic_scope_push(semantic_state_t* state) {
     if (!state || state->scope_depth >= SEM_MAX_SCOPES) {
         log_error(SEM_ERR_SCOPE_OVERFLOW);
         return -1;
     }
-    mem_set(&state->scopes[state->scope_depth], 0, sizeof(state->scopes[state->scope_depth]));
+    state->scope_base[state->scope_depth] = state->symbol_count;
     state->scope_depth++;
     return 0;
 }
@@ -240,58 +276,78 @@ static int8_t semantic_scope_push(semantic_state_t* state) {
 static void semantic_scope_pop(semantic_state_t* state) {
     if (!state || state->scope_depth == 0) return;
     state->scope_depth--;
+    while (state->symbol_count > state->scope_base[state->scope_depth]) {
+        const semantic_symbol_t* sym = &state->symbols[--state->symbol_count];
+        state->bindings[sym->name] = sym->shadowed;
+    }
 }
 
-static int8_t semantic_scope_add(semantic_state_t* state, const char* name,
+static int8_t semantic_scope_add(semantic_state_t* state, uint16_t name,
                                  semantic_symbol_kind_t kind,
                                  const semantic_type_t* type,
                                  uint8_t param_count,
                                  const semantic_type_t* params) {
-    if (!state || !name || !*name || state->scope_depth == 0) {
+    if (!state || name >= ast->string_count || state->scope_depth == 0) {
         log_error(SEM_ERR_LABEL_INVALID);
         return -1;
     }
-    semantic_scope_t* scope = &state->scopes[state->scope_depth - 1];
-    for (uint8_t i = 0; i < scope->count; i++) {
-        if (str_cmp(scope->symbols[i].name, name) == 0) {
-            log_error(SEM_ERR_IDENT_DUPLICATE);
-            log_error(name);
-            log_error("\n");
-            return -1;
-        }
+    uint16_t bound = state->bindings[name];
+    if (bound && bound - 1 >= state->scope_base[state->scope_depth - 1]) {
+        semantic_name_error(SEM_ERR_IDENT_DUPLICATE, name);
+        return -1;
     }
-    if (scope->count >= SEM_MAX_SYMBOLS) {
-        log_error(SEM_ERR_SYMBOL_OVERFLOW);
+    if (param_count > SEM_MAX_PARAMS) {
+        log_error(SEM_ERR_PARAM_OVERFLOW);
         return -1;
     }
-    scope->symbols[scope->count].name = name;
-    scope->symbols[scope->count].kind = kind;
+    if (state->symbol_count == state->symbol_capacity) {
+        semantic_symbol_t* grown = (semantic_symbol_t*)cc_grow(
+            state->symbols, &state->symbol_capacity,
+            semantic_next_capacity(state->symbol_capacity), sizeof(semantic_symbol_t));
+        if (!grown) {
+            log_error(SEM_ERR_OUT_OF_MEMORY);
+            return -1;
+        }
+        state->symbols = grown;
+    }
+    semantic_symbol_t* sym = &state->symbols[state->symbol_count];
+    sym->name = name;
+    sym->shadowed = bound;
+    sym->kind = (uint8_t)kind;
     if (type) {
-        scope->symbols[scope->count].type = *type;
+        sym->type = *type;
     } else {
-        semantic_type_clear(&scope->symbols[scope->count].type);
+        semantic_type_clear(&sym->type);
     }
-    scope->symbols[scope->count].param_count = 0;
-    if (kind == SEM_SYMBOL_FUNC && param_count > 0) {
-        if (param_count > SEM_MAX_PARAMS) {
-            log_error(SEM_ERR_PARAM_OVERFLOW);
-            return -1;
-        }
-        scope->symbols[scope->count].param_count = param_count;
+    sym->param_count = 0;
+    sym->params = state->param_count;
+    if (kind == SEM_SYMBOL_FUNC) {
         for (uint8_t i = 0; i < param_count; i++) {
-            scope->symbols[scope->count].params[i] = params[i];
+            if (state->param_count == state->param_capacity) {
+                semantic_type_t* grown = (semantic_type_t*)cc_grow(
+                    state->params, &state->param_capacity,
+                    semantic_next_capacity(state->param_capacity), sizeof(semantic_type_t));
+                if (!grown) {
+                    log_error(SEM_ERR_OUT_OF_MEMORY);
+                    return -1;
+                }
+                state->params = grown;
+            }
+            state->params[state->param_count++] = params[i];
         }
+        sym->param_count = param_count;
     }
-    scope->count++;
+    state->symbol_count++;
+    state->bindings[name] = state->symbol_count;
     return 0;
 }
 
-static int8_t semantic_scope_add_var(semantic_state_t* state, const char* name,
+static int8_t semantic_scope_add_var(semantic_state_t* state, uint16_t name,
                                      const semantic_type_t* type) {
     return semantic_scope_add(state, name, SEM_SYMBOL_VAR, type, 0, NULL);
 }
 
-static int8_t semantic_scope_add_func(semantic_state_t* state, const char* name,
+static int8_t semantic_scope_add_func(semantic_state_t* state, uint16_t name,
                                       const semantic_type_t* return_type,
                                       uint8_t param_count,
                                       const semantic_type_t* params) {
@@ -299,18 +355,103 @@ static int8_t semantic_scope_add_func(semantic_state_t* state, const char* name,
                               param_count, params);
 }
 
+/* Valid until the next symbol is added */
 static const semantic_symbol_t* semantic_scope_lookup(const semantic_state_t* state,
-                                                      const char* name) {
-    if (!state || !name || !*name) return NULL;
-    for (int8_t depth = (int8_t)state->scope_depth - 1; depth >= 0; depth--) {
-        const semantic_scope_t* scope = &state->scopes[depth];
-        for (uint8_t i = 0; i < scope->count; i++) {
-            if (str_cmp(scope->symbols[i].name, name) == 0) {
-                return &scope->symbols[i];
-            }
+                                                      uint16_t name) {
+    if (!state || name >= ast->string_count || !state->bindings[name]) return NULL;
+    return &state->symbols[state->bindings[name] - 1];
+}
+
+/* Analysis
+ *
+ * With an output, the input AST is copied with AST_FLAG_ANALYZED set and
+ * the analysis section appended after its string table: the globals and
+ * function signatures once pass 1 has registered them, then one frame per
+ * function as pass 2 finishes it. See docs/AST_FORMAT.md. */
+
+static int8_t semantic_copy_input(output_t out) {
+    char buf[32];
+    uint32_t pos = 0;
+    if (reader_seek(reader, 0) < 0) return -1;
+    while (pos < ast->analysis_offset) {
+        uint16_t len = 0;
+        while (len < sizeof(buf) && pos < ast->analysis_offset) {
+            int16_t ch = reader_next(reader);
+            if (ch < 0) return -1;
+            buf[len++] = (char)(pos == 5 ? (ch | AST_FLAG_ANALYZED) : ch);
+            pos++;
         }
+        if (output_write(out, buf, len) < 0) return -1;
     }
-    return NULL;
+    return 0;
+}
+
+static void semantic_write_signatures(const semantic_state_t* state) {
+    uint16_t globals = 0;
+    uint16_t functions = 0;
+    for (uint16_t i = 0; i < state->symbol_count; i++) {
+        if (state->symbols[i].kind == SEM_SYMBOL_VAR) {
+            globals++;
+        } else {
+            functions++;
+        }
+    }
+    ast_write_varint(state->out, globals);
+    for (uint16_t i = 0; i < state->symbol_count; i++) {
+        const semantic_symbol_t* sym = &state->symbols[i];
+        uint8_t elem_size = 0;
+        if (sym->kind != SEM_SYMBOL_VAR) continue;
+        ast_write_varint(state->out, sym->name);
+        ast_write_u8(state->out, ast_var_flags(sym->type.base, sym->type.depth,
+                                               sym->type.array_len, &elem_size));
+        ast_write_u8(state->out, elem_size);
+    }
+    ast_write_varint(state->out, functions);
+    for (uint16_t i = 0; i < state->symbol_count; i++) {
+        const semantic_symbol_t* sym = &state->symbols[i];
+        if (sym->kind != SEM_SYMBOL_FUNC) continue;
+        ast_write_varint(state->out, sym->name);
+        ast_write_u8(state->out, ast_type_is_16(sym->type.base, sym->type.depth));
+    }
+}
+
+static int8_t semantic_frame_add(semantic_state_t* state, uint16_t name,
+                                 const semantic_type_t* type) {
+    semantic_local_t* local;
+    for (uint16_t i = 0; i < state->frame_count; i++) {
+        if (state->frame[i].name == name) return 0;
+    }
+    if (state->frame_count == state->frame_capacity) {
+        semantic_local_t* grown = (semantic_local_t*)cc_grow(
+            state->frame, &state->frame_capacity,
+            semantic_next_capacity(state->frame_capacity), sizeof(semantic_local_t));
+        if (!grown) {
+            log_error(SEM_ERR_OUT_OF_MEMORY);
+            return -1;
+        }
+        state->frame = grown;
+    }
+    local = &state->frame[state->frame_count++];
+    local->name = name;
+    local->offset = state->frame_size;
+    local->flags = ast_var_flags(type->base, type->depth, type->array_len, &local->elem_size);
+    state->frame_size = (uint16_t)(state->frame_size +
+                                   ast_var_size(local->flags, local->elem_size, type->array_len));
+    return 0;
+}
+
+static void semantic_frame_write(semantic_state_t* state) {
+    ast_write_varint(state->out, state->frame_count);
+    ast_write_varint(state->out, state->frame_size);
+    for (uint16_t i = 0; i < state->frame_count; i++) {
+        const semantic_local_t* local = &state->frame[i];
+        ast_write_varint(state->out, local->name);
+        ast_write_varint(state->out, local->offset);
+        ast_write_u8(state->out, local->flags);
+        ast_write_u8(state->out, local->elem_size);
+    }
+    state->frame_count = 0;
+    state->frame_size = 0;
 }
 
 static int8_t semantic_add_label(semantic_ctx_t* ctx, const char* label) {
@@ -397,6 +538,7 @@ static int8_t semantic_check_tag_with_lvalue(
     uint8_t* out_const_zero
 ) {
     if (!ast || !reader) return -1;
+    CC_STAT_INC(nodes_read);
     if (out_lvalue) *out_lvalue = 0;
     if (out_const_zero) *out_const_zero = 0;
     if (out_type) semantic_type_clear(out_type);
@@ -408,8 +550,7 @@ static int8_t semantic_check_tag_with_lvalue(
             uint8_t depth = 0;
             uint16_t array_len = 0;
             semantic_ctx_t local_ctx;
-            uint16_t name_index = ast_read_u16();
-            const char* name = ast_reader_string(name_index);
+            uint16_t name_index = ast_read_index();
             uint8_t prev_in_function = state ? state->in_function : 0;
             semantic_type_t prev_return_type;
             uint8_t prev_return_is_void = state ? state->return_is_void : 0;
@@ -422,10 +563,10 @@ static int8_t semantic_check_tag_with_lvalue(
             }
             if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return -1;
             param_count = ast_read_u8();
-            if (state && semantic_scope_lookup(state, name) == NULL) {
+            if (state && semantic_scope_lookup(state, name_index) == NULL) {
                 semantic_type_t return_type;
                 return_type = semantic_type_make(base, depth, array_len);
-                if (semantic_scope_add_func(state, name, &return_type, 0, NULL) < 0) return -1;
+                if (semantic_scope_add_func(state, name_index, &return_type, 0, NULL) < 0) return -1;
             }
             if (state) {
                 if (semantic_scope_push(state) < 0) return -1;
@@ -437,8 +578,11 @@ static int8_t semantic_check_tag_with_lvalue(
             for (uint8_t i = 0; i < param_count; i++) {
                 if (semantic_check_node_with_lvalue(0, state, NULL, NULL, NULL) < 0) return -1;
             }
+            if (state) state->frame_open = 1;
             if (semantic_check_node_with_lvalue(0, state, NULL, NULL, NULL) < 0) return -1;
             if (state) {
+                state->frame_open = 0;
+                if (state->analyze) semantic_frame_write(state);
                 semantic_scope_pop(state);
                 state->in_function = prev_in_function;
                 state->label_ctx = prev_label_ctx;
@@ -452,18 +596,19 @@ static int8_t semantic_check_tag_with_lvalue(
             uint8_t base = 0;
             uint8_t depth = 0;
             uint16_t array_len = 0;
-            uint16_t name_index = ast_read_u16();
-            const char* name = ast_reader_string(name_index);
+            uint16_t name_index = ast_read_index();
             if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return -1;
             semantic_type_t var_type;
             var_type = semantic_type_make(base, depth, array_len);
             if (state && state->in_function) {
-                if (semantic_scope_add_var(state, name, &var_type) < 0) return -1;
+                if (semantic_scope_add_var(state, name_index, &var_type) < 0) return -1;
+                if (state->analyze && state->frame_open &&
+                    semantic_frame_add(state, name_index, &var_type) < 0) return -1;
             }
             has_init = ast_read_u8();
             if (has_init) {
                 if (array_len > 0) {
-                    uint8_t init_tag = ast_read_u8();
+                    uint8_t init_tag = ast_read_tag();
                     if (init_tag != AST_TAG_STRING_LITERAL) {
                         log_error(SEM_ERR_VAR_INIT_NO_STRING);
                         return -1;
@@ -472,7 +617,7 @@ static int8_t semantic_check_tag_with_lvalue(
                         log_error(SEM_ERR_TYPE_MISMATCH);
                         return -1;
                     }
-                    ast_read_u16();
+                    ast_read_index();
                     return 0;
                 }
                 semantic_type_t init_type;
@@ -492,7 +637,7 @@ static int8_t semantic_check_tag_with_lvalue(
             return 0;
         }
         case AST_TAG_COMPOUND_STMT: {
-            uint16_t stmt_count = ast_read_u16();
+            uint16_t stmt_count = ast_read_index();
             if (state && semantic_scope_push(state) < 0) return -1;
             for (uint16_t i = 0; i < stmt_count; i++) {
                 if (semantic_check_node_with_lvalue(loop_depth, state, NULL, NULL, NULL) < 0) {
@@ -547,16 +692,16 @@ static int8_t semantic_check_tag_with_lvalue(
         case AST_TAG_GOTO_STMT:
             if (!state || !state->label_ctx) return -1;
             {
-                uint16_t name_index = ast_read_u16();
-                const char* label = ast_reader_string(name_index);
+                uint16_t name_index = ast_read_index();
+                const char* label = ast_reader_name(name_index);
                 uint8_t depth = state ? state->scope_depth : 0;
                 return semantic_add_goto_scoped(state->label_ctx, label, depth);
             }
         case AST_TAG_LABEL_STMT:
             if (!state || !state->label_ctx) return -1;
             {
-                uint16_t name_index = ast_read_u16();
-                const char* label = ast_reader_string(name_index);
+                uint16_t name_index = ast_read_index();
+                const char* label = ast_reader_name(name_index);
                 uint8_t depth = state ? state->scope_depth : 0;
                 return semantic_add_label_scoped(state->label_ctx, label, depth);
             }
@@ -640,20 +785,14 @@ static int8_t semantic_check_tag_with_lvalue(
         }
         case AST_TAG_CALL: {
             uint8_t arg_count = 0;
-            uint16_t name_index = ast_read_u16();
-            const char* name = ast_reader_string(name_index);
-            const semantic_symbol_t* sym = state ? semantic_scope_lookup(state, name) : NULL;
-            uint8_t is_builtin = semantic_is_builtin_function(name);
-            if (state && !sym && !is_builtin) {
-                log_error(SEM_ERR_FUNC_UNDEFINED);
-                log_error(name);
-                log_error("\n");
+            uint16_t name_index = ast_read_index();
+            const semantic_symbol_t* sym = state ? semantic_scope_lookup(state, name_index) : NULL;
+            if (state && !sym && !semantic_is_builtin_function(ast_reader_string(name_index))) {
+                semantic_name_error(SEM_ERR_FUNC_UNDEFINED, name_index);
                 return -1;
             }
             if (sym && sym->kind != SEM_SYMBOL_FUNC) {
-                log_error(SEM_ERR_FUNC_UNDEFINED);
-                log_error(name);
-                log_error("\n");
+                semantic_name_error(SEM_ERR_FUNC_UNDEFINED, name_index);
                 return -1;
             }
             arg_count = ast_read_u8();
@@ -672,7 +811,7 @@ static int8_t semantic_check_tag_with_lvalue(
                     return -1;
                 }
                 if (sym && i < sym->param_count) {
-                    if (!semantic_type_can_convert(&sym->params[i], arg_type, arg_const_zero)) {
+                    if (!semantic_type_can_convert(&state->params[sym->params + i], arg_type, arg_const_zero)) {
                         log_error(SEM_ERR_CALL_ARG_TYPE);
                         return -1;
                     }
@@ -777,7 +916,7 @@ static int8_t semantic_check_tag_with_lvalue(
         }
         case AST_TAG_UNARY_OP: {
             uint8_t op = ast_read_u8();
-            uint8_t child_tag = ast_read_u8();
+            uint8_t child_tag = ast_read_tag();
             semantic_type_t child_type;
             semantic_type_t child_raw;
             uint8_t child_lvalue = 0;
@@ -850,14 +989,11 @@ static int8_t semantic_check_tag_with_lvalue(
             return -1;
         }
         case AST_TAG_IDENTIFIER: {
-            uint16_t name_index = ast_read_u16();
-            const char* name = ast_reader_string(name_index);
+            uint16_t name_index = ast_read_index();
             if (state) {
-                const semantic_symbol_t* sym = semantic_scope_lookup(state, name);
+                const semantic_symbol_t* sym = semantic_scope_lookup(state, name_index);
                 if (!sym || sym->kind != SEM_SYMBOL_VAR) {
-                    log_error(SEM_ERR_IDENT_UNDEFINED);
-                    log_error(name);
-                    log_error("\n");
+                    semantic_name_error(SEM_ERR_IDENT_UNDEFINED, name_index);
                     return -1;
                 }
                 if (out_type) *out_type = sym->type;
@@ -866,17 +1002,17 @@ static int8_t semantic_check_tag_with_lvalue(
             return 0;
         }
         case AST_TAG_CONSTANT: {
-            int16_t value = ast_read_i16();
+            int16_t value = ast_read_const();
             if (out_type) *out_type = semantic_type_make(AST_BASE_INT, 0, 0);
             if (out_const_zero && value == 0) *out_const_zero = 1;
             return 0;
         }
         case AST_TAG_STRING_LITERAL:
-            ast_read_u16();
+            ast_read_index();
             if (out_type) *out_type = semantic_type_make(AST_BASE_CHAR, 1, 0);
             return 0;
         case AST_TAG_ARRAY_ACCESS: {
-            uint8_t base_tag = ast_read_u8();
+            uint8_t base_tag = ast_read_tag();
             semantic_type_t base_type;
             semantic_type_t index_type;
             uint8_t index_tag = 0;
@@ -888,9 +1024,9 @@ static int8_t semantic_check_tag_with_lvalue(
             }
             if (semantic_check_tag_with_lvalue(base_tag, loop_depth, state,
                                                &base_type, NULL, NULL) < 0) return -1;
-            index_tag = ast_read_u8();
+            index_tag = ast_read_tag();
             if (index_tag == AST_TAG_CONSTANT) {
-                index_value = ast_read_i16();
+                index_value = ast_read_const();
                 index_is_const = 1;
                 index_type = semantic_type_make(AST_BASE_INT, 0, 0);
             } else {
@@ -946,7 +1082,7 @@ static int8_t semantic_check_node_with_lvalue(
 ) {
     uint8_t tag = 0;
     if (!ast || !reader) return -1;
-    tag = ast_read_u8();
+    tag = ast_read_tag();
     return semantic_check_tag_with_lvalue(tag, loop_depth, state,
                                           out_type, out_lvalue, out_const_zero);
 }
@@ -955,22 +1091,25 @@ static int8_t semantic_check_node(uint8_t loop_depth, semantic_state_t* state) {
     return semantic_check_node_with_lvalue(loop_depth, state, NULL, NULL, NULL);
 }
 
-cc_error_t semantic_validate(void) {
+static cc_error_t semantic_validate_program(void) {
     uint16_t decl_count = 0;
-    if (!ast) return CC_ERROR_INVALID_ARG;
-    mem_set(&g_semantic_state, 0, sizeof(g_semantic_state));
+    int16_t tag = 0;
     if (semantic_scope_push(&g_semantic_state) < 0) return CC_ERROR_SEMANTIC;
 
     if (ast_reader_begin_program(&decl_count) < 0) return CC_ERROR_SEMANTIC;
-    for (uint16_t i = 0; i < decl_count; i++) {
-        uint8_t tag = ast_read_u8();
+    /* Globals stay for the whole pass; size for them plus a function's locals */
+    g_semantic_state.symbol_capacity = (uint16_t)(decl_count + SEM_SYMBOLS_INITIAL);
+    g_semantic_state.symbols = (semantic_symbol_t*)cc_malloc(
+        g_semantic_state.symbol_capacity * sizeof(semantic_symbol_t));
+    if (!g_semantic_state.symbols) return CC_ERROR_SEMANTIC;
+    /* Signatures only; with a declaration index the bodies are not skipped */
+    while ((tag = ast_reader_next_decl(0)) > 0) {
         if (tag == AST_TAG_FUNCTION) {
-            uint16_t name_index = ast_read_u16();
+            uint16_t name_index = ast_read_index();
             uint8_t base = 0;
             uint8_t depth = 0;
             uint16_t array_len = 0;
             uint8_t param_count = 0;
-            const char* name = ast_reader_string(name_index);
             if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_SEMANTIC;
             semantic_type_t return_type;
             return_type = semantic_type_make(base, depth, array_len);
@@ -981,14 +1120,14 @@ cc_error_t semantic_validate(void) {
                 return CC_ERROR_SEMANTIC;
             }
             for (uint8_t p = 0; p < param_count; p++) {
-                uint8_t ptag = ast_read_u8();
+                uint8_t ptag = ast_read_tag();
                 uint16_t param_name_index = 0;
                 uint8_t param_base = 0;
                 uint8_t param_depth = 0;
                 uint16_t param_array_len = 0;
                 uint8_t param_has_init = 0;
                 if (ptag != AST_TAG_VAR_DECL) return CC_ERROR_SEMANTIC;
-                param_name_index = ast_read_u16();
+                param_name_index = ast_read_index();
                 (void)param_name_index;
                 if (ast_reader_read_type_info(&param_base, &param_depth,
                                               &param_array_len) < 0) return CC_ERROR_SEMANTIC;
@@ -996,26 +1135,31 @@ cc_error_t semantic_validate(void) {
                 param_has_init = ast_read_u8();
                 if (param_has_init && ast_reader_skip_node() < 0) return CC_ERROR_SEMANTIC;
             }
-            if (semantic_scope_add_func(&g_semantic_state, name, &return_type,
+            if (semantic_scope_add_func(&g_semantic_state, name_index, &return_type,
                                         param_count, params) < 0) return CC_ERROR_SEMANTIC;
-            if (ast_reader_skip_node() < 0) return CC_ERROR_SEMANTIC;
+            if (!ast->decls && ast_reader_skip_node() < 0) return CC_ERROR_SEMANTIC;
         } else if (tag == AST_TAG_VAR_DECL) {
-            uint16_t name_index = ast_read_u16();
+            uint16_t name_index = ast_read_index();
             uint8_t base = 0;
             uint8_t depth = 0;
             uint16_t array_len = 0;
             uint8_t has_init = 0;
-            const char* name = ast_reader_string(name_index);
             if (ast_reader_read_type_info(&base, &depth, &array_len) < 0) return CC_ERROR_SEMANTIC;
             semantic_type_t var_type;
             var_type = semantic_type_make(base, depth, array_len);
-            if (semantic_scope_add_var(&g_semantic_state, name, &var_type) < 0) return CC_ERROR_SEMANTIC;
+            if (semantic_scope_add_var(&g_semantic_state, name_index, &var_type) < 0) return CC_ERROR_SEMANTIC;
             has_init = ast_read_u8();
-            if (has_init && ast_reader_skip_node() < 0) return CC_ERROR_SEMANTIC;
+            if (has_init && !ast->decls && ast_reader_skip_node() < 0) return CC_ERROR_SEMANTIC;
         } else {
-            if (ast_reader_skip_tag(tag) < 0) return CC_ERROR_SEMANTIC;
+            if (ast_reader_skip_tag((uint8_t)tag) < 0) return CC_ERROR_SEMANTIC;
         }
     }
+    if (tag < 0) return CC_ERROR_SEMANTIC;
+
+    if (g_semantic_state.analyze) {
+        if (semantic_copy_input(g_semantic_state.out) < 0) return CC_ERROR_SEMANTIC;
+        semantic_write_signatures(&g_semantic_state);
+    }
 
     if (ast_reader_begin_program(&decl_count) < 0) return CC_ERROR_SEMANTIC;
     for (uint16_t i = 0; i < decl_count; i++) {
@@ -1023,3 +1167,25 @@ cc_error_t semantic_validate(void) {
     }
     return CC_OK;
 }
+
+cc_error_t semantic_validate(const output_t* analysis) {
+    cc_error_t err;
+    if (!ast) return CC_ERROR_INVALID_ARG;
+    mem_set(&g_semantic_state, 0, sizeof(g_semantic_state));
+    if (analysis) {
+        g_semantic_state.out = *analysis;
+        g_semantic_state.analyze = 1;
+    }
+    if (ast->string_count > 0) {
+        g_semantic_state.bindings = (uint16_t*)cc_malloc(ast->string_count * sizeof(uint16_t));
+        if (!g_semantic_state.bindings) return CC_ERROR_SEMANTIC;
+        mem_set(g_semantic_state.bindings, 0, ast->string_count * sizeof(uint16_t));
+    }
+    err = semantic_validate_program();
+    cc_free(g_semantic_state.symbols);
+    cc_free(g_semantic_state.params);
+    cc_free(g_semantic_state.bindings);
+    cc_free(g_semantic_state.frame);
+    mem_set(&g_semantic_state, 0, sizeof(g_semantic_state));
+    return err;
+}
@@ -1,25 +1,53 @@
 /* Modern/Desktop target implementation - argument parsing */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "common.h"
 #include "target.h"
 
 args_t parse_args(int argc, char** argv, uint8_t mode) {
     args_t result = {0};
+    char* positional[2] = {NULL, NULL};
+    int count = 0;
+
+    for (int i = 1; i < argc; i++) {
+#if CC_STATS
+        if (strcmp(argv[i], "--stats") == 0) {
+            result.stats = 1;
+            continue;
+        }
+#endif
+#if CC_COST
+        if (strcmp(argv[i], "--cost") == 0 && i + 1 < argc) {
+            result.cost_file = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--stack-limit") == 0 && i + 1 < argc) {
+            result.stack_limit = (uint16_t)strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+#endif
+        if (count < 2) {
+            positional[count] = argv[i];
+        }
+        count++;
+    }
 
     if (mode == ARG_MODE_IN_ONLY) {
-        if (argc < 2) {
+        if (count < 1) {
             result.error = 1;
             return result;
         }
-        result.input_file = argv[1];
-        result.output_file = NULL;
+        result.input_file = positional[0];
+        result.output_file = positional[1]; /* optional */
     } else {
-        if (argc < 3) {
+        if (count < 2) {
             result.error = 1;
             return result;
         }
-        result.input_file = argv[1];
-        result.output_file = argv[2];
+        result.input_file = positional[0];
+        result.output_file = positional[1];
     }
 
     return result;
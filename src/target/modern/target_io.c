@@ -1,4 +1,5 @@
 /* Modern/Desktop target implementation - streaming I/O and logging */
+#define _POSIX_C_SOURCE 200809L /* open_memstream */
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,15 +10,49 @@
 
 #define FILE_BUFFER_SIZE 512
 
+/* Files are memory-mapped and served in place, like a memory reader: no
+ * buffer copies, and a seek is just a position change. The buffered path
+ * remains for files that cannot be mapped (pipes, empty files) and with
+ * CC_READER_MMAP=0, which reproduces the Zeal reader's fill pattern. */
+#ifndef CC_READER_MMAP
+#define CC_READER_MMAP 1
+#endif
+
+#if CC_READER_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 struct reader {
-    int16_t fd;
+    int16_t fd;             /* -1 unless buffered */
+    const char* mem;        /* mapping or borrowed data; NULL if buffered */
+    uint32_t mem_len;
+    uint8_t mapped;         /* mem is our mapping, unmapped on close */
     char buffer[FILE_BUFFER_SIZE];
     ssize_t buf_len;
     ssize_t pos;
     uint32_t buffer_start;
-    uint32_t file_pos;
+    uint32_t file_pos;      /* read position of mem, or fd offset */
 };
 
+static reader_t* reader_alloc(int16_t fd, const char* data, uint32_t len) {
+    reader_t* r = (reader_t*)cc_malloc(sizeof(reader_t));
+    if (!r) return NULL;
+    r->fd = fd;
+    r->mem = data;
+    r->mem_len = len;
+    r->mapped = 0;
+    r->buf_len = 0;
+    r->pos = 0;
+    r->buffer_start = 0;
+    r->file_pos = 0;
+    if (data) {
+        CC_STAT_INC(reader_fills);
+        CC_STAT_ADD(bytes_read, len);
+    }
+    return r;
+}
+
 reader_t* reader_open(const char* filename) {
     int16_t fd = (int16_t)open(filename, O_RDONLY);
     if (fd < 0) {
@@ -25,20 +60,37 @@ reader_t* reader_open(const char* filename) {
         return NULL;
     }
 
-    reader_t* r = (reader_t*)cc_malloc(sizeof(reader_t));
+#if CC_READER_MMAP
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size <= (off_t)UINT32_MAX) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            reader_t* r = reader_alloc(-1, (const char*)map, (uint32_t)st.st_size);
+            close(fd);
+            if (!r) {
+                munmap(map, (size_t)st.st_size);
+                return NULL;
+            }
+            r->mapped = 1;
+            return r;
+        }
+    }
+#endif
+
+    reader_t* r = reader_alloc(fd, NULL, 0);
     if (!r) {
         close(fd);
         return NULL;
     }
-    r->fd = fd;
-    r->buf_len = 0;
-    r->pos = 0;
-    r->buffer_start = 0;
-    r->file_pos = 0;
     return r;
 }
 
+reader_t* reader_open_memory(const char* data, uint32_t len) {
+    return reader_alloc(-1, data ? data : "", len);
+}
+
 static int8_t reader_fill(reader_t* r) {
+    CC_STAT_INC(reader_fills);
     r->buffer_start = r->file_pos;
     r->buf_len = read(r->fd, r->buffer, FILE_BUFFER_SIZE);
     r->pos = 0;
@@ -46,11 +98,16 @@ static int8_t reader_fill(reader_t* r) {
         return -1;
     }
     r->file_pos += (uint32_t)r->buf_len;
+    CC_STAT_ADD(bytes_read, (uint32_t)r->buf_len);
     return 0;
 }
 
 int16_t reader_next(reader_t* reader) {
     if (!reader) return -1;
+    if (reader->mem) {
+        if (reader->file_pos >= reader->mem_len) return -1;
+        return (unsigned char)reader->mem[reader->file_pos++];
+    }
     if (reader->pos >= reader->buf_len) {
         if (reader_fill(reader) < 0) {
             return -1;
@@ -61,6 +118,10 @@ int16_t reader_next(reader_t* reader) {
 
 int16_t reader_peek(reader_t* reader) {
     if (!reader) return -1;
+    if (reader->mem) {
+        if (reader->file_pos >= reader->mem_len) return -1;
+        return (unsigned char)reader->mem[reader->file_pos];
+    }
     if (reader->pos >= reader->buf_len) {
         if (reader_fill(reader) < 0) {
             return -1;
@@ -69,10 +130,30 @@ int16_t reader_peek(reader_t* reader) {
     return (unsigned char)reader->buffer[reader->pos];
 }
 
+const uint8_t* reader_span(reader_t* reader, uint16_t len) {
+    const uint8_t* span;
+    if (!reader) return NULL;
+    if (reader->mem) {
+        if (reader->mem_len - reader->file_pos < len) return NULL;
+        span = (const uint8_t*)reader->mem + reader->file_pos;
+        reader->file_pos += len;
+        return span;
+    }
+    if (reader->buf_len - reader->pos < (ssize_t)len) return NULL;
+    span = (const uint8_t*)reader->buffer + reader->pos;
+    reader->pos += len;
+    return span;
+}
+
 int8_t reader_seek(reader_t* reader, uint32_t offset) {
     if (!reader) return -1;
-    off_t res = lseek(reader->fd, (off_t)offset, SEEK_SET);
-    if (res < 0) {
+    CC_STAT_INC(reader_seeks);
+    if (reader->mem) {
+        if (offset > reader->mem_len) return -1;
+        reader->file_pos = offset;
+        return 0;
+    }
+    if (lseek(reader->fd, (off_t)offset, SEEK_SET) < 0) {
         return -1;
     }
     reader->buf_len = 0;
@@ -84,11 +165,17 @@ int8_t reader_seek(reader_t* reader, uint32_t offset) {
 
 uint32_t reader_tell(reader_t* reader) {
     if (!reader) return 0;
+    if (reader->mem) return reader->file_pos;
     return reader->buffer_start + (uint32_t)reader->pos;
 }
 
 void reader_close(reader_t* reader) {
     if (!reader) return;
+#if CC_READER_MMAP
+    if (reader->mapped) {
+        munmap((void*)reader->mem, reader->mem_len);
+    }
+#endif
     if (reader->fd >= 0) {
         close(reader->fd);
     }
@@ -107,6 +194,10 @@ output_t output_open(const char* filename) {
     return fopen(filename, "wb");
 }
 
+output_t output_open_memory(char** data, size_t* len) {
+    return open_memstream(data, len);
+}
+
 void output_close(output_t handle) {
     if (handle) {
         fclose((FILE*)handle);
@@ -115,6 +206,8 @@ void output_close(output_t handle) {
 
 int8_t output_write(output_t handle, const char* data, uint16_t len) {
     if (!handle || !data || len == 0) return -1;
+    CC_STAT_INC(output_writes);
+    CC_STAT_ADD(output_bytes, len);
     size_t written = fwrite(data, 1, (size_t)len, (FILE*)handle);
     return (written == (size_t)len) ? 0 : -1;
 }
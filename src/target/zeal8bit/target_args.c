@@ -7,6 +7,12 @@
 
 args_t parse_args(int argc, char** argv, uint8_t mode) {
     args_t result = {0};
+    char* positional[2] = {NULL, NULL};
+    uint8_t count = 0;
+#if CC_COST
+    uint8_t cost_next = 0;
+    uint8_t stack_next = 0;
+#endif
 
     /* On ZOS, argv[0] contains all arguments as a single string separated by spaces */
     if (argc == 0) {
@@ -14,26 +20,58 @@ args_t parse_args(int argc, char** argv, uint8_t mode) {
         return result;
     }
 
-    result.input_file = argv[0];
-    result.output_file = NULL;
-
-    /* Find the space separator between arguments */
+    /* Split on spaces; each word is a flag or the next file name */
     char* p = argv[0];
     while (*p) {
-        if (*p == ' ') {
-            *p = 0; /* Null-terminate the first argument */
-            result.output_file = p + 1;
-            break;
+        char* word;
+        while (*p == ' ') p++;
+        if (!*p) break;
+        word = p;
+        while (*p && *p != ' ') p++;
+        if (*p) *p++ = 0; /* Null-terminate the word */
+#if CC_STATS
+        if (str_cmp(word, "--stats") == 0) {
+            result.stats = 1;
+            continue;
+        }
+#endif
+#if CC_COST
+        if (cost_next) {
+            result.cost_file = word;
+            cost_next = 0;
+            continue;
+        }
+        if (stack_next) {
+            while (*word >= '0' && *word <= '9') {
+                result.stack_limit = (uint16_t)(result.stack_limit * 10u + (uint8_t)(*word++ - '0'));
+            }
+            stack_next = 0;
+            continue;
+        }
+        if (str_cmp(word, "--cost") == 0) {
+            cost_next = 1;
+            continue;
         }
-        p++;
+        if (str_cmp(word, "--stack-limit") == 0) {
+            stack_next = 1;
+            continue;
+        }
+#endif
+        if (count < 2) {
+            positional[count] = word;
+        }
+        count++;
     }
 
+    result.input_file = positional[0];
+    result.output_file = positional[1];
+
     if (mode == ARG_MODE_IN_ONLY) {
         if (!result.input_file || *result.input_file == '\0') {
             result.error = 1;
             return result;
         }
-        result.output_file = NULL;
+        /* output_file stays optional */
     } else {
         /* Validate both arguments are present */
         if (!result.input_file || !result.output_file ||
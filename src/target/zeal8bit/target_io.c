@@ -38,6 +38,7 @@ reader_t* reader_open(const char* filename) {
 }
 
 static int8_t reader_fill(reader_t* r) {
+    CC_STAT_INC(reader_fills);
     r->buffer_start = r->file_pos;
     r->buf_len = FILE_BUFFER_SIZE;
     zos_err_t err = read(r->dev, file_buffer, &r->buf_len);
@@ -46,6 +47,7 @@ static int8_t reader_fill(reader_t* r) {
         return -1;
     }
     r->file_pos += (uint32_t)r->buf_len;
+    CC_STAT_ADD(bytes_read, (uint32_t)r->buf_len);
     return 0;
 }
 
@@ -67,6 +69,7 @@ int16_t reader_next(reader_t* reader) {
 
 int8_t reader_seek(reader_t* reader, uint32_t offset) {
     if (!reader) return -1;
+    CC_STAT_INC(reader_seeks);
     int32_t pos = (int32_t)offset;
     zos_err_t err = seek(reader->dev, &pos, SEEK_SET);
     if (err != ERR_SUCCESS) {
@@ -117,6 +120,8 @@ void output_close(output_t handle) {
 
 int8_t output_write(output_t handle, const char* data, uint16_t len) {
     if (handle < 0 || !data || len == 0) return -1;
+    CC_STAT_INC(output_writes);
+    CC_STAT_ADD(output_bytes, len);
     zos_dev_t dev = (zos_dev_t)handle;
     uint16_t write_size = len;
     zos_err_t err = write(dev, data, &write_size);
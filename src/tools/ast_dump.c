@@ -119,6 +119,32 @@ static void log_string(uint16_t index) {
     }
 }
 
+static void log_number(uint32_t value) {
+    char buf[11];
+    uint8_t i = (uint8_t)sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        buf[--i] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value > 0);
+    log_msg(buf + i);
+}
+
+static void dump_decl_index(void) {
+    log_msg("AST_DECL_INDEX\n");
+    for (uint16_t i = 0; i < ast->decl_entry_count; i++) {
+        const ast_decl_entry_t* decl = &ast->decls[i];
+        print_indent(1);
+        log_msg(decl->tag == AST_TAG_FUNCTION ? "AST_FUNCTION (name=" : "AST_VAR_DECL (name=");
+        log_string(decl->name_index);
+        log_msg(", offset=");
+        log_number(decl->offset);
+        log_msg(", length=");
+        log_number(decl->length);
+        log_msg(")\n");
+    }
+}
+
 static int8_t dump_node_stream(uint16_t depth);
 
 static int8_t dump_constant(int16_t value) {
@@ -159,20 +185,20 @@ static int8_t dump_node_stream(uint16_t depth) {
     uint8_t ptr_depth = 0;
     char type_buf[32];
 
-    tag = ast_read_u8();
+    tag = ast_read_tag();
     print_indent(depth);
 
     switch (tag) {
         case AST_TAG_PROGRAM:
             log_msg("AST_PROGRAM\n");
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             for (uint16_t i = 0; i < u16; i++) {
                 if (dump_node_stream(depth + 1) < 0) return -1;
             }
             return 0;
         case AST_TAG_FUNCTION: {
             uint16_t array_len = 0;
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             if (ast_reader_read_type_info(&base, &ptr_depth, &array_len) < 0) return -1;
             u8 = ast_read_u8();
             format_type_info(base, ptr_depth, array_len, type_buf, sizeof(type_buf));
@@ -189,7 +215,7 @@ static int8_t dump_node_stream(uint16_t depth) {
         case AST_TAG_VAR_DECL: {
             uint8_t has_init = 0;
             uint16_t array_len = 0;
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             if (ast_reader_read_type_info(&base, &ptr_depth, &array_len) < 0) return -1;
             has_init = ast_read_u8();
             format_type_info(base, ptr_depth, array_len, type_buf, sizeof(type_buf));
@@ -203,7 +229,7 @@ static int8_t dump_node_stream(uint16_t depth) {
         }
         case AST_TAG_COMPOUND_STMT:
             log_msg("AST_COMPOUND_STMT\n");
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             for (uint16_t i = 0; i < u16; i++) {
                 if (dump_node_stream(depth + 1) < 0) return -1;
             }
@@ -221,13 +247,13 @@ static int8_t dump_node_stream(uint16_t depth) {
             return 0;
         case AST_TAG_GOTO_STMT:
             log_msg("AST_GOTO_STMT (label=");
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             log_string(u16);
             log_msg(")\n");
             return 0;
         case AST_TAG_LABEL_STMT:
             log_msg("AST_LABEL_STMT (label=");
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             log_string(u16);
             log_msg(")\n");
             return 0;
@@ -260,7 +286,7 @@ static int8_t dump_node_stream(uint16_t depth) {
             if (dump_node_stream(depth + 1) < 0) return -1;
             return dump_node_stream(depth + 1);
         case AST_TAG_CALL:
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             u8 = ast_read_u8();
             log_msg("AST_CALL (name=");
             log_msg(ast_reader_string(u16) ? ast_reader_string(u16) : "null");
@@ -283,16 +309,16 @@ static int8_t dump_node_stream(uint16_t depth) {
             log_msg(")\n");
             return dump_node_stream(depth + 1);
         case AST_TAG_IDENTIFIER:
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             log_msg("AST_IDENTIFIER (name=");
             log_msg(ast_reader_string(u16) ? ast_reader_string(u16) : "null");
             log_msg(")\n");
             return 0;
         case AST_TAG_CONSTANT:
-            i16 = ast_read_i16();
+            i16 = ast_read_const();
             return dump_constant(i16);
         case AST_TAG_STRING_LITERAL:
-            u16 = ast_read_u16();
+            u16 = ast_read_index();
             log_msg("AST_STRING_LITERAL (value=");
             log_msg(ast_reader_string(u16) ? ast_reader_string(u16) : "null");
             log_msg(")\n");
@@ -373,6 +399,7 @@ int main(int argc, char** argv) {
             goto cleanup;
         }
     }
+    if (ast->decls) dump_decl_index();
     err = 0;
 
 cleanup:
@@ -0,0 +1,210 @@
+#include "cc_compat.h"
+#include "ast_reader.h"
+#include "ast_io.h"
+#include "common.h"
+#include "ir.h"
+#include "target.h"
+
+reader_t* reader;
+ast_reader_t* ast;
+ast_reader_t ast_ctx;
+
+static void log_number(uint16_t value) {
+    char buf[6];
+    uint8_t i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        buf[--i] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0 && i > 0);
+    log_msg(&buf[i]);
+}
+
+static void log_vreg(uint16_t reg) {
+    if (reg == IR_NONE) {
+        log_msg("_");
+        return;
+    }
+    log_msg("v");
+    log_number(reg);
+}
+
+static void log_name(uint16_t index) {
+    const char* value = ast_reader_string(index);
+    log_msg(value ? value : "?");
+}
+
+static void dump_instr(const ir_instr_t* ins) {
+    if (ins->op == IR_LABEL) {
+        log_msg("L");
+        log_number(ins->a);
+        log_msg(":\n");
+        return;
+    }
+    log_msg("    ");
+    if (ins->dst != IR_NONE) {
+        log_vreg(ins->dst);
+        log_msg(" = ");
+    }
+    log_msg(ir_op_name(ins->op));
+    log_msg((ins->flags & IR_F_16) ? ".16" : ".8");
+    if (ins->flags & IR_F_SIGNED) log_msg("s");
+    log_msg(" ");
+    switch (ins->op) {
+        case IR_CONST:
+            log_number(ins->a);
+            break;
+        case IR_LDL:
+        case IR_ADDRL:
+            log_msg("slot");
+            log_number(ins->a);
+            break;
+        case IR_STL:
+            log_msg("slot");
+            log_number(ins->a);
+            log_msg(", ");
+            log_vreg(ins->b);
+            break;
+        case IR_LDG:
+        case IR_ADDRG:
+            log_name(ins->a);
+            break;
+        case IR_STG:
+            log_name(ins->a);
+            log_msg(", ");
+            log_vreg(ins->b);
+            break;
+        case IR_ADDRS:
+            log_msg("str");
+            log_number(ins->a);
+            break;
+        case IR_CALL:
+            log_name(ins->a);
+            log_msg(" argc=");
+            log_number(ins->b);
+            break;
+        case IR_JMP:
+            log_msg("L");
+            log_number(ins->a);
+            break;
+        case IR_BZ:
+        case IR_BNZ:
+            log_vreg(ins->a);
+            log_msg(", L");
+            log_number(ins->b);
+            break;
+        default:
+            log_vreg(ins->a);
+            if ((ins->op >= IR_ADD && ins->op <= IR_SHR) ||
+                (ins->op >= IR_SEQ && ins->op <= IR_SGE) || ins->op == IR_STORE) {
+                log_msg(", ");
+                log_vreg(ins->b);
+            }
+            break;
+    }
+    log_msg("\n");
+}
+
+static int8_t dump_function(void) {
+    ir_function_t fn;
+    if (ir_read_function(&fn) < 0) return -1;
+    log_msg("function ");
+    log_name(fn.name_index);
+    log_msg((fn.flags & IR_FN_RET16) ? " (ret16" : " (ret8");
+    log_msg(", params=");
+    log_number(fn.param_count);
+    log_msg(", vregs=");
+    log_number(fn.vreg_count);
+    log_msg(")\n");
+    for (uint8_t i = 0; i < fn.slot_count; i++) {
+        log_msg("  slot");
+        log_number(i);
+        log_msg(fn.slots[i].kind == IR_SLOT_PARAM ? " param " : " local ");
+        log_name(fn.slots[i].name_index);
+        log_msg(" size=");
+        log_number(fn.slots[i].size);
+        log_msg("\n");
+    }
+    for (uint16_t i = 0; i < fn.instr_count; i++) {
+        dump_instr(&fn.instrs[i]);
+    }
+    ir_function_free(&fn);
+    return 0;
+}
+
+static void dump_global(void) {
+    static const char* const kinds[] = {
+        "byte", "word", "space", "string", "addr_string", "addr_var"
+    };
+    ir_global_t global;
+    ir_read_global(&global);
+    log_msg("global ");
+    log_name(global.name_index);
+    log_msg(" ");
+    log_msg(global.kind < DIM(kinds) ? kinds[global.kind] : "?");
+    log_msg(" size=");
+    log_number(global.size);
+    log_msg(" init=");
+    log_number(global.init);
+    log_msg("\n");
+}
+
+void cleanup(void) {
+    ast_reader_destroy();
+    reader_close(reader);
+}
+
+void handle_error(char* msg) {
+    log_error(msg);
+    cleanup();
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    cc_init_pool_default();
+
+    int8_t err = 1;
+    ir_header_t header;
+    if (argc < 2) {
+        log_error("Usage: ir_dump <input.ir>\n");
+        return 1;
+    }
+
+    reader = reader_open(argv[1]);
+    if (!reader) return 1;
+
+    ast = &ast_ctx;
+    mem_set(ast, 0, sizeof(ast_ctx));
+
+    ast_read_handler(handle_error, "Failed to read IR\n");
+
+    if (ir_read_header(&header) < 0) {
+        log_error("Failed to read IR header\n");
+        goto cleanup;
+    }
+    ast->string_count = header.string_count;
+    ast->string_table_offset = header.string_table_offset;
+    if (ast_reader_load_strings() < 0 || ir_seek_records(&header) < 0) {
+        log_error("Failed to read IR string table\n");
+        goto cleanup;
+    }
+    for (uint16_t i = 0; i < header.record_count; i++) {
+        uint8_t kind = ir_read_record_kind();
+        if (kind == IR_REC_FUNCTION) {
+            if (dump_function() < 0) {
+                log_error("Failed to read IR function\n");
+                goto cleanup;
+            }
+        } else if (kind == IR_REC_GLOBAL) {
+            dump_global();
+        } else {
+            log_error("Unknown IR record\n");
+            goto cleanup;
+        }
+    }
+    err = 0;
+
+cleanup:
+    cleanup();
+    return err;
+}
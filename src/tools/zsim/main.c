@@ -0,0 +1,316 @@
+#include "zsim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* zsim: run a Z80 program (assembly or raw binary) on the host with
+ * ZOS syscall stubs, and report exit code, cycles and per-function cost. */
+
+#define ZSIM_DEFAULT_MAX_CYCLES 200000000ULL
+#define ZSIM_MAX_FRAMES 256
+#define ZSIM_MAX_FUNCS 512
+
+typedef struct {
+    uint16_t addr;
+    const char* name;
+    uint64_t calls;
+    uint64_t self_cycles;
+    uint64_t incl_cycles;
+} zsim_func_t;
+
+typedef struct {
+    uint16_t func;
+    uint16_t sp;
+    uint64_t start_cycles;
+} zsim_frame_t;
+
+static zsim_t g_sim;
+static zsim_func_t g_funcs[ZSIM_MAX_FUNCS];
+static uint16_t g_func_count;
+static zsim_frame_t g_frames[ZSIM_MAX_FRAMES];
+static uint16_t g_frame_depth;
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: zsim [options] <program.asm|program.bin>\n"
+            "  --root <dir>        host directory mapped to ZOS paths (default .)\n"
+            "  --org <addr>        load address for .bin input (default 0x4000)\n"
+            "  --max-cycles <n>    abort after n T-states\n"
+            "  --profile           print per-function cycle counts\n"
+            "  --sizes             print the code size of each label\n"
+            "  --csv               print the profile (or sizes) as CSV\n"
+            "  --quiet             only print the summary line\n"
+            "  --trace             print every executed instruction\n");
+}
+
+static const char* func_name(const zsim_symtab_t* syms, uint16_t addr) {
+    const char* best = NULL;
+    for (uint16_t i = 0; i < syms->count; i++) {
+        if (syms->items[i].addr != addr) continue;
+        /* Prefer public names over "_"-prefixed runtime aliases */
+        if (!best || (best[0] == '_' && syms->items[i].name[0] != '_')) {
+            best = syms->items[i].name;
+        }
+    }
+    return best;
+}
+
+static uint16_t func_index(const zsim_symtab_t* syms, uint16_t addr) {
+    for (uint16_t i = 0; i < g_func_count; i++) {
+        if (g_funcs[i].addr == addr) return i;
+    }
+    if (g_func_count == ZSIM_MAX_FUNCS) return (uint16_t)(ZSIM_MAX_FUNCS - 1);
+    g_funcs[g_func_count].addr = addr;
+    g_funcs[g_func_count].name = func_name(syms, addr);
+    g_funcs[g_func_count].calls = 0;
+    g_funcs[g_func_count].self_cycles = 0;
+    g_funcs[g_func_count].incl_cycles = 0;
+    return g_func_count++;
+}
+
+static void frame_push(const zsim_symtab_t* syms, uint16_t addr, uint16_t sp) {
+    uint16_t f = func_index(syms, addr);
+    g_funcs[f].calls++;
+    if (g_frame_depth == ZSIM_MAX_FRAMES) return;
+    g_frames[g_frame_depth].func = f;
+    g_frames[g_frame_depth].sp = sp;
+    g_frames[g_frame_depth].start_cycles = g_sim.cycles;
+    g_frame_depth++;
+}
+
+static void frame_pop_to(uint16_t sp) {
+    /* Pop every frame whose return address has been consumed */
+    while (g_frame_depth > 1 && g_frames[g_frame_depth - 1].sp < sp) {
+        zsim_frame_t* fr = &g_frames[--g_frame_depth];
+        g_funcs[fr->func].incl_cycles += g_sim.cycles - fr->start_cycles;
+    }
+}
+
+/* Local labels emitted by the code generators: _l followed by digits */
+static int is_local_label(const char* name) {
+    if (name[0] != '_' || name[1] != 'l' || !name[2]) return 0;
+    for (name += 2; *name; name++) {
+        if (*name < '0' || *name > '9') return 0;
+    }
+    return 1;
+}
+
+static int cmp_symbol_addr(const void* a, const void* b) {
+    const zsim_symbol_t* sa = *(const zsim_symbol_t* const*)a;
+    const zsim_symbol_t* sb = *(const zsim_symbol_t* const*)b;
+    if (sa->addr != sb->addr) return sa->addr < sb->addr ? -1 : 1;
+    return 0;
+}
+
+/* Bytes from each label to the next one (local labels belong to their
+ * function); the last label runs to the end of the image. */
+static int print_sizes(const zsim_symtab_t* syms, uint16_t end, int csv) {
+    const zsim_symbol_t** labels;
+    uint16_t count = 0;
+    labels = (const zsim_symbol_t**)malloc(sizeof(*labels) * (syms->count + 1u));
+    if (!labels) return -1;
+    for (uint16_t i = 0; i < syms->count; i++) {
+        if (syms->items[i].is_label && !is_local_label(syms->items[i].name)) {
+            labels[count++] = &syms->items[i];
+        }
+    }
+    qsort(labels, count, sizeof(*labels), cmp_symbol_addr);
+    if (csv) {
+        printf("label,address,bytes\n");
+    } else {
+        printf("%-24s %6s %6s\n", "label", "addr", "bytes");
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t next = end;
+        for (uint16_t j = (uint16_t)(i + 1); j < count; j++) {
+            if (labels[j]->addr > labels[i]->addr) {
+                next = labels[j]->addr;
+                break;
+            }
+        }
+        if (next < labels[i]->addr) next = labels[i]->addr;
+        if (csv) {
+            printf("%s,0x%04X,%u\n", labels[i]->name, labels[i]->addr,
+                   (unsigned)(next - labels[i]->addr));
+        } else {
+            printf("%-24s 0x%04X %6u\n", labels[i]->name, labels[i]->addr,
+                   (unsigned)(next - labels[i]->addr));
+        }
+    }
+    free(labels);
+    return 0;
+}
+
+static int cmp_func(const void* a, const void* b) {
+    const zsim_func_t* fa = (const zsim_func_t*)a;
+    const zsim_func_t* fb = (const zsim_func_t*)b;
+    if (fa->self_cycles < fb->self_cycles) return 1;
+    if (fa->self_cycles > fb->self_cycles) return -1;
+    return 0;
+}
+
+static int load_binary(const char* path, uint16_t org) {
+    FILE* fp = fopen(path, "rb");
+    size_t n;
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    n = fread(&g_sim.mem[org], 1, ZSIM_MEM_SIZE - org, fp);
+    fclose(fp);
+    return n > 0 ? 0 : -1;
+}
+
+static int ends_with(const char* s, const char* suffix) {
+    size_t ls = strlen(s);
+    size_t lx = strlen(suffix);
+    return ls >= lx && strcmp(s + ls - lx, suffix) == 0;
+}
+
+int main(int argc, char** argv) {
+    const char* input = NULL;
+    const char* root = ".";
+    uint16_t org = ZSIM_DEFAULT_ORG;
+    uint64_t max_cycles = ZSIM_DEFAULT_MAX_CYCLES;
+    int profile = 0;
+    int sizes = 0;
+    int csv = 0;
+    int quiet = 0;
+    int trace = 0;
+    int status = 0;
+    uint16_t start = ZSIM_DEFAULT_ORG;
+    uint16_t end = ZSIM_DEFAULT_ORG;
+    zsim_symtab_t syms;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--root") == 0 && i + 1 < argc) {
+            root = argv[++i];
+        } else if (strcmp(argv[i], "--org") == 0 && i + 1 < argc) {
+            org = (uint16_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--max-cycles") == 0 && i + 1 < argc) {
+            max_cycles = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = 1;
+        } else if (strcmp(argv[i], "--sizes") == 0) {
+            sizes = 1;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = 1;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = 1;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            trace = 1;
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            input = argv[i];
+        }
+    }
+    if (!input) {
+        usage();
+        return 2;
+    }
+    if (csv && !sizes) profile = 1;
+
+    memset(&g_sim, 0, sizeof(g_sim));
+    zsim_symtab_init(&syms);
+    if (ends_with(input, ".bin")) {
+        start = org;
+        if (load_binary(input, org) < 0) return 2;
+    } else {
+        if (zsim_assemble(input, g_sim.mem, &start, &end, &syms) < 0) {
+            zsim_symtab_free(&syms);
+            return 2;
+        }
+    }
+
+    if (sizes && print_sizes(&syms, end, csv) < 0) {
+        zsim_symtab_free(&syms);
+        return 2;
+    }
+
+    zsim_reset(&g_sim, start, 0x0000);
+    g_sim.root = root;
+    /* Returning from the entry point lands on address 0: treat as exit. */
+    g_sim.sp = (uint16_t)(g_sim.sp - 2);
+    g_sim.mem[g_sim.sp] = 0;
+    g_sim.mem[(uint16_t)(g_sim.sp + 1)] = 0;
+    frame_push(&syms, start, g_sim.sp);
+
+    while (!g_sim.exited) {
+        uint16_t pc = g_sim.pc;
+        uint16_t sp = g_sim.sp;
+        uint8_t op = g_sim.mem[pc];
+        uint8_t t;
+        uint8_t is_call = (uint8_t)(op == 0xCD || (op & 0xC7) == 0xC4 || (op & 0xC7) == 0xC7);
+        uint8_t is_ret = (uint8_t)(op == 0xC9 || (op & 0xC7) == 0xC0 ||
+                                   (op == 0xED && (g_sim.mem[(uint16_t)(pc + 1)] & 0xC7) == 0x45));
+        if (trace) {
+            fprintf(stderr, "%04X %02X %02X %02X  A=%02X F=%02X BC=%02X%02X DE=%02X%02X HL=%02X%02X IX=%04X SP=%04X\n",
+                    pc, op, g_sim.mem[(uint16_t)(pc + 1)], g_sim.mem[(uint16_t)(pc + 2)],
+                    g_sim.a, g_sim.f, g_sim.b, g_sim.c, g_sim.d, g_sim.e, g_sim.h, g_sim.l,
+                    g_sim.ix, g_sim.sp);
+        }
+        t = zsim_step(&g_sim);
+        if (g_frame_depth > 0) {
+            g_funcs[g_frames[g_frame_depth - 1].func].self_cycles += t;
+        }
+        if (is_call && g_sim.sp == (uint16_t)(sp - 2) && g_sim.pc != 0x0008) {
+            frame_push(&syms, g_sim.pc, g_sim.sp);
+        } else if (is_ret && g_sim.sp == (uint16_t)(sp + 2)) {
+            frame_pop_to(g_sim.sp);
+        }
+        if (g_sim.pc == 0x0000 && !g_sim.exited) {
+            g_sim.exited = 1;
+            g_sim.exit_code = g_sim.a;
+        }
+        if (g_sim.halted) {
+            fprintf(stderr, "zsim: halted at 0x%04X\n", pc);
+            status = 3;
+            break;
+        }
+        if (g_sim.cycles > max_cycles) {
+            fprintf(stderr, "zsim: cycle limit exceeded at 0x%04X\n", pc);
+            status = 3;
+            break;
+        }
+    }
+    frame_pop_to(0xFFFF);
+    if (g_frame_depth > 0) {
+        g_funcs[g_frames[0].func].incl_cycles = g_sim.cycles;
+    }
+    fflush(stdout);
+    zsim_close_files(&g_sim);
+
+    if (!quiet || !profile) {
+        fprintf(stderr, "exit=0x%02X cycles=%llu instructions=%llu syscalls=%llu\n",
+                g_sim.exit_code, (unsigned long long)g_sim.cycles,
+                (unsigned long long)g_sim.instructions,
+                (unsigned long long)g_sim.syscall_count);
+    }
+    if (profile) {
+        qsort(g_funcs, g_func_count, sizeof(g_funcs[0]), cmp_func);
+        if (csv) {
+            printf("function,address,calls,self_cycles,incl_cycles\n");
+        } else {
+            printf("%-24s %6s %10s %12s %12s\n", "function", "addr", "calls", "self", "incl");
+        }
+        for (uint16_t i = 0; i < g_func_count; i++) {
+            const char* name = g_funcs[i].name ? g_funcs[i].name : "?";
+            if (csv) {
+                printf("%s,0x%04X,%llu,%llu,%llu\n", name, g_funcs[i].addr,
+                       (unsigned long long)g_funcs[i].calls,
+                       (unsigned long long)g_funcs[i].self_cycles,
+                       (unsigned long long)g_funcs[i].incl_cycles);
+            } else {
+                printf("%-24s 0x%04X %10llu %12llu %12llu\n", name, g_funcs[i].addr,
+                       (unsigned long long)g_funcs[i].calls,
+                       (unsigned long long)g_funcs[i].self_cycles,
+                       (unsigned long long)g_funcs[i].incl_cycles);
+            }
+        }
+    }
+    zsim_symtab_free(&syms);
+    return status;
+}
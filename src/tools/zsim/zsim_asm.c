@@ -0,0 +1,1141 @@
+#include "zsim.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Two-pass assembler for the Zealasm subset emitted by cc_codegen and the
+ * runtime files: labels, org, .db/.dw/.dm/.ds/.equ and the Z80 instruction
+ * set (including IX/IY, CB and ED forms). */
+
+#define ASM_LINE_MAX 512
+#define ASM_MAX_OPERANDS 3
+
+typedef enum {
+    OPD_NONE = 0,
+    OPD_R8,        /* reg: 0..7 encoding (6 unused) */
+    OPD_IDX8,      /* ixh/ixl/iyh/iyl: reg 4/5, idx */
+    OPD_IND_HL,    /* (hl) */
+    OPD_IND_IDX,   /* (ix+d) / (iy+d) */
+    OPD_R16,       /* bc de hl sp ix iy af */
+    OPD_AF_ALT,    /* af' */
+    OPD_IND_R16,   /* (bc) (de) (sp) */
+    OPD_IND_C,     /* (c) */
+    OPD_IMM,       /* expression */
+    OPD_IND_IMM,   /* (expression) */
+    OPD_I,
+    OPD_R
+} opd_kind_t;
+
+/* R16 ids */
+enum { R16_BC = 0, R16_DE, R16_HL, R16_SP, R16_AF, R16_IX, R16_IY };
+
+typedef struct {
+    opd_kind_t kind;
+    uint8_t reg;     /* R8 encoding or R16 id */
+    uint8_t idx;     /* 0 none, 1 ix, 2 iy */
+    int32_t value;   /* immediate / displacement */
+    char text[64];   /* original text (lower-cased, trimmed) */
+} operand_t;
+
+typedef struct {
+    const char* path;
+    int line;
+    int pass;
+    uint16_t pc;
+    uint16_t start;
+    uint16_t end;
+    uint8_t has_start;
+    uint8_t* mem;
+    zsim_symtab_t* syms;
+    int errors;
+} asm_ctx_t;
+
+void zsim_symtab_init(zsim_symtab_t* tab) {
+    tab->items = NULL;
+    tab->count = 0;
+    tab->capacity = 0;
+}
+
+void zsim_symtab_free(zsim_symtab_t* tab) {
+    for (uint16_t i = 0; i < tab->count; i++) {
+        free(tab->items[i].name);
+    }
+    free(tab->items);
+    zsim_symtab_init(tab);
+}
+
+const zsim_symbol_t* zsim_symtab_find(const zsim_symtab_t* tab, const char* name) {
+    for (uint16_t i = 0; i < tab->count; i++) {
+        if (strcmp(tab->items[i].name, name) == 0) return &tab->items[i];
+    }
+    return NULL;
+}
+
+int zsim_symtab_add(zsim_symtab_t* tab, const char* name, uint16_t addr) {
+    zsim_symbol_t* existing = (zsim_symbol_t*)zsim_symtab_find(tab, name);
+    if (existing) {
+        existing->addr = addr;
+        return 0;
+    }
+    if (tab->count == tab->capacity) {
+        uint16_t cap = (uint16_t)(tab->capacity ? tab->capacity * 2 : 64);
+        zsim_symbol_t* items = (zsim_symbol_t*)realloc(tab->items, cap * sizeof(*items));
+        if (!items) return -1;
+        tab->items = items;
+        tab->capacity = cap;
+    }
+    tab->items[tab->count].name = (char*)malloc(strlen(name) + 1);
+    if (!tab->items[tab->count].name) return -1;
+    strcpy(tab->items[tab->count].name, name);
+    tab->items[tab->count].addr = addr;
+    tab->items[tab->count].is_label = 0;
+    tab->count++;
+    return 0;
+}
+
+static void asm_error(asm_ctx_t* ctx, const char* msg, const char* detail) {
+    if (ctx->pass != 2) return;
+    fprintf(stderr, "%s:%d: %s%s%s\n", ctx->path, ctx->line, msg,
+            detail ? ": " : "", detail ? detail : "");
+    ctx->errors++;
+}
+
+static void emit8(asm_ctx_t* ctx, int32_t v) {
+    if (ctx->pass == 2) {
+        ctx->mem[ctx->pc] = (uint8_t)v;
+    }
+    ctx->pc = (uint16_t)(ctx->pc + 1);
+    if (!ctx->has_start) {
+        ctx->has_start = 1;
+        ctx->start = (uint16_t)(ctx->pc - 1);
+    }
+    if (ctx->pc > ctx->end || ctx->pc == 0) ctx->end = ctx->pc;
+}
+
+static void emit16(asm_ctx_t* ctx, int32_t v) {
+    emit8(ctx, v & 0xFF);
+    emit8(ctx, (v >> 8) & 0xFF);
+}
+
+static char* trim(char* s) {
+    char* end;
+    while (isspace((unsigned char)*s)) s++;
+    end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+/* ---- Expressions ---- */
+
+typedef struct {
+    const char* p;
+    asm_ctx_t* ctx;
+    int ok;
+} expr_t;
+
+static int32_t expr_parse_or(expr_t* e);
+
+static void expr_ws(expr_t* e) {
+    while (*e->p == ' ' || *e->p == '\t') e->p++;
+}
+
+static int32_t expr_char(expr_t* e) {
+    int32_t v;
+    e->p++;
+    if (*e->p == '\\') {
+        e->p++;
+        switch (*e->p) {
+            case 'n': v = '\n'; break;
+            case 'r': v = '\r'; break;
+            case 't': v = '\t'; break;
+            case '0': v = 0; break;
+            default: v = (unsigned char)*e->p; break;
+        }
+    } else {
+        v = (unsigned char)*e->p;
+    }
+    if (*e->p) e->p++;
+    if (*e->p == '\'') e->p++;
+    else e->ok = 0;
+    return v;
+}
+
+static int32_t expr_number(expr_t* e) {
+    const char* start = e->p;
+    const char* end = start;
+    int32_t v = 0;
+    while (isalnum((unsigned char)*end)) end++;
+    if (start[0] == '0' && (start[1] == 'x' || start[1] == 'X')) {
+        v = (int32_t)strtol(start + 2, NULL, 16);
+    } else if (start[0] == '0' && (start[1] == 'b' || start[1] == 'B') &&
+               end > start + 2 && (end[-1] == '0' || end[-1] == '1')) {
+        v = (int32_t)strtol(start + 2, NULL, 2);
+    } else if (end[-1] == 'h' || end[-1] == 'H') {
+        v = (int32_t)strtol(start, NULL, 16);
+    } else {
+        v = (int32_t)strtol(start, NULL, 10);
+    }
+    e->p = end;
+    return v;
+}
+
+static int32_t expr_primary(expr_t* e) {
+    expr_ws(e);
+    if (*e->p == '(') {
+        int32_t v;
+        e->p++;
+        v = expr_parse_or(e);
+        expr_ws(e);
+        if (*e->p == ')') e->p++;
+        else e->ok = 0;
+        return v;
+    }
+    if (*e->p == '-') {
+        e->p++;
+        return -expr_primary(e);
+    }
+    if (*e->p == '+') {
+        e->p++;
+        return expr_primary(e);
+    }
+    if (*e->p == '~') {
+        e->p++;
+        return ~expr_primary(e);
+    }
+    if (*e->p == '\'') return expr_char(e);
+    if (*e->p == '$' && isxdigit((unsigned char)e->p[1])) {
+        int32_t v;
+        char* end;
+        v = (int32_t)strtol(e->p + 1, &end, 16);
+        e->p = end;
+        return v;
+    }
+    if (*e->p == '$') {
+        e->p++;
+        return e->ctx->pc;
+    }
+    if (isdigit((unsigned char)*e->p)) return expr_number(e);
+    if (isalpha((unsigned char)*e->p) || *e->p == '_' || *e->p == '.') {
+        char name[128];
+        size_t n = 0;
+        const zsim_symbol_t* sym;
+        while ((isalnum((unsigned char)*e->p) || *e->p == '_' || *e->p == '.') &&
+               n + 1 < sizeof(name)) {
+            name[n++] = *e->p++;
+        }
+        name[n] = '\0';
+        sym = zsim_symtab_find(e->ctx->syms, name);
+        if (!sym) {
+            if (e->ctx->pass == 2) {
+                asm_error(e->ctx, "undefined symbol", name);
+            }
+            return 0;
+        }
+        return sym->addr;
+    }
+    e->ok = 0;
+    return 0;
+}
+
+static int32_t expr_mul(expr_t* e) {
+    int32_t v = expr_primary(e);
+    for (;;) {
+        expr_ws(e);
+        if (*e->p == '*') {
+            e->p++;
+            v *= expr_primary(e);
+        } else if (*e->p == '/') {
+            int32_t r;
+            e->p++;
+            r = expr_primary(e);
+            v = r ? v / r : 0;
+        } else if (*e->p == '%') {
+            int32_t r;
+            e->p++;
+            r = expr_primary(e);
+            v = r ? v % r : 0;
+        } else {
+            return v;
+        }
+    }
+}
+
+static int32_t expr_add(expr_t* e) {
+    int32_t v = expr_mul(e);
+    for (;;) {
+        expr_ws(e);
+        if (*e->p == '+') {
+            e->p++;
+            v += expr_mul(e);
+        } else if (*e->p == '-') {
+            e->p++;
+            v -= expr_mul(e);
+        } else {
+            return v;
+        }
+    }
+}
+
+static int32_t expr_shift(expr_t* e) {
+    int32_t v = expr_add(e);
+    for (;;) {
+        expr_ws(e);
+        if (e->p[0] == '<' && e->p[1] == '<') {
+            e->p += 2;
+            v <<= expr_add(e);
+        } else if (e->p[0] == '>' && e->p[1] == '>') {
+            e->p += 2;
+            v >>= expr_add(e);
+        } else {
+            return v;
+        }
+    }
+}
+
+static int32_t expr_parse_or(expr_t* e) {
+    int32_t v = expr_shift(e);
+    for (;;) {
+        expr_ws(e);
+        if (*e->p == '&') {
+            e->p++;
+            v &= expr_shift(e);
+        } else if (*e->p == '|') {
+            e->p++;
+            v |= expr_shift(e);
+        } else if (*e->p == '^') {
+            e->p++;
+            v ^= expr_shift(e);
+        } else {
+            return v;
+        }
+    }
+}
+
+static int32_t eval(asm_ctx_t* ctx, const char* text, int* ok) {
+    expr_t e;
+    int32_t v;
+    e.p = text;
+    e.ctx = ctx;
+    e.ok = 1;
+    v = expr_parse_or(&e);
+    expr_ws(&e);
+    if (*e.p) e.ok = 0;
+    if (ok) *ok = e.ok;
+    if (!e.ok) asm_error(ctx, "bad expression", text);
+    return v;
+}
+
+/* ---- Operands ---- */
+
+static int reg8_id(const char* s, uint8_t* reg, uint8_t* idx) {
+    static const char* names = "bcdehl_a";
+    *idx = 0;
+    if (s[0] && !s[1]) {
+        const char* f = strchr(names, s[0]);
+        if (f && s[0] != '_') {
+            *reg = (uint8_t)(f - names);
+            return 1;
+        }
+        return 0;
+    }
+    if (strcmp(s, "ixh") == 0) { *reg = 4; *idx = 1; return 1; }
+    if (strcmp(s, "ixl") == 0) { *reg = 5; *idx = 1; return 1; }
+    if (strcmp(s, "iyh") == 0) { *reg = 4; *idx = 2; return 1; }
+    if (strcmp(s, "iyl") == 0) { *reg = 5; *idx = 2; return 1; }
+    return 0;
+}
+
+static int reg16_id(const char* s, uint8_t* reg) {
+    static const char* names[] = { "bc", "de", "hl", "sp", "af", "ix", "iy" };
+    for (uint8_t i = 0; i < 7; i++) {
+        if (strcmp(s, names[i]) == 0) {
+            *reg = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void parse_operand(asm_ctx_t* ctx, char* text, operand_t* op) {
+    char lower[64];
+    size_t n = 0;
+    memset(op, 0, sizeof(*op));
+    text = trim(text);
+    for (n = 0; text[n] && n + 1 < sizeof(lower); n++) {
+        lower[n] = (char)tolower((unsigned char)text[n]);
+    }
+    lower[n] = '\0';
+    memcpy(op->text, lower, n + 1);
+    if (!lower[0]) {
+        op->kind = OPD_NONE;
+        return;
+    }
+    if (reg8_id(lower, &op->reg, &op->idx)) {
+        op->kind = op->idx ? OPD_IDX8 : OPD_R8;
+        return;
+    }
+    if (reg16_id(lower, &op->reg)) {
+        op->kind = OPD_R16;
+        return;
+    }
+    if (strcmp(lower, "af'") == 0) {
+        op->kind = OPD_AF_ALT;
+        return;
+    }
+    if (strcmp(lower, "i") == 0) {
+        op->kind = OPD_I;
+        return;
+    }
+    if (strcmp(lower, "r") == 0) {
+        op->kind = OPD_R;
+        return;
+    }
+    if (lower[0] == '(' && lower[n - 1] == ')') {
+        /* Make sure the parens enclose the whole operand */
+        int depth = 0;
+        size_t close_at = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (lower[i] == '(') depth++;
+            else if (lower[i] == ')') {
+                depth--;
+                if (depth == 0) {
+                    close_at = i;
+                    break;
+                }
+            }
+        }
+        if (close_at == n - 1) {
+            char inner[64];
+            char* in;
+            memcpy(inner, text + 1, n - 2);
+            inner[n - 2] = '\0';
+            in = trim(inner);
+            {
+                char li[64];
+                size_t k;
+                for (k = 0; in[k] && k + 1 < sizeof(li); k++) {
+                    li[k] = (char)tolower((unsigned char)in[k]);
+                }
+                li[k] = '\0';
+                if (strcmp(li, "hl") == 0) { op->kind = OPD_IND_HL; return; }
+                if (strcmp(li, "bc") == 0) { op->kind = OPD_IND_R16; op->reg = R16_BC; return; }
+                if (strcmp(li, "de") == 0) { op->kind = OPD_IND_R16; op->reg = R16_DE; return; }
+                if (strcmp(li, "sp") == 0) { op->kind = OPD_IND_R16; op->reg = R16_SP; return; }
+                if (strcmp(li, "c") == 0) { op->kind = OPD_IND_C; return; }
+                if ((li[0] == 'i' && (li[1] == 'x' || li[1] == 'y')) &&
+                    (li[2] == '\0' || li[2] == '+' || li[2] == '-' || li[2] == ' ')) {
+                    op->kind = OPD_IND_IDX;
+                    op->idx = (uint8_t)(li[1] == 'x' ? 1 : 2);
+                    if (li[2] == '\0') {
+                        op->value = 0;
+                    } else {
+                        op->value = eval(ctx, in + 2, NULL);
+                    }
+                    return;
+                }
+                op->kind = OPD_IND_IMM;
+                op->value = eval(ctx, in, NULL);
+                return;
+            }
+        }
+    }
+    op->kind = OPD_IMM;
+    op->value = eval(ctx, text, NULL);
+}
+
+static int split_operands(char* text, char** out, int max) {
+    int count = 0;
+    int depth = 0;
+    int in_quote = 0;
+    char* start = text;
+    if (!*trim(text)) return 0;
+    for (char* p = text;; p++) {
+        if (*p == '\'' && !(p > text && p[-1] == 'f' && p[-2] == 'a')) in_quote = !in_quote;
+        if (!in_quote) {
+            if (*p == '(') depth++;
+            if (*p == ')') depth--;
+        }
+        if (*p == '\0' || (*p == ',' && depth == 0 && !in_quote)) {
+            if (count < max) out[count++] = start;
+            if (*p == '\0') break;
+            *p = '\0';
+            start = p + 1;
+        }
+    }
+    return count;
+}
+
+static int cond_id(const char* s) {
+    static const char* names[] = { "nz", "z", "nc", "c", "po", "pe", "p", "m" };
+    for (int i = 0; i < 8; i++) {
+        if (strcmp(s, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static void emit_prefix(asm_ctx_t* ctx, uint8_t idx) {
+    if (idx == 1) emit8(ctx, 0xDD);
+    else if (idx == 2) emit8(ctx, 0xFD);
+}
+
+static void check_disp(asm_ctx_t* ctx, int32_t d) {
+    if (d < -128 || d > 127) asm_error(ctx, "displacement out of range", NULL);
+}
+
+/* r operand: R8, IDX8, (HL), (IX+d). Returns 0 if not an r operand. */
+static int is_r(const operand_t* op) {
+    return op->kind == OPD_R8 || op->kind == OPD_IDX8 ||
+           op->kind == OPD_IND_HL || op->kind == OPD_IND_IDX;
+}
+
+static uint8_t r_code(const operand_t* op) {
+    if (op->kind == OPD_IND_HL || op->kind == OPD_IND_IDX) return 6;
+    return op->reg;
+}
+
+static uint8_t r_idx(const operand_t* op) {
+    return (op->kind == OPD_IDX8 || op->kind == OPD_IND_IDX) ? op->idx : 0;
+}
+
+/* Emit prefix + opcode (+ displacement) for an instruction using one r operand. */
+static void emit_r_insn(asm_ctx_t* ctx, uint8_t opcode, const operand_t* op) {
+    emit_prefix(ctx, r_idx(op));
+    emit8(ctx, opcode);
+    if (op->kind == OPD_IND_IDX) {
+        check_disp(ctx, op->value);
+        emit8(ctx, op->value);
+    }
+}
+
+static uint8_t rp_code(const operand_t* op, uint8_t* idx) {
+    *idx = 0;
+    switch (op->reg) {
+        case R16_BC: return 0;
+        case R16_DE: return 1;
+        case R16_HL: return 2;
+        case R16_IX: *idx = 1; return 2;
+        case R16_IY: *idx = 2; return 2;
+        default: return 3; /* SP or AF */
+    }
+}
+
+static void bad_operands(asm_ctx_t* ctx, const char* mnemonic) {
+    asm_error(ctx, "invalid operands for", mnemonic);
+}
+
+static void asm_ld(asm_ctx_t* ctx, operand_t* dst, operand_t* src) {
+    uint8_t idx;
+    uint8_t p;
+    if (is_r(dst) && is_r(src)) {
+        uint8_t di = r_idx(dst);
+        uint8_t si = r_idx(src);
+        uint8_t idx_used = di ? di : si;
+        if (dst->kind == OPD_IND_HL && src->kind == OPD_IND_HL) {
+            bad_operands(ctx, "ld");
+            return;
+        }
+        if (di && si && di != si) {
+            bad_operands(ctx, "ld");
+            return;
+        }
+        emit_prefix(ctx, idx_used);
+        emit8(ctx, 0x40 | (r_code(dst) << 3) | r_code(src));
+        if (dst->kind == OPD_IND_IDX) emit8(ctx, dst->value);
+        else if (src->kind == OPD_IND_IDX) emit8(ctx, src->value);
+        return;
+    }
+    if (is_r(dst) && src->kind == OPD_IMM) {
+        emit_r_insn(ctx, (uint8_t)(0x06 | (r_code(dst) << 3)), dst);
+        emit8(ctx, src->value);
+        return;
+    }
+    if (dst->kind == OPD_R8 && dst->reg == 7) {
+        if (src->kind == OPD_IND_R16 && src->reg == R16_BC) { emit8(ctx, 0x0A); return; }
+        if (src->kind == OPD_IND_R16 && src->reg == R16_DE) { emit8(ctx, 0x1A); return; }
+        if (src->kind == OPD_IND_IMM) { emit8(ctx, 0x3A); emit16(ctx, src->value); return; }
+        if (src->kind == OPD_I) { emit8(ctx, 0xED); emit8(ctx, 0x57); return; }
+        if (src->kind == OPD_R) { emit8(ctx, 0xED); emit8(ctx, 0x5F); return; }
+    }
+    if (src->kind == OPD_R8 && src->reg == 7) {
+        if (dst->kind == OPD_IND_R16 && dst->reg == R16_BC) { emit8(ctx, 0x02); return; }
+        if (dst->kind == OPD_IND_R16 && dst->reg == R16_DE) { emit8(ctx, 0x12); return; }
+        if (dst->kind == OPD_IND_IMM) { emit8(ctx, 0x32); emit16(ctx, dst->value); return; }
+        if (dst->kind == OPD_I) { emit8(ctx, 0xED); emit8(ctx, 0x47); return; }
+        if (dst->kind == OPD_R) { emit8(ctx, 0xED); emit8(ctx, 0x4F); return; }
+    }
+    if (dst->kind == OPD_R16 && dst->reg != R16_AF) {
+        p = rp_code(dst, &idx);
+        if (src->kind == OPD_IMM) {
+            emit_prefix(ctx, idx);
+            emit8(ctx, 0x01 | (p << 4));
+            emit16(ctx, src->value);
+            return;
+        }
+        if (src->kind == OPD_IND_IMM) {
+            if (p == 2) {
+                emit_prefix(ctx, idx);
+                emit8(ctx, 0x2A);
+            } else {
+                emit8(ctx, 0xED);
+                emit8(ctx, 0x4B | (p << 4));
+            }
+            emit16(ctx, src->value);
+            return;
+        }
+        if (dst->reg == R16_SP && src->kind == OPD_R16 &&
+            (src->reg == R16_HL || src->reg == R16_IX || src->reg == R16_IY)) {
+            rp_code(src, &idx);
+            emit_prefix(ctx, idx);
+            emit8(ctx, 0xF9);
+            return;
+        }
+    }
+    if (dst->kind == OPD_IND_IMM && src->kind == OPD_R16 && src->reg != R16_AF) {
+        p = rp_code(src, &idx);
+        if (p == 2) {
+            emit_prefix(ctx, idx);
+            emit8(ctx, 0x22);
+        } else {
+            emit8(ctx, 0xED);
+            emit8(ctx, 0x43 | (p << 4));
+        }
+        emit16(ctx, dst->value);
+        return;
+    }
+    bad_operands(ctx, "ld");
+}
+
+static void asm_alu(asm_ctx_t* ctx, const char* mnemonic, uint8_t alu_op,
+                    operand_t* ops, int count) {
+    operand_t* src = &ops[0];
+    if (count == 2) {
+        if (ops[0].kind == OPD_R8 && ops[0].reg == 7) {
+            src = &ops[1];
+        } else if (ops[0].kind == OPD_R16 && alu_op <= 3) {
+            /* 16-bit add/adc/sbc */
+            uint8_t idx_dst;
+            uint8_t idx_src;
+            uint8_t p;
+            rp_code(&ops[0], &idx_dst);
+            if (ops[0].reg != R16_HL && ops[0].reg != R16_IX && ops[0].reg != R16_IY) {
+                bad_operands(ctx, mnemonic);
+                return;
+            }
+            if (ops[1].kind != OPD_R16) {
+                bad_operands(ctx, mnemonic);
+                return;
+            }
+            p = rp_code(&ops[1], &idx_src);
+            if (idx_src && idx_src != idx_dst) {
+                bad_operands(ctx, mnemonic);
+                return;
+            }
+            if (alu_op == 0) {
+                emit_prefix(ctx, idx_dst);
+                emit8(ctx, 0x09 | (p << 4));
+            } else if (alu_op == 1 && !idx_dst) {
+                emit8(ctx, 0xED);
+                emit8(ctx, 0x4A | (p << 4));
+            } else if (alu_op == 3 && !idx_dst) {
+                emit8(ctx, 0xED);
+                emit8(ctx, 0x42 | (p << 4));
+            } else {
+                bad_operands(ctx, mnemonic);
+            }
+            return;
+        } else {
+            bad_operands(ctx, mnemonic);
+            return;
+        }
+    }
+    if (is_r(src)) {
+        emit_r_insn(ctx, (uint8_t)(0x80 | (alu_op << 3) | r_code(src)), src);
+        return;
+    }
+    if (src->kind == OPD_IMM) {
+        emit8(ctx, 0xC6 | (alu_op << 3));
+        emit8(ctx, src->value);
+        return;
+    }
+    bad_operands(ctx, mnemonic);
+}
+
+static void asm_incdec(asm_ctx_t* ctx, const char* mnemonic, uint8_t is_dec, operand_t* op) {
+    if (is_r(op)) {
+        emit_r_insn(ctx, (uint8_t)(0x04 | is_dec | (r_code(op) << 3)), op);
+        return;
+    }
+    if (op->kind == OPD_R16 && op->reg != R16_AF) {
+        uint8_t idx;
+        uint8_t p = rp_code(op, &idx);
+        emit_prefix(ctx, idx);
+        emit8(ctx, (is_dec ? 0x0B : 0x03) | (p << 4));
+        return;
+    }
+    bad_operands(ctx, mnemonic);
+}
+
+static void asm_cb(asm_ctx_t* ctx, uint8_t opcode, operand_t* op) {
+    if (!is_r(op) || op->kind == OPD_IDX8) {
+        asm_error(ctx, "invalid CB operand", op->text);
+        return;
+    }
+    if (op->kind == OPD_IND_IDX) {
+        emit_prefix(ctx, op->idx);
+        emit8(ctx, 0xCB);
+        check_disp(ctx, op->value);
+        emit8(ctx, op->value);
+        emit8(ctx, opcode | 6);
+        return;
+    }
+    emit8(ctx, 0xCB);
+    emit8(ctx, opcode | r_code(op));
+}
+
+/* Called after the opcode byte has been emitted. */
+static int32_t rel_offset(asm_ctx_t* ctx, int32_t target) {
+    int32_t d = target - (int32_t)(uint16_t)(ctx->pc + 1);
+    if (ctx->pass == 2 && (d < -128 || d > 127)) {
+        asm_error(ctx, "relative jump out of range", NULL);
+    }
+    return d;
+}
+
+static void asm_instruction(asm_ctx_t* ctx, const char* mnemonic, char* rest) {
+    char* parts[ASM_MAX_OPERANDS];
+    operand_t ops[ASM_MAX_OPERANDS];
+    int count = split_operands(rest, parts, ASM_MAX_OPERANDS);
+    int cc = -1;
+    char first[64] = "";
+
+    if (count > 0) {
+        char* t = trim(parts[0]);
+        size_t i;
+        for (i = 0; t[i] && i + 1 < sizeof(first); i++) {
+            first[i] = (char)tolower((unsigned char)t[i]);
+        }
+        first[i] = '\0';
+    }
+
+    /* Conditions must be recognised before operand parsing (c is also a register) */
+    if ((strcmp(mnemonic, "jp") == 0 || strcmp(mnemonic, "jr") == 0 ||
+         strcmp(mnemonic, "call") == 0 || strcmp(mnemonic, "ret") == 0) && count >= 1) {
+        cc = cond_id(first);
+        if (cc >= 0) {
+            if (count == 2) {
+                parse_operand(ctx, parts[1], &ops[1]);
+            }
+        }
+    }
+    if (cc < 0) {
+        for (int i = 0; i < count; i++) {
+            parse_operand(ctx, parts[i], &ops[i]);
+        }
+    }
+
+    if (strcmp(mnemonic, "ld") == 0 && count == 2) { asm_ld(ctx, &ops[0], &ops[1]); return; }
+    if (strcmp(mnemonic, "add") == 0) { asm_alu(ctx, mnemonic, 0, ops, count); return; }
+    if (strcmp(mnemonic, "adc") == 0) { asm_alu(ctx, mnemonic, 1, ops, count); return; }
+    if (strcmp(mnemonic, "sub") == 0) { asm_alu(ctx, mnemonic, 2, ops, count); return; }
+    if (strcmp(mnemonic, "sbc") == 0) { asm_alu(ctx, mnemonic, 3, ops, count); return; }
+    if (strcmp(mnemonic, "and") == 0) { asm_alu(ctx, mnemonic, 4, ops, count); return; }
+    if (strcmp(mnemonic, "xor") == 0) { asm_alu(ctx, mnemonic, 5, ops, count); return; }
+    if (strcmp(mnemonic, "or") == 0) { asm_alu(ctx, mnemonic, 6, ops, count); return; }
+    if (strcmp(mnemonic, "cp") == 0) { asm_alu(ctx, mnemonic, 7, ops, count); return; }
+    if (strcmp(mnemonic, "inc") == 0 && count == 1) { asm_incdec(ctx, mnemonic, 0, &ops[0]); return; }
+    if (strcmp(mnemonic, "dec") == 0 && count == 1) { asm_incdec(ctx, mnemonic, 1, &ops[0]); return; }
+
+    if (strcmp(mnemonic, "push") == 0 || strcmp(mnemonic, "pop") == 0) {
+        uint8_t base = (uint8_t)(mnemonic[1] == 'u' ? 0xC5 : 0xC1);
+        if (count == 1 && ops[0].kind == OPD_R16 && ops[0].reg != R16_SP) {
+            uint8_t idx;
+            uint8_t p = rp_code(&ops[0], &idx);
+            emit_prefix(ctx, idx);
+            emit8(ctx, base | (p << 4));
+            return;
+        }
+        bad_operands(ctx, mnemonic);
+        return;
+    }
+
+    if (strcmp(mnemonic, "jp") == 0) {
+        if (cc >= 0 && count == 2) {
+            emit8(ctx, 0xC2 | (cc << 3));
+            emit16(ctx, ops[1].value);
+            return;
+        }
+        if (count == 1 && ops[0].kind == OPD_IMM) {
+            emit8(ctx, 0xC3);
+            emit16(ctx, ops[0].value);
+            return;
+        }
+        if (count == 1 && ops[0].kind == OPD_IND_HL) {
+            emit8(ctx, 0xE9);
+            return;
+        }
+        if (count == 1 && ops[0].kind == OPD_IND_IDX && ops[0].value == 0) {
+            emit_prefix(ctx, ops[0].idx);
+            emit8(ctx, 0xE9);
+            return;
+        }
+        bad_operands(ctx, mnemonic);
+        return;
+    }
+    if (strcmp(mnemonic, "jr") == 0) {
+        if (cc >= 0 && cc < 4 && count == 2) {
+            emit8(ctx, 0x20 | (cc << 3));
+            emit8(ctx, rel_offset(ctx, ops[1].value));
+            return;
+        }
+        if (cc < 0 && count == 1 && ops[0].kind == OPD_IMM) {
+            emit8(ctx, 0x18);
+            emit8(ctx, rel_offset(ctx, ops[0].value));
+            return;
+        }
+        bad_operands(ctx, mnemonic);
+        return;
+    }
+    if (strcmp(mnemonic, "djnz") == 0 && count == 1) {
+        emit8(ctx, 0x10);
+        emit8(ctx, rel_offset(ctx, ops[0].value));
+        return;
+    }
+    if (strcmp(mnemonic, "call") == 0) {
+        if (cc >= 0 && count == 2) {
+            emit8(ctx, 0xC4 | (cc << 3));
+            emit16(ctx, ops[1].value);
+            return;
+        }
+        if (count == 1 && ops[0].kind == OPD_IMM) {
+            emit8(ctx, 0xCD);
+            emit16(ctx, ops[0].value);
+            return;
+        }
+        bad_operands(ctx, mnemonic);
+        return;
+    }
+    if (strcmp(mnemonic, "ret") == 0) {
+        if (cc >= 0) emit8(ctx, 0xC0 | (cc << 3));
+        else if (count == 0) emit8(ctx, 0xC9);
+        else bad_operands(ctx, mnemonic);
+        return;
+    }
+    if (strcmp(mnemonic, "rst") == 0 && count == 1) {
+        emit8(ctx, 0xC7 | (ops[0].value & 0x38));
+        return;
+    }
+    if (strcmp(mnemonic, "ex") == 0 && count == 2) {
+        if (ops[0].kind == OPD_R16 && ops[0].reg == R16_DE &&
+            ops[1].kind == OPD_R16 && ops[1].reg == R16_HL) {
+            emit8(ctx, 0xEB);
+            return;
+        }
+        if (ops[0].kind == OPD_R16 && ops[0].reg == R16_AF && ops[1].kind == OPD_AF_ALT) {
+            emit8(ctx, 0x08);
+            return;
+        }
+        if (ops[0].kind == OPD_IND_R16 && ops[0].reg == R16_SP && ops[1].kind == OPD_R16) {
+            uint8_t idx;
+            rp_code(&ops[1], &idx);
+            emit_prefix(ctx, idx);
+            emit8(ctx, 0xE3);
+            return;
+        }
+        bad_operands(ctx, mnemonic);
+        return;
+    }
+    if (strcmp(mnemonic, "bit") == 0 || strcmp(mnemonic, "set") == 0 ||
+        strcmp(mnemonic, "res") == 0) {
+        uint8_t base = (uint8_t)(mnemonic[0] == 'b' ? 0x40 : (mnemonic[0] == 'r' ? 0x80 : 0xC0));
+        if (count != 2 || ops[0].kind != OPD_IMM || ops[0].value < 0 || ops[0].value > 7) {
+            bad_operands(ctx, mnemonic);
+            return;
+        }
+        asm_cb(ctx, (uint8_t)(base | (ops[0].value << 3)), &ops[1]);
+        return;
+    }
+    {
+        static const char* rots[] = { "rlc", "rrc", "rl", "rr", "sla", "sra", "sll", "srl" };
+        for (uint8_t i = 0; i < 8; i++) {
+            if (strcmp(mnemonic, rots[i]) == 0) {
+                if (count != 1) {
+                    bad_operands(ctx, mnemonic);
+                    return;
+                }
+                asm_cb(ctx, (uint8_t)(i << 3), &ops[0]);
+                return;
+            }
+        }
+    }
+    if (strcmp(mnemonic, "im") == 0 && count == 1) {
+        static const uint8_t codes[] = { 0x46, 0x56, 0x5E };
+        emit8(ctx, 0xED);
+        emit8(ctx, codes[ops[0].value & 3]);
+        return;
+    }
+    if (strcmp(mnemonic, "out") == 0 && count == 2) {
+        if (ops[0].kind == OPD_IND_IMM) {
+            emit8(ctx, 0xD3);
+            emit8(ctx, ops[0].value);
+            return;
+        }
+        if (ops[0].kind == OPD_IND_C && ops[1].kind == OPD_R8) {
+            emit8(ctx, 0xED);
+            emit8(ctx, 0x41 | (ops[1].reg << 3));
+            return;
+        }
+        bad_operands(ctx, mnemonic);
+        return;
+    }
+    if (strcmp(mnemonic, "in") == 0 && count == 2) {
+        if (ops[1].kind == OPD_IND_IMM) {
+            emit8(ctx, 0xDB);
+            emit8(ctx, ops[1].value);
+            return;
+        }
+        if (ops[1].kind == OPD_IND_C && ops[0].kind == OPD_R8) {
+            emit8(ctx, 0xED);
+            emit8(ctx, 0x40 | (ops[0].reg << 3));
+            return;
+        }
+        bad_operands(ctx, mnemonic);
+        return;
+    }
+    if (count == 0) {
+        static const struct { const char* name; uint8_t prefix; uint8_t code; } simple[] = {
+            { "nop", 0, 0x00 }, { "rlca", 0, 0x07 }, { "rrca", 0, 0x0F }, { "rla", 0, 0x17 },
+            { "rra", 0, 0x1F }, { "daa", 0, 0x27 }, { "cpl", 0, 0x2F }, { "scf", 0, 0x37 },
+            { "ccf", 0, 0x3F }, { "halt", 0, 0x76 }, { "exx", 0, 0xD9 }, { "di", 0, 0xF3 },
+            { "ei", 0, 0xFB }, { "neg", 0xED, 0x44 }, { "retn", 0xED, 0x45 },
+            { "reti", 0xED, 0x4D }, { "rrd", 0xED, 0x67 }, { "rld", 0xED, 0x6F },
+            { "ldi", 0xED, 0xA0 }, { "cpi", 0xED, 0xA1 }, { "ini", 0xED, 0xA2 },
+            { "outi", 0xED, 0xA3 }, { "ldd", 0xED, 0xA8 }, { "cpd", 0xED, 0xA9 },
+            { "ind", 0xED, 0xAA }, { "outd", 0xED, 0xAB }, { "ldir", 0xED, 0xB0 },
+            { "cpir", 0xED, 0xB1 }, { "inir", 0xED, 0xB2 }, { "otir", 0xED, 0xB3 },
+            { "lddr", 0xED, 0xB8 }, { "cpdr", 0xED, 0xB9 }, { "indr", 0xED, 0xBA },
+            { "otdr", 0xED, 0xBB }
+        };
+        for (size_t i = 0; i < sizeof(simple) / sizeof(simple[0]); i++) {
+            if (strcmp(mnemonic, simple[i].name) == 0) {
+                if (simple[i].prefix) emit8(ctx, simple[i].prefix);
+                emit8(ctx, simple[i].code);
+                return;
+            }
+        }
+    }
+    asm_error(ctx, "unknown instruction", mnemonic);
+}
+
+/* .db/.dm: comma separated numbers and quoted strings */
+static void asm_data_bytes(asm_ctx_t* ctx, char* rest) {
+    char* p = rest;
+    while (*p) {
+        while (isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+        if (*p == '"') {
+            p++;
+            while (*p && *p != '"') {
+                char c = *p++;
+                if (c == '\\' && *p) {
+                    char esc = *p++;
+                    switch (esc) {
+                        case 'n': c = '\n'; break;
+                        case 'r': c = '\r'; break;
+                        case 't': c = '\t'; break;
+                        case '0': c = '\0'; break;
+                        default: c = esc; break;
+                    }
+                }
+                emit8(ctx, (uint8_t)c);
+            }
+            if (*p == '"') p++;
+        } else {
+            char item[128];
+            size_t n = 0;
+            int in_quote = 0;
+            while (*p && (in_quote || *p != ',') && n + 1 < sizeof(item)) {
+                if (*p == '\'') in_quote = !in_quote;
+                item[n++] = *p++;
+            }
+            item[n] = '\0';
+            emit8(ctx, eval(ctx, trim(item), NULL));
+        }
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == ',') p++;
+    }
+}
+
+static void asm_data_words(asm_ctx_t* ctx, char* rest) {
+    char* parts[64];
+    int count = 0;
+    char* start = rest;
+    for (char* p = rest;; p++) {
+        if (*p == ',' || *p == '\0') {
+            int end = *p == '\0';
+            *p = '\0';
+            if (count < 64) parts[count++] = start;
+            if (end) break;
+            start = p + 1;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        emit16(ctx, eval(ctx, trim(parts[i]), NULL));
+    }
+}
+
+/* Strip comments outside string/char literals. */
+static void strip_comment(char* line) {
+    int in_str = 0;
+    int in_chr = 0;
+    for (char* p = line; *p; p++) {
+        if (*p == '"' && !in_chr) in_str = !in_str;
+        else if (*p == '\'' && !in_str) {
+            /* af' is not a char literal */
+            if (!(p - line >= 2 && tolower((unsigned char)p[-1]) == 'f' &&
+                  tolower((unsigned char)p[-2]) == 'a')) {
+                in_chr = !in_chr;
+            }
+        } else if (*p == ';' && !in_str && !in_chr) {
+            *p = '\0';
+            return;
+        }
+    }
+}
+
+static int asm_line(asm_ctx_t* ctx, char* raw) {
+    char* line;
+    char* colon;
+    char mnemonic[16];
+    size_t n = 0;
+    char* rest;
+
+    strip_comment(raw);
+    line = trim(raw);
+    if (!*line) return 0;
+
+    /* Label: identifier followed by ':' at the start of the line */
+    colon = line;
+    while (isalnum((unsigned char)*colon) || *colon == '_' || *colon == '.') colon++;
+    if (*colon == ':' && colon > line) {
+        *colon = '\0';
+        if (ctx->pass == 1) {
+            if (zsim_symtab_find(ctx->syms, line)) {
+                ctx->pass = 2;
+                asm_error(ctx, "duplicate label", line);
+                ctx->pass = 1;
+            }
+            if (zsim_symtab_add(ctx->syms, line, ctx->pc) == 0) {
+                ((zsim_symbol_t*)zsim_symtab_find(ctx->syms, line))->is_label = 1;
+            }
+        }
+        line = trim(colon + 1);
+        if (!*line) return 0;
+    }
+
+    while (*line && !isspace((unsigned char)*line) && n + 1 < sizeof(mnemonic)) {
+        mnemonic[n++] = (char)tolower((unsigned char)*line++);
+    }
+    mnemonic[n] = '\0';
+    rest = trim(line);
+
+    /* "name .equ value" / "name equ value" */
+    {
+        char* sp = rest;
+        char word[16];
+        size_t k = 0;
+        while (*sp && !isspace((unsigned char)*sp) && k + 1 < sizeof(word)) {
+            word[k++] = (char)tolower((unsigned char)*sp++);
+        }
+        word[k] = '\0';
+        if (strcmp(word, ".equ") == 0 || strcmp(word, "equ") == 0) {
+            char name[64];
+            int32_t v;
+            strncpy(name, mnemonic, sizeof(name) - 1);
+            name[sizeof(name) - 1] = '\0';
+            v = eval(ctx, trim(sp), NULL);
+            zsim_symtab_add(ctx->syms, name, (uint16_t)v);
+            return 0;
+        }
+    }
+
+    if (strcmp(mnemonic, "org") == 0 || strcmp(mnemonic, ".org") == 0) {
+        ctx->pc = (uint16_t)eval(ctx, rest, NULL);
+        return 0;
+    }
+    if (strcmp(mnemonic, ".equ") == 0 || strcmp(mnemonic, "equ") == 0) {
+        /* ".equ NAME, value" */
+        char* comma = strchr(rest, ',');
+        if (comma) {
+            *comma = '\0';
+            zsim_symtab_add(ctx->syms, trim(rest), (uint16_t)eval(ctx, trim(comma + 1), NULL));
+        }
+        return 0;
+    }
+    if (strcmp(mnemonic, ".db") == 0 || strcmp(mnemonic, "db") == 0 ||
+        strcmp(mnemonic, ".byte") == 0 || strcmp(mnemonic, "defb") == 0 ||
+        strcmp(mnemonic, ".dm") == 0 || strcmp(mnemonic, "dm") == 0 ||
+        strcmp(mnemonic, ".ascii") == 0 || strcmp(mnemonic, "defm") == 0) {
+        asm_data_bytes(ctx, rest);
+        return 0;
+    }
+    if (strcmp(mnemonic, ".dw") == 0 || strcmp(mnemonic, "dw") == 0 ||
+        strcmp(mnemonic, ".word") == 0 || strcmp(mnemonic, "defw") == 0) {
+        asm_data_words(ctx, rest);
+        return 0;
+    }
+    if (strcmp(mnemonic, ".ds") == 0 || strcmp(mnemonic, "ds") == 0 ||
+        strcmp(mnemonic, "defs") == 0) {
+        int32_t count = eval(ctx, rest, NULL);
+        for (int32_t i = 0; i < count; i++) emit8(ctx, 0);
+        return 0;
+    }
+    if (strcmp(mnemonic, ".globl") == 0 || strcmp(mnemonic, ".global") == 0 ||
+        strcmp(mnemonic, ".module") == 0 || strcmp(mnemonic, ".area") == 0) {
+        return 0;
+    }
+    asm_instruction(ctx, mnemonic, rest);
+    return 0;
+}
+
+static int asm_pass(asm_ctx_t* ctx, FILE* fp) {
+    char buf[ASM_LINE_MAX];
+    ctx->line = 0;
+    ctx->pc = ZSIM_DEFAULT_ORG;
+    ctx->has_start = 0;
+    ctx->end = 0;
+    rewind(fp);
+    while (fgets(buf, sizeof(buf), fp)) {
+        ctx->line++;
+        asm_line(ctx, buf);
+    }
+    return ctx->errors ? -1 : 0;
+}
+
+int zsim_assemble(const char* path, uint8_t* mem, uint16_t* out_start,
+                  uint16_t* out_end, zsim_symtab_t* symbols) {
+    asm_ctx_t ctx;
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.path = path;
+    ctx.mem = mem;
+    ctx.syms = symbols;
+    ctx.pass = 1;
+    asm_pass(&ctx, fp);
+    ctx.pass = 2;
+    ctx.errors = 0;
+    if (asm_pass(&ctx, fp) < 0) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    if (out_start) *out_start = ctx.start;
+    if (out_end) *out_end = ctx.end;
+    return 0;
+}
@@ -0,0 +1,916 @@
+#include "zsim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Z80 core with T-state accounting. Undocumented flag bits 3/5 are not
+ * modelled; instruction timings follow the Zilog user manual. */
+
+#define FC ZSIM_FLAG_C
+#define FN ZSIM_FLAG_N
+#define FPV ZSIM_FLAG_PV
+#define FH ZSIM_FLAG_H
+#define FZ ZSIM_FLAG_Z
+#define FS ZSIM_FLAG_S
+
+/* ZOS syscall numbers (L register on rst 0x08) */
+#define ZOS_SYS_READ 0
+#define ZOS_SYS_WRITE 1
+#define ZOS_SYS_OPEN 2
+#define ZOS_SYS_CLOSE 3
+#define ZOS_SYS_EXIT 15
+
+#define ZOS_DEV_STDOUT 0
+#define ZOS_DEV_FIRST_FILE 3
+#define ZOS_ERR_FAILURE 1
+#define ZOS_ERR_NO_SUCH_ENTRY 4
+#define ZOS_ERR_INVALID_PARAMETER 2
+
+/* open flags (H register) */
+#define ZOS_O_ACCESS 0x03 /* O_RDONLY 0, O_WRONLY 1, O_RDWR 2 */
+#define ZOS_O_TRUNC 0x04
+#define ZOS_O_APPEND 0x08
+#define ZOS_O_CREAT 0x10
+
+static uint8_t parity(uint8_t v) {
+    v ^= (uint8_t)(v >> 4);
+    v ^= (uint8_t)(v >> 2);
+    v ^= (uint8_t)(v >> 1);
+    return (uint8_t)((v & 1) ? 0 : FPV);
+}
+
+static uint8_t sz(uint8_t v) {
+    return (uint8_t)((v & 0x80) | (v == 0 ? FZ : 0));
+}
+
+static uint8_t szp(uint8_t v) {
+    return (uint8_t)(sz(v) | parity(v));
+}
+
+static uint8_t rd(zsim_t* s, uint16_t addr) {
+    return s->mem[addr];
+}
+
+static void wr(zsim_t* s, uint16_t addr, uint8_t v) {
+    s->mem[addr] = v;
+}
+
+static uint16_t rd16(zsim_t* s, uint16_t addr) {
+    return (uint16_t)(rd(s, addr) | (rd(s, (uint16_t)(addr + 1)) << 8));
+}
+
+static void wr16(zsim_t* s, uint16_t addr, uint16_t v) {
+    wr(s, addr, (uint8_t)v);
+    wr(s, (uint16_t)(addr + 1), (uint8_t)(v >> 8));
+}
+
+static uint8_t fetch(zsim_t* s) {
+    return rd(s, s->pc++);
+}
+
+static uint16_t fetch16(zsim_t* s) {
+    uint16_t v = rd16(s, s->pc);
+    s->pc = (uint16_t)(s->pc + 2);
+    return v;
+}
+
+static void push16(zsim_t* s, uint16_t v) {
+    s->sp = (uint16_t)(s->sp - 2);
+    wr16(s, s->sp, v);
+}
+
+static uint16_t pop16(zsim_t* s) {
+    uint16_t v = rd16(s, s->sp);
+    s->sp = (uint16_t)(s->sp + 2);
+    return v;
+}
+
+static uint16_t get_bc(zsim_t* s) { return (uint16_t)((s->b << 8) | s->c); }
+static uint16_t get_de(zsim_t* s) { return (uint16_t)((s->d << 8) | s->e); }
+static uint16_t get_hl(zsim_t* s) { return (uint16_t)((s->h << 8) | s->l); }
+static void set_bc(zsim_t* s, uint16_t v) { s->b = (uint8_t)(v >> 8); s->c = (uint8_t)v; }
+static void set_de(zsim_t* s, uint16_t v) { s->d = (uint8_t)(v >> 8); s->e = (uint8_t)v; }
+static void set_hl(zsim_t* s, uint16_t v) { s->h = (uint8_t)(v >> 8); s->l = (uint8_t)v; }
+
+/* idx: 0 = HL, 1 = IX, 2 = IY */
+static uint16_t get_xy(zsim_t* s, uint8_t idx) {
+    if (idx == 1) return s->ix;
+    if (idx == 2) return s->iy;
+    return get_hl(s);
+}
+
+static void set_xy(zsim_t* s, uint8_t idx, uint16_t v) {
+    if (idx == 1) s->ix = v;
+    else if (idx == 2) s->iy = v;
+    else set_hl(s, v);
+}
+
+/* rp table: BC, DE, HL/IX/IY, SP */
+static uint16_t get_rp(zsim_t* s, uint8_t p, uint8_t idx) {
+    switch (p) {
+        case 0: return get_bc(s);
+        case 1: return get_de(s);
+        case 2: return get_xy(s, idx);
+        default: return s->sp;
+    }
+}
+
+static void set_rp(zsim_t* s, uint8_t p, uint8_t idx, uint16_t v) {
+    switch (p) {
+        case 0: set_bc(s, v); break;
+        case 1: set_de(s, v); break;
+        case 2: set_xy(s, idx, v); break;
+        default: s->sp = v; break;
+    }
+}
+
+/* rp2 table: BC, DE, HL/IX/IY, AF */
+static uint16_t get_rp2(zsim_t* s, uint8_t p, uint8_t idx) {
+    if (p == 3) return (uint16_t)((s->a << 8) | s->f);
+    return get_rp(s, p, idx);
+}
+
+static void set_rp2(zsim_t* s, uint8_t p, uint8_t idx, uint16_t v) {
+    if (p == 3) {
+        s->a = (uint8_t)(v >> 8);
+        s->f = (uint8_t)v;
+        return;
+    }
+    set_rp(s, p, idx, v);
+}
+
+/* 8-bit register by encoding; r == 6 is handled by callers.
+ * When idx != 0, H/L map to the index register halves. */
+static uint8_t get_r(zsim_t* s, uint8_t r, uint8_t idx) {
+    switch (r) {
+        case 0: return s->b;
+        case 1: return s->c;
+        case 2: return s->d;
+        case 3: return s->e;
+        case 4:
+            if (idx == 1) return (uint8_t)(s->ix >> 8);
+            if (idx == 2) return (uint8_t)(s->iy >> 8);
+            return s->h;
+        case 5:
+            if (idx == 1) return (uint8_t)s->ix;
+            if (idx == 2) return (uint8_t)s->iy;
+            return s->l;
+        default: return s->a;
+    }
+}
+
+static void set_r(zsim_t* s, uint8_t r, uint8_t idx, uint8_t v) {
+    switch (r) {
+        case 0: s->b = v; break;
+        case 1: s->c = v; break;
+        case 2: s->d = v; break;
+        case 3: s->e = v; break;
+        case 4:
+            if (idx == 1) s->ix = (uint16_t)((s->ix & 0x00FF) | (v << 8));
+            else if (idx == 2) s->iy = (uint16_t)((s->iy & 0x00FF) | (v << 8));
+            else s->h = v;
+            break;
+        case 5:
+            if (idx == 1) s->ix = (uint16_t)((s->ix & 0xFF00) | v);
+            else if (idx == 2) s->iy = (uint16_t)((s->iy & 0xFF00) | v);
+            else s->l = v;
+            break;
+        default: s->a = v; break;
+    }
+}
+
+/* Address for (HL) or (IX+d)/(IY+d); fetches the displacement. */
+static uint16_t mem_operand(zsim_t* s, uint8_t idx) {
+    if (idx == 0) return get_hl(s);
+    {
+        int8_t d = (int8_t)fetch(s);
+        return (uint16_t)(get_xy(s, idx) + d);
+    }
+}
+
+static uint8_t cond(zsim_t* s, uint8_t y) {
+    switch (y) {
+        case 0: return !(s->f & FZ);
+        case 1: return (s->f & FZ) != 0;
+        case 2: return !(s->f & FC);
+        case 3: return (s->f & FC) != 0;
+        case 4: return !(s->f & FPV);
+        case 5: return (s->f & FPV) != 0;
+        case 6: return !(s->f & FS);
+        default: return (s->f & FS) != 0;
+    }
+}
+
+static void alu(zsim_t* s, uint8_t op, uint8_t v) {
+    uint8_t a = s->a;
+    uint16_t res;
+    uint8_t carry = (uint8_t)(s->f & FC);
+    switch (op) {
+        case 1: /* ADC */
+        case 0: /* ADD */
+            if (op == 0) carry = 0;
+            res = (uint16_t)(a + v + carry);
+            s->f = (uint8_t)(sz((uint8_t)res) |
+                             (((a & 0x0F) + (v & 0x0F) + carry) & 0x10 ? FH : 0) |
+                             ((~(a ^ v) & (a ^ res) & 0x80) ? FPV : 0) |
+                             (res > 0xFF ? FC : 0));
+            s->a = (uint8_t)res;
+            break;
+        case 3: /* SBC */
+        case 2: /* SUB */
+        case 7: /* CP */
+            if (op != 3) carry = 0;
+            res = (uint16_t)(a - v - carry);
+            s->f = (uint8_t)(sz((uint8_t)res) | FN |
+                             (((a & 0x0F) - (v & 0x0F) - carry) & 0x10 ? FH : 0) |
+                             (((a ^ v) & (a ^ res) & 0x80) ? FPV : 0) |
+                             (res > 0xFF ? FC : 0));
+            if (op != 7) s->a = (uint8_t)res;
+            break;
+        case 4: /* AND */
+            s->a = (uint8_t)(a & v);
+            s->f = (uint8_t)(szp(s->a) | FH);
+            break;
+        case 5: /* XOR */
+            s->a = (uint8_t)(a ^ v);
+            s->f = szp(s->a);
+            break;
+        default: /* OR */
+            s->a = (uint8_t)(a | v);
+            s->f = szp(s->a);
+            break;
+    }
+}
+
+static uint8_t inc8(zsim_t* s, uint8_t v) {
+    uint8_t r = (uint8_t)(v + 1);
+    s->f = (uint8_t)((s->f & FC) | sz(r) | ((v & 0x0F) == 0x0F ? FH : 0) |
+                     (v == 0x7F ? FPV : 0));
+    return r;
+}
+
+static uint8_t dec8(zsim_t* s, uint8_t v) {
+    uint8_t r = (uint8_t)(v - 1);
+    s->f = (uint8_t)((s->f & FC) | sz(r) | FN | ((v & 0x0F) == 0 ? FH : 0) |
+                     (v == 0x80 ? FPV : 0));
+    return r;
+}
+
+static uint16_t add16(zsim_t* s, uint16_t a, uint16_t b) {
+    uint32_t res = (uint32_t)a + b;
+    s->f = (uint8_t)((s->f & (FS | FZ | FPV)) |
+                     (((a & 0x0FFF) + (b & 0x0FFF)) & 0x1000 ? FH : 0) |
+                     (res > 0xFFFF ? FC : 0));
+    return (uint16_t)res;
+}
+
+static uint16_t adc16(zsim_t* s, uint16_t a, uint16_t b) {
+    uint8_t c = (uint8_t)(s->f & FC);
+    uint32_t res = (uint32_t)a + b + c;
+    uint16_t r16 = (uint16_t)res;
+    s->f = (uint8_t)(((r16 >> 8) & FS) | (r16 == 0 ? FZ : 0) |
+                     (((a & 0x0FFF) + (b & 0x0FFF) + c) & 0x1000 ? FH : 0) |
+                     ((~(a ^ b) & (a ^ r16) & 0x8000) ? FPV : 0) |
+                     (res > 0xFFFF ? FC : 0));
+    return r16;
+}
+
+static uint16_t sbc16(zsim_t* s, uint16_t a, uint16_t b) {
+    uint8_t c = (uint8_t)(s->f & FC);
+    uint32_t res = (uint32_t)a - b - c;
+    uint16_t r16 = (uint16_t)res;
+    s->f = (uint8_t)(((r16 >> 8) & FS) | (r16 == 0 ? FZ : 0) | FN |
+                     (((a & 0x0FFF) - (b & 0x0FFF) - c) & 0x1000 ? FH : 0) |
+                     (((a ^ b) & (a ^ r16) & 0x8000) ? FPV : 0) |
+                     (res > 0xFFFF ? FC : 0));
+    return r16;
+}
+
+static uint8_t rot(zsim_t* s, uint8_t op, uint8_t v) {
+    uint8_t c = 0;
+    uint8_t r = v;
+    switch (op) {
+        case 0: c = (uint8_t)(v >> 7); r = (uint8_t)((v << 1) | c); break;           /* RLC */
+        case 1: c = (uint8_t)(v & 1); r = (uint8_t)((v >> 1) | (c << 7)); break;     /* RRC */
+        case 2: c = (uint8_t)(v >> 7); r = (uint8_t)((v << 1) | (s->f & FC)); break; /* RL */
+        case 3: c = (uint8_t)(v & 1); r = (uint8_t)((v >> 1) | ((s->f & FC) << 7)); break; /* RR */
+        case 4: c = (uint8_t)(v >> 7); r = (uint8_t)(v << 1); break;                 /* SLA */
+        case 5: c = (uint8_t)(v & 1); r = (uint8_t)((v >> 1) | (v & 0x80)); break;   /* SRA */
+        case 6: c = (uint8_t)(v >> 7); r = (uint8_t)((v << 1) | 1); break;           /* SLL */
+        default: c = (uint8_t)(v & 1); r = (uint8_t)(v >> 1); break;                 /* SRL */
+    }
+    s->f = (uint8_t)(szp(r) | (c ? FC : 0));
+    return r;
+}
+
+static void daa(zsim_t* s) {
+    uint8_t a = s->a;
+    uint8_t corr = 0;
+    uint8_t carry = (uint8_t)(s->f & FC);
+    uint8_t n = (uint8_t)(s->f & FN);
+    if ((s->f & FH) || (a & 0x0F) > 9) corr |= 0x06;
+    if (carry || a > 0x99) {
+        corr |= 0x60;
+        carry = FC;
+    }
+    if (n) {
+        s->f = (uint8_t)((s->f & FH) && (a & 0x0F) < 6 ? FH : 0);
+        a = (uint8_t)(a - corr);
+    } else {
+        s->f = (uint8_t)((a & 0x0F) > 9 ? FH : 0);
+        a = (uint8_t)(a + corr);
+    }
+    s->f = (uint8_t)(s->f | szp(a) | carry | n);
+    s->a = a;
+}
+
+/* Flags in H: the access mode in bits 0-1, then O_TRUNC, O_APPEND and
+ * O_CREAT; both writable modes open the host file for update */
+static FILE* zsim_open(const char* host, uint8_t flags) {
+    FILE* fp;
+    if ((flags & ZOS_O_ACCESS) == 0) return fopen(host, "rb");
+    fp = fopen(host, (flags & ZOS_O_APPEND) ? "a+b" : "r+b");
+    if (fp && (flags & ZOS_O_TRUNC)) {
+        fclose(fp);
+        fp = fopen(host, "w+b");
+    }
+    if (!fp && (flags & ZOS_O_CREAT)) fp = fopen(host, "w+b");
+    return fp;
+}
+
+static FILE* zsim_file(zsim_t* s, uint8_t dev) {
+    if (dev < ZOS_DEV_FIRST_FILE || dev >= ZOS_DEV_FIRST_FILE + ZSIM_MAX_FILES) return NULL;
+    return (FILE*)s->files[dev - ZOS_DEV_FIRST_FILE];
+}
+
+/* Map a ZOS path ("h:/tests/x.txt") onto the host root directory. */
+static void zsim_host_path(zsim_t* s, const char* path, char* out, size_t out_size) {
+    const char* p = path;
+    if (p[0] && p[1] == ':') p += 2;
+    while (*p == '/') p++;
+    snprintf(out, out_size, "%s/%s", s->root ? s->root : ".", p);
+}
+
+static void zsim_syscall(zsim_t* s) {
+    uint8_t dev = s->h;
+    switch (s->l) {
+        case ZOS_SYS_READ: {
+            FILE* fp = zsim_file(s, dev);
+            uint16_t size = get_bc(s);
+            size_t n;
+            if (!fp) {
+                s->a = ZOS_ERR_INVALID_PARAMETER;
+                break;
+            }
+            if ((uint32_t)get_de(s) + size > ZSIM_MEM_SIZE) {
+                size = (uint16_t)(ZSIM_MEM_SIZE - get_de(s));
+            }
+            n = fread(&s->mem[get_de(s)], 1, size, fp);
+            set_bc(s, (uint16_t)n);
+            s->a = 0;
+            break;
+        }
+        case ZOS_SYS_WRITE: {
+            uint16_t size = get_bc(s);
+            FILE* fp = dev == ZOS_DEV_STDOUT ? stdout : zsim_file(s, dev);
+            if (!fp) {
+                s->a = ZOS_ERR_INVALID_PARAMETER;
+                break;
+            }
+            if ((uint32_t)get_de(s) + size > ZSIM_MEM_SIZE) {
+                size = (uint16_t)(ZSIM_MEM_SIZE - get_de(s));
+            }
+            fwrite(&s->mem[get_de(s)], 1, size, fp);
+            s->a = 0;
+            break;
+        }
+        case ZOS_SYS_OPEN: {
+            char name[256];
+            char host[512];
+            uint16_t addr = get_bc(s);
+            size_t i = 0;
+            uint8_t slot;
+            while (i + 1 < sizeof(name) && s->mem[(uint16_t)(addr + i)]) {
+                name[i] = (char)s->mem[(uint16_t)(addr + i)];
+                i++;
+            }
+            name[i] = '\0';
+            zsim_host_path(s, name, host, sizeof(host));
+            for (slot = 0; slot < ZSIM_MAX_FILES; slot++) {
+                if (!s->files[slot]) break;
+            }
+            if (slot == ZSIM_MAX_FILES) {
+                s->a = (uint8_t)-ZOS_ERR_FAILURE;
+                break;
+            }
+            s->files[slot] = zsim_open(host, dev);
+            if (!s->files[slot]) {
+                s->a = (uint8_t)-ZOS_ERR_NO_SUCH_ENTRY;
+                break;
+            }
+            s->a = (uint8_t)(ZOS_DEV_FIRST_FILE + slot);
+            break;
+        }
+        case ZOS_SYS_CLOSE: {
+            FILE* fp = zsim_file(s, dev);
+            if (!fp) {
+                s->a = ZOS_ERR_INVALID_PARAMETER;
+                break;
+            }
+            fclose(fp);
+            s->files[dev - ZOS_DEV_FIRST_FILE] = NULL;
+            s->a = 0;
+            break;
+        }
+        case ZOS_SYS_EXIT:
+            fflush(stdout);
+            s->exited = 1;
+            s->exit_code = dev;
+            break;
+        default:
+            s->a = ZOS_ERR_FAILURE;
+            break;
+    }
+    s->syscall_count++;
+}
+
+void zsim_close_files(zsim_t* s) {
+    for (uint8_t i = 0; i < ZSIM_MAX_FILES; i++) {
+        if (s->files[i]) {
+            fclose((FILE*)s->files[i]);
+            s->files[i] = NULL;
+        }
+    }
+}
+
+void zsim_reset(zsim_t* s, uint16_t pc, uint16_t sp) {
+    s->a = s->f = s->b = s->c = s->d = s->e = s->h = s->l = 0;
+    s->a2 = s->f2 = s->b2 = s->c2 = s->d2 = s->e2 = s->h2 = s->l2 = 0;
+    s->ix = s->iy = 0;
+    s->i = s->r = s->iff1 = s->iff2 = s->im = 0;
+    s->halted = 0;
+    s->exited = 0;
+    s->exit_code = 0;
+    s->cycles = 0;
+    s->instructions = 0;
+    s->syscall_count = 0;
+    s->pc = pc;
+    s->sp = sp;
+}
+
+static uint8_t exec_cb(zsim_t* s, uint8_t idx) {
+    uint16_t addr = 0;
+    uint8_t op;
+    uint8_t x, y, z;
+    uint8_t v;
+    if (idx) {
+        addr = mem_operand(s, idx);
+        op = fetch(s);
+    } else {
+        op = fetch(s);
+    }
+    x = (uint8_t)(op >> 6);
+    y = (uint8_t)((op >> 3) & 7);
+    z = (uint8_t)(op & 7);
+    if (idx) {
+        v = rd(s, addr);
+    } else if (z == 6) {
+        addr = get_hl(s);
+        v = rd(s, addr);
+    } else {
+        v = get_r(s, z, 0);
+    }
+    switch (x) {
+        case 0:
+            v = rot(s, y, v);
+            break;
+        case 1:
+            s->f = (uint8_t)((s->f & FC) | FH |
+                             ((v & (1 << y)) ? 0 : (FZ | FPV)) |
+                             (y == 7 && (v & 0x80) ? FS : 0));
+            if (idx) return 20;
+            return (uint8_t)(z == 6 ? 12 : 8);
+        case 2:
+            v = (uint8_t)(v & ~(1 << y));
+            break;
+        default:
+            v = (uint8_t)(v | (1 << y));
+            break;
+    }
+    if (idx) {
+        wr(s, addr, v);
+        if (z != 6) set_r(s, z, 0, v);
+        return 23;
+    }
+    if (z == 6) {
+        wr(s, addr, v);
+        return 15;
+    }
+    set_r(s, z, 0, v);
+    return 8;
+}
+
+static uint8_t exec_ed(zsim_t* s) {
+    uint8_t op = fetch(s);
+    uint8_t x = (uint8_t)(op >> 6);
+    uint8_t y = (uint8_t)((op >> 3) & 7);
+    uint8_t z = (uint8_t)(op & 7);
+    uint8_t p = (uint8_t)(y >> 1);
+    uint8_t q = (uint8_t)(y & 1);
+    if (x == 1) {
+        switch (z) {
+            case 0: { /* IN r,(C) */
+                uint8_t v = 0xFF;
+                if (y != 6) set_r(s, y, 0, v);
+                s->f = (uint8_t)((s->f & FC) | szp(v));
+                return 12;
+            }
+            case 1: /* OUT (C),r */
+                return 12;
+            case 2:
+                if (q == 0) set_hl(s, sbc16(s, get_hl(s), get_rp(s, p, 0)));
+                else set_hl(s, adc16(s, get_hl(s), get_rp(s, p, 0)));
+                return 15;
+            case 3: {
+                uint16_t nn = fetch16(s);
+                if (q == 0) wr16(s, nn, get_rp(s, p, 0));
+                else set_rp(s, p, 0, rd16(s, nn));
+                return 20;
+            }
+            case 4: { /* NEG */
+                uint8_t v = s->a;
+                s->a = 0;
+                alu(s, 2, v);
+                return 8;
+            }
+            case 5: /* RETN/RETI */
+                s->pc = pop16(s);
+                s->iff1 = s->iff2;
+                return 14;
+            case 6:
+                s->im = (uint8_t)(y & 3);
+                return 8;
+            default:
+                switch (y) {
+                    case 0: s->i = s->a; return 9;
+                    case 1: s->r = s->a; return 9;
+                    case 2:
+                        s->a = s->i;
+                        s->f = (uint8_t)((s->f & FC) | sz(s->a) | (s->iff2 ? FPV : 0));
+                        return 9;
+                    case 3:
+                        s->a = s->r;
+                        s->f = (uint8_t)((s->f & FC) | sz(s->a) | (s->iff2 ? FPV : 0));
+                        return 9;
+                    case 4: { /* RRD */
+                        uint16_t hl = get_hl(s);
+                        uint8_t m = rd(s, hl);
+                        wr(s, hl, (uint8_t)((s->a << 4) | (m >> 4)));
+                        s->a = (uint8_t)((s->a & 0xF0) | (m & 0x0F));
+                        s->f = (uint8_t)((s->f & FC) | szp(s->a));
+                        return 18;
+                    }
+                    case 5: { /* RLD */
+                        uint16_t hl = get_hl(s);
+                        uint8_t m = rd(s, hl);
+                        wr(s, hl, (uint8_t)((m << 4) | (s->a & 0x0F)));
+                        s->a = (uint8_t)((s->a & 0xF0) | (m >> 4));
+                        s->f = (uint8_t)((s->f & FC) | szp(s->a));
+                        return 18;
+                    }
+                    default:
+                        return 8;
+                }
+        }
+    }
+    if (x == 2 && z <= 1 && y >= 4) {
+        int8_t dir = (y & 1) ? -1 : 1;
+        uint8_t repeat = (uint8_t)(y >= 6);
+        uint16_t hl = get_hl(s);
+        uint16_t bc;
+        if (z == 0) { /* LDI/LDD/LDIR/LDDR */
+            uint16_t de = get_de(s);
+            wr(s, de, rd(s, hl));
+            set_hl(s, (uint16_t)(hl + dir));
+            set_de(s, (uint16_t)(de + dir));
+            bc = (uint16_t)(get_bc(s) - 1);
+            set_bc(s, bc);
+            s->f = (uint8_t)((s->f & (FS | FZ | FC)) | (bc ? FPV : 0));
+            if (repeat && bc) {
+                s->pc = (uint16_t)(s->pc - 2);
+                return 21;
+            }
+            return 16;
+        } else { /* CPI/CPD/CPIR/CPDR */
+            uint8_t v = rd(s, hl);
+            uint8_t res = (uint8_t)(s->a - v);
+            set_hl(s, (uint16_t)(hl + dir));
+            bc = (uint16_t)(get_bc(s) - 1);
+            set_bc(s, bc);
+            s->f = (uint8_t)((s->f & FC) | sz(res) | FN |
+                             (((s->a & 0x0F) - (v & 0x0F)) & 0x10 ? FH : 0) |
+                             (bc ? FPV : 0));
+            if (repeat && bc && res != 0) {
+                s->pc = (uint16_t)(s->pc - 2);
+                return 21;
+            }
+            return 16;
+        }
+    }
+    /* Block I/O and invalid ED opcodes act as NOPs */
+    return 8;
+}
+
+static uint8_t exec_main(zsim_t* s, uint8_t op, uint8_t idx) {
+    uint8_t x = (uint8_t)(op >> 6);
+    uint8_t y = (uint8_t)((op >> 3) & 7);
+    uint8_t z = (uint8_t)(op & 7);
+    uint8_t p = (uint8_t)(y >> 1);
+    uint8_t q = (uint8_t)(y & 1);
+    /* Extra cost of an (IX+d) operand over (HL) */
+    uint8_t ixd = (uint8_t)(idx ? 8 : 0);
+
+    switch (x) {
+        case 0:
+            switch (z) {
+                case 0:
+                    switch (y) {
+                        case 0: return 4;
+                        case 1: {
+                            uint8_t t;
+                            t = s->a; s->a = s->a2; s->a2 = t;
+                            t = s->f; s->f = s->f2; s->f2 = t;
+                            return 4;
+                        }
+                        case 2: {
+                            int8_t d = (int8_t)fetch(s);
+                            s->b--;
+                            if (s->b) {
+                                s->pc = (uint16_t)(s->pc + d);
+                                return 13;
+                            }
+                            return 8;
+                        }
+                        case 3: {
+                            int8_t d = (int8_t)fetch(s);
+                            s->pc = (uint16_t)(s->pc + d);
+                            return 12;
+                        }
+                        default: {
+                            int8_t d = (int8_t)fetch(s);
+                            if (cond(s, (uint8_t)(y - 4))) {
+                                s->pc = (uint16_t)(s->pc + d);
+                                return 12;
+                            }
+                            return 7;
+                        }
+                    }
+                case 1:
+                    if (q == 0) {
+                        set_rp(s, p, idx, fetch16(s));
+                        return 10;
+                    }
+                    set_xy(s, idx, add16(s, get_xy(s, idx), get_rp(s, p, idx)));
+                    return 11;
+                case 2:
+                    switch (y) {
+                        case 0: wr(s, get_bc(s), s->a); return 7;
+                        case 1: s->a = rd(s, get_bc(s)); return 7;
+                        case 2: wr(s, get_de(s), s->a); return 7;
+                        case 3: s->a = rd(s, get_de(s)); return 7;
+                        case 4: wr16(s, fetch16(s), get_xy(s, idx)); return 16;
+                        case 5: set_xy(s, idx, rd16(s, fetch16(s))); return 16;
+                        case 6: wr(s, fetch16(s), s->a); return 13;
+                        default: s->a = rd(s, fetch16(s)); return 13;
+                    }
+                case 3:
+                    if (q == 0) set_rp(s, p, idx, (uint16_t)(get_rp(s, p, idx) + 1));
+                    else set_rp(s, p, idx, (uint16_t)(get_rp(s, p, idx) - 1));
+                    return 6;
+                case 4:
+                case 5:
+                    if (y == 6) {
+                        uint16_t addr = mem_operand(s, idx);
+                        uint8_t v = rd(s, addr);
+                        v = z == 4 ? inc8(s, v) : dec8(s, v);
+                        wr(s, addr, v);
+                        return (uint8_t)(11 + ixd);
+                    }
+                    if (z == 4) set_r(s, y, idx, inc8(s, get_r(s, y, idx)));
+                    else set_r(s, y, idx, dec8(s, get_r(s, y, idx)));
+                    return 4;
+                case 6:
+                    if (y == 6) {
+                        uint16_t addr = mem_operand(s, idx);
+                        wr(s, addr, fetch(s));
+                        return (uint8_t)(idx ? 15 : 10);
+                    }
+                    set_r(s, y, idx, fetch(s));
+                    return 7;
+                default:
+                    switch (y) {
+                        case 0: { /* RLCA */
+                            uint8_t c = (uint8_t)(s->a >> 7);
+                            s->a = (uint8_t)((s->a << 1) | c);
+                            s->f = (uint8_t)((s->f & (FS | FZ | FPV)) | c);
+                            return 4;
+                        }
+                        case 1: { /* RRCA */
+                            uint8_t c = (uint8_t)(s->a & 1);
+                            s->a = (uint8_t)((s->a >> 1) | (c << 7));
+                            s->f = (uint8_t)((s->f & (FS | FZ | FPV)) | c);
+                            return 4;
+                        }
+                        case 2: { /* RLA */
+                            uint8_t c = (uint8_t)(s->a >> 7);
+                            s->a = (uint8_t)((s->a << 1) | (s->f & FC));
+                            s->f = (uint8_t)((s->f & (FS | FZ | FPV)) | c);
+                            return 4;
+                        }
+                        case 3: { /* RRA */
+                            uint8_t c = (uint8_t)(s->a & 1);
+                            s->a = (uint8_t)((s->a >> 1) | ((s->f & FC) << 7));
+                            s->f = (uint8_t)((s->f & (FS | FZ | FPV)) | c);
+                            return 4;
+                        }
+                        case 4: daa(s); return 4;
+                        case 5:
+                            s->a = (uint8_t)~s->a;
+                            s->f = (uint8_t)(s->f | FH | FN);
+                            return 4;
+                        case 6:
+                            s->f = (uint8_t)((s->f & (FS | FZ | FPV)) | FC);
+                            return 4;
+                        default:
+                            s->f = (uint8_t)((s->f & (FS | FZ | FPV)) |
+                                             ((s->f & FC) ? FH : FC));
+                            return 4;
+                    }
+            }
+        case 1:
+            if (y == 6 && z == 6) {
+                s->halted = 1;
+                return 4;
+            }
+            if (y == 6) {
+                uint16_t addr = mem_operand(s, idx);
+                wr(s, addr, get_r(s, z, 0));
+                return (uint8_t)(7 + ixd);
+            }
+            if (z == 6) {
+                uint16_t addr = mem_operand(s, idx);
+                set_r(s, y, 0, rd(s, addr));
+                return (uint8_t)(7 + ixd);
+            }
+            set_r(s, y, idx, get_r(s, z, idx));
+            return 4;
+        case 2:
+            if (z == 6) {
+                uint16_t addr = mem_operand(s, idx);
+                alu(s, y, rd(s, addr));
+                return (uint8_t)(7 + ixd);
+            }
+            alu(s, y, get_r(s, z, idx));
+            return 4;
+        default:
+            switch (z) {
+                case 0:
+                    if (cond(s, y)) {
+                        s->pc = pop16(s);
+                        return 11;
+                    }
+                    return 5;
+                case 1:
+                    if (q == 0) {
+                        set_rp2(s, p, idx, pop16(s));
+                        return 10;
+                    }
+                    switch (p) {
+                        case 0:
+                            s->pc = pop16(s);
+                            return 10;
+                        case 1: {
+                            uint8_t t;
+                            t = s->b; s->b = s->b2; s->b2 = t;
+                            t = s->c; s->c = s->c2; s->c2 = t;
+                            t = s->d; s->d = s->d2; s->d2 = t;
+                            t = s->e; s->e = s->e2; s->e2 = t;
+                            t = s->h; s->h = s->h2; s->h2 = t;
+                            t = s->l; s->l = s->l2; s->l2 = t;
+                            return 4;
+                        }
+                        case 2:
+                            s->pc = get_xy(s, idx);
+                            return 4;
+                        default:
+                            s->sp = get_xy(s, idx);
+                            return 6;
+                    }
+                case 2: {
+                    uint16_t nn = fetch16(s);
+                    if (cond(s, y)) s->pc = nn;
+                    return 10;
+                }
+                case 3:
+                    switch (y) {
+                        case 0:
+                            s->pc = fetch16(s);
+                            return 10;
+                        case 1:
+                            return exec_cb(s, idx);
+                        case 2:
+                            fetch(s);
+                            return 11;
+                        case 3:
+                            fetch(s);
+                            s->a = 0xFF;
+                            return 11;
+                        case 4: {
+                            uint16_t v = rd16(s, s->sp);
+                            wr16(s, s->sp, get_xy(s, idx));
+                            set_xy(s, idx, v);
+                            return 19;
+                        }
+                        case 5: {
+                            uint16_t v = get_de(s);
+                            set_de(s, get_hl(s));
+                            set_hl(s, v);
+                            return 4;
+                        }
+                        case 6:
+                            s->iff1 = s->iff2 = 0;
+                            return 4;
+                        default:
+                            s->iff1 = s->iff2 = 1;
+                            return 4;
+                    }
+                case 4: {
+                    uint16_t nn = fetch16(s);
+                    if (cond(s, y)) {
+                        push16(s, s->pc);
+                        s->pc = nn;
+                        return 17;
+                    }
+                    return 10;
+                }
+                case 5:
+                    if (q == 0) {
+                        push16(s, get_rp2(s, p, idx));
+                        return 11;
+                    }
+                    if (p == 0) {
+                        uint16_t nn = fetch16(s);
+                        push16(s, s->pc);
+                        s->pc = nn;
+                        return 17;
+                    }
+                    if (p == 2) return exec_ed(s);
+                    /* DD/FD after a prefix: treated as NOP prefix */
+                    return 4;
+                case 6:
+                    alu(s, y, fetch(s));
+                    return 7;
+                default:
+                    push16(s, s->pc);
+                    s->pc = (uint16_t)(y * 8);
+                    return 11;
+            }
+    }
+}
+
+uint8_t zsim_step(zsim_t* s) {
+    uint8_t op;
+    uint8_t idx = 0;
+    uint8_t t = 0;
+    if (s->exited) return 0;
+    if (s->halted) {
+        s->cycles += 4;
+        return 4;
+    }
+    /* ZOS syscall entry: rst 0x08 lands here. Service and return. */
+    if (s->pc == 0x0008) {
+        zsim_syscall(s);
+        s->pc = pop16(s);
+        s->cycles += 10;
+        s->instructions++;
+        return 10;
+    }
+    op = fetch(s);
+    s->r = (uint8_t)((s->r & 0x80) | ((s->r + 1) & 0x7F));
+    while (op == 0xDD || op == 0xFD) {
+        idx = (uint8_t)(op == 0xDD ? 1 : 2);
+        t = (uint8_t)(t + 4);
+        op = fetch(s);
+    }
+    if (op == 0xCB) {
+        t = (uint8_t)(t + exec_cb(s, idx));
+        if (idx) t = (uint8_t)(t - 4);
+    } else if (op == 0xED) {
+        t = (uint8_t)(t + exec_ed(s));
+    } else {
+        t = (uint8_t)(t + exec_main(s, op, idx));
+    }
+    s->cycles += t;
+    s->instructions++;
+    return t;
+}
@@ -35,16 +35,25 @@ EXPECTED_RESULTS = {
     "goto": "B2",
     "global": "0A",
     "if": "2A",
+    "inline": "4D",
     "bitwise": "E4",
+    "bits": "3B",
+    "blocks": "5B",
+    "loops": "4C",
     "math": "3A",
+    "narrow": "5A",
     "params": "14",
     "pointer": "86",
     "simple_return": "0C",
     "return16": "EF",
+    "scopes": "48",
     "struct": None,
     "signs": "EE",
+    "strings": "68",
+    "tables": "15",
     "semantic": None,
     "ternary": None,
+    "types": "5C",
     "unary": "AA",
     "while": "0A",
     "zealos": "EA",
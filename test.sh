@@ -14,6 +14,10 @@ esac
 CC_PARSE="bin/cc_parse_${ARCH}"
 CC_SEMANTIC="bin/cc_semantic_${ARCH}"
 CC_CODEGEN="bin/cc_codegen_${ARCH}"
+CC_DRIVER="bin/cc_${ARCH}"
+CC_LOWER="bin/cc_lower_${ARCH}"
+CC_ISEL="bin/cc_isel_${ARCH}"
+ZSIM="bin/zsim_${ARCH}"
 
 if [[ ! -x "$CC_PARSE" ]]; then
   echo "Missing $CC_PARSE. Build host binaries first."
@@ -27,8 +31,18 @@ if [[ ! -x "$CC_CODEGEN" ]]; then
   echo "Missing $CC_CODEGEN. Build host binaries first."
   exit 1
 fi
+if [[ ! -x "$CC_DRIVER" ]]; then
+  echo "Missing $CC_DRIVER. Build host binaries first."
+  exit 1
+fi
+for tool in "$CC_LOWER" "$CC_ISEL" "$ZSIM"; do
+  if [[ ! -x "$tool" ]]; then
+    echo "Missing $tool. Build host binaries first."
+    exit 1
+  fi
+done
 
-rm -f tests/*.asm tests/*.bin tests/*.ast
+rm -f tests/*.asm tests/*.bin tests/*.ast tests/*.ir
 
 TESTS=(
   break
@@ -43,24 +57,64 @@ TESTS=(
   goto
   global
   if
+  inline
   bitwise
+  bits
+  blocks
+  loops
   math
+  narrow
   params
   pointer
   simple_return
   return16
+  scopes
   signs
+  strings
   struct
+  tables
   ternary
+  types
   unary
   while
   zealos
   semantic
 )
 
+# Exit codes checked through the IR pipeline (cc_lower, cc_isel) under zsim;
+# the same values as EXPECTED_RESULTS in test.py
+declare -A IR_EXPECTED=(
+  [break]=B1 [assign]=15 [array]=EF [char]=41 [comp]=4E [compares]=3F
+  [expr]=1C [for]=0A [goto]=B2 [global]=0A [if]=2A [inline]=4D
+  [bitwise]=E4 [bits]=3B [blocks]=5B [loops]=4C [math]=3A [narrow]=5A
+  [params]=14 [pointer]=86 [simple_return]=0C [return16]=EF [scopes]=48
+  [signs]=EE [strings]=68 [tables]=15 [types]=5C [unary]=AA [while]=0A
+  [zealos]=EA
+)
 
 FAILED=0
 
+# Lowers tests/<name>.ast through the IR and checks its exit code
+run_ir() {
+  local name="$1"
+  local src="tests/${name}.c"
+  local ir="tests/${name}.ir"
+  local asm="tests/${name}.ir.asm"
+  local want="${IR_EXPECTED[$name]:-}"
+  local got
+  [[ -n "$want" ]] || return 0
+  if ! "$CC_LOWER" "tests/${name}.ast" "$ir" >/dev/null || ! "$CC_ISEL" "$ir" "$asm" >/dev/null; then
+    echo "IR pipeline failed: ${src}"
+    return 1
+  fi
+  got="$("$ZSIM" --quiet "$asm" 2>&1 >/dev/null | sed -n 's/.*exit=0x\([0-9A-F]*\).*/\1/p')"
+  rm -f "$ir" "$asm"
+  if [[ "$got" != "$want" ]]; then
+    echo "IR exit code differs: ${src} (0x${got:-??}, expected 0x${want})"
+    return 1
+  fi
+}
+
 run_test() {
   local name="$1"
   local src="tests/${name}.c"
@@ -92,6 +146,17 @@ run_test() {
     FAILED=1
     return
   fi
+  if ! "$CC_DRIVER" "$src" -o "tests/${name}.cc.asm" >/dev/null || ! cmp -s "$asm" "tests/${name}.cc.asm"; then
+    echo "Driver output differs: ${src}"
+    FAILED=1
+    rm -f "tests/${name}.cc.asm"
+    return
+  fi
+  rm -f "tests/${name}.cc.asm"
+  if ! run_ir "$name"; then
+    FAILED=1
+    return
+  fi
   echo "OK: ${src}"
 }
 
@@ -99,5 +164,17 @@ for test_name in "${TESTS[@]}"; do
   run_test "$test_name"
 done
 
+# The driver finds runtime/ from its own path, so a cached build works from
+# any directory: once to fill the cache, once to hit it
+CACHE_DIR="$(mktemp -d)"
+for pass in fill hit; do
+  if ! (cd "$CACHE_DIR" && "$ROOT_DIR/$CC_DRIVER" --cache . "$ROOT_DIR/tests/while.c" -o while.asm >/dev/null) ||
+     ! cmp -s tests/while.asm "$CACHE_DIR/while.asm"; then
+    echo "Driver output differs outside the source tree (cache ${pass})"
+    FAILED=1
+  fi
+done
+rm -rf "$CACHE_DIR"
+
 echo "!!! Complete !!!"
 exit "$FAILED"
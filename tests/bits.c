@@ -0,0 +1,95 @@
+/* Single-byte mask tests and updates */
+unsigned char g_flags = 0x21;
+int g_word = 0x0400;
+unsigned char g_regs[4];
+
+int test_local(void) {
+    unsigned char f;
+    int w;
+
+    f = 0x08;
+    w = 0x0201;
+    if (!(f & 0x08)) return 0x01;
+    if (f & 0x10) return 0x02;
+    if ((f & 0x0C) == 0) return 0x03;
+    if ((w & 0x0200) != 0x0200) return 0x04;
+    if (!(w & 0x0200)) return 0x05;
+    if (0x0100 & w) return 0x06;
+
+    f = f | 0x40;
+    f = f & ~0x08;
+    f = f ^ 0x03;
+    if (f != 0x43) return 0x07;
+    w = w | 0x8000;
+    w = w & ~0x0001;
+    w = 0x0030 | w;
+    if (w != 0x8230) return 0x08;
+    return 0;
+}
+
+int test_global(void) {
+    int n;
+
+    g_flags = g_flags & 0xFE;
+    g_word = g_word | 0x0100;
+    if (g_flags != 0x20) return 0x09;
+    if (!(g_word & 0x0100)) return 0x0A;
+    if (g_word != 0x0500) return 0x0B;
+
+    n = 0;
+    while (g_flags & 0x20) {
+        g_flags = g_flags & ~0x20;
+        n = n + 1;
+    }
+    if (n != 1) return 0x0C;
+    return 0;
+}
+
+int test_indirect(void) {
+    unsigned char* reg;
+    char i;
+
+    reg = g_regs + 1;
+    *reg = 0;
+    *reg = *reg | 0x80;
+    if (!(*reg & 0x80)) return 0x0D;
+    for (i = 0; i < 4; i++) {
+        g_regs[i] = g_regs[i] | 0x02;
+    }
+    g_regs[2] = g_regs[2] & ~0x02;
+    if (g_regs[2] & 0x02) return 0x0E;
+    if ((g_regs[3] & 0x02) == 0) return 0x0F;
+    if (g_regs[1] != 0x82) return 0x10;
+    return 0;
+}
+
+int test_shift(void) {
+    unsigned char b;
+    int r;
+
+    /* A byte shifted left keeps the bits that leave the low byte */
+    b = 0x81;
+    r = b << 4;
+    if (r != 0x0810) return 0x11;
+    r = g_flags << 8;
+    if (r != 0x0000) return 0x12;
+    g_flags = 0xC0;
+    r = g_flags << 2;
+    if (r != 0x0300) return 0x13;
+    return 0;
+}
+
+int main() {
+    int result = 0;
+
+    result = test_local();
+    if (result) return result;
+    result = test_global();
+    if (result) return result;
+    result = test_indirect();
+    if (result) return result;
+    result = test_shift();
+    if (result) return result;
+
+    return 0x3B;
+}
@@ -1,7 +1,15 @@
 int a = 1;
 int b = 2;
 int c = 3;
+/* Uninitialized globals are emitted as zeroed .dw/.db lines */
+int d;
+char e;
+char* p;
 
 int main() {
+    d = 5;
+    e = 6;
+    p = &e;
+    if (d + *p != 11) return 0x01;
     return a + b + c + 4; /* Expected return: 10 (0x0A). */
 }
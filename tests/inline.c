@@ -0,0 +1,143 @@
+/* Small functions expanded at their call sites */
+int g_total = 0;
+unsigned char g_flags = 0;
+
+static int twice(int x) {
+    return x + x;
+}
+
+static inline int mix(int a, int b) {
+    return (a << 2) + (b ^ 3) - (a & b);
+}
+
+static void add_total(int n) {
+    g_total = g_total + n;
+}
+
+static unsigned char low_nibble(unsigned char b) {
+    return b & 0x0F;
+}
+
+inline void set_flag(unsigned char mask) {
+    g_flags = g_flags | mask;
+}
+
+int square(int x) {
+    return x * x;
+}
+
+int nested(void) {
+    int a;
+
+    a = 3;
+    if (twice(twice(a)) != 12) return 0x01;
+    if (square(a) + twice(a) != 15) return 0x02;
+    if (mix(a, 5) != 17) return 0x0A;
+    return 0;
+}
+
+int statements(void) {
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        add_total(i);
+    }
+    if (g_total != 6) return 0x03;
+    if (g_total == 6) add_total(twice(2));
+    if (g_total != 10) return 0x04;
+    set_flag(0x01);
+    set_flag(0x80);
+    if (g_flags != 0x81) return 0x05;
+    twice(i);
+    return 0;
+}
+
+int conditional(void) {
+    int n;
+
+    n = 0;
+    while (twice(n) < 10) {
+        n = n + 1;
+    }
+    if (n != 5) return 0x06;
+    if (n == 5 || square(n) == 0) {
+        n = low_nibble(0x3C);
+    }
+    if (n != 0x0C) return 0x07;
+    return 0;
+}
+
+int shadowed(void) {
+    int g_total;
+
+    g_total = 100;
+    add_total(1);
+    if (g_total != 100) return 0x08;
+    return 0;
+}
+
+int shadowed_late(void) {
+    int n;
+
+    n = 1;
+    add_total(n);
+    if (n) {
+        int g_total;
+
+        g_total = 50;
+        if (g_total != 50) return 0x0B;
+    }
+    return 0;
+}
+
+int many_calls(void) {
+    int t;
+
+    t = 0;
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    t = t + twice(1);
+    if (t != 48) return 0x0C;
+    return 0;
+}
+
+int main() {
+    int result = 0;
+
+    result = nested();
+    if (result) return result;
+    result = statements();
+    if (result) return result;
+    result = conditional();
+    if (result) return result;
+    result = shadowed();
+    if (result) return result;
+    result = shadowed_late();
+    if (result) return result;
+    result = many_calls();
+    if (result) return result;
+    if (g_total != 12) return 0x09;
+
+    return 0x4D;
+}
@@ -0,0 +1,151 @@
+/* Loop bodies with invariant and non-invariant sub-expressions */
+char g_table[4];
+char g_count = 0;
+char* g_ptr;
+int g_limit = 5;
+char* g_word = "abcd";
+
+void bump(void) {
+    g_count = g_count + 1;
+}
+
+int local_array_base(void) {
+    char buf[4];
+    char i;
+    char sum;
+
+    i = 0;
+    while (i < 4) {
+        buf[i] = i + 1;
+        i = i + 1;
+    }
+    sum = 0;
+    for (i = 0; i < 4; i = i + 1) {
+        sum = sum + buf[i];
+    }
+    if (sum != 10) return 0x01;
+    return 0;
+}
+
+int global_changed_by_call(void) {
+    char i;
+    char total;
+
+    g_count = 0;
+    total = 0;
+    for (i = 0; i < 3; i = i + 1) {
+        total = total + g_count * 2;
+        bump();
+    }
+    if (total != 6) return 0x02;
+    return 0;
+}
+
+int local_changed_through_pointer(void) {
+    char step;
+    char i;
+    char total;
+
+    step = 1;
+    g_ptr = &step;
+    total = 0;
+    i = 0;
+    while (i < 3) {
+        total = total + step * 3;
+        *g_ptr = step + 1;
+        i = i + 1;
+    }
+    if (total != 18) return 0x03;
+    return 0;
+}
+
+int nested_with_continue(void) {
+    char i;
+    char j;
+    char hits;
+    char scale;
+
+    scale = 6;
+    hits = 0;
+    i = 0;
+    while (i < 4) {
+        i = i + 1;
+        if (i == 2) continue;
+        for (j = 0; j < 2; j = j + 1) {
+            g_table[j] = scale / 2 + j;
+            hits = hits + g_table[j];
+        }
+    }
+    if (hits != 21) return 0x04;
+    return 0;
+}
+
+int two_local_arrays(void) {
+    char src[4];
+    char dst[4];
+    char i;
+
+    for (i = 0; i < 4; i = i + 1) {
+        src[i] = i + 3;
+    }
+    for (i = 0; i < 4; i = i + 1) {
+        dst[i] = src[i];
+    }
+    if (dst[3] != 6 || dst[0] != 3) return 0x05;
+    return 0;
+}
+
+int sum_until(char* p, char stop) {
+    int i;
+
+    for (i = 0; p[i]; i++) {
+        if (p[i] == stop) return i + 0x100;
+    }
+    return i;
+}
+
+int invariant_pointers(void) {
+    int v;
+    int* q;
+    int* lim;
+    char i;
+    int total;
+
+    v = 1;
+    q = &v;
+    total = 0;
+    for (i = 0; i < 3; i = i + 1) {
+        total = total + v;
+        *q = v + 1;
+    }
+    if (total != 6) return 0x06;
+    lim = &g_limit;
+    total = 0;
+    for (i = 0; i < 3; i = i + 1) {
+        total = total + g_limit;
+        *lim = g_limit + 1;
+    }
+    if (total != 18) return 0x07;
+    if (sum_until(g_word, 'c') != 0x102) return 0x08;
+    if (sum_until(g_word, 'x') != 4) return 0x09;
+    return 0;
+}
+
+int main() {
+    int result = 0;
+
+    result = local_array_base();
+    if (result) return result;
+    result = global_changed_by_call();
+    if (result) return result;
+    result = local_changed_through_pointer();
+    if (result) return result;
+    result = nested_with_continue();
+    if (result) return result;
+    result = two_local_arrays();
+    if (result) return result;
+    result = invariant_pointers();
+    if (result) return result;
+
+    return 0x4C;
+}
@@ -1,3 +1,32 @@
+int g_x;
+int g_y;
+
+/* Through globals, so the operands' ranges are unknown to the code
+ * generator and the 16-bit runtime multiply is used */
+int product(int x, int y) {
+    g_x = x;
+    g_y = y;
+    return g_x * g_y;
+}
+
+int multiply(void) {
+    signed int s;
+
+    if (product(0, 1234) != 0) return 0x0A;
+    if (product(1234, 0) != 0) return 0x0B;
+    if (product(1, 0x1234) != 0x1234) return 0x0C;
+    if (product(0x1234, 1) != 0x1234) return 0x0D;
+    if (product(200, 2) != 400) return 0x0E;
+    if (product(255, 255) != 0xFE01) return 0x0F;
+    if (product(0xFFFF, 0xFFFF) != 1) return 0x10;
+    if (product(0x8000, 2) != 0) return 0x11;
+    s = product(-3, 5);
+    if (s != -15) return 0x12;
+    s = product(-3, -4);
+    if (s != 12) return 0x13;
+    return 0;
+}
+
 int main() {
     int total = 0;
     int a = 6;
@@ -30,5 +59,7 @@ int main() {
     total = total + v;
 
     if (total != 58) return 0x09;
+    v = multiply();
+    if (v) return v;
     return 0x3A; /* Should return 58 (0x3A) */
 }
@@ -0,0 +1,109 @@
+/* int locals whose values provably fit a byte */
+unsigned char g_bits = 0xF3;
+char g_big = 200;
+
+int count_up(void) {
+    int i;
+    int sum;
+
+    sum = 0;
+    for (i = 0; i < 10; i++) {
+        sum = sum + i;
+    }
+    if (sum != 45) return 0x01;
+    if (i != 10) return 0x02;
+    return 0;
+}
+
+int count_past_byte(void) {
+    int n;
+
+    n = 0;
+    while (n < 300) {
+        n = n + 1;
+    }
+    if (n != 300) return 0x03;
+    return 0;
+}
+
+int count_down(void) {
+    int k;
+    int steps;
+
+    k = 200;
+    steps = 0;
+    while (k > 0) {
+        k = k - 1;
+        steps = steps + 1;
+    }
+    if (k != 0) return 0x04;
+    if (steps != 200) return 0x05;
+    return 0;
+}
+
+int wide_compare(void) {
+    int i;
+
+    i = 0;
+    if (i - 1 == 255) return 0x06;
+    if (i + 255 != 255) return 0x07;
+    return 0;
+}
+
+int masked(void) {
+    int low;
+
+    low = (g_bits & 0x0F) + 1;
+    if (low != 4) return 0x08;
+    if ((g_bits >> 4) + (g_bits & 0x0F) != 18) return 0x09;
+    return 0;
+}
+
+int wide_product(void) {
+    int x;
+    int y;
+
+    x = 0x0280;
+    y = 0x0140;
+    if ((x * y) >> 8 != 0x20) return 0x0A;
+    return 0;
+}
+
+int promoted(void) {
+    char q;
+    unsigned char b;
+    int r;
+
+    /* Byte operands are promoted to int before the arithmetic */
+    q = g_big;
+    b = 0x81;
+    r = q + q;
+    if (r != 400) return 0x0B;
+    if (q * 2 < 256) return 0x0C;
+    if ((b << 1) != 0x102) return 0x0D;
+    /* and a byte result keeps only the low byte */
+    q = q + q;
+    if (q != 144) return 0x0E;
+    return 0;
+}
+
+int main() {
+    int result = 0;
+
+    result = count_up();
+    if (result) return result;
+    result = count_past_byte();
+    if (result) return result;
+    result = count_down();
+    if (result) return result;
+    result = wide_compare();
+    if (result) return result;
+    result = masked();
+    if (result) return result;
+    result = wide_product();
+    if (result) return result;
+    result = promoted();
+    if (result) return result;
+
+    return 0x5A;
+}
@@ -0,0 +1,62 @@
+/* More than 32 names in one scope, and names reused in sibling blocks. */
+char g0 = 0;
+char g1 = 1;
+char g2 = 2;
+char g3 = 3;
+char g4 = 0;
+char g5 = 1;
+char g6 = 2;
+char g7 = 3;
+char g8 = 0;
+char g9 = 1;
+char g10 = 2;
+char g11 = 3;
+char g12 = 0;
+char g13 = 1;
+char g14 = 2;
+char g15 = 3;
+char g16 = 0;
+char g17 = 1;
+char g18 = 2;
+char g19 = 3;
+char g20 = 0;
+char g21 = 1;
+char g22 = 2;
+char g23 = 3;
+char g24 = 0;
+char g25 = 1;
+char g26 = 2;
+char g27 = 3;
+char g28 = 0;
+char g29 = 1;
+char g30 = 2;
+char g31 = 3;
+char g32 = 0;
+char g33 = 1;
+char g34 = 2;
+char g35 = 3;
+char g36 = 0;
+char g37 = 1;
+char g38 = 2;
+char g39 = 3;
+
+int main() {
+    int total;
+
+    total = g0 + g1 + g2 + g3 + g4 + g5 + g6 + g7;
+    total = total + g8 + g9 + g10 + g11 + g12 + g13 + g14 + g15;
+    total = total + g16 + g17 + g18 + g19 + g20 + g21 + g22 + g23;
+    total = total + g24 + g25 + g26 + g27 + g28 + g29 + g30 + g31;
+    total = total + g32 + g33 + g34 + g35 + g36 + g37 + g38 + g39;
+    {
+        int t;
+        t = 4;
+        total = total + t;
+    }
+    {
+        char t;
+        t = 8;
+        total = total + t;
+    }
+    return total; /* Expected return: 60 + 4 + 8 = 72 (0x48). */
+}
@@ -0,0 +1,24 @@
+char* g_error = "parse error";
+char* g_short = "or";
+
+int main() {
+    char* a = "error";
+    char* b = "parse error";
+    char* c = "";
+    char* d = "ror";
+    int sum;
+
+    sum = 0;
+    /* "error", "ror" and "or" end "parse error"; wherever they are placed,
+     * each still reads as its own string */
+    if (a[0] == 'e' && a[5] == 0) sum = sum + 1;
+    if (d[0] == 'r' && d[3] == 0) sum = sum + 2;
+    if (g_short[0] == 'o' && g_short[2] == 0) sum = sum + 4;
+    if (g_error[6] == b[6] && b[11] == 0) sum = sum + 8;
+    if (c[0] == 0) sum = sum + 16;
+    sum = sum + a[4] + d[2] + "parse"[4];
+
+    /* Actual return: 0x1F + 'r' + 'r' + 'e' = 0x168 */
+    /* Expected return: 0x68. */
+    return sum;
+}
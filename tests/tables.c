@@ -0,0 +1,221 @@
+/* More globals, locals and string literals than codegen's old fixed
+ * tables held (64 of each) */
+char g00 = 0;
+char g01 = 1;
+char g02 = 2;
+char g03 = 3;
+char g04 = 4;
+char g05 = 5;
+char g06 = 6;
+char g07 = 7;
+char g08 = 8;
+char g09 = 9;
+char g10 = 10;
+char g11 = 11;
+char g12 = 12;
+char g13 = 13;
+char g14 = 14;
+char g15 = 15;
+char g16 = 16;
+char g17 = 17;
+char g18 = 18;
+char g19 = 19;
+char g20 = 20;
+char g21 = 21;
+char g22 = 22;
+char g23 = 23;
+char g24 = 24;
+char g25 = 25;
+char g26 = 26;
+char g27 = 27;
+char g28 = 28;
+char g29 = 29;
+char g30 = 30;
+char g31 = 31;
+char g32 = 32;
+char g33 = 33;
+char g34 = 34;
+char g35 = 35;
+char g36 = 36;
+char g37 = 37;
+char g38 = 38;
+char g39 = 39;
+char g40 = 40;
+char g41 = 41;
+char g42 = 42;
+char g43 = 43;
+char g44 = 44;
+char g45 = 45;
+char g46 = 46;
+char g47 = 47;
+char g48 = 48;
+char g49 = 49;
+char g50 = 50;
+char g51 = 51;
+char g52 = 52;
+char g53 = 53;
+char g54 = 54;
+char g55 = 55;
+char g56 = 56;
+char g57 = 57;
+char g58 = 58;
+char g59 = 59;
+char g60 = 60;
+char g61 = 61;
+char g62 = 62;
+char g63 = 63;
+char g64 = 64;
+char g65 = 65;
+char g66 = 66;
+char g67 = 67;
+char g68 = 68;
+char g69 = 69;
+
+int main() {
+    char l00 = 1;
+    char l01 = 2;
+    char l02 = 3;
+    char l03 = 4;
+    char l04 = 5;
+    char l05 = 6;
+    char l06 = 7;
+    char l07 = 8;
+    char l08 = 9;
+    char l09 = 10;
+    char l10 = 11;
+    char l11 = 12;
+    char l12 = 13;
+    char l13 = 14;
+    char l14 = 15;
+    char l15 = 16;
+    char l16 = 17;
+    char l17 = 18;
+    char l18 = 19;
+    char l19 = 20;
+    char l20 = 21;
+    char l21 = 22;
+    char l22 = 23;
+    char l23 = 24;
+    char l24 = 25;
+    char l25 = 26;
+    char l26 = 27;
+    char l27 = 28;
+    char l28 = 29;
+    char l29 = 30;
+    char l30 = 31;
+    char l31 = 32;
+    char l32 = 33;
+    char l33 = 34;
+    char l34 = 35;
+    char l35 = 36;
+    char l36 = 37;
+    char l37 = 38;
+    char l38 = 39;
+    char l39 = 40;
+    char l40 = 41;
+    char l41 = 42;
+    char l42 = 43;
+    char l43 = 44;
+    char l44 = 45;
+    char l45 = 46;
+    char l46 = 47;
+    char l47 = 48;
+    char l48 = 49;
+    char l49 = 50;
+    char l50 = 51;
+    char l51 = 52;
+    char l52 = 53;
+    char l53 = 54;
+    char l54 = 55;
+    char l55 = 56;
+    char l56 = 57;
+    char l57 = 58;
+    char l58 = 59;
+    char l59 = 60;
+    char l60 = 61;
+    char l61 = 62;
+    char l62 = 63;
+    char l63 = 64;
+    char l64 = 65;
+    char l65 = 66;
+    char l66 = 67;
+    char l67 = 68;
+    char l68 = 69;
+    char l69 = 70;
+    int sum = 0;
+
+    sum = sum + g00 - l00 + "00"[1];
+    sum = sum + g01 - l01 + "01"[1];
+    sum = sum + g02 - l02 + "02"[1];
+    sum = sum + g03 - l03 + "03"[1];
+    sum = sum + g04 - l04 + "04"[1];
+    sum = sum + g05 - l05 + "05"[1];
+    sum = sum + g06 - l06 + "06"[1];
+    sum = sum + g07 - l07 + "07"[1];
+    sum = sum + g08 - l08 + "08"[1];
+    sum = sum + g09 - l09 + "09"[1];
+    sum = sum + g10 - l10 + "10"[1];
+    sum = sum + g11 - l11 + "11"[1];
+    sum = sum + g12 - l12 + "12"[1];
+    sum = sum + g13 - l13 + "13"[1];
+    sum = sum + g14 - l14 + "14"[1];
+    sum = sum + g15 - l15 + "15"[1];
+    sum = sum + g16 - l16 + "16"[1];
+    sum = sum + g17 - l17 + "17"[1];
+    sum = sum + g18 - l18 + "18"[1];
+    sum = sum + g19 - l19 + "19"[1];
+    sum = sum + g20 - l20 + "20"[1];
+    sum = sum + g21 - l21 + "21"[1];
+    sum = sum + g22 - l22 + "22"[1];
+    sum = sum + g23 - l23 + "23"[1];
+    sum = sum + g24 - l24 + "24"[1];
+    sum = sum + g25 - l25 + "25"[1];
+    sum = sum + g26 - l26 + "26"[1];
+    sum = sum + g27 - l27 + "27"[1];
+    sum = sum + g28 - l28 + "28"[1];
+    sum = sum + g29 - l29 + "29"[1];
+    sum = sum + g30 - l30 + "30"[1];
+    sum = sum + g31 - l31 + "31"[1];
+    sum = sum + g32 - l32 + "32"[1];
+    sum = sum + g33 - l33 + "33"[1];
+    sum = sum + g34 - l34 + "34"[1];
+    sum = sum + g35 - l35 + "35"[1];
+    sum = sum + g36 - l36 + "36"[1];
+    sum = sum + g37 - l37 + "37"[1];
+    sum = sum + g38 - l38 + "38"[1];
+    sum = sum + g39 - l39 + "39"[1];
+    sum = sum + g40 - l40 + "40"[1];
+    sum = sum + g41 - l41 + "41"[1];
+    sum = sum + g42 - l42 + "42"[1];
+    sum = sum + g43 - l43 + "43"[1];
+    sum = sum + g44 - l44 + "44"[1];
+    sum = sum + g45 - l45 + "45"[1];
+    sum = sum + g46 - l46 + "46"[1];
+    sum = sum + g47 - l47 + "47"[1];
+    sum = sum + g48 - l48 + "48"[1];
+    sum = sum + g49 - l49 + "49"[1];
+    sum = sum + g50 - l50 + "50"[1];
+    sum = sum + g51 - l51 + "51"[1];
+    sum = sum + g52 - l52 + "52"[1];
+    sum = sum + g53 - l53 + "53"[1];
+    sum = sum + g54 - l54 + "54"[1];
+    sum = sum + g55 - l55 + "55"[1];
+    sum = sum + g56 - l56 + "56"[1];
+    sum = sum + g57 - l57 + "57"[1];
+    sum = sum + g58 - l58 + "58"[1];
+    sum = sum + g59 - l59 + "59"[1];
+    sum = sum + g60 - l60 + "60"[1];
+    sum = sum + g61 - l61 + "61"[1];
+    sum = sum + g62 - l62 + "62"[1];
+    sum = sum + g63 - l63 + "63"[1];
+    sum = sum + g64 - l64 + "64"[1];
+    sum = sum + g65 - l65 + "65"[1];
+    sum = sum + g66 - l66 + "66"[1];
+    sum = sum + g67 - l67 + "67"[1];
+    sum = sum + g68 - l68 + "68"[1];
+    sum = sum + g69 - l69 + "69"[1];
+
+    /* Actual return: 70 * -1 + 7 * ('0' + ... + '9') = 0xE15 */
+    /* Expected return: 0x15. */
+    return sum;
+}
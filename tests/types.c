@@ -0,0 +1,274 @@
+/* 24 functions with three local arrays each, of a different length or
+ * element type: 72 array types, more than the first version 2 type table
+ * held (64) */
+
+int f00(void) {
+    char a[1];
+    int b[1];
+    signed char c[1];
+    a[0] = 1;
+    b[0] = 2;
+    c[0] = 3;
+    return a[0] + b[0] + c[0];
+}
+
+int f01(void) {
+    char a[2];
+    int b[2];
+    signed char c[2];
+    a[1] = 1;
+    b[1] = 2;
+    c[1] = 3;
+    return a[1] + b[1] + c[1];
+}
+
+int f02(void) {
+    char a[3];
+    int b[3];
+    signed char c[3];
+    a[2] = 1;
+    b[2] = 2;
+    c[2] = 3;
+    return a[2] + b[2] + c[2];
+}
+
+int f03(void) {
+    char a[4];
+    int b[4];
+    signed char c[4];
+    a[3] = 1;
+    b[3] = 2;
+    c[3] = 3;
+    return a[3] + b[3] + c[3];
+}
+
+int f04(void) {
+    char a[5];
+    int b[5];
+    signed char c[5];
+    a[4] = 1;
+    b[4] = 2;
+    c[4] = 3;
+    return a[4] + b[4] + c[4];
+}
+
+int f05(void) {
+    char a[6];
+    int b[6];
+    signed char c[6];
+    a[5] = 1;
+    b[5] = 2;
+    c[5] = 3;
+    return a[5] + b[5] + c[5];
+}
+
+int f06(void) {
+    char a[7];
+    int b[7];
+    signed char c[7];
+    a[6] = 1;
+    b[6] = 2;
+    c[6] = 3;
+    return a[6] + b[6] + c[6];
+}
+
+int f07(void) {
+    char a[8];
+    int b[8];
+    signed char c[8];
+    a[7] = 1;
+    b[7] = 2;
+    c[7] = 3;
+    return a[7] + b[7] + c[7];
+}
+
+int f08(void) {
+    char a[9];
+    int b[9];
+    signed char c[9];
+    a[8] = 1;
+    b[8] = 2;
+    c[8] = 3;
+    return a[8] + b[8] + c[8];
+}
+
+int f09(void) {
+    char a[10];
+    int b[10];
+    signed char c[10];
+    a[9] = 1;
+    b[9] = 2;
+    c[9] = 3;
+    return a[9] + b[9] + c[9];
+}
+
+int f10(void) {
+    char a[11];
+    int b[11];
+    signed char c[11];
+    a[10] = 1;
+    b[10] = 2;
+    c[10] = 3;
+    return a[10] + b[10] + c[10];
+}
+
+int f11(void) {
+    char a[12];
+    int b[12];
+    signed char c[12];
+    a[11] = 1;
+    b[11] = 2;
+    c[11] = 3;
+    return a[11] + b[11] + c[11];
+}
+
+int f12(void) {
+    char a[13];
+    int b[13];
+    signed char c[13];
+    a[12] = 1;
+    b[12] = 2;
+    c[12] = 3;
+    return a[12] + b[12] + c[12];
+}
+
+int f13(void) {
+    char a[14];
+    int b[14];
+    signed char c[14];
+    a[13] = 1;
+    b[13] = 2;
+    c[13] = 3;
+    return a[13] + b[13] + c[13];
+}
+
+int f14(void) {
+    char a[15];
+    int b[15];
+    signed char c[15];
+    a[14] = 1;
+    b[14] = 2;
+    c[14] = 3;
+    return a[14] + b[14] + c[14];
+}
+
+int f15(void) {
+    char a[16];
+    int b[16];
+    signed char c[16];
+    a[15] = 1;
+    b[15] = 2;
+    c[15] = 3;
+    return a[15] + b[15] + c[15];
+}
+
+int f16(void) {
+    char a[17];
+    int b[17];
+    signed char c[17];
+    a[16] = 1;
+    b[16] = 2;
+    c[16] = 3;
+    return a[16] + b[16] + c[16];
+}
+
+int f17(void) {
+    char a[18];
+    int b[18];
+    signed char c[18];
+    a[17] = 1;
+    b[17] = 2;
+    c[17] = 3;
+    return a[17] + b[17] + c[17];
+}
+
+int f18(void) {
+    char a[19];
+    int b[19];
+    signed char c[19];
+    a[18] = 1;
+    b[18] = 2;
+    c[18] = 3;
+    return a[18] + b[18] + c[18];
+}
+
+int f19(void) {
+    char a[20];
+    int b[20];
+    signed char c[20];
+    a[19] = 1;
+    b[19] = 2;
+    c[19] = 3;
+    return a[19] + b[19] + c[19];
+}
+
+int f20(void) {
+    char a[21];
+    int b[21];
+    signed char c[21];
+    a[20] = 1;
+    b[20] = 2;
+    c[20] = 3;
+    return a[20] + b[20] + c[20];
+}
+
+int f21(void) {
+    char a[22];
+    int b[22];
+    signed char c[22];
+    a[21] = 1;
+    b[21] = 2;
+    c[21] = 3;
+    return a[21] + b[21] + c[21];
+}
+
+int f22(void) {
+    char a[23];
+    int b[23];
+    signed char c[23];
+    a[22] = 1;
+    b[22] = 2;
+    c[22] = 3;
+    return a[22] + b[22] + c[22];
+}
+
+int f23(void) {
+    char a[24];
+    int b[24];
+    signed char c[24];
+    a[23] = 1;
+    b[23] = 2;
+    c[23] = 3;
+    return a[23] + b[23] + c[23];
+}
+
+int main() {
+    int total = 0;
+
+    total = total + f00();
+    total = total + f01();
+    total = total + f02();
+    total = total + f03();
+    total = total + f04();
+    total = total + f05();
+    total = total + f06();
+    total = total + f07();
+    total = total + f08();
+    total = total + f09();
+    total = total + f10();
+    total = total + f11();
+    total = total + f12();
+    total = total + f13();
+    total = total + f14();
+    total = total + f15();
+    total = total + f16();
+    total = total + f17();
+    total = total + f18();
+    total = total + f19();
+    total = total + f20();
+    total = total + f21();
+    total = total + f22();
+    total = total + f23();
+    if (total != 144) return 0x01;
+    return 0x5C;
+}